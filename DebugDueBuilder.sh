@@ -313,6 +313,15 @@ Step 1, clean operation and configuration options:
                     for the first time (or after cleaning it).
                     There are also some caveats, see this script's source code
                     for details about ccache.
+  --disable-cpp-exceptions  Builds the firmware with -fno-exceptions.
+                    Only the DebugDue project supports this option.
+                    Like --enable-ccache, it only takes effect when configuring
+                    the project for the first time (or after cleaning it).
+  --enable-stack-usage-report  Generates a worst-case stack usage report
+                    for the main loop and for each interrupt handler
+                    next to the firmware. This option disables LTO.
+                    Like --enable-ccache, it only takes effect when configuring
+                    the project for the first time (or after cleaning it).
 
 Step 2, build operations:
   --autogen  Regenerates the autoconf files, so that the next build will
@@ -367,7 +376,8 @@ Step 4, debug operations:
   --openocd-path="openocd-0.10.0/bin/openocd"  Path to the OpenOCD executable.
 
 Global options:
-  --project="<project name>"  Specify 'DebugDue' (the default), 'EmptyFirmware' or 'QemuFirmware'.
+  --project="<project name>"  Specify 'DebugDue' (the default), 'EmptyFirmware',
+                              'QemuFirmware' or 'QemuBenchmark'.
   --toolchain-dir="<path>"
   --build-type="<type>"  Build types are "debug" and "release".
 
@@ -585,6 +595,14 @@ do_configure ()
 
   quote_and_append_args CONFIG_CMD "--with-project=$PROJECT_NAME"
 
+  if $DISABLE_CPP_EXCEPTIONS_SPECIFIED; then
+    quote_and_append_args CONFIG_CMD "--enable-cpp-exceptions=no"
+  fi
+
+  if $ENABLE_STACK_USAGE_REPORT_SPECIFIED; then
+    quote_and_append_args CONFIG_CMD "--enable-stack-usage-report=yes"
+  fi
+
   quote_and_append_args CONFIG_CMD "--host=$TARGET_ARCH"
   # I have not figured out yet how to get the value passed as --host to configure.ac ,
   # so I am passing it again in a separate command-line option.
@@ -692,6 +710,8 @@ process_command_line_argument ()
     autogen) AUTOGEN_SPECIFIED=true;;
     build) BUILD_SPECIFIED=true;;
     enable-ccache) ENABLE_CCACHE_SPECIFIED=true;;
+    disable-cpp-exceptions) DISABLE_CPP_EXCEPTIONS_SPECIFIED=true;;
+    enable-stack-usage-report) ENABLE_STACK_USAGE_REPORT_SPECIFIED=true;;
     disassemble) DISASSEMBLE_SPECIFIED=true;;
     program-over-jtag) PROGRAM_OVER_JTAG_SPECIFIED=true;;
     program-with-bossac) PROGRAM_WITH_BOSSAC_SPECIFIED=true;;
@@ -1851,6 +1871,14 @@ do_run_in_qemu ()
 
   quote_and_append_args  QEMU_CMD  "-semihosting"
 
+  if [[ $PROJECT_NAME_LOWERCASE = "qemubenchmark" ]]; then
+    # With -icount, the virtual clock advances by 2^shift nanoseconds per instruction executed,
+    # instead of following the host's real time. This way, the SysTick counts in the benchmark results
+    # are deterministic and can be compared between builds. Use shift=0 so that the count
+    # is as fine-grained as possible.
+    quote_and_append_args  QEMU_CMD  "-icount"  "shift=0"
+  fi
+
   if $DEBUG_SPECIFIED; then
     # OpenOCD uses port number 3333 by default, so use the same port here. If you wish to change it,
     # you will need to pass it as an argument to script DebuggerStarterHelper.sh too.
@@ -1972,6 +2000,8 @@ USER_LONG_OPTIONS_SPEC+=( [enable-configure-cache]=0 )
 USER_LONG_OPTIONS_SPEC+=( [autogen]=0 )
 USER_LONG_OPTIONS_SPEC+=( [build]=0 )
 USER_LONG_OPTIONS_SPEC+=( [enable-ccache]=0 )
+USER_LONG_OPTIONS_SPEC+=( [disable-cpp-exceptions]=0 )
+USER_LONG_OPTIONS_SPEC+=( [enable-stack-usage-report]=0 )
 USER_LONG_OPTIONS_SPEC+=( [disassemble]=0 )
 USER_LONG_OPTIONS_SPEC+=( [program-over-jtag]=0 )
 USER_LONG_OPTIONS_SPEC+=( [program-with-bossac]=0 )
@@ -2003,6 +2033,8 @@ CONFIGURE_CACHE_FILENAME=""
 AUTOGEN_SPECIFIED=false
 BUILD_SPECIFIED=false
 ENABLE_CCACHE_SPECIFIED=false
+DISABLE_CPP_EXCEPTIONS_SPECIFIED=false
+ENABLE_STACK_USAGE_REPORT_SPECIFIED=false
 DISASSEMBLE_SPECIFIED=false
 PROGRAM_OVER_JTAG_SPECIFIED=false
 PROGRAM_WITH_BOSSAC_SPECIFIED=false
@@ -2052,6 +2084,7 @@ case "${PROJECT_NAME_LOWERCASE}" in
   debugdue)       PROJECT_NAME="DebugDue" ;;
   emptyfirmware) PROJECT_NAME="EmptyFirmware" ;;
   qemufirmware) PROJECT_NAME="QemuFirmware" ;;
+  qemubenchmark) PROJECT_NAME="QemuBenchmark" ;;
   *) abort "Invalid project name \"$PROJECT\"." ;;
 esac
 
@@ -2169,7 +2202,7 @@ if $CACHE_PROGRAMMED_FILE_SPECIFIED && ! $PROGRAM_OVER_JTAG_SPECIFIED && ! $PROG
   abort "Option '--cache-programmed-file' is only valid when programming the firmware."
 fi
 
-if [[ $PROJECT_NAME_LOWERCASE = "qemufirmware" ]]; then
+if [[ $PROJECT_NAME_LOWERCASE = "qemufirmware" || $PROJECT_NAME_LOWERCASE = "qemubenchmark" ]]; then
 
   if $PROGRAM_OVER_JTAG_SPECIFIED || $PROGRAM_WITH_BOSSAC_SPECIFIED; then
     abort "Cannot program a Qemu firmware. You can only run it with option '--debug'."
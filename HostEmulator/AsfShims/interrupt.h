@@ -0,0 +1,47 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+// This header replaces the Atmel Software Framework header of the same name for the host emulator.
+//
+// There are no interrupts on the host, so these routines do nothing.
+
+#include <stdint.h>
+
+#include "sam3xa.h"
+
+typedef uint32_t irqflags_t;
+
+inline bool cpu_irq_is_enabled ( void ) throw()
+{
+  return true;
+}
+
+inline irqflags_t cpu_irq_save ( void ) throw()
+{
+  return 0;
+}
+
+inline void cpu_irq_restore ( irqflags_t ) throw()
+{
+}
+
+inline void cpu_irq_disable ( void ) throw()
+{
+}
+
+inline void cpu_irq_enable ( void ) throw()
+{
+}
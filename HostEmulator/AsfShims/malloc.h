@@ -0,0 +1,25 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+// This header wraps the system header of the same name for the host emulator.
+//
+// glibc has deprecated mallinfo(), whose fields are 'int', in favour of mallinfo2(), whose fields are 'size_t',
+// like newlib's mallinfo() on the Arduino Due. The firmware then uses the same code on both platforms.
+// mallinfo2() is available since glibc 2.33 .
+
+#include_next <malloc.h>
+
+#define mallinfo  mallinfo2
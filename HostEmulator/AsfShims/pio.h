@@ -0,0 +1,37 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+// This header replaces the Atmel Software Framework header of the same name for the host emulator.
+// The pin configuration routines are implemented in SimulatedPio.cpp .
+
+#include <stdint.h>
+
+#include "sam3xa.h"
+
+#define PIO_PULLUP  ( 1u << 0 )
+
+#define DISABLE  0
+#define ENABLE   1
+
+#define LOW   0
+#define HIGH  1
+
+void pio_set_input ( Pio * p_pio, uint32_t ul_mask, uint32_t ul_attribute ) throw();
+
+void pio_set_output ( Pio * p_pio, uint32_t ul_mask,
+                      uint32_t ul_default_level,
+                      uint32_t ul_multidrive_enable,
+                      uint32_t ul_pull_up_enable ) throw();
@@ -0,0 +1,111 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+// This header replaces the CMSIS header of the same name for the host emulator.
+// It only provides the definitions that the firmware modules compiled for the host actually use.
+//
+// The PIO registers are simulated, see SimulatedPio.h . The other peripherals
+// are plain variables that nobody looks at, except for the DWT cycle counter,
+// which follows the host's monotonic clock, so that time budgets in the firmware work as expected.
+
+#include <stdint.h>
+
+#include "../SimulatedPio.h"
+
+
+// ------ Cycle counter ------
+
+class CHostCycleCounterRegister
+{
+public:
+  operator uint32_t () const throw();
+
+  CHostCycleCounterRegister & operator= ( uint32_t val ) throw();
+};
+
+struct HostDwtType
+{
+  uint32_t CTRL;
+  CHostCycleCounterRegister CYCCNT;
+};
+
+struct HostCoreDebugType
+{
+  uint32_t DEMCR;
+};
+
+extern HostDwtType       g_hostDwt;
+extern HostCoreDebugType g_hostCoreDebug;
+
+#define DWT        ( &g_hostDwt )
+#define CoreDebug  ( &g_hostCoreDebug )
+
+#define DWT_CTRL_CYCCNTENA_Msk        ( 1UL << 0 )
+#define CoreDebug_DEMCR_TRCENA_Msk    ( 1UL << 24 )
+
+
+// ------ SysTick ------
+
+struct HostSysTickType
+{
+  uint32_t CTRL;
+  uint32_t LOAD;
+  uint32_t VAL;
+};
+
+extern HostSysTickType g_hostSysTick;
+
+#define SysTick  ( &g_hostSysTick )
+
+#define SysTick_CTRL_CLKSOURCE_Msk  ( 1UL << 2 )
+#define SysTick_LOAD_RELOAD_Msk     ( 0xFFFFFFUL )
+
+
+// ------ Core registers ------
+
+// There is no interrupt context on the host, and the interrupts are always enabled.
+
+#define IPSR_ISR_Msk  ( 0x1FFUL )
+
+inline uint32_t __get_IPSR ( void ) throw()
+{
+  return 0;
+}
+
+inline uint32_t __get_PRIMASK ( void ) throw()
+{
+  return 0;
+}
+
+inline void __disable_irq ( void ) throw()
+{
+}
+
+inline void __enable_irq ( void ) throw()
+{
+}
+
+
+// ------ Reset controller ------
+
+struct Rstc
+{
+  uint32_t RSTC_SR;
+};
+
+extern Rstc g_hostRstc;
+
+#define RSTC  ( &g_hostRstc )
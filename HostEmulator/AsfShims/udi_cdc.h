@@ -0,0 +1,23 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+// This header replaces the Atmel Software Framework header of the same name for the host emulator.
+// The pseudo-terminal plays the role of the USB CDC serial port, see PtyConnection.cpp .
+
+#include <stdint.h>
+
+// Returns the number of bytes that could not be sent.
+uint32_t udi_cdc_write_buf ( const void * buf, uint32_t size );
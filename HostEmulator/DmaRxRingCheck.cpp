@@ -0,0 +1,279 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+// This program checks the ring buffer logic in BareMetalSupport/DmaRxRing.h , which the UART bridge
+// uses for its DMA reception buffer. It simulates a DMA engine that writes a known byte sequence
+// and checks what the reader gets, including wrap-around at the end of the buffer, data lost
+// when the DMA engine overtakes the reader, and the DMA byte counter wrapping at 2^32.
+// It runs as part of "make check", see RunChecks.sh .
+//
+// The exit code is 0 if all checks pass.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include <BareMetalSupport/DmaRxRing.h>
+
+
+static const uint32_t RING_SIZE = 16;
+
+typedef CDmaRxRing< RING_SIZE > CTestRing;
+
+static unsigned s_errorCount = 0;
+
+
+static void Check ( const bool condition, const char * const what, const uint32_t expected, const uint32_t actual )
+{
+  if ( condition )
+    return;
+
+  ++s_errorCount;
+
+  // Do not flood the output if something is badly broken.
+  if ( s_errorCount <= 10 )
+    fprintf( stderr, "Mismatch in %s: expected %" PRIu32 ", actual %" PRIu32 ".\n", what, expected, actual );
+}
+
+
+static void CheckEqual ( const char * const what, const uint32_t expected, const uint32_t actual )
+{
+  Check( expected == actual, what, expected, actual );
+}
+
+
+// The byte the simulated DMA engine writes at the given position in the data stream.
+// It depends on the upper bits too, so that reading from the wrong lap is noticed.
+
+static uint8_t GetStreamByte ( const uint32_t streamPos )
+{
+  return uint8_t( streamPos ^ ( streamPos >> 8 ) ^ ( streamPos >> 16 ) ^ ( streamPos >> 24 ) );
+}
+
+
+// Writes round and round into the ring buffer like the DMA engine does, without looking at the reader.
+
+class CSimulatedDma
+{
+  CTestRing * const m_ring;
+  uint32_t m_writeCount;  // Modulo 2^32, like UartPort_GetRxWriteCount().
+
+ public:
+  CSimulatedDma ( CTestRing * const ring, const uint32_t initialWriteCount )
+    : m_ring( ring )
+    , m_writeCount( initialWriteCount )
+  {
+  }
+
+  uint32_t GetWriteCount ( void ) const { return m_writeCount; }
+
+  void Write ( const uint32_t byteCount )
+  {
+    for ( uint32_t i = 0; i < byteCount; ++i )
+    {
+      m_ring->GetBuffer()[ m_writeCount % RING_SIZE ] = GetStreamByte( m_writeCount );
+      ++m_writeCount;
+    }
+  }
+};
+
+
+// Reads up to maxByteCount bytes and checks them against the stream, starting at *expectedStreamPos.
+// Returns the number of bytes read.
+
+static uint32_t ReadAndCheck ( CTestRing * const ring,
+                               const CSimulatedDma & dma,
+                               uint32_t * const expectedStreamPos,
+                               const uint32_t maxByteCount )
+{
+  uint32_t readCount = 0;
+
+  while ( readCount < maxByteCount )
+  {
+    uint32_t elemCount;
+    const uint8_t * const readPtr = ring->GetReadPtr( dma.GetWriteCount(), &elemCount );
+
+    if ( elemCount == 0 )
+      break;
+
+    // The returned block must not go past the end of the buffer.
+    Check( readPtr + elemCount <= ring->GetBuffer() + RING_SIZE,
+           "GetReadPtr() block end", RING_SIZE, uint32_t( readPtr - ring->GetBuffer() ) + elemCount );
+
+    CheckEqual( "GetReadPtr() position", *expectedStreamPos % RING_SIZE, uint32_t( readPtr - ring->GetBuffer() ) );
+
+    if ( elemCount > maxByteCount - readCount )
+      elemCount = maxByteCount - readCount;
+
+    for ( uint32_t i = 0; i < elemCount; ++i )
+    {
+      CheckEqual( "read data", GetStreamByte( *expectedStreamPos ), readPtr[ i ] );
+      ++*expectedStreamPos;
+    }
+
+    ring->ConsumeReadElements( elemCount );
+    readCount += elemCount;
+  }
+
+  return readCount;
+}
+
+
+// The reader drains the buffer in chunks smaller than the buffer, so that the read position
+// wraps around at the end of the buffer many times. Nothing should get lost.
+
+static void CheckWrapAround ( const uint32_t initialWriteCount )
+{
+  CTestRing ring;
+  CSimulatedDma dma( &ring, initialWriteCount );
+  ring.Reset( dma.GetWriteCount() );
+
+  uint32_t expectedStreamPos = initialWriteCount;
+
+  for ( uint32_t i = 0; i < 200; ++i )
+  {
+    const uint32_t writeCount = 1 + i % RING_SIZE;
+
+    dma.Write( writeCount );
+
+    CheckEqual( "GetElemCount() after writing", writeCount, ring.GetElemCount( dma.GetWriteCount() ) );
+
+    // When the data straddles the end of the buffer, the first block stops there.
+    uint32_t elemCount;
+    ring.GetReadPtr( dma.GetWriteCount(), &elemCount );
+    const uint32_t untilEndCount = RING_SIZE - expectedStreamPos % RING_SIZE;
+    CheckEqual( "GetReadPtr() block length", writeCount < untilEndCount ? writeCount : untilEndCount, elemCount );
+
+    CheckEqual( "bytes read", writeCount, ReadAndCheck( &ring, dma, &expectedStreamPos, UINT32_MAX ) );
+    CheckEqual( "GetElemCount() after reading", 0, ring.GetElemCount( dma.GetWriteCount() ) );
+  }
+
+  CheckEqual( "lost count without overruns", 0, ring.GetLostCount() );
+}
+
+
+// The DMA engine overtakes the reader. The reader should skip to the oldest byte still
+// in the buffer and count the skipped bytes as lost.
+
+static void CheckOverrun ( const uint32_t initialWriteCount )
+{
+  CTestRing ring;
+  CSimulatedDma dma( &ring, initialWriteCount );
+  ring.Reset( dma.GetWriteCount() );
+
+  uint32_t expectedStreamPos = initialWriteCount;
+  uint32_t expectedLostCount = 0;
+
+  // Read a little first, so that the read position is not at the beginning of the buffer.
+  dma.Write( 5 );
+  ReadAndCheck( &ring, dma, &expectedStreamPos, 3 );
+
+  // Exactly full is not an overrun yet.
+  dma.Write( RING_SIZE - 2 );
+  CheckEqual( "GetElemCount() when full", RING_SIZE, ring.GetElemCount( dma.GetWriteCount() ) );
+  CheckEqual( "lost count when full", 0, ring.GetLostCount() );
+
+  // One more byte overwrites the oldest one.
+  dma.Write( 1 );
+  ++expectedLostCount;
+  ++expectedStreamPos;
+  CheckEqual( "GetElemCount() after a 1-byte overrun", RING_SIZE, ring.GetElemCount( dma.GetWriteCount() ) );
+  CheckEqual( "lost count after a 1-byte overrun", expectedLostCount, ring.GetLostCount() );
+  CheckEqual( "bytes read after a 1-byte overrun", RING_SIZE, ReadAndCheck( &ring, dma, &expectedStreamPos, UINT32_MAX ) );
+
+  // The DMA engine laps the reader several times.
+  const uint32_t lapCount = 3 * RING_SIZE + 7;
+  dma.Write( lapCount );
+  expectedLostCount += lapCount - RING_SIZE;
+  expectedStreamPos  += lapCount - RING_SIZE;
+
+  // GetReadPtr() must skip the lost data too, not just GetElemCount().
+  CheckEqual( "bytes read after several laps", RING_SIZE, ReadAndCheck( &ring, dma, &expectedStreamPos, UINT32_MAX ) );
+  CheckEqual( "lost count after several laps", expectedLostCount, ring.GetLostCount() );
+
+  // Reset() discards everything and clears the lost count.
+  dma.Write( RING_SIZE + 1 );
+  ring.Reset( dma.GetWriteCount() );
+  CheckEqual( "GetElemCount() after Reset()", 0, ring.GetElemCount( dma.GetWriteCount() ) );
+  CheckEqual( "lost count after Reset()", 0, ring.GetLostCount() );
+}
+
+
+// A random mix of writes and reads, checked against a simple model of what should be lost.
+
+static uint64_t s_randomState = 1;
+
+static uint32_t GetRandomValue ( void )
+{
+  s_randomState = s_randomState * 6364136223846793005ULL + 1442695040888963407ULL;
+  return uint32_t( s_randomState >> 32 );
+}
+
+static void CheckRandomTraffic ( const uint32_t initialWriteCount )
+{
+  CTestRing ring;
+  CSimulatedDma dma( &ring, initialWriteCount );
+  ring.Reset( dma.GetWriteCount() );
+
+  uint32_t expectedStreamPos = initialWriteCount;
+  uint32_t expectedLostCount = 0;
+
+  for ( uint32_t i = 0; i < 10000; ++i )
+  {
+    dma.Write( GetRandomValue() % ( RING_SIZE + RING_SIZE / 2 ) );
+
+    const uint32_t pendingCount = dma.GetWriteCount() - expectedStreamPos;
+
+    if ( pendingCount > RING_SIZE )
+    {
+      expectedLostCount += pendingCount - RING_SIZE;
+      expectedStreamPos += pendingCount - RING_SIZE;
+    }
+
+    // The ring buffer only notices the lost data when the reader looks at it.
+    CheckEqual( "GetElemCount() with random traffic",
+                dma.GetWriteCount() - expectedStreamPos,
+                ring.GetElemCount( dma.GetWriteCount() ) );
+
+    CheckEqual( "lost count with random traffic", expectedLostCount, ring.GetLostCount() );
+
+    ReadAndCheck( &ring, dma, &expectedStreamPos, GetRandomValue() % ( RING_SIZE + 1 ) );
+  }
+}
+
+
+int main ( void )
+{
+  // The DMA byte counter starts at 0 after a reset, but wraps around at 2^32 after 4 GiB.
+  // Start just below 2^32 too, so that each check crosses that point.
+  const uint32_t initialWriteCounts[] = { 0, UINT32_MAX - RING_SIZE * 3 };
+
+  for ( const uint32_t initialWriteCount : initialWriteCounts )
+  {
+    CheckWrapAround( initialWriteCount );
+    CheckOverrun( initialWriteCount );
+    CheckRandomTraffic( initialWriteCount );
+  }
+
+  if ( s_errorCount != 0 )
+  {
+    fprintf( stderr, "%u mismatch(es) found.\n", s_errorCount );
+    return EXIT_FAILURE;
+  }
+
+  printf( "The DMA reception ring buffer behaves as expected.\n" );
+  return EXIT_SUCCESS;
+}
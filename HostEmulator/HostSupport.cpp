@@ -0,0 +1,322 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "HostSupport.h"  // The include file for this module should come first.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <assert.h>
+
+#include <sam3xa.h>
+
+#include <BareMetalSupport/Uptime.h>
+#include <BareMetalSupport/MainLoopSleep.h>
+#include <BareMetalSupport/SerialPrint.h>
+#include <BareMetalSupport/StackCheck.h>
+#include <BareMetalSupport/BusyWait.h>
+#include <BareMetalSupport/DebugConsoleSerialSync.h>
+#include <BareMetalSupport/LinkScriptSymbols.h>
+#include <BareMetalSupport/Miscellaneous.h>
+
+#include <BoardSupport-ArduinoDue/DebugConsoleSupport.h>
+
+#include <Misc/AssertionUtils.h>
+
+
+HostDwtType       g_hostDwt;
+HostCoreDebugType g_hostCoreDebug;
+HostSysTickType   g_hostSysTick = { SysTick_CTRL_CLKSOURCE_Msk, 0, 0 };
+Rstc              g_hostRstc;
+
+volatile uint64_t g_updateCounter_internalUseOnly = 0;
+
+static uint64_t s_startTimeUs = GetHostMonotonicTimeUs();
+
+
+uint64_t GetHostMonotonicTimeUs ( void ) throw()
+{
+  timespec ts;
+
+  if ( 0 != clock_gettime( CLOCK_MONOTONIC, &ts ) )
+  {
+    Panic( "clock_gettime() failed." );
+  }
+
+  return uint64_t( ts.tv_sec ) * 1000000 + uint64_t( ts.tv_nsec ) / 1000;
+}
+
+
+void UpdateHostUptime ( void ) throw()
+{
+  g_updateCounter_internalUseOnly = ( GetHostMonotonicTimeUs() - s_startTimeUs ) / 1000;
+}
+
+
+// ------ Cycle counter ------
+
+// The cycle counter runs at CPU_CLOCK, like on the Arduino Due, but follows the host's clock.
+
+static uint32_t s_cycleCounterOffset = 0;
+
+static uint32_t GetHostCycleCount ( void ) throw()
+{
+  return uint32_t( GetHostMonotonicTimeUs() * ( CPU_CLOCK / 1000000 ) );
+}
+
+CHostCycleCounterRegister::operator uint32_t () const throw()
+{
+  return GetHostCycleCount() - s_cycleCounterOffset;
+}
+
+CHostCycleCounterRegister & CHostCycleCounterRegister::operator= ( const uint32_t val ) throw()
+{
+  s_cycleCounterOffset = GetHostCycleCount() - val;
+  return *this;
+}
+
+
+// ------ Serial port (the debug console) ------
+
+void SerialPrintStr ( const char * const msg )
+{
+  fputs( msg, stdout );
+  fflush( stdout );
+}
+
+
+void SerialPrintV ( const char * const formatStr, va_list argList )
+{
+  vprintf( formatStr, argList );
+  fflush( stdout );
+}
+
+
+void SerialPrintf ( const char * const formatStr, ... )
+{
+  va_list argList;
+  va_start( argList, formatStr );
+
+  SerialPrintV( formatStr, argList );
+
+  va_end( argList );
+}
+
+
+void SerialPrintHexDump ( const void * const ptr, const size_t byteCount, const char * const endOfLineChars )
+{
+  const uint8_t * const bytes = static_cast< const uint8_t * >( ptr );
+
+  for ( size_t i = 0; i < byteCount; ++i )
+  {
+    printf( "%02X%s", unsigned( bytes[ i ] ), ( i % 16 == 15 || i + 1 == byteCount ) ? endOfLineChars : " " );
+  }
+
+  fflush( stdout );
+}
+
+
+void WriteSerialPortCharSync ( const uint8_t c ) throw()
+{
+  putchar( c );
+  fflush( stdout );
+}
+
+
+void SerialSyncWriteStr ( const char * const msg ) throw()
+{
+  SerialPrintStr( msg );
+}
+
+
+void SerialSyncWriteUint32Hex ( const uint32_t val ) throw()
+{
+  printf( "0x%08X", unsigned( val ) );
+  fflush( stdout );
+}
+
+
+void SerialWaitForDataSent ( void ) throw()
+{
+  fflush( stdout );
+}
+
+
+// ------ Main loop sleep ------
+
+// The main loop in Main.cpp waits on the pseudo-terminal with poll() instead,
+// see ConsumeMainLoopWakeUpRequest().
+
+static bool s_wasMainLoopWakeUpRequested = false;
+
+void WakeFromMainLoopSleep ( void ) throw()
+{
+  s_wasMainLoopWakeUpRequested = true;
+}
+
+
+bool ConsumeMainLoopWakeUpRequest ( void ) throw()
+{
+  const bool wasRequested = s_wasMainLoopWakeUpRequested;
+  s_wasMainLoopWakeUpRequested = false;
+  return wasRequested;
+}
+
+
+void MainLoopSleep ( void )
+{
+}
+
+
+void CpuLoadStatsTick ( void ) throw()
+{
+}
+
+
+void UpdateCpuLoadStats ( void )
+{
+}
+
+
+void GetCpuLoadStats ( const uint8_t ** const lastLongPeriod,
+                             uint8_t  * const lastLongPeriodIndex,
+                       const uint8_t ** const lastShortPeriod,
+                             uint8_t  * const lastShortPeriodIndex )
+{
+  // The emulator does not measure the CPU load, so report it as idle.
+
+  static const uint8_t s_longPeriod [ CPU_LOAD_LONG_PERIOD_SLOT_COUNT  ] = { 0 };
+  static const uint8_t s_shortPeriod[ CPU_LOAD_SHORT_PERIOD_SLOT_COUNT ] = { 0 };
+
+  *lastLongPeriod       = s_longPeriod;
+  *lastLongPeriodIndex  = 0;
+  *lastShortPeriod      = s_shortPeriod;
+  *lastShortPeriodIndex = 0;
+}
+
+
+// ------ Stack ------
+
+// The stack belongs to the host's operating system, so there is nothing to check.
+
+void FillStackCanary ( void ) throw()
+{
+}
+
+
+bool CheckStackCanary ( size_t ) throw()
+{
+  return true;
+}
+
+
+size_t GetStackSizeUsageEstimate ( void ) throw()
+{
+  return 0;
+}
+
+
+size_t GetCurrentStackDepth ( void ) throw()
+{
+  return 0;
+}
+
+
+// ------ Busy wait ------
+
+void BusyWaitAsmLoop ( const uint32_t iterationCount )
+{
+  // See GetBusyWaitLoopIterationCountFromUs() about the iteration speed on the Arduino Due.
+
+  const uint64_t waitTimeUs = uint64_t( iterationCount ) * 3 / ( CPU_CLOCK / 1000000 );
+
+  const uint64_t startTime = GetHostMonotonicTimeUs();
+
+  while ( GetHostMonotonicTimeUs() - startTime < waitTimeUs )
+  {
+  }
+}
+
+
+bool IsBusyWaitAsmLoopAligned ( void ) throw()
+{
+  return true;
+}
+
+
+// ------ Linker script symbols ------
+
+// There is no linker script on the host, so the memory layout reported by the firmware is meaningless.
+
+int _sfixed;
+int __etext;
+int __ramfunc_start__;
+int __ramfunc_end__;
+int __data_start__;
+int __data_end__;
+int __bss_start__;
+int __bss_end__;
+int __noinit_start__;
+int __noinit_end__;
+int __StackLimit;
+int __StackTop;
+int __end__;
+int __HeapLimit;
+
+
+// ------ Miscellaneous ------
+
+void BreakpointPlaceholder ( void ) throw()
+{
+}
+
+
+void ForeverHang ( bool ) throw()
+{
+  Panic( "ForeverHang() called." );
+}
+
+
+void ResetBoard ( bool ) throw()
+{
+  // Restarting the emulator would create a new pseudo-terminal, so quit instead.
+  SerialPrintStr( "The firmware has requested a board reset, so the emulator quits." EOL );
+  exit( EXIT_SUCCESS );
+}
+
+
+static UserPanicMsgFunction s_UserPanicMsgFunction = nullptr;
+
+void SetUserPanicMsgFunction ( const UserPanicMsgFunction functionPointer ) throw()
+{
+  s_UserPanicMsgFunction = functionPointer;
+}
+
+
+void Panic ( const char * const msg ) throw()
+{
+  if ( s_UserPanicMsgFunction )
+    s_UserPanicMsgFunction( msg );
+
+  ForeverHangAfterPanic();
+}
+
+
+void ForeverHangAfterPanic ( void ) throw()
+{
+  // Generate a core dump, which is the host's equivalent of stopping in the debugger.
+  fflush( stdout );
+  abort();
+}
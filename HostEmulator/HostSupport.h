@@ -0,0 +1,31 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+// Host replacements for the bare-metal support routines that the firmware modules need.
+//
+// The firmware's "programming" serial port, which normally shows the debug console, maps to stdout.
+
+#include <stdint.h>
+
+uint64_t GetHostMonotonicTimeUs ( void ) throw();
+
+// The firmware's uptime counts milliseconds since start-up, and is normally updated by the SysTick interrupt.
+// There are no interrupts on the host, so the main loop must call this routine instead.
+void UpdateHostUptime ( void ) throw();
+
+// Whether some firmware module has called WakeFromMainLoopSleep() since the last call,
+// which means that the main loop should not wait for the next event.
+bool ConsumeMainLoopWakeUpRequest ( void ) throw();
@@ -0,0 +1,276 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+// This program checks the fast number and hex dump formatting routines in BareMetalSupport/IntegerPrintUtils.h
+// against the slower implementations they replaced: the digit-by-digit convert_unsigned_to_dec_th(),
+// and snprintf() for the rest. It runs as part of "make check", see RunChecks.sh .
+//
+// The exit code is 0 if all outputs are byte-identical.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include <string>
+
+#include <BareMetalSupport/IntegerPrintUtils.h>
+#include <BareMetalSupport/DebugConsoleEol.h>
+
+
+static unsigned s_errorCount = 0;
+
+static void ReportMismatch ( const char * const what, const std::string & expected, const std::string & actual )
+{
+  ++s_errorCount;
+
+  // Do not flood the output if something is badly broken.
+  if ( s_errorCount <= 10 )
+    fprintf( stderr, "Mismatch in %s:\n  expected: \"%s\"\n  actual:   \"%s\"\n", what, expected.c_str(), actual.c_str() );
+}
+
+
+static void Compare ( const char * const what, const std::string & expected, const std::string & actual )
+{
+  if ( expected != actual )
+    ReportMismatch( what, expected, actual );
+}
+
+
+// ------ Decimal conversion ------
+
+// This is the implementation of convert_unsigned_to_dec_th() before the digit-pair optimisation.
+
+static const char * OldConvertUnsignedToDecTh ( uint64_t val, char * const buffer, const char thousandSepChar )
+{
+  if ( val == 0 )
+  {
+    buffer[0] = '0';
+    buffer[1] = '\0';
+    return buffer;
+  }
+
+  char * p = buffer + CONVERT_TO_DEC_BUF_SIZE - 1;
+
+  int i = 0;
+
+  *p = '\0';
+
+  do
+  {
+    if ( i % 3 == 0 && i != 0 )
+    {
+      --p;
+      *p = thousandSepChar;
+    }
+
+    --p;
+    *p = char( '0' + val % 10 );
+    val /= 10;
+    ++i;
+  }
+  while ( val != 0 );
+
+  return p;
+}
+
+
+static void CheckDecimalConversion ( const uint64_t val )
+{
+  char expectedBuffer[ CONVERT_TO_DEC_BUF_SIZE ];
+  char actualBuffer  [ CONVERT_TO_DEC_BUF_SIZE ];
+
+  Compare( "convert_unsigned_to_dec_th()",
+           OldConvertUnsignedToDecTh( val, expectedBuffer, ',' ),
+           convert_unsigned_to_dec_th( val, actualBuffer, ',' ) );
+
+  const uint32_t val32 = uint32_t( val );
+
+  char printfBuffer[ CONVERT_UINT32_TO_DEC_BUFSIZE ];
+  snprintf( printfBuffer, sizeof( printfBuffer ), "%" PRIu32, val32 );
+
+  char uint32Buffer[ CONVERT_UINT32_TO_DEC_BUFSIZE ];
+
+  Compare( "ConvertUint32ToDec()",
+           printfBuffer,
+           ConvertUint32ToDec( val32, uint32Buffer ) );
+}
+
+
+// A simple linear congruential generator, so that the check is reproducible.
+
+static uint64_t s_randomState = 1;
+
+static uint64_t GetRandomValue ( void )
+{
+  s_randomState = s_randomState * 6364136223846793005ULL + 1442695040888963407ULL;
+  return s_randomState;
+}
+
+
+static void CheckDecimalConversions ( void )
+{
+  // Edge cases: all powers of 10 and their neighbours, and the type limits.
+
+  uint64_t powerOf10 = 1;
+
+  for ( unsigned i = 0; i < 20; ++i )
+  {
+    CheckDecimalConversion( powerOf10 - 1 );
+    CheckDecimalConversion( powerOf10     );
+    CheckDecimalConversion( powerOf10 + 1 );
+    powerOf10 *= 10;
+  }
+
+  CheckDecimalConversion( UINT32_MAX - 1 );
+  CheckDecimalConversion( UINT32_MAX     );
+  CheckDecimalConversion( uint64_t( UINT32_MAX ) + 1 );
+  CheckDecimalConversion( UINT64_MAX - 1 );
+  CheckDecimalConversion( UINT64_MAX     );
+
+  // Random values, shifted so that the numbers have all possible lengths.
+
+  const unsigned RANDOM_VALUE_COUNT = 1000000;
+
+  for ( unsigned i = 0; i < RANDOM_VALUE_COUNT; ++i )
+    CheckDecimalConversion( GetRandomValue() >> ( i % 64 ) );
+}
+
+
+// ------ Hex conversion ------
+
+static void CheckHexConversions ( void )
+{
+  for ( unsigned i = 0; i <= 0xFF; ++i )
+  {
+    char expected[ 3 ];
+    snprintf( expected, sizeof( expected ), "%02" PRIX8, uint8_t( i ) );
+
+    // The old code converted each nibble separately.
+    const char oldCode[ 3 ] = { ConvertDigitToHex( i >> 4, false ), ConvertDigitToHex( i & 0xF, false ), '\0' };
+
+    char actual[ 3 ];
+    char * const end = ConvertByteToHex( uint8_t( i ), actual );
+    *end = '\0';
+
+    Compare( "ConvertByteToHex() against printf()", expected, actual );
+    Compare( "ConvertByteToHex() against ConvertDigitToHex()", oldCode, actual );
+  }
+}
+
+
+// ------ Hex dump ------
+
+// This is how SerialPrintHexDump() and CCommandProcessor::HexDump() used to print each line with printf(),
+// plus the address and the ASCII column.
+
+static std::string OldFormatHexDumpLine ( const uint8_t * const data,
+                                          const size_t byteCount,
+                                          const size_t bytesPerLine,
+                                          const unsigned options,
+                                          const char * const endOfLineChars )
+{
+  std::string line;
+  char buffer[ 32 ];
+
+  if ( options & hdloAddress )
+  {
+    snprintf( buffer, sizeof( buffer ), "%08" PRIX32 ": ", uint32_t( uintptr_t( data ) ) );
+    line += buffer;
+  }
+
+  const char * const byteFormat = ( options & hdloPrefix0x ) ? "0x%02" PRIX8 " " : "%02" PRIX8 " ";
+
+  for ( size_t i = 0; i < byteCount; ++i )
+  {
+    snprintf( buffer, sizeof( buffer ), byteFormat, data[ i ] );
+    line += buffer;
+  }
+
+  if ( options & hdloAsciiColumn )
+  {
+    const size_t charsPerByte = ( options & hdloPrefix0x ) ? 5 : 3;
+
+    line.append( ( bytesPerLine - byteCount ) * charsPerByte + 1, ' ' );
+
+    for ( size_t i = 0; i < byteCount; ++i )
+    {
+      const uint8_t c = data[ i ];
+      line += ( c >= 0x20 && c < 0x7F ) ? char( c ) : '.';
+    }
+  }
+
+  line += endOfLineChars;
+
+  return line;
+}
+
+
+static void CheckHexDumpLines ( void )
+{
+  uint8_t data[ HEX_DUMP_MAX_BYTES_PER_LINE ];
+
+  for ( size_t i = 0; i < sizeof( data ); ++i )
+    data[ i ] = uint8_t( GetRandomValue() >> 32 );
+
+  // Make sure that the ASCII column sees the boundary characters.
+  data[ 0 ] = 0x1F;
+  data[ 1 ] = 0x20;
+  data[ 2 ] = 0x7E;
+  data[ 3 ] = 0x7F;
+
+  const char * const EOLS[] = { "\n", "\r\n", EOL };
+
+  for ( unsigned options = 0; options <= ( hdloPrefix0x | hdloAddress | hdloAsciiColumn ); ++options )
+  {
+    for ( const char * const eol : EOLS )
+    {
+      for ( size_t bytesPerLine = 1; bytesPerLine <= HEX_DUMP_MAX_BYTES_PER_LINE; ++bytesPerLine )
+      {
+        for ( size_t byteCount = 1; byteCount <= bytesPerLine; ++byteCount )
+        {
+          char line[ HEX_DUMP_LINE_BUFSIZE ];
+
+          const size_t lineLen = FormatHexDumpLine( data, byteCount, bytesPerLine, options, eol, line );
+
+          Compare( "FormatHexDumpLine()",
+                   OldFormatHexDumpLine( data, byteCount, bytesPerLine, options, eol ),
+                   line );
+
+          if ( lineLen != strlen( line ) )
+            ReportMismatch( "FormatHexDumpLine() length", std::to_string( strlen( line ) ), std::to_string( lineLen ) );
+        }
+      }
+    }
+  }
+}
+
+
+int main ( void )
+{
+  CheckDecimalConversions();
+  CheckHexConversions();
+  CheckHexDumpLines();
+
+  if ( s_errorCount != 0 )
+  {
+    fprintf( stderr, "%u mismatch(es) found.\n", s_errorCount );
+    return EXIT_FAILURE;
+  }
+
+  printf( "The number and hex dump formatting routines match the old implementations.\n" );
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,284 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+// The DebugDue host emulator runs the DebugDue firmware's Bus Pirate protocol implementation on a Linux PC.
+// The protocol goes over a pseudo-terminal instead of the 'native' USB port, and the JTAG pins
+// drive a simulated TAP chain instead of real hardware. See README.pod for more information.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <getopt.h>
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include <BareMetalSupport/Uptime.h>
+#include <BareMetalSupport/SerialPrint.h>
+#include <BareMetalSupport/BootTimestamps.h>
+#include <Misc/AssertionUtils.h>
+
+#include <JtagFirmware/Globals.h>
+#include <JtagFirmware/BusPirateOpenOcdMode.h>
+
+#include "HostSupport.h"
+#include "PtyConnection.h"
+#include "PtyUartBridge.h"
+#include "SimulatedPio.h"
+#include "SimulatedTap.h"
+#include "SimulatedSpiFlash.h"
+
+
+// The same IDCODE as the Arduino Due's, so that OpenOCD's auto-probing output
+// looks like it does with a real second Arduino Due as the JTAG target.
+static const uint32_t DEFAULT_IDCODE = 0x4BA00477;
+
+static const uint8_t DEFAULT_USER_DR_LENGTH = 32;
+
+
+static volatile sig_atomic_t s_wasTerminationRequested = 0;
+
+static void TerminationSignalHandler ( int )
+{
+  s_wasTerminationRequested = 1;
+}
+
+
+static void PrintHelp ( void )
+{
+  printf( "Usage: DebugDueHostEmulator [options]\n"
+          "\n"
+          "Options:\n"
+          "  --pty-link=<filename>        Create a symbolic link with this name to the pseudo-terminal.\n"
+          "  --uart-bridge-pty-link=<filename>\n"
+          "                               Create a second pseudo-terminal for the UART bridge, with a symbolic link\n"
+          "                               with this name to it. The simulated target UART is a loopback.\n"
+          "  --tap-count=<n>              Number of TAPs in the simulated JTAG chain. The default is 1.\n"
+          "  --idcode=<value>             IDCODE of all TAPs. The default is 0x%08X.\n"
+          "  --user-dr-length=<n>         Length in bits of the USER data register (instruction 0x%X), 1-%u. The default is %u.\n"
+          "  --user-dr-capture=<v1,v2...> Values loaded by successive Capture-DR states with the USER instruction.\n"
+          "                               Without this option, the USER data register behaves like a loopback.\n"
+          "  --trace-user-dr              Print each value written to a USER data register.\n"
+          "  --help                       Print this help text.\n"
+          "\n"
+          "Numbers can be decimal or hexadecimal with a '0x' prefix.\n",
+          unsigned( DEFAULT_IDCODE ),
+          unsigned( CSimulatedTap::IR_USER ),
+          unsigned( CSimulatedTap::MAX_USER_DR_LENGTH ),
+          unsigned( DEFAULT_USER_DR_LENGTH ) );
+}
+
+
+static uint64_t ParseNumber ( const char * const optionName, const char * const str )
+{
+  char * end;
+  errno = 0;
+  const unsigned long long val = strtoull( str, &end, 0 );
+
+  if ( errno != 0 || end == str || *end != '\0' || *str == '-' )
+    throw std::runtime_error( std::string( "Invalid number \"" ) + str + "\" in option --" + optionName + "." );
+
+  return val;
+}
+
+
+static std::vector< uint64_t > ParseNumberList ( const char * const optionName, const char * const str )
+{
+  std::vector< uint64_t > values;
+
+  std::string remaining = str;
+
+  for ( ; ; )
+  {
+    const size_t commaPos = remaining.find( ',' );
+
+    values.push_back( ParseNumber( optionName, remaining.substr( 0, commaPos ).c_str() ) );
+
+    if ( commaPos == std::string::npos )
+      break;
+
+    remaining.erase( 0, commaPos + 1 );
+  }
+
+  return values;
+}
+
+
+static void PrintPanicMsg ( const char * const msg )
+{
+  fprintf( stderr, "%s\n", msg );
+}
+
+
+static int RunEmulator ( const int argc, char ** const argv )
+{
+  enum
+  {
+    OPT_PTY_LINK = 1,
+    OPT_UART_BRIDGE_PTY_LINK,
+    OPT_TAP_COUNT,
+    OPT_IDCODE,
+    OPT_USER_DR_LENGTH,
+    OPT_USER_DR_CAPTURE,
+    OPT_TRACE_USER_DR,
+    OPT_HELP
+  };
+
+  static const option LONG_OPTIONS[] =
+  {
+    { "pty-link"       , required_argument, nullptr, OPT_PTY_LINK        },
+    { "uart-bridge-pty-link", required_argument, nullptr, OPT_UART_BRIDGE_PTY_LINK },
+    { "tap-count"      , required_argument, nullptr, OPT_TAP_COUNT       },
+    { "idcode"         , required_argument, nullptr, OPT_IDCODE          },
+    { "user-dr-length" , required_argument, nullptr, OPT_USER_DR_LENGTH  },
+    { "user-dr-capture", required_argument, nullptr, OPT_USER_DR_CAPTURE },
+    { "trace-user-dr"  , no_argument      , nullptr, OPT_TRACE_USER_DR   },
+    { "help"           , no_argument      , nullptr, OPT_HELP            },
+    { nullptr, 0, nullptr, 0 }
+  };
+
+  const char * ptyLinkFilename = nullptr;
+  const char * uartBridgePtyLinkFilename = nullptr;
+  uint64_t tapCount     = 1;
+  uint64_t idCode       = DEFAULT_IDCODE;
+  uint64_t userDrLength = DEFAULT_USER_DR_LENGTH;
+  std::vector< uint64_t > userDrCaptureValues;
+  bool traceUserDr = false;
+
+  for ( ; ; )
+  {
+    const int opt = getopt_long( argc, argv, "", LONG_OPTIONS, nullptr );
+
+    if ( opt == -1 )
+      break;
+
+    switch ( opt )
+    {
+    case OPT_PTY_LINK:        ptyLinkFilename     = optarg; break;
+    case OPT_UART_BRIDGE_PTY_LINK:  uartBridgePtyLinkFilename = optarg; break;
+    case OPT_TAP_COUNT:       tapCount            = ParseNumber( "tap-count", optarg ); break;
+    case OPT_IDCODE:          idCode              = ParseNumber( "idcode", optarg ); break;
+    case OPT_USER_DR_LENGTH:  userDrLength        = ParseNumber( "user-dr-length", optarg ); break;
+    case OPT_USER_DR_CAPTURE: userDrCaptureValues = ParseNumberList( "user-dr-capture", optarg ); break;
+    case OPT_TRACE_USER_DR:   traceUserDr = true; break;
+
+    case OPT_HELP:
+      PrintHelp();
+      return EXIT_SUCCESS;
+
+    default:
+      // getopt_long() has already printed an error message.
+      return EXIT_FAILURE;
+    }
+  }
+
+  if ( optind != argc )
+    throw std::runtime_error( "This program takes no non-option arguments." );
+
+  if ( tapCount < 1 || tapCount > 32 )
+    throw std::runtime_error( "The TAP count must be between 1 and 32." );
+
+  if ( idCode > UINT32_MAX )
+    throw std::runtime_error( "The IDCODE must be a 32-bit value." );
+
+  if ( userDrLength < 1 || userDrLength > CSimulatedTap::MAX_USER_DR_LENGTH )
+    throw std::runtime_error( "Invalid USER data register length." );
+
+  for ( uint64_t i = 0; i < tapCount; ++i )
+  {
+    g_simulatedTapChain.AddTap( CSimulatedTap( uint32_t( idCode ), uint8_t( userDrLength ), userDrCaptureValues ) );
+  }
+
+  g_simulatedTapChain.SetTraceUserDrUpdates( traceUserDr );
+
+
+  // ------ Initialisation, like in the firmware's Configure() ------
+
+  SetUserPanicMsgFunction( &PrintPanicMsg );
+
+  StartBootTimestamps();  // This enables the cycle counter too.
+  InitSimulatedPios();
+  InitJtagPins();
+
+  OpenPtyConnection( ptyLinkFilename );
+
+  if ( uartBridgePtyLinkFilename != nullptr )
+    OpenPtyUartBridge( uartBridgePtyLinkFilename );
+
+  SerialPrintf( "--- DebugDue %s ---" EOL, PACKAGE_VERSION );
+  SerialPrintf( "Pseudo-terminal: %s" EOL, GetPtySlaveFilename() );
+
+  if ( ptyLinkFilename != nullptr )
+    SerialPrintf( "Symbolic link: %s" EOL, ptyLinkFilename );
+
+  if ( IsPtyUartBridgeOpen() )
+    SerialPrintf( "UART bridge pseudo-terminal: %s , symbolic link: %s" EOL, GetPtyUartBridgeSlaveFilename(), uartBridgePtyLinkFilename );
+
+  SerialPrintf( "Simulated JTAG chain: %u TAP(s) with IDCODE 0x%08X." EOL, unsigned( tapCount ), unsigned( idCode ) );
+  SerialPrintf( "Simulated SPI flash: %u KiB in the Bus Pirate binary SPI mode." EOL, unsigned( CSimulatedSpiFlash::SIZE / 1024 ) );
+  SerialPrintStr( "Press Ctrl+C to quit." EOL );
+
+
+  // ------ Main loop ------
+
+  signal( SIGINT , &TerminationSignalHandler );
+  signal( SIGTERM, &TerminationSignalHandler );
+
+  // A client that disconnects in the middle of a write would otherwise kill the emulator.
+  signal( SIGPIPE, SIG_IGN );
+
+  RecordBootTimestamp( bpMainLoop );
+
+  while ( !s_wasTerminationRequested )
+  {
+    UpdateHostUptime();
+
+    const uint64_t currentTime = GetUptime();
+
+    ServicePtyConnection( currentTime );
+
+    ServicePtyUartBridge();
+
+    // The system tick period is the time resolution the firmware expects for its time-outs.
+    WaitForPtyEvents( ConsumeMainLoopWakeUpRequest() ? 0 : SYSTEM_TICK_PERIOD_MS );
+  }
+
+  SerialPrintf( EOL "Simulated TCK cycles: %llu" EOL, (unsigned long long) g_simulatedTapChain.GetClockCount() );
+  SerialPrintf( "Simulated SPI bytes: %llu" EOL, (unsigned long long) g_simulatedSpiFlash.GetTransferredByteCount() );
+
+  ClosePtyUartBridge();
+  ClosePtyConnection();
+
+  return EXIT_SUCCESS;
+}
+
+
+int main ( const int argc, char ** const argv )
+{
+  try
+  {
+    return RunEmulator( argc, argv );
+  }
+  catch ( const std::exception & e )
+  {
+    ClosePtyUartBridge();
+    ClosePtyConnection();
+    fprintf( stderr, "Error: %s\n", e.what() );
+    return EXIT_FAILURE;
+  }
+}
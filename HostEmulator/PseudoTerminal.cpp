@@ -0,0 +1,186 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "PseudoTerminal.h"  // The include file for this module should come first.
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/stat.h>
+
+
+std::runtime_error CreateErrnoException ( const char * const prefix, const int errorCode )
+{
+  std::string msg = prefix;
+  msg += ": ";
+  msg += strerror( errorCode );
+  return std::runtime_error( msg );
+}
+
+
+CPseudoTerminal::CPseudoTerminal ( void ) throw()
+  : m_masterFd( -1 )
+{
+}
+
+
+CPseudoTerminal::~CPseudoTerminal ( void ) throw()
+{
+  Close();
+}
+
+
+void CPseudoTerminal::Open ( const char * const symlinkFilename )
+{
+  assert( m_masterFd == -1 );
+
+  m_masterFd = posix_openpt( O_RDWR | O_NOCTTY | O_NONBLOCK );
+
+  if ( m_masterFd == -1 )
+    throw CreateErrnoException( "Cannot create the pseudo-terminal", errno );
+
+  try
+  {
+    if ( 0 != grantpt( m_masterFd ) ||
+         0 != unlockpt( m_masterFd ) )
+    {
+      throw CreateErrnoException( "Cannot unlock the pseudo-terminal", errno );
+    }
+
+    const char * const slaveFilename = ptsname( m_masterFd );
+
+    if ( slaveFilename == nullptr )
+      throw CreateErrnoException( "Cannot get the pseudo-terminal's name", errno );
+
+    m_slaveFilename = slaveFilename;
+
+    // Otherwise, the line discipline on the slave side would echo the data back
+    // and translate the end-of-line characters, which would break the binary protocol.
+    // Changing the settings on the master side changes them on the slave side.
+
+    termios settings;
+
+    if ( 0 != tcgetattr( m_masterFd, &settings ) )
+      throw CreateErrnoException( "Cannot get the pseudo-terminal settings", errno );
+
+    cfmakeraw( &settings );
+
+    if ( 0 != tcsetattr( m_masterFd, TCSANOW, &settings ) )
+      throw CreateErrnoException( "Cannot set the pseudo-terminal settings", errno );
+
+    if ( symlinkFilename != nullptr )
+    {
+      // Replace a stale symbolic link left behind by a previous run, but never a real file.
+
+      struct stat statBuffer;
+
+      if ( 0 == lstat( symlinkFilename, &statBuffer ) )
+      {
+        if ( !S_ISLNK( statBuffer.st_mode ) )
+          throw std::runtime_error( std::string( "File \"" ) + symlinkFilename + "\" exists and is not a symbolic link." );
+
+        if ( 0 != unlink( symlinkFilename ) )
+          throw CreateErrnoException( "Cannot delete the old symbolic link", errno );
+      }
+
+      if ( 0 != symlink( slaveFilename, symlinkFilename ) )
+        throw CreateErrnoException( "Cannot create the symbolic link", errno );
+
+      m_symlinkFilename = symlinkFilename;
+    }
+  }
+  catch ( ... )
+  {
+    Close();
+    throw;
+  }
+}
+
+
+void CPseudoTerminal::Close ( void ) throw()
+{
+  if ( !m_symlinkFilename.empty() )
+  {
+    // There is not much we can do if this fails.
+    unlink( m_symlinkFilename.c_str() );
+    m_symlinkFilename.clear();
+  }
+
+  if ( m_masterFd != -1 )
+  {
+    close( m_masterFd );
+    m_masterFd = -1;
+  }
+
+  m_slaveFilename.clear();
+}
+
+
+bool CPseudoTerminal::IsSlaveSideOpen ( void ) const
+{
+  // If no client has the slave side open, poll() reports a hang-up on the master side.
+
+  pollfd pfd = { m_masterFd, POLLIN, 0 };
+
+  if ( -1 == poll( &pfd, 1, 0 ) )
+    throw CreateErrnoException( "Error polling the pseudo-terminal", errno );
+
+  return 0 == ( pfd.revents & POLLHUP );
+}
+
+
+void CPseudoTerminal::Flush ( void ) throw()
+{
+  tcflush( m_masterFd, TCIOFLUSH );
+}
+
+
+size_t CPseudoTerminal::Read ( void * const buffer, const size_t bufferSize, const char * const errorMsgPrefix )
+{
+  const ssize_t readCount = read( m_masterFd, buffer, bufferSize );
+
+  if ( readCount == -1 )
+  {
+    // EIO means that the client has closed the slave side.
+    if ( errno == EAGAIN || errno == EINTR || errno == EIO )
+      return 0;
+
+    throw CreateErrnoException( errorMsgPrefix, errno );
+  }
+
+  return size_t( readCount );
+}
+
+
+size_t CPseudoTerminal::Write ( const void * const data, const size_t dataLen, const char * const errorMsgPrefix )
+{
+  const ssize_t writtenCount = write( m_masterFd, data, dataLen );
+
+  if ( writtenCount == -1 )
+  {
+    // EIO means that the client has just closed the slave side.
+    if ( errno == EAGAIN || errno == EINTR || errno == EIO )
+      return 0;
+
+    throw CreateErrnoException( errorMsgPrefix, errno );
+  }
+
+  return size_t( writtenCount );
+}
@@ -0,0 +1,62 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+// Helpers for the pseudo-terminals that replace the USB CDC serial ports in the host emulator,
+// see PtyConnection.h and PtyUartBridge.h .
+//
+// The slave side of a pseudo-terminal has a name like /dev/pts/5 . Because that name changes every time,
+// a symbolic link with a fixed name can point to it.
+//
+// Errors throw std::runtime_error.
+
+#include <string>
+#include <stdexcept>
+
+
+std::runtime_error CreateErrnoException ( const char * prefix, int errorCode );
+
+class CPseudoTerminal
+{
+  int m_masterFd;
+  std::string m_slaveFilename;
+  std::string m_symlinkFilename;
+
+ public:
+  CPseudoTerminal ( void ) throw();
+  ~CPseudoTerminal ( void ) throw();
+
+  // The pseudo-terminal is in raw mode. The symbolic link filename is optional.
+  void Open ( const char * symlinkFilename );
+  void Close ( void ) throw();
+
+  bool IsOpen ( void ) const throw() { return m_masterFd != -1; }
+
+  int GetMasterFd ( void ) const throw() { return m_masterFd; }
+
+  const char * GetSlaveFilename ( void ) const throw() { return m_slaveFilename.c_str(); }
+
+  // Whether some client has the slave side open.
+  bool IsSlaveSideOpen ( void ) const;
+
+  // Discards any data that the client has not read yet, and any data that it wrote
+  // but we have not read yet.
+  void Flush ( void ) throw();
+
+  // These routines return the number of bytes transferred, which may be 0.
+  // They do not fail if the client has just closed the slave side.
+  size_t Read  ( void * buffer, size_t bufferSize, const char * errorMsgPrefix );
+  size_t Write ( const void * data, size_t dataLen, const char * errorMsgPrefix );
+};
@@ -0,0 +1,312 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "PtyConnection.h"  // The include file for this module should come first.
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+
+#include <stdexcept>
+
+#include <BareMetalSupport/SerialPrint.h>
+#include <BareMetalSupport/MainLoopSleep.h>
+#include <BareMetalSupport/Miscellaneous.h>
+#include <Misc/AssertionUtils.h>
+
+#include <JtagFirmware/UsbBuffers.h>
+#include <JtagFirmware/BusPirateConnection.h>
+#include <JtagFirmware/Globals.h>
+#include <JtagFirmware/UsbTxFlushPolicy.h>
+
+#include <udi_cdc.h>
+
+#include "PseudoTerminal.h"
+#include "PtyUartBridge.h"
+
+
+static CPseudoTerminal s_pty;
+
+static bool s_isConnectionOpen = false;
+
+static CUsbTxBuffer s_txBuffer;
+static CUsbRxBuffer s_rxBuffer;
+
+
+void OpenPtyConnection ( const char * const symlinkFilename )
+{
+  s_pty.Open( symlinkFilename );
+}
+
+
+void ClosePtyConnection ( void ) throw()
+{
+  s_pty.Close();
+}
+
+
+const char * GetPtySlaveFilename ( void ) throw()
+{
+  return s_pty.GetSlaveFilename();
+}
+
+
+static void ResetBuffers ( void )
+{
+  s_txBuffer.Reset();
+  s_rxBuffer.Reset();
+}
+
+
+static void PtyConnectionEstablished ( void )
+{
+  SerialPrintStr( "Connection opened on the pseudo-terminal." EOL );
+
+  ResetBuffers();
+
+  // Pretend to be the Arduino Due's high-speed USB port.
+  UsbTxFlushPolicy_Reset( USB_HIGH_SPEED_BULK_PACKET_SIZE );
+
+  BusPirateConnection_Init( &s_txBuffer );
+}
+
+
+static void PtyConnectionLost ( void )
+{
+  SerialPrintStr( "Connection lost on the pseudo-terminal." EOL );
+
+  BusPirateConnection_Terminate();
+  ResetBuffers();
+
+  // Unlike the USB connection, we can discard any outgoing data that the client did not read,
+  // so that the next client does not receive stale data.
+  s_pty.Flush();
+}
+
+
+// See the same routine in UsbConnection.cpp . ReceiveData() reads all there is from the pseudo-terminal,
+// so an empty Rx Buffer is a good enough sign that the client is waiting for the replies.
+
+static bool SendData ( void )
+{
+  uint32_t toFlushCount = UsbTxFlushPolicy_GetByteCountToSend( s_txBuffer.GetElemCount(), s_rxBuffer.IsEmpty() );
+
+  if ( toFlushCount == 0 )
+    return false;
+
+  uint32_t sentCount = 0;
+
+  while ( toFlushCount != 0 )
+  {
+    uint32_t availableByteCount;
+    const uint8_t * const readPtr = s_txBuffer.GetReadPtr( &availableByteCount );
+
+    assert( availableByteCount != 0 );
+
+    const size_t writtenCount = s_pty.Write( readPtr, MinFrom( availableByteCount, toFlushCount ), "Error writing to the pseudo-terminal" );
+
+    if ( writtenCount == 0 )
+      break;
+
+    if ( false )
+    {
+      SerialPrintStr( "Data sent:" EOL );
+      SerialPrintHexDump( readPtr, writtenCount, EOL );
+    }
+
+    s_txBuffer.ConsumeReadElements( uint32_t( writtenCount ) );
+    sentCount    += uint32_t( writtenCount );
+    toFlushCount -= uint32_t( writtenCount );
+  }
+
+  UsbTxFlushPolicy_DataSent( sentCount, s_txBuffer.GetElemCount() );
+
+  return sentCount != 0;
+}
+
+
+static void ReceiveData ( void )
+{
+  for ( ; ; )
+  {
+    uint32_t byteCountToWrite;
+    uint8_t * const writePtr = s_rxBuffer.GetWritePtr( &byteCountToWrite );
+
+    if ( byteCountToWrite == 0 )
+      break;
+
+    const size_t readCount = s_pty.Read( writePtr, byteCountToWrite, "Error reading from the pseudo-terminal" );
+
+    if ( readCount == 0 )
+      break;
+
+    if ( false )
+    {
+      SerialPrintStr( "Data received:" EOL );
+      SerialPrintHexDump( writePtr, readCount, EOL );
+    }
+
+    s_rxBuffer.CommitWrittenElements( uint32_t( readCount ) );
+  }
+}
+
+
+static void HandleError ( const char * const errMsg )
+{
+  // See the same routine in UsbConnection.cpp .
+
+  SerialPrintStr( EOL "Error servicing the pseudo-terminal connection: " );
+  SerialPrintStr( errMsg );
+  SerialPrintStr( EOL );
+
+  s_rxBuffer.Reset();
+
+  ChangeBusPirateMode( bpInvalid, nullptr );
+  ChangeBusPirateMode( bpConsoleMode, &s_txBuffer );
+}
+
+
+void ServicePtyConnection ( const uint64_t currentTime )
+{
+  try
+  {
+    const bool isSlaveSideOpen = s_pty.IsSlaveSideOpen();
+
+    if ( !s_isConnectionOpen )
+    {
+      if ( !isSlaveSideOpen )
+        return;
+
+      s_isConnectionOpen = true;
+      PtyConnectionEstablished();
+    }
+
+    // If the client has just closed the slave side, there may still be some data to read.
+    ReceiveData();
+
+    const ProtocolResult result = BusPirateConnection_ProcessData( &s_rxBuffer, &s_txBuffer, currentTime );
+
+    if ( !result.IsOk() )
+    {
+      HandleError( result.GetErrMsg() );
+      return;
+    }
+
+    const ProtocolResult txOverflowResult = CheckAndClearUsbTxBufferOverflow();
+
+    if ( !txOverflowResult.IsOk() )
+    {
+      HandleError( txOverflowResult.GetErrMsg() );
+      return;
+    }
+
+    if ( !isSlaveSideOpen )
+    {
+      s_isConnectionOpen = false;
+      PtyConnectionLost();
+      return;
+    }
+
+    // If we have sent at least one byte of data, then there is more space available in the tx buffer,
+    // which means that perhaps the next command already waiting in the rx buffer could be processed
+    // straight away, for its reply would fit now in the tx buffer.
+    //
+    // If the flush policy is holding some data back, keep polling, so that its time-out can trigger.
+
+    if ( SendData() || UsbTxFlushPolicy_IsHoldingData() )
+      WakeFromMainLoopSleep();
+  }
+  catch ( const std::exception & e )
+  {
+    HandleError( e.what() );
+  }
+  catch ( ... )
+  {
+    HandleError( "Unexpected C++ exception." );
+  }
+}
+
+
+// This is the equivalent of the PendSV handler in UsbConnection.cpp . The emulator is single-threaded,
+// so it runs when new data arrives while the main loop is waiting, which is when the real firmware
+// would run it too if the main loop had nothing else to do.
+
+static void ServiceLowLatencyPath ( void )
+{
+  try
+  {
+    ReceiveData();
+
+    if ( BusPirateConnection_ProcessDataFromInterrupt( &s_rxBuffer, &s_txBuffer ) )
+      SendData();
+  }
+  catch ( const std::exception & e )
+  {
+    HandleError( e.what() );
+  }
+  catch ( ... )
+  {
+    HandleError( "Unexpected C++ exception." );
+  }
+
+  // The main loop takes care of any data left in the buffers.
+  WakeFromMainLoopSleep();
+}
+
+
+void WaitForPtyEvents ( const uint32_t timeoutMs )
+{
+  pollfd pfds[ 2 ];
+  nfds_t pfdCount = 0;
+
+  // Without a client, poll() would keep reporting a hang-up straight away, so leave the pseudo-terminal out then.
+
+  if ( s_isConnectionOpen )
+  {
+    pollfd & pfd = pfds[ pfdCount++ ];
+
+    pfd.fd      = s_pty.GetMasterFd();
+    pfd.events  = POLLIN;
+    pfd.revents = 0;
+
+    if ( !s_txBuffer.IsEmpty() )
+      pfd.events |= POLLOUT;
+  }
+
+  if ( GetPtyUartBridgePollFd( &pfds[ pfdCount ] ) )
+    ++pfdCount;
+
+  const int pollResult = poll( pfdCount == 0 ? nullptr : pfds, pfdCount, int( timeoutMs ) );
+
+  if ( pollResult == -1 && errno != EINTR )
+    throw CreateErrnoException( "Error waiting for the pseudo-terminal", errno );
+
+  // If the main pseudo-terminal is in the poll list, it is always the first entry.
+  if ( ENABLE_USB_LOW_LATENCY_MODE &&
+       pollResult > 0 &&
+       s_isConnectionOpen &&
+       0 != ( pfds[ 0 ].revents & POLLIN ) )
+  {
+    ServiceLowLatencyPath();
+  }
+}
+
+
+uint32_t udi_cdc_write_buf ( const void * const buf, const uint32_t size )
+{
+  // This is only used by the USB speed test, which sends data directly, bypassing the Tx Buffer.
+
+  return size - uint32_t( s_pty.Write( buf, size, "Error writing to the pseudo-terminal" ) );
+}
@@ -0,0 +1,37 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+// This module replaces UsbConnection.cpp in the host emulator. Instead of the 'native' USB port,
+// the Bus Pirate protocol runs over a Linux pseudo-terminal, which looks like a normal serial port
+// to OpenOCD and other clients.
+//
+// The slave side of a pseudo-terminal has a name like /dev/pts/5 . Because that name changes every time,
+// this module can also create a symbolic link with a fixed name to it, see PseudoTerminal.h .
+//
+// Errors throw std::runtime_error.
+
+#include <stdint.h>
+
+void OpenPtyConnection ( const char * symlinkFilename );
+void ClosePtyConnection ( void ) throw();
+
+const char * GetPtySlaveFilename ( void ) throw();
+
+void ServicePtyConnection ( uint64_t currentTime );
+
+// Waits until there is something to do on the pseudo-terminal or on the UART bridge's one (see PtyUartBridge.h),
+// or until the timeout expires.
+void WaitForPtyEvents ( uint32_t timeoutMs );
@@ -0,0 +1,159 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "PtyUartBridge.h"  // The include file for this module should come first.
+
+#include <BareMetalSupport/SerialPrint.h>
+
+#include <JtagFirmware/UartBridge.h>
+
+#include "PseudoTerminal.h"
+
+
+static CPseudoTerminal s_pty;
+
+static bool s_isConnectionOpen = false;
+
+
+void OpenPtyUartBridge ( const char * const symlinkFilename )
+{
+  s_pty.Open( symlinkFilename );
+  UartBridge_Init();
+}
+
+
+void ClosePtyUartBridge ( void ) throw()
+{
+  s_pty.Close();
+}
+
+
+bool IsPtyUartBridgeOpen ( void ) throw()
+{
+  return s_pty.IsOpen();
+}
+
+
+const char * GetPtyUartBridgeSlaveFilename ( void ) throw()
+{
+  return s_pty.GetSlaveFilename();
+}
+
+
+// See the same routines in UartBridgeConnection.cpp .
+
+static void TransferHostToTarget ( void )
+{
+  for ( ; ; )
+  {
+    uint32_t freeCount;
+    uint8_t * const writePtr = UartBridge_GetTxWritePtr( &freeCount );
+
+    if ( freeCount == 0 )
+      break;
+
+    const size_t readCount = s_pty.Read( writePtr, freeCount, "Error reading from the UART bridge pseudo-terminal" );
+
+    if ( readCount == 0 )
+      break;
+
+    UartBridge_CommitTxData( uint32_t( readCount ) );
+  }
+}
+
+
+static void TransferTargetToHost ( void )
+{
+  for ( ; ; )
+  {
+    uint32_t availableCount;
+    const uint8_t * const readPtr = UartBridge_GetRxReadPtr( &availableCount );
+
+    if ( availableCount == 0 )
+      break;
+
+    const size_t writtenCount = s_pty.Write( readPtr, availableCount, "Error writing to the UART bridge pseudo-terminal" );
+
+    if ( writtenCount == 0 )
+      break;
+
+    UartBridge_ConsumeRxData( uint32_t( writtenCount ) );
+  }
+}
+
+
+void ServicePtyUartBridge ( void )
+{
+  if ( !s_pty.IsOpen() )
+    return;
+
+  const bool isOpen = s_pty.IsSlaveSideOpen();
+
+  if ( isOpen != s_isConnectionOpen )
+  {
+    s_isConnectionOpen = isOpen;
+
+    if ( isOpen )
+    {
+      SerialPrintStr( "Connection opened on the UART bridge pseudo-terminal." EOL );
+    }
+    else
+    {
+      UartBridgeStats stats;
+      UartBridge_GetStats( &stats );
+
+      SerialPrintf( "Connection lost on the UART bridge pseudo-terminal. Bytes to target: %llu, from target: %llu, lost: %u." EOL,
+                    (unsigned long long) stats.hostToTargetByteCount,
+                    (unsigned long long) stats.targetToHostByteCount,
+                    unsigned( stats.lostRxByteCount ) );
+
+      s_pty.Flush();
+    }
+
+    UartBridge_DiscardData();
+  }
+
+  if ( isOpen )
+  {
+    TransferHostToTarget();
+    TransferTargetToHost();
+  }
+  else
+  {
+    UartBridge_DiscardData();
+  }
+
+  UartBridge_Service();
+}
+
+
+bool GetPtyUartBridgePollFd ( pollfd * const pfd )
+{
+  // Without a client, poll() would keep reporting a hang-up straight away.
+  if ( !s_isConnectionOpen )
+    return false;
+
+  pfd->fd      = s_pty.GetMasterFd();
+  pfd->events  = POLLIN;
+  pfd->revents = 0;
+
+  uint32_t availableCount;
+  UartBridge_GetRxReadPtr( &availableCount );
+
+  if ( availableCount != 0 )
+    pfd->events |= POLLOUT;
+
+  return true;
+}
@@ -0,0 +1,37 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+// This module replaces UartBridgeConnection.cpp in the host emulator. The UART bridge
+// (see JtagFirmware/UartBridge.h) runs over a second pseudo-terminal instead of the second USB CDC serial port.
+// The simulated UART on the other side is a loopback, see SimulatedUartPort.cpp , so whatever
+// the client writes comes back, and the bridge's buffer handling can be tested without any hardware.
+//
+// The UART bridge is optional in the emulator. If OpenPtyUartBridge() is not called, the other routines do nothing.
+//
+// Errors throw std::runtime_error.
+
+#include <poll.h>
+
+void OpenPtyUartBridge ( const char * symlinkFilename );
+void ClosePtyUartBridge ( void ) throw();
+
+bool IsPtyUartBridgeOpen ( void ) throw();
+const char * GetPtyUartBridgeSlaveFilename ( void ) throw();
+
+void ServicePtyUartBridge ( void );
+
+// Fills in the poll() entry for WaitForPtyEvents(). Returns false if there is nothing to wait for.
+bool GetPtyUartBridgePollFd ( pollfd * pfd );
@@ -0,0 +1,190 @@
+#!/bin/bash
+#
+# This script runs the automated checks against the host emulator. The usual way to start it is with "make check".
+#
+# Usage: RunChecks.sh <emulator executable> <build directory>
+#
+# Copyright (c) 2012 - R. Diez - Licensed under the GNU AGPLv3.
+
+set -o errexit
+set -o nounset
+set -o pipefail
+
+declare -r SCRIPT_NAME="${BASH_SOURCE[0]##*/}"  # This script's filename only, without any path components.
+
+
+abort ()
+{
+  echo >&2 && echo "Error in script \"$SCRIPT_NAME\": $*" >&2
+  exit 1
+}
+
+
+declare EMULATOR_PID=""
+
+start_emulator ()
+{
+  echo "Starting the emulator, its output goes to \"$EMULATOR_LOG_FILENAME\" ..."
+
+  # Remove any stale link from a previous run, so that we can wait for the new one below.
+  rm -f -- "$PTY_LINK"
+
+  "$EMULATOR_FILENAME" --pty-link="$PTY_LINK" --tap-count="$TAP_COUNT" >"$EMULATOR_LOG_FILENAME" 2>&1 &
+  EMULATOR_PID="$!"
+
+  local -i ATTEMPT
+  for (( ATTEMPT = 0; ATTEMPT < 50; ++ATTEMPT )); do
+    if [ -e "$PTY_LINK" ]; then
+      return
+    fi
+    sleep 0.1
+  done
+
+  abort "The emulator did not create pseudo-terminal link \"$PTY_LINK\"."
+}
+
+
+stop_emulator ()
+{
+  if [ -n "$EMULATOR_PID" ]; then
+    kill -- "$EMULATOR_PID"
+    wait -- "$EMULATOR_PID" || true
+    EMULATOR_PID=""
+  fi
+}
+
+
+check_integer_print_utils ()
+{
+  echo
+  echo "Checking the number and hex dump formatting routines against the old implementations..."
+
+  "$BUILD_DIR/IntegerPrintUtilsCheck"
+}
+
+
+check_dma_rx_ring ()
+{
+  echo
+  echo "Checking the UART bridge's DMA reception ring buffer..."
+
+  "$BUILD_DIR/DmaRxRingCheck"
+}
+
+
+check_protocol_benchmark ()
+{
+  echo
+  echo "Building ProtocolBenchmark..."
+
+  local -r PROTOCOL_BENCHMARK_BUILD_DIR="$BUILD_DIR/ProtocolBenchmark"
+
+  make --no-print-directory -C "$REPOSITORY_DIR/JtagTroubleshooting/ProtocolBenchmark" BUILD_DIR="$PROTOCOL_BENCHMARK_BUILD_DIR"
+
+  local -r PROTOCOL_BENCHMARK="$PROTOCOL_BENCHMARK_BUILD_DIR/ProtocolBenchmark"
+
+  # ProtocolBenchmark exits with a non-zero status code if the TDO data does not match.
+
+  echo
+  echo "Checking the OpenOCD mode with the TAP chain in BYPASS mode..."
+  "$PROTOCOL_BENCHMARK" --verify-bypass --pipeline-depth=4 --command-count=200 "$PTY_LINK"
+
+  echo
+  echo "Checking the TDO digest extension..."
+  "$PROTOCOL_BENCHMARK" --verify-bypass --tdo-digest --command-count=200 "$PTY_LINK"
+
+  echo
+  echo "Checking the TDI pattern extension..."
+  "$PROTOCOL_BENCHMARK" --verify-bypass --tdi-pattern=prbs31 --pattern-bits=1000000 "$PTY_LINK"
+
+  echo
+  echo "Checking the RLE extension with sparse TDI data..."
+  "$PROTOCOL_BENCHMARK" --verify-bypass --rle --sparse-tdi --command-count=200 "$PTY_LINK"
+
+  # The bit counts below are not multiples of 8, so the decoder must mask the last partial pair.
+
+  echo
+  echo "Checking the RLE extension with random TDI data..."
+  "$PROTOCOL_BENCHMARK" --verify-bypass --rle --bits-per-command=8189 --command-count=200 "$PTY_LINK"
+
+  # With this bit count, some commands end with a decoder chunk that only holds the partial pair.
+  echo
+  echo "Checking the RLE extension with a partial pair on its own..."
+  "$PROTOCOL_BENCHMARK" --verify-bypass --rle --sparse-tdi --bits-per-command=1003 --command-count=200 "$PTY_LINK"
+}
+
+
+check_spi_flash ()
+{
+  echo
+  echo "Checking the binary SPI mode against the simulated SPI flash..."
+
+  perl "$REPOSITORY_DIR/HostEmulator/SpiFlashCheck.pl" "$PTY_LINK"
+}
+
+
+check_svf_player ()
+{
+  echo
+  echo "Checking the SVF player with a deliberate TDO mismatch..."
+
+  local -r SVF_FILENAME="$REPOSITORY_DIR/HostEmulator/SvfCheck.svf"
+
+  local EXPECTED_LINE_NUMBER
+  EXPECTED_LINE_NUMBER="$(grep --line-number --max-count=1 --extended-regexp "^[^!]+! EXPECTED MISMATCH" -- "$SVF_FILENAME" | cut -d: -f1)"
+
+  local SVF_PLAYER_OUTPUT
+  local -i EXIT_CODE=0
+
+  SVF_PLAYER_OUTPUT="$(perl "$REPOSITORY_DIR/Tools/SvfPlayer.pl" --device="$PTY_LINK" "$SVF_FILENAME" 2>&1)" || EXIT_CODE="$?"
+
+  echo "$SVF_PLAYER_OUTPUT"
+
+  # SvfPlayer.pl exits with EXIT_CODE_FAILURE_ERROR (2) if a TDO comparison fails.
+  if (( EXIT_CODE != 2 )); then
+    abort "SvfPlayer.pl exited with status code $EXIT_CODE, but 2 was expected."
+  fi
+
+  # The scans before the marked one must have passed, so the mismatch must be reported in that line.
+  if [[ $SVF_PLAYER_OUTPUT != *"TDO mismatch in the SDR with 8 bits in line $EXPECTED_LINE_NUMBER,"* ]]; then
+    abort "SvfPlayer.pl did not report the TDO mismatch in line $EXPECTED_LINE_NUMBER of file \"$SVF_FILENAME\"."
+  fi
+
+  echo "The TDO mismatch was reported as expected."
+}
+
+
+# ----- Entry point -----
+
+if (( $# != 2 )); then
+  abort "Invalid number of command-line arguments."
+fi
+
+declare -r EMULATOR_FILENAME="$1"
+declare -r BUILD_DIR="$2"
+
+REPOSITORY_DIR="$(readlink --verbose --canonicalize -- "${BASH_SOURCE[0]%/*}/..")"
+declare -r REPOSITORY_DIR
+
+declare -r PTY_LINK="$BUILD_DIR/CheckPty"
+declare -r EMULATOR_LOG_FILENAME="$BUILD_DIR/CheckEmulatorLog.txt"
+declare -r -i TAP_COUNT=3
+
+check_integer_print_utils
+
+check_dma_rx_ring
+
+trap stop_emulator EXIT
+
+start_emulator
+
+check_protocol_benchmark
+
+check_spi_flash
+
+check_svf_player
+
+stop_emulator
+
+echo
+echo "All host emulator checks passed."
@@ -0,0 +1,135 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+// This module replaces the firmware's LogicSampler.cpp . There are no timer interrupts on the host,
+// so the samples that the interrupt handler would have taken since the last call are generated
+// when the main loop asks for the next full block. The pin levels do not change in the meantime,
+// because the emulator only runs the firmware code from the main loop.
+
+#include <JtagFirmware/LogicSampler.h>
+
+#include <assert.h>
+
+#include <pio.h>
+
+#include "HostSupport.h"
+
+
+static LogicSampler_Block s_blocks[ 2 ];
+
+static bool     s_isBlockFull[ 2 ];
+static uint8_t  s_fillBlockIndex;
+static uint32_t s_fillPos;
+static uint32_t s_droppedSampleCount;
+static uint8_t  s_readBlockIndex;
+
+static bool     s_isRunning = false;
+static uint32_t s_sampleRateHz;
+static uint64_t s_startTimeUs;
+static uint64_t s_generatedSampleCount;
+
+
+// Generates the samples due since the last call, like the timer interrupt handler would have done.
+
+static void GenerateDueSamples ( void )
+{
+  const uint64_t elapsedUs = GetHostMonotonicTimeUs() - s_startTimeUs;
+  const uint64_t dueSampleCount = elapsedUs * s_sampleRateHz / 1000000;
+
+  assert( dueSampleCount >= s_generatedSampleCount );
+  uint64_t samplesLeft = dueSampleCount - s_generatedSampleCount;
+  s_generatedSampleCount = dueSampleCount;
+
+  const uint8_t sample = LogicSampler_PackJtagPins( PIOA->PIO_PDSR, PIOC->PIO_PDSR );
+
+  while ( samplesLeft != 0 )
+  {
+    const uint8_t blockIndex = s_fillBlockIndex;
+
+    if ( s_isBlockFull[ blockIndex ] )
+    {
+      // The main loop has not caught up yet.
+      s_droppedSampleCount += uint32_t( samplesLeft );
+      return;
+    }
+
+    LogicSampler_Block * const block = &s_blocks[ blockIndex ];
+
+    if ( s_fillPos == 0 )
+    {
+      block->droppedSampleCountBefore = s_droppedSampleCount;
+      s_droppedSampleCount = 0;
+    }
+
+    block->samples[ s_fillPos ] = sample;
+    --samplesLeft;
+
+    if ( ++s_fillPos == LOGIC_SAMPLER_BLOCK_SAMPLE_COUNT )
+    {
+      s_fillPos = 0;
+      s_isBlockFull[ blockIndex ] = true;
+      s_fillBlockIndex = uint8_t( blockIndex ^ 1 );
+    }
+  }
+}
+
+
+uint32_t LogicSampler_Start ( const uint32_t sampleRateHz )
+{
+  assert( !s_isRunning );
+  assert( sampleRateHz >= LOGIC_SAMPLER_MIN_RATE_HZ && sampleRateHz <= LOGIC_SAMPLER_MAX_RATE_HZ );
+
+  s_isBlockFull[ 0 ]     = false;
+  s_isBlockFull[ 1 ]     = false;
+  s_fillBlockIndex       = 0;
+  s_fillPos              = 0;
+  s_droppedSampleCount   = 0;
+  s_readBlockIndex       = 0;
+  s_sampleRateHz         = sampleRateHz;
+  s_startTimeUs          = GetHostMonotonicTimeUs();
+  s_generatedSampleCount = 0;
+
+  s_isRunning = true;
+
+  return sampleRateHz;
+}
+
+
+void LogicSampler_Stop ( void )
+{
+  s_isRunning = false;
+}
+
+
+const LogicSampler_Block * LogicSampler_GetFullBlock ( void )
+{
+  assert( s_isRunning );
+
+  GenerateDueSamples();
+
+  if ( !s_isBlockFull[ s_readBlockIndex ] )
+    return nullptr;
+
+  return &s_blocks[ s_readBlockIndex ];
+}
+
+
+void LogicSampler_ReleaseBlock ( void )
+{
+  assert( s_isBlockFull[ s_readBlockIndex ] );
+
+  s_isBlockFull[ s_readBlockIndex ] = false;
+  s_readBlockIndex = uint8_t( s_readBlockIndex ^ 1 );
+}
@@ -0,0 +1,205 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "SimulatedPio.h"  // The include file for this module should come first.
+
+#include <assert.h>
+
+#include <pio.h>
+
+#include <JtagFirmware/JtagPins.h>
+
+#include "SimulatedTap.h"
+
+
+Pio g_simulatedPios[ SIMULATED_PIO_COUNT ];
+
+struct PioState
+{
+  uint32_t outputData;       // PIO_ODSR.
+  uint32_t outputEnabled;    // PIO_OSR.
+  uint32_t pullUpDisabled;   // PIO_PUSR.
+};
+
+static PioState s_pioStates[ SIMULATED_PIO_COUNT ];
+
+static bool s_lastTck;
+
+
+static PioState & GetPioState ( const Pio * const pio ) throw()
+{
+  const uintptr_t index = ( uintptr_t( pio ) - uintptr_t( PIOA ) ) / PIO_DELTA;
+
+  assert( index < SIMULATED_PIO_COUNT );
+
+  return s_pioStates[ index ];
+}
+
+
+static uint32_t GetPinLevels ( const Pio * const pio ) throw()
+{
+  const PioState & s = GetPioState( pio );
+
+  // The inputs read high if their pull-ups are enabled. Otherwise, they would be floating,
+  // and the emulator lets them read low.
+  uint32_t inputLevels = ~s.pullUpDisabled;
+
+  if ( pio == JTAG_TDO_PIO && g_simulatedTapChain.IsTdoDriven() )
+  {
+    const uint32_t tdoMask = uint32_t( 1 ) << JTAG_TDO_PIN;
+
+    if ( g_simulatedTapChain.GetTdo() )
+      inputLevels |= tdoMask;
+    else
+      inputLevels &= ~tdoMask;
+  }
+
+  return ( s.outputData & s.outputEnabled ) | ( inputLevels & ~s.outputEnabled );
+}
+
+
+static bool GetPinLevel ( const Pio * const pio, const uint8_t pinNumber ) throw()
+{
+  return 0 != ( GetPinLevels( pio ) & ( uint32_t( 1 ) << pinNumber ) );
+}
+
+
+// Called after each change to the PIO state, in order to detect the edges on the JTAG signals.
+
+static void UpdateJtagSignals ( void ) throw()
+{
+  const bool tck  = GetPinLevel( JTAG_TCK_PIO , JTAG_TCK_PIN  );
+  const bool trst = GetPinLevel( JTAG_TRST_PIO, JTAG_TRST_PIN );
+
+  // TRST is active low, and holds the TAP in reset as long as it is asserted.
+
+  if ( !trst )
+  {
+    g_simulatedTapChain.Reset();
+  }
+  else if ( tck != s_lastTck )
+  {
+    if ( tck )
+    {
+      g_simulatedTapChain.ClockRisingEdge( GetPinLevel( JTAG_TDI_PIO, JTAG_TDI_PIN ),
+                                           GetPinLevel( JTAG_TMS_PIO, JTAG_TMS_PIN ) );
+    }
+    else
+    {
+      g_simulatedTapChain.ClockFallingEdge();
+    }
+  }
+
+  s_lastTck = tck;
+}
+
+
+void InitSimulatedPios ( void ) throw()
+{
+  // Like after a reset: all pins are inputs with the pull-ups enabled.
+
+  for ( PioState & s : s_pioStates )
+  {
+    s.outputData     = 0;
+    s.outputEnabled  = 0;
+    s.pullUpDisabled = 0;
+  }
+
+  s_lastTck = GetPinLevel( JTAG_TCK_PIO , JTAG_TCK_PIN  );
+}
+
+
+uint32_t SimulatedPioRead ( const Pio * const pio, const PioRegisterEnum reg ) throw()
+{
+  const PioState & s = GetPioState( pio );
+
+  switch ( reg )
+  {
+  case pioRegPsr:  return UINT32_MAX;  // All pins are controlled by the PIO, and not by some other peripheral.
+  case pioRegPusr: return s.pullUpDisabled;
+  case pioRegOwsr: return 0;  // Writing to PIO_ODSR is not supported.
+  case pioRegOdsr: return s.outputData;
+  case pioRegPdsr: return GetPinLevels( pio );
+
+  default:
+    assert( false );  // Write-only register.
+    return 0;
+  }
+}
+
+
+void SimulatedPioWrite ( Pio * const pio, const PioRegisterEnum reg, const uint32_t val ) throw()
+{
+  PioState & s = GetPioState( pio );
+
+  switch ( reg )
+  {
+  case pioRegSodr:
+    s.outputData |= val;
+    break;
+
+  case pioRegCodr:
+    s.outputData &= ~val;
+    break;
+
+  default:
+    assert( false );  // Read-only register, or one that the emulator does not support yet.
+    return;
+  }
+
+  UpdateJtagSignals();
+}
+
+
+void pio_set_input ( Pio * const p_pio, const uint32_t ul_mask, const uint32_t ul_attribute ) throw()
+{
+  PioState & s = GetPioState( p_pio );
+
+  s.outputEnabled &= ~ul_mask;
+
+  if ( ul_attribute & PIO_PULLUP )
+    s.pullUpDisabled &= ~ul_mask;
+  else
+    s.pullUpDisabled |= ul_mask;
+
+  UpdateJtagSignals();
+}
+
+
+void pio_set_output ( Pio * const p_pio,
+                      const uint32_t ul_mask,
+                      const uint32_t ul_default_level,
+                      const uint32_t ul_multidrive_enable,
+                      const uint32_t ul_pull_up_enable ) throw()
+{
+  // Open-drain outputs behave like normal outputs here, as there is nobody else driving the lines.
+  (void) ul_multidrive_enable;
+
+  PioState & s = GetPioState( p_pio );
+
+  if ( ul_default_level )
+    s.outputData |= ul_mask;
+  else
+    s.outputData &= ~ul_mask;
+
+  if ( ul_pull_up_enable )
+    s.pullUpDisabled &= ~ul_mask;
+  else
+    s.pullUpDisabled |= ul_mask;
+
+  s.outputEnabled |= ul_mask;
+
+  UpdateJtagSignals();
+}
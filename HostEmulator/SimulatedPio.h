@@ -0,0 +1,105 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+// The firmware accesses the Atmel PIO registers through the inline routines in IoUtils.h .
+// In the host emulator, those registers are C++ objects that intercept every read and write,
+// so that IoUtils.h and the JTAG bit-banging code compile unchanged and drive the simulated TAP chain
+// in SimulatedTap.h instead of real pins.
+//
+// Only the registers that the firmware modules compiled for the host actually use are implemented.
+
+#include <stdint.h>
+
+
+enum PioRegisterEnum
+{
+  pioRegPsr,   // PIO Status Register: whether the PIO controls the pin (and not a peripheral).
+  pioRegPusr,  // Pull-up Status Register, 0 means enabled.
+  pioRegOwsr,  // Output Write Status Register.
+  pioRegSodr,  // Set Output Data Register.
+  pioRegCodr,  // Clear Output Data Register.
+  pioRegOdsr,  // Output Data Status Register.
+  pioRegPdsr,  // Pin Data Status Register.
+};
+
+
+struct Pio;
+
+uint32_t SimulatedPioRead  ( const Pio * pio, PioRegisterEnum reg ) throw();
+void     SimulatedPioWrite (       Pio * pio, PioRegisterEnum reg, uint32_t val ) throw();
+
+
+// Each register object only knows which register it is. The owning Pio object is found
+// from the register's position inside it, which is why all registers must have the same size.
+
+template < PioRegisterEnum reg >
+class CSimulatedPioRegister
+{
+  uint32_t m_unused;
+
+  const Pio * GetPio ( void ) const throw()
+  {
+    return reinterpret_cast< const Pio * >( reinterpret_cast< uintptr_t >( this ) - uintptr_t( reg ) * sizeof( *this ) );
+  }
+
+public:
+
+  operator uint32_t () const throw()
+  {
+    return SimulatedPioRead( GetPio(), reg );
+  }
+
+  CSimulatedPioRegister & operator= ( const uint32_t val ) throw()
+  {
+    SimulatedPioWrite( const_cast< Pio * >( GetPio() ), reg, val );
+    return *this;
+  }
+};
+
+
+struct Pio
+{
+  CSimulatedPioRegister< pioRegPsr  > PIO_PSR;
+  CSimulatedPioRegister< pioRegPusr > PIO_PUSR;
+  CSimulatedPioRegister< pioRegOwsr > PIO_OWSR;
+  CSimulatedPioRegister< pioRegSodr > PIO_SODR;
+  CSimulatedPioRegister< pioRegCodr > PIO_CODR;
+  CSimulatedPioRegister< pioRegOdsr > PIO_ODSR;
+  CSimulatedPioRegister< pioRegPdsr > PIO_PDSR;
+};
+
+static_assert( sizeof( Pio ) == ( pioRegPdsr + 1 ) * sizeof( uint32_t ), "Unexpected padding in the Pio structure." );
+
+
+#define SIMULATED_PIO_COUNT  4
+
+extern Pio g_simulatedPios[ SIMULATED_PIO_COUNT ];
+
+#define PIOA  ( &g_simulatedPios[ 0 ] )
+#define PIOB  ( &g_simulatedPios[ 1 ] )
+#define PIOC  ( &g_simulatedPios[ 2 ] )
+#define PIOD  ( &g_simulatedPios[ 3 ] )
+
+#define PIO_DELTA  sizeof( Pio )
+
+// The same peripheral identifiers as on the SAM3X.
+#define ID_PIOA  11
+#define ID_PIOB  12
+#define ID_PIOC  13
+#define ID_PIOD  14
+
+
+void InitSimulatedPios ( void ) throw();
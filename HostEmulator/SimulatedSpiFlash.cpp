@@ -0,0 +1,313 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "SimulatedSpiFlash.h"  // The include file for this module should come first.
+
+#include <assert.h>
+
+#include <JtagFirmware/SpiPort.h>
+
+
+CSimulatedSpiFlash g_simulatedSpiFlash;
+
+
+static const uint8_t CMD_WRITE_STATUS_REGISTER     = 0x01;
+static const uint8_t CMD_PAGE_PROGRAM              = 0x02;
+static const uint8_t CMD_READ_DATA                 = 0x03;
+static const uint8_t CMD_WRITE_DISABLE             = 0x04;
+static const uint8_t CMD_READ_STATUS_REGISTER      = 0x05;
+static const uint8_t CMD_WRITE_ENABLE              = 0x06;
+static const uint8_t CMD_FAST_READ                 = 0x0B;
+static const uint8_t CMD_SECTOR_ERASE_4K           = 0x20;
+static const uint8_t CMD_VOLATILE_SR_WRITE_ENABLE  = 0x50;
+static const uint8_t CMD_BLOCK_ERASE_32K           = 0x52;
+static const uint8_t CMD_CHIP_ERASE_1              = 0x60;
+static const uint8_t CMD_READ_MANUFACTURER_ID      = 0x90;
+static const uint8_t CMD_READ_JEDEC_ID             = 0x9F;
+static const uint8_t CMD_RELEASE_POWER_DOWN        = 0xAB;
+static const uint8_t CMD_CHIP_ERASE_2              = 0xC7;
+static const uint8_t CMD_BLOCK_ERASE_64K           = 0xD8;
+
+static const uint8_t MANUFACTURER_ID = 0xEF;  // Winbond.
+static const uint8_t DEVICE_ID       = 0x13;
+static const uint8_t JEDEC_ID[]      = { MANUFACTURER_ID, 0x40, 0x14 };
+
+static const uint8_t STATUS_WEL_BIT = 0x02;
+
+static const uint32_t ADDRESS_BYTE_COUNT = 3;
+
+// The bus floats high when nobody drives MISO.
+static const uint8_t IDLE_MISO = 0xFF;
+
+
+CSimulatedSpiFlash::CSimulatedSpiFlash ( void )
+  : m_memory( SIZE, 0xFF )
+  , m_pageBuffer( PAGE_SIZE, 0xFF )
+  , m_isSelected( false )
+  , m_isSpiModeSupported( true )
+  , m_opcode( 0 )
+  , m_commandByteCount( 0 )
+  , m_address( 0 )
+  , m_pageProgramByteCount( 0 )
+  , m_newStatusRegister( 0 )
+  , m_isWriteEnabled( false )
+  , m_statusRegister( 0 )
+  , m_transferredByteCount( 0 )
+{
+}
+
+
+void CSimulatedSpiFlash::SetChipSelect ( const bool isActive ) throw()
+{
+  if ( isActive == m_isSelected )
+    return;
+
+  m_isSelected = isActive;
+
+  if ( isActive )
+  {
+    m_commandByteCount = 0;
+  }
+  else
+  {
+    if ( m_commandByteCount != 0 )
+      ExecuteCommandOnDeselect();
+  }
+}
+
+
+void CSimulatedSpiFlash::Erase ( const uint32_t blockSize ) throw()
+{
+  const uint32_t start = m_address & ~( blockSize - 1 );
+
+  for ( uint32_t i = 0; i < blockSize; ++i )
+    m_memory[ start + i ] = 0xFF;
+}
+
+
+// Like on the real chip, the write and erase commands only take effect when the chip select
+// goes inactive, and only if the command had the right length.
+
+void CSimulatedSpiFlash::ExecuteCommandOnDeselect ( void ) throw()
+{
+  const bool wasWriteEnabled = m_isWriteEnabled;
+
+  switch ( m_opcode )
+  {
+  case CMD_WRITE_ENABLE:
+  case CMD_VOLATILE_SR_WRITE_ENABLE:  // The simulation makes no difference between the volatile and non-volatile status registers.
+    m_isWriteEnabled = true;
+    return;
+
+  case CMD_WRITE_DISABLE:
+    m_isWriteEnabled = false;
+    return;
+
+  case CMD_WRITE_STATUS_REGISTER:
+    if ( wasWriteEnabled && m_commandByteCount >= 2 )
+    {
+      // Bits WEL and BUSY are read-only.
+      m_statusRegister = m_newStatusRegister & ~0x03;
+      m_isWriteEnabled = false;
+    }
+    return;
+
+  case CMD_PAGE_PROGRAM:
+    if ( wasWriteEnabled && m_commandByteCount > 1 + ADDRESS_BYTE_COUNT )
+    {
+      // Programming can only change bits from 1 to 0.
+      const uint32_t pageStart = m_address & ~( PAGE_SIZE - 1 );
+
+      for ( uint32_t i = 0; i < PAGE_SIZE; ++i )
+        m_memory[ pageStart + i ] &= m_pageBuffer[ i ];
+
+      m_isWriteEnabled = false;
+    }
+    return;
+
+  case CMD_SECTOR_ERASE_4K:
+  case CMD_BLOCK_ERASE_32K:
+  case CMD_BLOCK_ERASE_64K:
+    if ( wasWriteEnabled && m_commandByteCount == 1 + ADDRESS_BYTE_COUNT )
+    {
+      Erase( m_opcode == CMD_SECTOR_ERASE_4K ? 4 * 1024 :
+             m_opcode == CMD_BLOCK_ERASE_32K ? 32 * 1024 : 64 * 1024 );
+      m_isWriteEnabled = false;
+    }
+    return;
+
+  case CMD_CHIP_ERASE_1:
+  case CMD_CHIP_ERASE_2:
+    if ( wasWriteEnabled && m_commandByteCount == 1 )
+    {
+      m_address = 0;
+      Erase( SIZE );
+      m_isWriteEnabled = false;
+    }
+    return;
+
+  default:
+    return;
+  }
+}
+
+
+uint8_t CSimulatedSpiFlash::TransferByte ( const uint8_t mosi ) throw()
+{
+  ++m_transferredByteCount;
+
+  if ( !m_isSelected || !m_isSpiModeSupported )
+    return IDLE_MISO;
+
+  const uint32_t index = m_commandByteCount;
+  ++m_commandByteCount;
+
+  if ( index == 0 )
+  {
+    m_opcode = mosi;
+    m_address = 0;
+    m_pageProgramByteCount = 0;
+
+    if ( m_opcode == CMD_PAGE_PROGRAM )
+      m_pageBuffer.assign( PAGE_SIZE, 0xFF );
+
+    return IDLE_MISO;
+  }
+
+  const bool isAddressByte = index <= ADDRESS_BYTE_COUNT;
+
+  switch ( m_opcode )
+  {
+  case CMD_READ_JEDEC_ID:
+    return JEDEC_ID[ ( index - 1 ) % sizeof( JEDEC_ID ) ];
+
+  case CMD_READ_MANUFACTURER_ID:
+    if ( isAddressByte )
+      return IDLE_MISO;
+
+    return ( ( index - 1 - ADDRESS_BYTE_COUNT ) % 2 == 0 ) ? MANUFACTURER_ID : DEVICE_ID;
+
+  case CMD_RELEASE_POWER_DOWN:
+    return isAddressByte ? IDLE_MISO : DEVICE_ID;
+
+  case CMD_READ_STATUS_REGISTER:
+    return m_statusRegister | ( m_isWriteEnabled ? STATUS_WEL_BIT : 0 );
+
+  case CMD_WRITE_STATUS_REGISTER:
+    if ( index == 1 )
+      m_newStatusRegister = mosi;
+    return IDLE_MISO;
+
+  case CMD_READ_DATA:
+  case CMD_FAST_READ:
+    if ( isAddressByte )
+    {
+      m_address = ( ( m_address << 8 ) | mosi ) % SIZE;
+      return IDLE_MISO;
+    }
+
+    if ( m_opcode == CMD_FAST_READ && index == 1 + ADDRESS_BYTE_COUNT )
+      return IDLE_MISO;  // Dummy byte.
+
+    {
+      const uint8_t data = m_memory[ m_address ];
+      m_address = ( m_address + 1 ) % SIZE;
+      return data;
+    }
+
+  case CMD_PAGE_PROGRAM:
+    if ( isAddressByte )
+    {
+      m_address = ( ( m_address << 8 ) | mosi ) % SIZE;
+    }
+    else
+    {
+      // If more than a page is sent, the address wraps around within the page,
+      // and the last bytes win.
+      m_pageBuffer[ ( m_address + m_pageProgramByteCount ) % PAGE_SIZE ] = mosi;
+      ++m_pageProgramByteCount;
+    }
+    return IDLE_MISO;
+
+  case CMD_SECTOR_ERASE_4K:
+  case CMD_BLOCK_ERASE_32K:
+  case CMD_BLOCK_ERASE_64K:
+    if ( isAddressByte )
+      m_address = ( ( m_address << 8 ) | mosi ) % SIZE;
+    return IDLE_MISO;
+
+  default:
+    return IDLE_MISO;
+  }
+}
+
+
+// ------ Replacement for the firmware's SpiPort.cpp ------
+
+void SpiPort_Init ( void )
+{
+  g_simulatedSpiFlash.SetChipSelect( false );
+}
+
+
+void SpiPort_Terminate ( void )
+{
+  g_simulatedSpiFlash.SetChipSelect( false );
+}
+
+
+void SpiPort_SetChipSelect ( const bool isActive )
+{
+  g_simulatedSpiFlash.SetChipSelect( isActive );
+}
+
+
+bool SpiPort_SetSpeed ( const uint8_t speedIndex )
+{
+  // The simulation has no timing, but it rejects the same speeds as the real SPI port.
+  assert( speedIndex <= 7 );
+  return speedIndex >= SPI_PORT_DEFAULT_SPEED_INDEX;
+}
+
+
+void SpiPort_SetBusConfig ( const bool isOpenDrain,
+                            const bool isClockIdleHigh,
+                            const bool isOutputOnActiveToIdleEdge )
+{
+  // The simulated bus always has pull-ups, so open-drain outputs work too.
+  (void) isOpenDrain;
+
+  // SPI mode 0 is "clock idle low, output on the active to idle edge",
+  // and SPI mode 3 is "clock idle high, output on the idle to active edge".
+  g_simulatedSpiFlash.SetSpiModeSupported( isClockIdleHigh != isOutputOnActiveToIdleEdge );
+}
+
+
+void SpiPort_SetPullUps ( const bool enablePullUps )
+{
+  (void) enablePullUps;
+}
+
+
+void SpiPort_Transfer ( const uint8_t * const txData, uint8_t * const rxData, const uint32_t byteCount )
+{
+  for ( uint32_t i = 0; i < byteCount; ++i )
+  {
+    const uint8_t received = g_simulatedSpiFlash.TransferByte( txData[ i ] );
+
+    if ( rxData != nullptr )
+      rxData[ i ] = received;
+  }
+}
@@ -0,0 +1,77 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+// A simulated SPI NOR flash on the SPI bus of the Bus Pirate binary SPI mode.
+//
+// This module replaces the firmware's SpiPort.cpp , which drives the SAM3X SPI peripheral,
+// so that BusPirateSpiMode.cpp compiles unchanged and flashrom's 'buspirate_spi' programmer
+// can read, erase and write the simulated flash.
+//
+// The flash behaves like a Winbond W25Q80 (1 MiB, JEDEC ID EF 40 14) with these commands:
+//   0x9F Read JEDEC ID, 0x90 Read Manufacturer / Device ID, 0xAB Release Power-down / Device ID,
+//   0x05 Read Status Register, 0x01 Write Status Register, 0x06 Write Enable, 0x50 Volatile SR Write Enable,
+//   0x04 Write Disable, 0x03 Read Data, 0x0B Fast Read, 0x02 Page Program,
+//   0x20 Sector Erase (4 KiB), 0x52 Block Erase (32 KiB), 0xD8 Block Erase (64 KiB), 0x60 and 0xC7 Chip Erase.
+//
+// Program and erase operations complete immediately, so the BUSY status bit is never set.
+// The write protection bits in the status register are stored, but they are not honoured.
+// The flash only responds in SPI modes 0 and 3, like the real chip.
+
+#include <stdint.h>
+
+#include <vector>
+
+
+class CSimulatedSpiFlash
+{
+public:
+  static const uint32_t SIZE = 1024 * 1024;
+  static const uint32_t PAGE_SIZE = 256;
+
+  CSimulatedSpiFlash ( void );
+
+  void SetChipSelect ( bool isActive ) throw();
+
+  void SetSpiModeSupported ( const bool isSupported ) throw() { m_isSpiModeSupported = isSupported; }
+
+  uint8_t TransferByte ( uint8_t mosi ) throw();
+
+  uint64_t GetTransferredByteCount ( void ) const throw() { return m_transferredByteCount; }
+
+private:
+  void ExecuteCommandOnDeselect ( void ) throw();
+  void Erase ( uint32_t blockSize ) throw();
+
+  std::vector< uint8_t > m_memory;
+  std::vector< uint8_t > m_pageBuffer;
+
+  bool m_isSelected;
+  bool m_isSpiModeSupported;
+
+  uint8_t  m_opcode;
+  uint32_t m_commandByteCount;  // Including the opcode.
+  uint32_t m_address;
+  uint32_t m_pageProgramByteCount;
+  uint8_t  m_newStatusRegister;
+
+  bool    m_isWriteEnabled;
+  uint8_t m_statusRegister;
+
+  uint64_t m_transferredByteCount;
+};
+
+
+extern CSimulatedSpiFlash g_simulatedSpiFlash;
@@ -0,0 +1,279 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "SimulatedTap.h"  // The include file for this module should come first.
+
+#include <assert.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include <stdexcept>
+
+
+CSimulatedTapChain g_simulatedTapChain;
+
+
+static TapStateEnum GetNextTapState ( const TapStateEnum state, const bool tms ) throw()
+{
+  switch ( state )
+  {
+  case tsTestLogicReset: return tms ? tsTestLogicReset : tsRunTestIdle;
+  case tsRunTestIdle:    return tms ? tsSelectDrScan   : tsRunTestIdle;
+
+  case tsSelectDrScan:   return tms ? tsSelectIrScan   : tsCaptureDr;
+  case tsCaptureDr:      return tms ? tsExit1Dr        : tsShiftDr;
+  case tsShiftDr:        return tms ? tsExit1Dr        : tsShiftDr;
+  case tsExit1Dr:        return tms ? tsUpdateDr       : tsPauseDr;
+  case tsPauseDr:        return tms ? tsExit2Dr        : tsPauseDr;
+  case tsExit2Dr:        return tms ? tsUpdateDr       : tsShiftDr;
+  case tsUpdateDr:       return tms ? tsSelectDrScan   : tsRunTestIdle;
+
+  case tsSelectIrScan:   return tms ? tsTestLogicReset : tsCaptureIr;
+  case tsCaptureIr:      return tms ? tsExit1Ir        : tsShiftIr;
+  case tsShiftIr:        return tms ? tsExit1Ir        : tsShiftIr;
+  case tsExit1Ir:        return tms ? tsUpdateIr       : tsPauseIr;
+  case tsPauseIr:        return tms ? tsExit2Ir        : tsPauseIr;
+  case tsExit2Ir:        return tms ? tsUpdateIr       : tsShiftIr;
+  case tsUpdateIr:       return tms ? tsSelectDrScan   : tsRunTestIdle;
+
+  default:
+    assert( false );
+    return tsTestLogicReset;
+  }
+}
+
+
+const char * GetTapStateName ( const TapStateEnum state ) throw()
+{
+  switch ( state )
+  {
+  case tsTestLogicReset: return "Test-Logic-Reset";
+  case tsRunTestIdle:    return "Run-Test/Idle";
+  case tsSelectDrScan:   return "Select-DR-Scan";
+  case tsCaptureDr:      return "Capture-DR";
+  case tsShiftDr:        return "Shift-DR";
+  case tsExit1Dr:        return "Exit1-DR";
+  case tsPauseDr:        return "Pause-DR";
+  case tsExit2Dr:        return "Exit2-DR";
+  case tsUpdateDr:       return "Update-DR";
+  case tsSelectIrScan:   return "Select-IR-Scan";
+  case tsCaptureIr:      return "Capture-IR";
+  case tsShiftIr:        return "Shift-IR";
+  case tsExit1Ir:        return "Exit1-IR";
+  case tsPauseIr:        return "Pause-IR";
+  case tsExit2Ir:        return "Exit2-IR";
+  case tsUpdateIr:       return "Update-IR";
+
+  default:
+    assert( false );
+    return "<unknown>";
+  }
+}
+
+
+static uint64_t GetBitMask ( const uint8_t bitCount ) throw()
+{
+  assert( bitCount >= 1 && bitCount <= 64 );
+
+  return bitCount == 64 ? UINT64_MAX : ( ( uint64_t( 1 ) << bitCount ) - 1 );
+}
+
+
+CSimulatedTap::CSimulatedTap ( const uint32_t idCode,
+                               const uint8_t userDrLength,
+                               const std::vector< uint64_t > & userDrCaptureValues )
+  : m_idCode( idCode )
+  , m_userDrLength( userDrLength )
+  , m_userDrCaptureValues( userDrCaptureValues )
+{
+  // The IEEE 1149.1 standard mandates that the IDCODE's least-significant bit is 1.
+  if ( 0 == ( idCode & 1 ) )
+    throw std::runtime_error( "The least-significant bit of the IDCODE must be 1." );
+
+  if ( userDrLength < 1 || userDrLength > MAX_USER_DR_LENGTH )
+    throw std::runtime_error( "Invalid USER data register length." );
+
+  Reset();
+}
+
+
+void CSimulatedTap::Reset ( void ) throw()
+{
+  m_state       = tsTestLogicReset;
+  m_instruction = IR_IDCODE;
+  m_userDr      = 0;
+  m_userDrUpdateCount = 0;
+  m_nextUserDrCaptureValueIndex = 0;
+
+  m_shiftRegister       = 0;
+  m_shiftRegisterLength = 1;
+
+  m_tdo         = false;
+  m_isTdoDriven = false;
+}
+
+
+uint8_t CSimulatedTap::GetSelectedDrLength ( void ) const throw()
+{
+  switch ( m_instruction )
+  {
+  case IR_IDCODE: return 32;
+  case IR_USER:   return m_userDrLength;
+  default:        return 1;  // BYPASS.
+  }
+}
+
+
+void CSimulatedTap::ClockRisingEdge ( const bool tdi, const bool tms ) throw()
+{
+  switch ( m_state )
+  {
+  case tsCaptureIr:
+    m_shiftRegister       = 0x1;
+    m_shiftRegisterLength = IR_LENGTH;
+    break;
+
+  case tsCaptureDr:
+    m_shiftRegisterLength = GetSelectedDrLength();
+
+    switch ( m_instruction )
+    {
+    case IR_IDCODE:
+      m_shiftRegister = m_idCode;
+      break;
+
+    case IR_USER:
+      if ( m_userDrCaptureValues.empty() )
+      {
+        m_shiftRegister = m_userDr;
+      }
+      else
+      {
+        m_shiftRegister = m_userDrCaptureValues[ m_nextUserDrCaptureValueIndex ] & GetBitMask( m_userDrLength );
+        m_nextUserDrCaptureValueIndex = ( m_nextUserDrCaptureValueIndex + 1 ) % m_userDrCaptureValues.size();
+      }
+      break;
+
+    default:
+      m_shiftRegister = 0;
+      break;
+    }
+    break;
+
+  case tsShiftIr:
+  case tsShiftDr:
+    // LSB goes out first, and the new bit comes in at the MSB.
+    m_shiftRegister >>= 1;
+
+    if ( tdi )
+      m_shiftRegister |= uint64_t( 1 ) << ( m_shiftRegisterLength - 1 );
+    break;
+
+  default:
+    break;
+  }
+
+  m_state = GetNextTapState( m_state, tms );
+
+  if ( m_state == tsTestLogicReset )
+  {
+    m_instruction = IR_IDCODE;
+  }
+}
+
+
+void CSimulatedTap::ClockFallingEdge ( void ) throw()
+{
+  switch ( m_state )
+  {
+  case tsShiftIr:
+  case tsShiftDr:
+    m_tdo         = 0 != ( m_shiftRegister & 1 );
+    m_isTdoDriven = true;
+    break;
+
+  case tsUpdateIr:
+    m_instruction = uint32_t( m_shiftRegister & GetBitMask( IR_LENGTH ) );
+    m_isTdoDriven = false;
+    break;
+
+  case tsUpdateDr:
+    if ( m_instruction == IR_USER )
+    {
+      m_userDr = m_shiftRegister & GetBitMask( m_userDrLength );
+      ++m_userDrUpdateCount;
+    }
+    m_isTdoDriven = false;
+    break;
+
+  default:
+    m_isTdoDriven = false;
+    break;
+  }
+}
+
+
+void CSimulatedTapChain::Reset ( void ) throw()
+{
+  for ( CSimulatedTap & tap : m_taps )
+    tap.Reset();
+}
+
+
+void CSimulatedTapChain::ClockRisingEdge ( const bool tdi, const bool tms ) throw()
+{
+  ++m_clockCount;
+
+  // TDO only changes on the falling edge, so each device can sample its predecessor's TDO
+  // in any order during the rising edge. Iterating backwards makes that obvious.
+
+  for ( size_t i = m_taps.size(); i-- > 0; )
+  {
+    const bool tapTdi = ( i == 0 ) ? tdi : m_taps[ i - 1 ].GetTdo();
+
+    m_taps[ i ].ClockRisingEdge( tapTdi, tms );
+  }
+}
+
+
+void CSimulatedTapChain::ClockFallingEdge ( void ) throw()
+{
+  for ( size_t i = 0; i < m_taps.size(); ++i )
+  {
+    CSimulatedTap & tap = m_taps[ i ];
+
+    const uint32_t prevUpdateCount = tap.GetUserDrUpdateCount();
+
+    tap.ClockFallingEdge();
+
+    if ( m_traceUserDrUpdates && prevUpdateCount != tap.GetUserDrUpdateCount() )
+    {
+      printf( "TAP %zu: USER DR updated to 0x%016" PRIX64 ".\n", i, tap.GetUserDr() );
+    }
+  }
+}
+
+
+bool CSimulatedTapChain::IsTdoDriven ( void ) const throw()
+{
+  return !m_taps.empty() && m_taps.back().IsTdoDriven();
+}
+
+
+bool CSimulatedTapChain::GetTdo ( void ) const throw()
+{
+  assert( IsTdoDriven() );
+  return m_taps.back().GetTdo();
+}
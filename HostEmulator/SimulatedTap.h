@@ -0,0 +1,143 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+// A simulated IEEE 1149.1 JTAG TAP chain.
+//
+// Every device in the chain has the same simple layout:
+//
+//   - A 4-bit instruction register. Capture-IR loads the mandatory 0b0001 pattern.
+//   - IDCODE (0xE), 32 bits. This is the instruction selected after a TAP reset.
+//   - BYPASS (0xF), 1 bit. Unknown instructions select BYPASS too.
+//   - USER   (0x8), a scriptable data register with a configurable length of up to 64 bits.
+//     Each Capture-DR loads the next value from a user-supplied list, cycling round.
+//     If the list is empty, Capture-DR loads the value written by the last Update-DR,
+//     so that the register behaves like a loopback.
+//
+// The timing follows the standard: TDI and TMS are sampled on TCK's rising edge,
+// and TDO changes on TCK's falling edge.
+
+#include <stdint.h>
+#include <stddef.h>  // For size_t.
+
+#include <vector>
+
+
+enum TapStateEnum
+{
+  tsTestLogicReset,
+  tsRunTestIdle,
+  tsSelectDrScan,
+  tsCaptureDr,
+  tsShiftDr,
+  tsExit1Dr,
+  tsPauseDr,
+  tsExit2Dr,
+  tsUpdateDr,
+  tsSelectIrScan,
+  tsCaptureIr,
+  tsShiftIr,
+  tsExit1Ir,
+  tsPauseIr,
+  tsExit2Ir,
+  tsUpdateIr
+};
+
+
+class CSimulatedTap
+{
+public:
+  static const uint8_t  IR_LENGTH = 4;
+
+  static const uint32_t IR_USER   = 0x8;
+  static const uint32_t IR_IDCODE = 0xE;
+  static const uint32_t IR_BYPASS = 0xF;
+
+  static const uint8_t  MAX_USER_DR_LENGTH = 64;
+
+  CSimulatedTap ( uint32_t idCode,
+                  uint8_t userDrLength,
+                  const std::vector< uint64_t > & userDrCaptureValues );
+
+  void Reset ( void ) throw();
+
+  void ClockRisingEdge ( bool tdi, bool tms ) throw();
+  void ClockFallingEdge ( void ) throw();
+
+  // When TDO is not driven, the pin is in high-impedance mode.
+  bool IsTdoDriven ( void ) const throw() { return m_isTdoDriven; }
+  bool GetTdo      ( void ) const throw() { return m_tdo; }
+
+  TapStateEnum GetState ( void ) const throw() { return m_state; }
+
+  uint32_t GetInstruction ( void ) const throw() { return m_instruction; }
+  uint64_t GetUserDr      ( void ) const throw() { return m_userDr; }
+
+  uint32_t GetUserDrUpdateCount ( void ) const throw() { return m_userDrUpdateCount; }
+
+private:
+  uint8_t GetSelectedDrLength ( void ) const throw();
+
+  const uint32_t m_idCode;
+  const uint8_t  m_userDrLength;
+  const std::vector< uint64_t > m_userDrCaptureValues;
+  size_t m_nextUserDrCaptureValueIndex;
+
+  TapStateEnum m_state;
+  uint32_t m_instruction;
+  uint64_t m_userDr;
+  uint32_t m_userDrUpdateCount;
+
+  uint64_t m_shiftRegister;
+  uint8_t  m_shiftRegisterLength;
+
+  bool m_tdo;
+  bool m_isTdoDriven;
+};
+
+
+// The first device's TDI is the adapter's TDI, and the last device's TDO is the adapter's TDO.
+
+class CSimulatedTapChain
+{
+public:
+  void AddTap ( const CSimulatedTap & tap ) { m_taps.push_back( tap ); }
+
+  size_t GetTapCount ( void ) const throw() { return m_taps.size(); }
+
+  const CSimulatedTap & GetTap ( const size_t index ) const throw() { return m_taps[ index ]; }
+
+  void Reset ( void ) throw();
+
+  void ClockRisingEdge ( bool tdi, bool tms ) throw();
+  void ClockFallingEdge ( void ) throw();
+
+  bool IsTdoDriven ( void ) const throw();
+  bool GetTdo ( void ) const throw();
+
+  uint64_t GetClockCount ( void ) const throw() { return m_clockCount; }
+
+  void SetTraceUserDrUpdates ( const bool trace ) throw() { m_traceUserDrUpdates = trace; }
+
+private:
+  std::vector< CSimulatedTap > m_taps;
+  uint64_t m_clockCount = 0;
+  bool m_traceUserDrUpdates = false;
+};
+
+
+extern CSimulatedTapChain g_simulatedTapChain;
+
+const char * GetTapStateName ( TapStateEnum state ) throw();
@@ -0,0 +1,85 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+// This module replaces the firmware's UartPort.cpp . The simulated UART has its transmit line
+// connected to its receive line, so all data sent comes straight back, like with a loopback plug.
+// The "DMA" completes immediately, so the UART is never busy.
+
+#include <JtagFirmware/UartPort.h>
+
+#include <assert.h>
+
+#include <BareMetalSupport/MainLoopSleep.h>
+
+
+static uint8_t * s_rxRingBuffer;
+static uint32_t  s_rxRingBufferSize;
+static uint32_t  s_rxWriteCount;
+
+
+void UartPort_Init ( uint8_t * const rxRingBuffer, const uint32_t rxRingBufferSize )
+{
+  assert( 0 == ( rxRingBufferSize & ( rxRingBufferSize - 1 ) ) );
+
+  s_rxRingBuffer = rxRingBuffer;
+  s_rxRingBufferSize = rxRingBufferSize;
+  s_rxWriteCount = 0;
+}
+
+
+bool UartPort_SetLineCoding ( const uint32_t baudRate,
+                              const uint8_t dataBits,
+                              const UartParityEnum parity,
+                              const UartStopBitsEnum stopBits )
+{
+  // The line settings make no difference to a loopback.
+  (void) parity;
+  (void) stopBits;
+
+  return baudRate != 0 && dataBits >= 5 && dataBits <= 8;
+}
+
+
+uint32_t UartPort_GetRxWriteCount ( void )
+{
+  return s_rxWriteCount;
+}
+
+
+uint32_t UartPort_GetRxErrorCount ( void )
+{
+  return 0;
+}
+
+
+bool UartPort_IsTxBusy ( void )
+{
+  return false;
+}
+
+
+void UartPort_StartTx ( const uint8_t * const data, const uint32_t dataLen )
+{
+  // Like the reception DMA, overwrite any data that has not been read yet.
+
+  for ( uint32_t i = 0; i < dataLen; ++i )
+  {
+    s_rxRingBuffer[ s_rxWriteCount % s_rxRingBufferSize ] = data[ i ];
+    ++s_rxWriteCount;
+  }
+
+  // Like the USART interrupt handler does when new data arrives.
+  WakeFromMainLoopSleep();
+}
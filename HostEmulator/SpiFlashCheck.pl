@@ -0,0 +1,481 @@
+#!/usr/bin/perl
+
+# This script checks the Bus Pirate binary SPI mode against the host emulator's simulated SPI flash,
+# see SimulatedSpiFlash.h . It runs as part of "make check", see RunChecks.sh .
+#
+# flashrom is not needed. The script follows the same steps as flashrom's 'buspirate_spi' programmer
+# when writing a flash chip:
+# - Init:    reset the Bus Pirate with '#' and wait for the "HiZ>" prompt, enter the binary mode and
+#            then the binary SPI mode, configure the peripherals, the speed and the bus, and read the JEDEC ID.
+#            An SPI speed that the DebugDue cannot reach must be rejected.
+# - Erase:   erase the whole chip and check that it is blank.
+# - Program: write a pseudo-random image page by page, polling the status register after each page.
+# - Verify:  read the whole chip back and compare it with the image.
+# Afterwards, it erases a single sector and checks that only that sector has changed,
+# and it leaves the binary mode in order to check that the console still works.
+#
+# Usage:
+#   perl SpiFlashCheck.pl <serial port>
+#
+# The exit code is non-zero if any check fails.
+#
+# Copyright (c) 2012 - R. Diez - Licensed under the GNU AGPLv3.
+
+use strict;
+use warnings;
+
+use FindBin qw( $Bin $Script );
+use IO::Handle;
+use IO::Select;
+use Fcntl;
+use Time::HiRes qw( time );
+
+use constant EXIT_CODE_SUCCESS       => 0;
+use constant EXIT_CODE_FAILURE_ARGS  => 1;
+use constant EXIT_CODE_FAILURE_ERROR => 2;
+
+# Bus Pirate binary mode commands, see BusPirateBinaryMode.cpp and BusPirateSpiMode.cpp .
+use constant BIN_MODE_CHAR        => 0x00;
+use constant BIN_CMD_SPI_MODE     => 0x01;
+use constant BIN_CMD_CONSOLE_MODE => 0x0F;
+
+use constant SPI_CMD_EXIT               => 0x00;
+use constant SPI_CMD_CS_HIGH            => 0x03;
+use constant SPI_CMD_WRITE_THEN_READ    => 0x04;
+use constant SPI_CMD_CONFIG_PERIPHERALS => 0x40;
+use constant SPI_CMD_SET_SPEED          => 0x60;
+use constant SPI_CMD_CONFIG_BUS         => 0x80;
+
+use constant SPI_REPLY_SUCCESS => "\x01";
+use constant SPI_REPLY_FAILURE => "\x00";
+
+# Like flashrom: power on, AUX high, chip select high.
+use constant SPI_PERIPHERALS => 0x0B;
+# 8 MHz.
+use constant SPI_SPEED => 0x07;
+# 30 kHz, which the DebugDue cannot reach.
+use constant SPI_SPEED_TOO_SLOW => 0x00;
+# Like flashrom: push-pull outputs (3.3 V), clock idle low, data changes on the active to idle clock edge.
+use constant SPI_BUS_CONFIG => 0x0A;
+
+use constant MAX_WRITE_THEN_READ_BYTE_COUNT => 4096;
+
+# SPI flash commands.
+use constant FLASH_CMD_WRITE_ENABLE => 0x06;
+use constant FLASH_CMD_READ_STATUS  => 0x05;
+use constant FLASH_CMD_READ_DATA    => 0x03;
+use constant FLASH_CMD_PAGE_PROGRAM => 0x02;
+use constant FLASH_CMD_SECTOR_ERASE => 0x20;
+use constant FLASH_CMD_CHIP_ERASE   => 0xC7;
+use constant FLASH_CMD_READ_JEDEC   => 0x9F;
+
+use constant FLASH_STATUS_BUSY => 0x01;
+use constant FLASH_STATUS_WEL  => 0x02;
+
+# The simulated flash is a Winbond W25Q80.
+use constant FLASH_JEDEC_ID    => "\xEF\x40\x14";
+use constant FLASH_SIZE        => 1024 * 1024;
+use constant FLASH_PAGE_SIZE   => 256;
+use constant FLASH_SECTOR_SIZE => 4096;
+
+# Programming the whole chip page by page takes too long for an automated check,
+# so only the beginning of the chip is programmed. The rest must stay blank.
+use constant PROGRAMMED_BYTE_COUNT => 64 * 1024;
+
+use constant ERASED_SECTOR_ADDR => 2 * FLASH_SECTOR_SIZE;
+
+
+sub write_stdout ( $ )
+{
+  ( print STDOUT $_[0] ) or die "Error writing to standard output: $!\n";
+}
+
+
+# ------------ Serial port ------------
+
+sub read_with_timeout ( $ $ $ )
+{
+  my $fh        = shift;
+  my $byteCount = shift;
+  my $timeout   = shift;
+
+  my $data = "";
+  my $select = IO::Select->new( $fh );
+  my $endTime = time() + $timeout;
+
+  while ( length( $data ) < $byteCount )
+  {
+    my $remaining = $endTime - time();
+
+    last if $remaining <= 0;
+
+    next if !$select->can_read( $remaining );
+
+    my $readCount = sysread( $fh, $data, $byteCount - length( $data ), length( $data ) );
+
+    if ( !defined( $readCount ) )
+    {
+      die "Error reading from the serial port: $!\n";
+    }
+
+    if ( $readCount == 0 )
+    {
+      die "The serial port has been closed.\n";
+    }
+  }
+
+  return $data;
+}
+
+
+sub write_all ( $ $ )
+{
+  my $fh   = shift;
+  my $data = shift;
+
+  my $offset = 0;
+
+  while ( $offset < length( $data ) )
+  {
+    my $writtenCount = syswrite( $fh, $data, length( $data ) - $offset, $offset );
+
+    if ( !defined( $writtenCount ) )
+    {
+      die "Error writing to the serial port: $!\n";
+    }
+
+    $offset += $writtenCount;
+  }
+}
+
+
+sub expect_reply ( $ $ $ )
+{
+  my $fh       = shift;
+  my $expected = shift;
+  my $context  = shift;
+
+  my $reply = read_with_timeout( $fh, length( $expected ), 3 );
+
+  if ( $reply ne $expected )
+  {
+    die sprintf( qq<Unexpected reply "%s" %s, expected "%s".\n>, unpack( "H*", $reply ), $context, unpack( "H*", $expected ) );
+  }
+}
+
+
+sub wait_for_console_prompt ( $ )
+{
+  my $fh = shift;
+
+  write_all( $fh, "#\r" );
+
+  my $banner = "";
+  my $endTime = time() + 3;
+
+  while ( $banner !~ m/HiZ>/ )
+  {
+    my $remaining = $endTime - time();
+
+    if ( $remaining <= 0 )
+    {
+      die "The console did not answer the '#' command with the \"HiZ>\" prompt.\n";
+    }
+
+    $banner .= read_with_timeout( $fh, 1, $remaining );
+  }
+
+  if ( $banner !~ m/Firmware v6\.2/ )
+  {
+    die "The console reported the wrong Bus Pirate firmware version.\n";
+  }
+}
+
+
+sub enter_binary_mode ( $ )
+{
+  my $fh = shift;
+
+  # Discard anything the console may have printed so far.
+  read_with_timeout( $fh, 1000000, 0.2 );
+
+  # Like flashrom, send zeros until the binary mode answers.
+
+  for ( my $i = 0; $i < 20; ++$i )
+  {
+    write_all( $fh, pack( "C", BIN_MODE_CHAR ) );
+
+    my $reply = read_with_timeout( $fh, 1000000, 0.05 );
+
+    if ( $reply =~ m/BBIO1/ )
+    {
+      # Each zero sent after the first one has generated another welcome string.
+      read_with_timeout( $fh, 1000000, 0.2 );
+      return;
+    }
+  }
+
+  die "The DebugDue did not enter the binary mode.\n";
+}
+
+
+sub send_spi_cmd ( $ $ $ )
+{
+  my $fh      = shift;
+  my $cmdCode = shift;
+  my $context = shift;
+
+  write_all( $fh, pack( "C", $cmdCode ) );
+  expect_reply( $fh, SPI_REPLY_SUCCESS, $context );
+}
+
+
+# ------------ SPI flash ------------
+
+sub write_then_read ( $ $ $ )
+{
+  my $fh        = shift;
+  my $writeData = shift;
+  my $readCount = shift;
+
+  write_all( $fh, pack( "Cnn", SPI_CMD_WRITE_THEN_READ, length( $writeData ), $readCount ) . $writeData );
+
+  # The success byte comes after all data has been written to the SPI bus.
+  expect_reply( $fh, SPI_REPLY_SUCCESS, sprintf( "to the write then read command with SPI command 0x%02X", ord( $writeData ) ) );
+
+  my $readData = read_with_timeout( $fh, $readCount, 5 );
+
+  if ( length( $readData ) != $readCount )
+  {
+    die "Timeout waiting for the data of the write then read command.\n";
+  }
+
+  return $readData;
+}
+
+
+sub flash_cmd_with_address ( $ $ )
+{
+  my $cmdCode = shift;
+  my $addr    = shift;
+
+  return pack( "CCCC", $cmdCode, ( $addr >> 16 ) & 0xFF, ( $addr >> 8 ) & 0xFF, $addr & 0xFF );
+}
+
+
+sub wait_while_busy ( $ )
+{
+  my $fh = shift;
+
+  for ( my $i = 0; $i < 1000; ++$i )
+  {
+    my $status = ord( write_then_read( $fh, pack( "C", FLASH_CMD_READ_STATUS ), 1 ) );
+
+    return if ( $status & FLASH_STATUS_BUSY ) == 0;
+  }
+
+  die "The flash stayed busy for too long.\n";
+}
+
+
+sub write_enable ( $ )
+{
+  my $fh = shift;
+
+  write_then_read( $fh, pack( "C", FLASH_CMD_WRITE_ENABLE ), 0 );
+
+  my $status = ord( write_then_read( $fh, pack( "C", FLASH_CMD_READ_STATUS ), 1 ) );
+
+  if ( ( $status & FLASH_STATUS_WEL ) == 0 )
+  {
+    die "The Write Enable command did not set the WEL bit in the status register.\n";
+  }
+}
+
+
+sub read_flash ( $ $ $ )
+{
+  my $fh        = shift;
+  my $addr      = shift;
+  my $byteCount = shift;
+
+  my $data = "";
+
+  while ( length( $data ) < $byteCount )
+  {
+    my $chunkLen = $byteCount - length( $data );
+
+    $chunkLen = MAX_WRITE_THEN_READ_BYTE_COUNT if $chunkLen > MAX_WRITE_THEN_READ_BYTE_COUNT;
+
+    $data .= write_then_read( $fh, flash_cmd_with_address( FLASH_CMD_READ_DATA, $addr + length( $data ) ), $chunkLen );
+  }
+
+  return $data;
+}
+
+
+sub verify_flash ( $ $ $ )
+{
+  my $fh       = shift;
+  my $expected = shift;
+  my $context  = shift;
+
+  my $actual = read_flash( $fh, 0, FLASH_SIZE );
+
+  return if $actual eq $expected;
+
+  for ( my $i = 0; $i < FLASH_SIZE; ++$i )
+  {
+    if ( substr( $actual, $i, 1 ) ne substr( $expected, $i, 1 ) )
+    {
+      die sprintf( "Verification failed %s at address 0x%06X: read 0x%02X, expected 0x%02X.\n",
+                   $context, $i, ord( substr( $actual, $i, 1 ) ), ord( substr( $expected, $i, 1 ) ) );
+    }
+  }
+
+  die "Internal error comparing the flash contents.\n";
+}
+
+
+sub generate_image ()
+{
+  # A fixed seed makes any failure reproducible.
+  srand( 1 );
+
+  my $image = "";
+
+  for ( my $i = 0; $i < PROGRAMMED_BYTE_COUNT; ++$i )
+  {
+    $image .= chr( int( rand( 256 ) ) );
+  }
+
+  return $image . ( "\xFF" x ( FLASH_SIZE - PROGRAMMED_BYTE_COUNT ) );
+}
+
+
+sub run_check ( $ )
+{
+  my $device = shift;
+
+  system( "stty", "-F", $device, "raw", "-echo" ) == 0
+    or die qq<Cannot configure serial port "$device" with stty.\n>;
+
+  sysopen( my $fh, $device, O_RDWR | O_NOCTTY ) or die qq<Cannot open serial port "$device": $!\n>;
+
+  my $startTime = time();
+
+  # ---- Init ----
+
+  wait_for_console_prompt( $fh );
+
+  enter_binary_mode( $fh );
+
+  write_all( $fh, pack( "C", BIN_CMD_SPI_MODE ) );
+  expect_reply( $fh, "SPI1", "when entering the binary SPI mode" );
+
+  send_spi_cmd( $fh, SPI_CMD_CONFIG_PERIPHERALS | SPI_PERIPHERALS, "to the peripheral configuration command" );
+  write_all( $fh, pack( "C", SPI_CMD_SET_SPEED | SPI_SPEED_TOO_SLOW ) );
+  expect_reply( $fh, SPI_REPLY_FAILURE, "to the speed command with an unsupported speed" );
+
+  send_spi_cmd( $fh, SPI_CMD_SET_SPEED | SPI_SPEED, "to the speed command" );
+  send_spi_cmd( $fh, SPI_CMD_CONFIG_BUS | SPI_BUS_CONFIG, "to the bus configuration command" );
+  send_spi_cmd( $fh, SPI_CMD_CS_HIGH, "to the chip select high command" );
+
+  my $jedecId = write_then_read( $fh, pack( "C", FLASH_CMD_READ_JEDEC ), 3 );
+
+  if ( $jedecId ne FLASH_JEDEC_ID )
+  {
+    die sprintf( "Wrong JEDEC ID %s, expected %s.\n", unpack( "H*", $jedecId ), unpack( "H*", FLASH_JEDEC_ID ) );
+  }
+
+  write_stdout( "Found the simulated W25Q80 SPI flash.\n" );
+
+  # ---- Erase ----
+
+  write_enable( $fh );
+  write_then_read( $fh, pack( "C", FLASH_CMD_CHIP_ERASE ), 0 );
+  wait_while_busy( $fh );
+
+  verify_flash( $fh, "\xFF" x FLASH_SIZE, "after erasing the chip" );
+
+  write_stdout( "Erased the chip.\n" );
+
+  # ---- Program ----
+
+  my $image = generate_image();
+
+  for ( my $addr = 0; $addr < PROGRAMMED_BYTE_COUNT; $addr += FLASH_PAGE_SIZE )
+  {
+    write_enable( $fh );
+    write_then_read( $fh, flash_cmd_with_address( FLASH_CMD_PAGE_PROGRAM, $addr ) . substr( $image, $addr, FLASH_PAGE_SIZE ), 0 );
+    wait_while_busy( $fh );
+  }
+
+  write_stdout( sprintf( "Programmed %u KiB.\n", PROGRAMMED_BYTE_COUNT / 1024 ) );
+
+  # ---- Verify ----
+
+  verify_flash( $fh, $image, "after programming" );
+
+  write_stdout( "Verified the whole chip.\n" );
+
+  # ---- Erase a single sector ----
+
+  write_enable( $fh );
+  write_then_read( $fh, flash_cmd_with_address( FLASH_CMD_SECTOR_ERASE, ERASED_SECTOR_ADDR ), 0 );
+  wait_while_busy( $fh );
+
+  substr( $image, ERASED_SECTOR_ADDR, FLASH_SECTOR_SIZE ) = "\xFF" x FLASH_SECTOR_SIZE;
+
+  verify_flash( $fh, $image, "after erasing a sector" );
+
+  write_stdout( "Erased a single sector.\n" );
+
+  # ---- Leave the binary mode ----
+
+  write_all( $fh, pack( "C", SPI_CMD_EXIT ) );
+  expect_reply( $fh, "BBIO1", "when leaving the binary SPI mode" );
+
+  write_all( $fh, pack( "C", BIN_CMD_CONSOLE_MODE ) );
+
+  read_with_timeout( $fh, 1000000, 0.2 );
+
+  wait_for_console_prompt( $fh );
+
+  close( $fh ) or die "Cannot close the serial port: $!\n";
+
+  write_stdout( sprintf( "The SPI flash check passed in %.2f seconds.\n", time() - $startTime ) );
+}
+
+
+sub main ()
+{
+  if ( @ARGV != 1 )
+  {
+    write_stdout( "See the comments at the beginning of script $Bin/$Script for usage information.\n" );
+    return EXIT_CODE_FAILURE_ARGS;
+  }
+
+  run_check( $ARGV[0] );
+
+  return EXIT_CODE_SUCCESS;
+}
+
+
+# ------------ Script entry point ------------
+
+eval
+{
+  my $exitCode = main();
+  exit $exitCode;
+};
+
+my $errorMessage = $@;
+
+# We want the error message to be the last thing on the screen,
+# so we need to flush the standard output first.
+STDOUT->flush();
+
+print STDERR "\nError running \"$Bin/$Script\": $errorMessage";
+
+exit EXIT_CODE_FAILURE_ERROR;
@@ -0,0 +1,1352 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+// This tool measures the throughput and latency of the Bus Pirate OpenOCD mode, as implemented by the DebugDue firmware.
+//
+// It speaks the binary protocol directly, like OpenOCD's 'buspirate' driver does, but without OpenOCD's overhead:
+// it enters the binary mode and then the OpenOCD mode, and sends a stream of CMD_TAP_SHIFT commands
+// with random TDI data. It keeps a configurable number of commands in flight, in order to measure
+// the effect of pipelining, and measures the round-trip time of each command, from the moment
+// its first byte is written until its reply has been completely read. Measuring from the last byte
+// would be misleading, as the device may already be processing the command, or even have replied,
+// before the write() call that sends its last bytes returns.
+//
+// Any serial port works, like the Arduino Due's 'native' USB port (/dev/ttyACM0) or the pseudo-terminal
+// of the DebugDue host emulator.
+//
+// Every reply is checked against its command header and length. With option --verify-bypass,
+// the TDO data is verified too. The tool then puts all TAPs in the chain in BYPASS mode and leaves them
+// in the Shift-DR state, so that TDO must return the TDI data delayed by one bit per TAP.
+// The number of TAPs is detected automatically from the first reply.
+//
+// With option --tdo-digest, the tool sends CMD_TAP_SHIFT_DIGEST commands instead, which return no TDO data.
+// The firmware accumulates a CRC-32 of the TDO data, which the tool reads at the end and, with --verify-bypass,
+// checks against the expected value. This measures the throughput when the TDO data does not need to travel back.
+//
+// With option --tdi-pattern, the tool sends a single CMD_TAP_SHIFT_PATTERN command, so that the firmware
+// generates the TDI data itself. With --verify-bypass, the firmware checks the TDO data against the same pattern,
+// delayed by the number of TAPs. This measures the JTAG shifting speed without any USB transfer limits.
+//
+// With option --rle, the tool sends the commands as CMD_TAP_SHIFT_RLE, using the reference encoder below.
+// Option --sparse-tdi generates TDI data with the kind of redundancy that real JTAG traffic has.
+// Option --measure-trace does not talk to the device at all, it just reports how many bytes the encoder
+// would save on a raw capture of the host to DebugDue data stream in OpenOCD mode.
+//
+// Run the tool with --help for more information.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <termios.h>
+#include <getopt.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <stdexcept>
+
+
+// These values come from the DebugDue firmware, see BusPirateBinaryMode.h and BusPirateOpenOcdMode.cpp .
+
+static const uint8_t BIN_MODE_CHAR  = 0x00;
+static const uint8_t OOCD_MODE_CHAR = 0x06;
+static const uint8_t BIN_MODE_EXIT_TO_CONSOLE = 0x0F;
+
+static const uint8_t CMD_PORT_MODE = 0x01;
+static const uint8_t CMD_TAP_SHIFT = 0x05;
+static const uint8_t CMD_TAP_SHIFT_DIGEST = 0x10;
+static const uint8_t CMD_READ_DIGEST = 0x11;
+static const uint8_t CMD_TAP_SHIFT_PATTERN = 0x12;
+static const uint8_t CMD_TAP_SHIFT_RLE = 0x13;
+static const uint8_t CMD_UART_SPEED = 0x07;
+static const uint8_t CMD_FEATURE = 0x02;
+
+static const uint8_t PATTERN_FLAG_CHECK_TDO = 0x01;
+
+static const uint8_t MODE_JTAG = 0x01;
+
+static const size_t TAP_SHIFT_CMD_HEADER_LEN = 3;
+static const size_t RLE_CMD_HEADER_LEN = 5;
+static const size_t USB_RX_BUFFER_SIZE = 4096;
+
+// The firmware's Rx Buffer must hold a complete command, see MAX_JTAG_TAP_SHIFT_BIT_COUNT.
+static const unsigned MAX_BITS_PER_COMMAND = ( 4096 - TAP_SHIFT_CMD_HEADER_LEN ) / 2 * 8;
+
+// The Bus Pirate firmware, and therefore OpenOCD, use this limit.
+static const unsigned DEFAULT_BITS_PER_COMMAND = 0x2000;
+
+static const unsigned MAX_BYPASS_TAP_COUNT = 32;
+
+// Enough to fill the instruction registers of any reasonable JTAG chain with 1s, which selects BYPASS.
+static const unsigned BYPASS_IR_BIT_COUNT = 1024;
+
+
+static std::runtime_error CreateErrnoException ( const char * const prefix, const int errorCode )
+{
+  return std::runtime_error( std::string( prefix ) + ": " + strerror( errorCode ) );
+}
+
+
+static uint64_t GetMonotonicTimeUs ( void )
+{
+  timespec ts;
+
+  if ( 0 != clock_gettime( CLOCK_MONOTONIC, &ts ) )
+    throw CreateErrnoException( "clock_gettime() failed", errno );
+
+  return uint64_t( ts.tv_sec ) * 1000000 + uint64_t( ts.tv_nsec ) / 1000;
+}
+
+
+// ------ Serial port ------
+
+class CSerialPort
+{
+public:
+  explicit CSerialPort ( const char * const filename )
+  {
+    m_fd = open( filename, O_RDWR | O_NOCTTY | O_NONBLOCK );
+
+    if ( m_fd == -1 )
+      throw CreateErrnoException( ( std::string( "Cannot open \"" ) + filename + "\"" ).c_str(), errno );
+
+    // The baud rate makes no difference on USB virtual serial ports or pseudo-terminals,
+    // but raw mode is essential for a binary protocol.
+
+    termios settings;
+
+    if ( 0 != tcgetattr( m_fd, &settings ) )
+    {
+      const int errCode = errno;
+      close( m_fd );
+      throw CreateErrnoException( "Cannot get the serial port settings", errCode );
+    }
+
+    cfmakeraw( &settings );
+    cfsetspeed( &settings, B115200 );
+
+    if ( 0 != tcsetattr( m_fd, TCSANOW, &settings ) )
+    {
+      const int errCode = errno;
+      close( m_fd );
+      throw CreateErrnoException( "Cannot set the serial port settings", errCode );
+    }
+  }
+
+  ~CSerialPort ( void )
+  {
+    close( m_fd );
+  }
+
+  int GetFd ( void ) const { return m_fd; }
+
+  // Returns the number of bytes written, which may be 0.
+  size_t WriteSome ( const uint8_t * const data, const size_t len )
+  {
+    const ssize_t res = write( m_fd, data, len );
+
+    if ( res == -1 )
+    {
+      if ( errno == EAGAIN || errno == EINTR )
+        return 0;
+
+      throw CreateErrnoException( "Error writing to the serial port", errno );
+    }
+
+    return size_t( res );
+  }
+
+  // Returns the number of bytes read, which may be 0.
+  size_t ReadSome ( uint8_t * const data, const size_t len )
+  {
+    const ssize_t res = read( m_fd, data, len );
+
+    if ( res == -1 )
+    {
+      if ( errno == EAGAIN || errno == EINTR )
+        return 0;
+
+      throw CreateErrnoException( "Error reading from the serial port", errno );
+    }
+
+    return size_t( res );
+  }
+
+  void Wait ( const bool forWriting, const int timeoutMs )
+  {
+    pollfd pfd = { m_fd, short( POLLIN | ( forWriting ? POLLOUT : 0 ) ), 0 };
+
+    if ( -1 == poll( &pfd, 1, timeoutMs ) && errno != EINTR )
+      throw CreateErrnoException( "Error waiting for the serial port", errno );
+  }
+
+  void WriteAll ( const uint8_t * const data, const size_t len )
+  {
+    size_t writtenCount = 0;
+
+    while ( writtenCount < len )
+    {
+      const size_t res = WriteSome( data + writtenCount, len - writtenCount );
+
+      if ( res == 0 )
+        Wait( true, 100 );
+
+      writtenCount += res;
+    }
+  }
+
+  // Reads whatever arrives until the line has been quiet for the given time.
+  std::string ReadUntilQuiet ( const int quietTimeMs )
+  {
+    std::string data;
+
+    for ( ; ; )
+    {
+      pollfd pfd = { m_fd, POLLIN, 0 };
+
+      const int res = poll( &pfd, 1, quietTimeMs );
+
+      if ( res == -1 )
+      {
+        if ( errno == EINTR )
+          continue;
+
+        throw CreateErrnoException( "Error waiting for the serial port", errno );
+      }
+
+      if ( res == 0 )
+        return data;
+
+      uint8_t buffer[ 1024 ];
+      const size_t readCount = ReadSome( buffer, sizeof( buffer ) );
+      data.append( reinterpret_cast< const char * >( buffer ), readCount );
+    }
+  }
+
+  void ReadExactly ( uint8_t * const data, const size_t len, const int timeoutMs )
+  {
+    const uint64_t deadline = GetMonotonicTimeUs() + uint64_t( timeoutMs ) * 1000;
+
+    size_t readCount = 0;
+
+    while ( readCount < len )
+    {
+      if ( GetMonotonicTimeUs() >= deadline )
+        throw std::runtime_error( "Timeout waiting for data from the serial port." );
+
+      const size_t res = ReadSome( data + readCount, len - readCount );
+
+      if ( res == 0 )
+        Wait( false, 100 );
+
+      readCount += res;
+    }
+  }
+
+private:
+  int m_fd;
+};
+
+
+// ------ Protocol ------
+
+static void EnterOpenOcdMode ( CSerialPort & port )
+{
+  // Like OpenOCD, send 20 zeros, which switches from the console to the binary mode.
+  // If we were already in binary mode, we get several "BBIO1" replies.
+  // If we were in OpenOCD mode, the first zero switches to binary mode.
+
+  port.ReadUntilQuiet( 100 );  // Discard any stale data.
+
+  const std::vector< uint8_t > zeros( 20, BIN_MODE_CHAR );
+  port.WriteAll( zeros.data(), zeros.size() );
+
+  const std::string binModeReply = port.ReadUntilQuiet( 200 );
+
+  if ( binModeReply.find( "BBIO1" ) == std::string::npos )
+    throw std::runtime_error( "The device did not enter the binary mode." );
+
+  port.WriteAll( &OOCD_MODE_CHAR, 1 );
+
+  uint8_t oocdModeReply[ 4 ];
+  port.ReadExactly( oocdModeReply, sizeof( oocdModeReply ), 1000 );
+
+  if ( 0 != memcmp( oocdModeReply, "OCD1", sizeof( oocdModeReply ) ) )
+    throw std::runtime_error( "The device did not enter the OpenOCD mode." );
+
+  const uint8_t portModeCmd[] = { CMD_PORT_MODE, MODE_JTAG };
+  port.WriteAll( portModeCmd, sizeof( portModeCmd ) );
+}
+
+
+static void LeaveOpenOcdMode ( CSerialPort & port )
+{
+  const uint8_t cmd[] = { BIN_MODE_CHAR, BIN_MODE_EXIT_TO_CONSOLE };
+
+  port.WriteAll( cmd, sizeof( cmd ) );
+
+  // Discard the binary mode and console welcome messages.
+  port.ReadUntilQuiet( 200 );
+}
+
+
+struct TapShiftCommand
+{
+  std::vector< uint8_t > data;  // The complete command, ready to send.
+  std::vector< uint8_t > tdi;   // Just the TDI bits, LSB first.
+  unsigned bitCount;
+};
+
+
+static TapShiftCommand BuildTapShiftCommand ( const std::vector< bool > & tdiBits,
+                                              const std::vector< bool > & tmsBits )
+{
+  const unsigned bitCount = unsigned( tdiBits.size() );
+
+  TapShiftCommand cmd;
+  cmd.bitCount = bitCount;
+
+  const unsigned byteCount = ( bitCount + 7 ) / 8;
+
+  cmd.data.push_back( CMD_TAP_SHIFT );
+  cmd.data.push_back( uint8_t( bitCount >> 8 ) );
+  cmd.data.push_back( uint8_t( bitCount ) );
+
+  for ( unsigned i = 0; i < byteCount; ++i )
+  {
+    uint8_t tdi8 = 0;
+    uint8_t tms8 = 0;
+
+    for ( unsigned j = 0; j < 8 && i * 8 + j < bitCount; ++j )
+    {
+      tdi8 |= uint8_t( tdiBits[ i * 8 + j ] ? 1 << j : 0 );
+      tms8 |= uint8_t( tmsBits[ i * 8 + j ] ? 1 << j : 0 );
+    }
+
+    cmd.data.push_back( tdi8 );
+    cmd.data.push_back( tms8 );
+    cmd.tdi.push_back( tdi8 );
+  }
+
+  return cmd;
+}
+
+
+// ------ CMD_TAP_SHIFT_RLE reference encoder ------
+
+// See CMD_TAP_SHIFT_RLE in BusPirateOpenOcdMode.cpp for the format. This is a simple greedy encoder:
+// each token covers as many byte pairs as possible with the same TDI and TMS modes.
+
+static const unsigned RLE_MAX_PAIRS_PER_TOKEN = 32;
+
+enum RleTdiMode
+{
+  RLE_TDI_ZERO    = 0,
+  RLE_TDI_ONES    = 1,
+  RLE_TDI_REPEAT  = 2,
+  RLE_TDI_LITERAL = 3
+};
+
+static const uint8_t RLE_TMS_LITERAL = 0x20;
+
+
+// Counts how many bytes starting at 'pos' have the same value as data[ pos ].
+
+static size_t GetRunLength ( const uint8_t * const data, const size_t pos, const size_t count, const size_t stride )
+{
+  size_t len = 1;
+
+  while ( pos + len < count && data[ ( pos + len ) * stride ] == data[ pos * stride ] )
+    ++len;
+
+  return len;
+}
+
+
+// Returns whether a run at 'pos' is worth its own token, instead of being part of a literal block.
+
+static bool IsTdiRunWorthIt ( const uint8_t * const pairs, const size_t pos, const size_t count )
+{
+  const size_t runLen = GetRunLength( pairs, pos, count, 2 );
+  const uint8_t tdi8 = pairs[ pos * 2 ];
+
+  return runLen >= ( tdi8 == 0x00 || tdi8 == 0xFF ? 2 : 3 );
+}
+
+
+static bool IsTmsZeroRunWorthIt ( const uint8_t * const pairs, const size_t pos, const size_t count )
+{
+  return pairs[ pos * 2 + 1 ] == 0 && GetRunLength( pairs + 1, pos, count, 2 ) >= 2;
+}
+
+
+// 'pairs' has the interleaved TDI and TMS bytes, like CMD_TAP_SHIFT.
+
+static std::vector< uint8_t > EncodeRlePayload ( const uint8_t * const pairs, const size_t pairCount )
+{
+  std::vector< uint8_t > payload;
+
+  for ( size_t pos = 0; pos < pairCount; )
+  {
+    // Decide the TDI mode and its maximum length.
+
+    RleTdiMode tdiMode;
+    size_t tdiLen;
+
+    if ( IsTdiRunWorthIt( pairs, pos, pairCount ) )
+    {
+      const uint8_t tdi8 = pairs[ pos * 2 ];
+      tdiMode = tdi8 == 0x00 ? RLE_TDI_ZERO : tdi8 == 0xFF ? RLE_TDI_ONES : RLE_TDI_REPEAT;
+      tdiLen  = GetRunLength( pairs, pos, pairCount, 2 );
+    }
+    else
+    {
+      tdiMode = RLE_TDI_LITERAL;
+      tdiLen  = 1;
+
+      while ( pos + tdiLen < pairCount && !IsTdiRunWorthIt( pairs, pos + tdiLen, pairCount ) )
+        ++tdiLen;
+    }
+
+    // Decide the TMS mode and its maximum length.
+
+    const bool tmsIsLiteral = pairs[ pos * 2 + 1 ] != 0;
+    size_t tmsLen;
+
+    if ( tmsIsLiteral )
+    {
+      tmsLen = 1;
+
+      while ( pos + tmsLen < pairCount && !IsTmsZeroRunWorthIt( pairs, pos + tmsLen, pairCount ) )
+        ++tmsLen;
+    }
+    else
+    {
+      tmsLen = GetRunLength( pairs + 1, pos, pairCount, 2 );
+    }
+
+    const size_t len = std::min( { tdiLen, tmsLen, size_t( RLE_MAX_PAIRS_PER_TOKEN ) } );
+
+    payload.push_back( uint8_t( tdiMode << 6 | ( tmsIsLiteral ? RLE_TMS_LITERAL : 0 ) | ( len - 1 ) ) );
+
+    if ( tdiMode == RLE_TDI_REPEAT )
+      payload.push_back( pairs[ pos * 2 ] );
+
+    if ( tdiMode == RLE_TDI_LITERAL )
+    {
+      for ( size_t i = 0; i < len; ++i )
+        payload.push_back( pairs[ ( pos + i ) * 2 ] );
+    }
+
+    if ( tmsIsLiteral )
+    {
+      for ( size_t i = 0; i < len; ++i )
+        payload.push_back( pairs[ ( pos + i ) * 2 + 1 ] );
+    }
+
+    pos += len;
+  }
+
+  return payload;
+}
+
+
+// Converts a CMD_TAP_SHIFT command into CMD_TAP_SHIFT_RLE. Returns an empty vector
+// if the compressed command would not be smaller, or would not fit in the DebugDue's Rx Buffer.
+
+static std::vector< uint8_t > EncodeRleShiftCommand ( const std::vector< uint8_t > & tapShiftCmd )
+{
+  const size_t pairCount = ( tapShiftCmd.size() - TAP_SHIFT_CMD_HEADER_LEN ) / 2;
+
+  const std::vector< uint8_t > payload = EncodeRlePayload( tapShiftCmd.data() + TAP_SHIFT_CMD_HEADER_LEN, pairCount );
+
+  const size_t cmdLen = RLE_CMD_HEADER_LEN + payload.size();
+
+  if ( cmdLen >= tapShiftCmd.size() || cmdLen > USB_RX_BUFFER_SIZE )
+    return std::vector< uint8_t >();
+
+  std::vector< uint8_t > cmd;
+  cmd.reserve( cmdLen );
+  cmd.push_back( CMD_TAP_SHIFT_RLE );
+  cmd.push_back( tapShiftCmd[ 1 ] );
+  cmd.push_back( tapShiftCmd[ 2 ] );
+  cmd.push_back( uint8_t( payload.size() >> 8 ) );
+  cmd.push_back( uint8_t( payload.size() ) );
+  cmd.insert( cmd.end(), payload.begin(), payload.end() );
+
+  return cmd;
+}
+
+
+// Returns the TDO data.
+
+static std::vector< uint8_t > ShiftAndWait ( CSerialPort & port, const TapShiftCommand & cmd )
+{
+  port.WriteAll( cmd.data.data(), cmd.data.size() );
+
+  std::vector< uint8_t > reply( TAP_SHIFT_CMD_HEADER_LEN + cmd.tdi.size() );
+  port.ReadExactly( reply.data(), reply.size(), 2000 );
+
+  if ( 0 != memcmp( reply.data(), cmd.data.data(), TAP_SHIFT_CMD_HEADER_LEN ) )
+    throw std::runtime_error( "The CMD_TAP_SHIFT reply header does not match the command." );
+
+  return std::vector< uint8_t >( reply.begin() + TAP_SHIFT_CMD_HEADER_LEN, reply.end() );
+}
+
+
+// Resets the TAPs, loads BYPASS into all of them and leaves them in the Shift-DR state.
+
+static void EnterBypassShiftDr ( CSerialPort & port )
+{
+  std::vector< bool > tms;
+  std::vector< bool > tdi;
+
+  const auto addBits = [ &tms, &tdi ] ( const unsigned count, const bool tmsBit, const bool tdiBit )
+  {
+    tms.insert( tms.end(), count, tmsBit );
+    tdi.insert( tdi.end(), count, tdiBit );
+  };
+
+  addBits( 5, true, false );  // Test-Logic-Reset.
+  addBits( 1, false, false );  // Run-Test/Idle.
+  addBits( 2, true, false );  // Select-DR-Scan, Select-IR-Scan.
+  addBits( 2, false, false );  // Capture-IR, Shift-IR.
+  addBits( BYPASS_IR_BIT_COUNT - 1, false, true );
+  addBits( 1, true, true );  // Exit1-IR.
+  addBits( 2, true, false );  // Update-IR, Select-DR-Scan.
+  addBits( 2, false, false );  // Capture-DR, Shift-DR.
+
+  ShiftAndWait( port, BuildTapShiftCommand( tdi, tms ) );
+}
+
+
+static bool GetBit ( const uint8_t * const data, const size_t bitIndex )
+{
+  return 0 != ( data[ bitIndex / 8 ] & ( 1 << ( bitIndex % 8 ) ) );
+}
+
+
+// The firmware leaves the TDO bits of an incomplete last byte aligned to the MSB.
+
+static size_t GetTdoBitPosition ( const size_t bitIndex, const size_t bitCount )
+{
+  const size_t restBitCount = bitCount % 8;
+
+  if ( restBitCount != 0 && bitIndex / 8 == bitCount / 8 )
+    return bitIndex + 8 - restBitCount;
+
+  return bitIndex;
+}
+
+
+// This is the same CRC-32 as in the firmware's Crc32.cpp . Speed does not matter here.
+
+static uint32_t UpdateCrc32 ( const uint32_t crc, const uint8_t * const data, const size_t byteCount )
+{
+  uint32_t c = ~crc;
+
+  for ( size_t i = 0; i < byteCount; ++i )
+  {
+    c ^= data[ i ];
+
+    for ( unsigned j = 0; j < 8; ++j )
+      c = ( c & 1 ) ? ( ( c >> 1 ) ^ 0xEDB88320 ) : ( c >> 1 );
+  }
+
+  return ~c;
+}
+
+
+// In the Shift-DR state with all TAPs in BYPASS, TDO is TDI delayed by one bit per TAP.
+// The TDI history spans across commands, because the TAPs stay in Shift-DR.
+
+class CBypassVerifier
+{
+public:
+  bool IsTapCountKnown ( void ) const { return m_tapCount != 0; }
+  unsigned GetTapCount ( void ) const { return m_tapCount; }
+
+  void DetectTapCount ( const TapShiftCommand & cmd, const uint8_t * const tdo )
+  {
+    for ( unsigned tapCount = 1; tapCount <= MAX_BYPASS_TAP_COUNT; ++tapCount )
+    {
+      if ( Matches( cmd, tdo, tapCount ) )
+      {
+        m_tapCount = tapCount;
+        return;
+      }
+    }
+
+    throw std::runtime_error( "The TDO data does not look like a JTAG chain in BYPASS mode." );
+  }
+
+  void Verify ( const TapShiftCommand & cmd, const uint8_t * const tdo )
+  {
+    if ( !Matches( cmd, tdo, m_tapCount ) )
+      throw std::runtime_error( "TDO data mismatch." );
+
+    m_history = UpdateHistory( m_history, cmd );
+  }
+
+  // Returns the TDO data the firmware should capture for the given command.
+  std::vector< uint8_t > PredictTdo ( const TapShiftCommand & cmd )
+  {
+    std::vector< uint8_t > tdo( cmd.tdi.size(), 0 );
+
+    for ( unsigned i = 0; i < cmd.bitCount; ++i )
+    {
+      if ( 0 != ( ( m_history >> ( m_tapCount - 1 ) ) & 1 ) )
+      {
+        const size_t pos = GetTdoBitPosition( i, cmd.bitCount );
+        tdo[ pos / 8 ] |= uint8_t( 1 << ( pos % 8 ) );
+      }
+
+      m_history = ( m_history << 1 ) | ( GetBit( cmd.tdi.data(), i ) ? 1 : 0 );
+    }
+
+    return tdo;
+  }
+
+private:
+  // Bit 0 is the last TDI bit sent. The BYPASS registers hold 0 after Capture-DR.
+  uint64_t m_history = 0;
+  unsigned m_tapCount = 0;
+
+  static uint64_t UpdateHistory ( uint64_t history, const TapShiftCommand & cmd )
+  {
+    for ( unsigned i = 0; i < cmd.bitCount; ++i )
+      history = ( history << 1 ) | ( GetBit( cmd.tdi.data(), i ) ? 1 : 0 );
+
+    return history;
+  }
+
+  bool Matches ( const TapShiftCommand & cmd, const uint8_t * const tdo, const unsigned tapCount ) const
+  {
+    uint64_t history = m_history;
+
+    for ( unsigned i = 0; i < cmd.bitCount; ++i )
+    {
+      const bool expected = 0 != ( ( history >> ( tapCount - 1 ) ) & 1 );
+
+      if ( expected != GetBit( tdo, GetTdoBitPosition( i, cmd.bitCount ) ) )
+        return false;
+
+      history = ( history << 1 ) | ( GetBit( cmd.tdi.data(), i ) ? 1 : 0 );
+    }
+
+    return true;
+  }
+};
+
+
+// ------ Benchmark ------
+
+struct BenchmarkOptions
+{
+  const char * portFilename   = nullptr;
+  unsigned bitsPerCommand     = DEFAULT_BITS_PER_COMMAND;
+  unsigned pipelineDepth      = 1;
+  unsigned commandCount       = 1000;
+  unsigned timeoutMs          = 5000;
+  bool verifyBypass           = false;
+  bool tdoDigest              = false;
+  const char * tdiPattern     = nullptr;
+  unsigned patternBitCount    = 8 * 1024 * 1024;
+  bool rle                    = false;
+  bool sparseTdi              = false;
+  const char * traceFilename  = nullptr;
+};
+
+
+// A simple xorshift generator, so that the data is reproducible.
+
+static uint32_t GetNextRandomValue ( uint32_t * const randomState )
+{
+  uint32_t x = *randomState;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  *randomState = x;
+
+  return x;
+}
+
+
+static TapShiftCommand BuildRandomCommand ( const unsigned bitCount, uint32_t * const randomState,
+                                            const bool sparseTdi = false )
+{
+  std::vector< bool > tdi( bitCount );
+  const std::vector< bool > tms( bitCount, false );  // Stay in the current TAP state.
+
+  // The sparse data has runs of 0x00 and 0xFF bytes with some random bytes in between,
+  // like the TDI data for memory writes and flash programming often does.
+  unsigned byteKind = 0;
+
+  for ( unsigned i = 0; i < bitCount; ++i )
+  {
+    const uint32_t x = GetNextRandomValue( randomState );
+
+    if ( !sparseTdi )
+    {
+      tdi[ i ] = 0 != ( x & 1 );
+      continue;
+    }
+
+    if ( i % 8 == 0 && ( x >> 8 ) % 8 == 0 )
+      byteKind = ( x >> 16 ) % 3;
+
+    switch ( byteKind )
+    {
+    case 0:  tdi[ i ] = false; break;
+    case 1:  tdi[ i ] = true;  break;
+    default: tdi[ i ] = 0 != ( x & 1 ); break;
+    }
+  }
+
+  return BuildTapShiftCommand( tdi, tms );
+}
+
+
+static uint64_t GetPercentile ( const std::vector< uint64_t > & sortedValues, const unsigned percentile )
+{
+  const size_t index = ( sortedValues.size() - 1 ) * percentile / 100;
+  return sortedValues[ index ];
+}
+
+
+static void RunBenchmark ( CSerialPort & port, const BenchmarkOptions & options )
+{
+  CBypassVerifier bypassVerifier;
+
+  if ( options.verifyBypass )
+    EnterBypassShiftDr( port );
+
+  // The commands are generated beforehand, so that generating them does not distort the measurements.
+  uint32_t randomState = 0x12345678;
+  std::vector< TapShiftCommand > commands;
+  commands.reserve( options.commandCount );
+
+  size_t rawByteCount  = 0;
+  size_t sentByteCount = 0;
+
+  for ( unsigned i = 0; i < options.commandCount; ++i )
+  {
+    commands.push_back( BuildRandomCommand( options.bitsPerCommand, &randomState, options.sparseTdi ) );
+
+    TapShiftCommand & cmd = commands.back();
+    rawByteCount += cmd.data.size();
+
+    if ( options.rle )
+    {
+      std::vector< uint8_t > rleCmd = EncodeRleShiftCommand( cmd.data );
+
+      // The reply has the same header as the command, so the header check below still works.
+      if ( !rleCmd.empty() )
+        cmd.data.swap( rleCmd );
+    }
+
+    sentByteCount += cmd.data.size();
+  }
+
+  const size_t replyLen = TAP_SHIFT_CMD_HEADER_LEN + ( options.bitsPerCommand + 7 ) / 8;
+
+  std::vector< uint64_t > latenciesUs;
+  latenciesUs.reserve( options.commandCount );
+
+  std::deque< uint64_t > sendTimes;  // Of the commands in flight.
+
+  size_t nextCmdIndex     = 0;  // The next command to send.
+  size_t nextCmdSentBytes = 0;
+  size_t nextReplyIndex   = 0;  // The next reply to receive.
+
+  std::vector< uint8_t > reply( replyLen );
+  size_t replyReceivedBytes = 0;
+
+  const uint64_t startTime = GetMonotonicTimeUs();
+  uint64_t lastProgressTime = startTime;
+
+  while ( nextReplyIndex < commands.size() )
+  {
+    bool madeProgress = false;
+
+    // Send as much as the pipeline depth allows.
+
+    while ( nextCmdIndex < commands.size() &&
+            nextCmdIndex - nextReplyIndex < options.pipelineDepth )
+    {
+      const std::vector< uint8_t > & data = commands[ nextCmdIndex ].data;
+
+      // Take the time beforehand, because write() may not return until the device has already replied.
+      const uint64_t writeStartTime = GetMonotonicTimeUs();
+
+      const size_t writtenCount = port.WriteSome( data.data() + nextCmdSentBytes, data.size() - nextCmdSentBytes );
+
+      if ( writtenCount == 0 )
+        break;
+
+      if ( nextCmdSentBytes == 0 )
+        sendTimes.push_back( writeStartTime );
+
+      madeProgress = true;
+      nextCmdSentBytes += writtenCount;
+
+      if ( nextCmdSentBytes == data.size() )
+      {
+        ++nextCmdIndex;
+        nextCmdSentBytes = 0;
+      }
+    }
+
+    // Receive whatever has arrived.
+
+    for ( ; ; )
+    {
+      const size_t readCount = port.ReadSome( reply.data() + replyReceivedBytes, replyLen - replyReceivedBytes );
+
+      if ( readCount == 0 )
+        break;
+
+      madeProgress = true;
+      replyReceivedBytes += readCount;
+
+      if ( replyReceivedBytes < replyLen )
+        continue;
+
+      if ( nextReplyIndex >= nextCmdIndex )
+        throw std::runtime_error( "Received a reply before the command was completely sent." );
+
+      latenciesUs.push_back( GetMonotonicTimeUs() - sendTimes.front() );
+      sendTimes.pop_front();
+
+      const TapShiftCommand & cmd = commands[ nextReplyIndex ];
+
+      if ( 0 != memcmp( reply.data(), cmd.data.data(), TAP_SHIFT_CMD_HEADER_LEN ) )
+        throw std::runtime_error( "The CMD_TAP_SHIFT reply header does not match the command." );
+
+      if ( options.verifyBypass )
+      {
+        const uint8_t * const tdo = reply.data() + TAP_SHIFT_CMD_HEADER_LEN;
+
+        if ( !bypassVerifier.IsTapCountKnown() )
+          bypassVerifier.DetectTapCount( cmd, tdo );
+
+        bypassVerifier.Verify( cmd, tdo );
+      }
+
+      ++nextReplyIndex;
+      replyReceivedBytes = 0;
+
+      if ( nextReplyIndex == commands.size() )
+        break;
+    }
+
+    const uint64_t now = GetMonotonicTimeUs();
+
+    if ( madeProgress )
+    {
+      lastProgressTime = now;
+    }
+    else
+    {
+      if ( now - lastProgressTime > uint64_t( options.timeoutMs ) * 1000 )
+        throw std::runtime_error( "Timeout waiting for the device." );
+
+      const bool canSendMore = nextCmdIndex < commands.size() &&
+                               nextCmdIndex - nextReplyIndex < options.pipelineDepth;
+      port.Wait( canSendMore, 100 );
+    }
+  }
+
+  const uint64_t elapsedUs = GetMonotonicTimeUs() - startTime;
+
+
+  // ------ Report ------
+
+  std::sort( latenciesUs.begin(), latenciesUs.end() );
+
+  const double elapsedSec = double( elapsedUs ) / 1000000;
+  const uint64_t totalBits = uint64_t( options.bitsPerCommand ) * options.commandCount;
+
+  printf( "Commands: %u x %u bits, pipeline depth %u.\n",
+          options.commandCount, options.bitsPerCommand, options.pipelineDepth );
+
+  if ( options.verifyBypass )
+    printf( "TDO data verified against %u TAP(s) in BYPASS mode.\n", bypassVerifier.GetTapCount() );
+  else
+    printf( "TDO data not verified, only the reply headers and lengths.\n" );
+
+  if ( options.rle )
+  {
+    printf( "Command bytes sent: %zu instead of %zu with CMD_TAP_SHIFT (%.1f %%).\n",
+            sentByteCount, rawByteCount, double( sentByteCount ) * 100 / double( rawByteCount ) );
+  }
+
+  printf( "Elapsed time: %.3f s\n", elapsedSec );
+  printf( "Throughput: %.1f KiB/s of TDI data, %.1f commands/s\n",
+          double( totalBits ) / 8 / 1024 / elapsedSec,
+          double( options.commandCount ) / elapsedSec );
+  printf( "Round-trip latency in us: min %llu, p50 %llu, p90 %llu, p99 %llu, max %llu\n",
+          (unsigned long long) latenciesUs.front(),
+          (unsigned long long) GetPercentile( latenciesUs, 50 ),
+          (unsigned long long) GetPercentile( latenciesUs, 90 ),
+          (unsigned long long) GetPercentile( latenciesUs, 99 ),
+          (unsigned long long) latenciesUs.back() );
+}
+
+
+// Puts the JTAG chain in BYPASS mode and detects the number of TAPs with a normal shift.
+
+static void DetectBypassChain ( CSerialPort & port, CBypassVerifier * const bypassVerifier )
+{
+  EnterBypassShiftDr( port );
+
+  uint32_t detectionRandomState = 0x87654321;
+  const TapShiftCommand detectionCmd = BuildRandomCommand( 64, &detectionRandomState );
+  const std::vector< uint8_t > tdo = ShiftAndWait( port, detectionCmd );
+
+  bypassVerifier->DetectTapCount( detectionCmd, tdo.data() );
+  bypassVerifier->Verify( detectionCmd, tdo.data() );
+}
+
+
+static void RunDigestBenchmark ( CSerialPort & port, const BenchmarkOptions & options )
+{
+  CBypassVerifier bypassVerifier;
+
+  // The digest hides the TDO data, so the number of TAPs must be known beforehand.
+  if ( options.verifyBypass )
+    DetectBypassChain( port, &bypassVerifier );
+
+  uint32_t randomState = 0x12345678;
+  std::vector< uint8_t > stream;
+  uint32_t expectedCrc = 0;
+
+  for ( unsigned i = 0; i < options.commandCount; ++i )
+  {
+    TapShiftCommand cmd = BuildRandomCommand( options.bitsPerCommand, &randomState );
+    cmd.data[ 0 ] = CMD_TAP_SHIFT_DIGEST;
+
+    stream.insert( stream.end(), cmd.data.begin(), cmd.data.end() );
+
+    if ( options.verifyBypass )
+    {
+      const std::vector< uint8_t > tdo = bypassVerifier.PredictTdo( cmd );
+      expectedCrc = UpdateCrc32( expectedCrc, tdo.data(), tdo.size() );
+    }
+  }
+
+  stream.push_back( CMD_READ_DIGEST );
+
+  const uint64_t startTime = GetMonotonicTimeUs();
+
+  port.WriteAll( stream.data(), stream.size() );
+
+  uint8_t reply[ 1 + 4 + 4 ];
+  port.ReadExactly( reply, sizeof( reply ), int( options.timeoutMs ) );
+
+  const uint64_t elapsedUs = GetMonotonicTimeUs() - startTime;
+
+  const uint32_t crc       = uint32_t( reply[1] << 24 | reply[2] << 16 | reply[3] << 8 | reply[4] );
+  const uint32_t byteCount = uint32_t( reply[5] << 24 | reply[6] << 16 | reply[7] << 8 | reply[8] );
+
+  if ( reply[ 0 ] != CMD_READ_DIGEST )
+    throw std::runtime_error( "The CMD_READ_DIGEST reply has the wrong command code." );
+
+  if ( byteCount != uint64_t( ( options.bitsPerCommand + 7 ) / 8 ) * options.commandCount )
+    throw std::runtime_error( "The TDO digest covers the wrong number of bytes." );
+
+  if ( options.verifyBypass && crc != expectedCrc )
+    throw std::runtime_error( "TDO digest mismatch." );
+
+
+  // ------ Report ------
+
+  const double elapsedSec = double( elapsedUs ) / 1000000;
+  const uint64_t totalBits = uint64_t( options.bitsPerCommand ) * options.commandCount;
+
+  printf( "Commands: %u x %u bits, TDO digest only.\n", options.commandCount, options.bitsPerCommand );
+
+  if ( options.verifyBypass )
+    printf( "TDO digest 0x%08X verified against %u TAP(s) in BYPASS mode.\n", unsigned( crc ), bypassVerifier.GetTapCount() );
+  else
+    printf( "TDO digest 0x%08X not verified.\n", unsigned( crc ) );
+
+  printf( "Elapsed time: %.3f s\n", elapsedSec );
+  printf( "Throughput: %.1f KiB/s of TDI data, %.1f commands/s\n",
+          double( totalBits ) / 8 / 1024 / elapsedSec,
+          double( options.commandCount ) / elapsedSec );
+}
+
+
+static void RunPatternBenchmark ( CSerialPort & port, const BenchmarkOptions & options )
+{
+  // Generator code, pattern or seed, and pattern length. The seeds are arbitrary.
+  struct PatternInfo
+  {
+    const char * name;
+    uint8_t generator;
+    uint32_t patternOrSeed;
+    uint8_t patternLen;
+  };
+
+  static const PatternInfo PATTERNS[] =
+  {
+    { "const0" , 0, 0x00000000,  1 },
+    { "const1" , 0, 0x00000001,  1 },
+    { "alt"    , 1, 0x00000001,  2 },
+    { "prbs7"  , 2, 0x0000007F,  0 },
+    { "prbs15" , 3, 0x00007FFF,  0 },
+    { "prbs31" , 4, 0x7FFFFFFF,  0 },
+  };
+
+  const PatternInfo * pattern = nullptr;
+
+  for ( const PatternInfo & p : PATTERNS )
+  {
+    if ( 0 == strcmp( p.name, options.tdiPattern ) )
+      pattern = &p;
+  }
+
+  if ( pattern == nullptr )
+    throw std::runtime_error( std::string( "Unknown TDI pattern \"" ) + options.tdiPattern + "\"." );
+
+  CBypassVerifier bypassVerifier;
+
+  if ( options.verifyBypass )
+    DetectBypassChain( port, &bypassVerifier );
+
+  const uint32_t bitCount = options.patternBitCount;
+  const uint16_t tdoDelay = uint16_t( bypassVerifier.GetTapCount() );
+
+  const uint8_t cmd[] =
+  {
+    CMD_TAP_SHIFT_PATTERN,
+    pattern->generator,
+    options.verifyBypass ? PATTERN_FLAG_CHECK_TDO : uint8_t( 0 ),
+    uint8_t( bitCount >> 24 ), uint8_t( bitCount >> 16 ), uint8_t( bitCount >> 8 ), uint8_t( bitCount ),
+    uint8_t( pattern->patternOrSeed >> 24 ), uint8_t( pattern->patternOrSeed >> 16 ),
+    uint8_t( pattern->patternOrSeed >>  8 ), uint8_t( pattern->patternOrSeed ),
+    pattern->patternLen,
+    uint8_t( tdoDelay >> 8 ), uint8_t( tdoDelay ),
+  };
+
+  const uint64_t startTime = GetMonotonicTimeUs();
+
+  port.WriteAll( cmd, sizeof( cmd ) );
+
+  uint8_t reply[ 1 + 4 + 4 ];
+  port.ReadExactly( reply, sizeof( reply ), int( options.timeoutMs ) );
+
+  const uint64_t elapsedUs = GetMonotonicTimeUs() - startTime;
+
+  if ( reply[ 0 ] != CMD_TAP_SHIFT_PATTERN )
+    throw std::runtime_error( "The CMD_TAP_SHIFT_PATTERN reply has the wrong command code." );
+
+  const uint32_t errorCount    = uint32_t( reply[1] << 24 | reply[2] << 16 | reply[3] << 8 | reply[4] );
+  const uint32_t firstErrorBit = uint32_t( reply[5] << 24 | reply[6] << 16 | reply[7] << 8 | reply[8] );
+
+
+  // ------ Report ------
+
+  const double elapsedSec = double( elapsedUs ) / 1000000;
+
+  printf( "Pattern shift: %u bits of TDI pattern \"%s\" generated by the firmware.\n", unsigned( bitCount ), pattern->name );
+
+  if ( options.verifyBypass )
+  {
+    printf( "TDO data checked against %u TAP(s) in BYPASS mode: ", bypassVerifier.GetTapCount() );
+
+    if ( errorCount == 0 )
+      printf( "no errors.\n" );
+    else
+      printf( "%u bit error(s), the first one at bit %u.\n", unsigned( errorCount ), unsigned( firstErrorBit ) );
+  }
+  else
+  {
+    printf( "TDO data not checked.\n" );
+  }
+
+  printf( "Elapsed time: %.3f s\n", elapsedSec );
+  printf( "Throughput: %.1f KiB/s of TDI data\n", double( bitCount ) / 8 / 1024 / elapsedSec );
+
+  if ( errorCount != 0 )
+    throw std::runtime_error( "TDO pattern mismatch." );
+}
+
+
+// ------ Trace measurement ------
+
+// The trace file is a raw capture of the data stream that OpenOCD sends to the DebugDue in OpenOCD mode.
+// One way to capture it is to place "socat -r <file>" between OpenOCD and the DebugDue host emulator.
+
+static void MeasureTrace ( const BenchmarkOptions & options )
+{
+  FILE * const f = fopen( options.traceFilename, "rb" );
+
+  if ( f == nullptr )
+    throw CreateErrnoException( "Cannot open the trace file", errno );
+
+  std::vector< uint8_t > trace;
+
+  for ( ; ; )
+  {
+    uint8_t buffer[ 64 * 1024 ];
+    const size_t readCount = fread( buffer, 1, sizeof( buffer ), f );
+    trace.insert( trace.end(), buffer, buffer + readCount );
+
+    if ( readCount < sizeof( buffer ) )
+      break;
+  }
+
+  const bool readError = ferror( f ) != 0;
+  fclose( f );
+
+  if ( readError )
+    throw std::runtime_error( "Error reading the trace file." );
+
+  size_t shiftCmdCount   = 0;
+  size_t rleCmdCount     = 0;
+  size_t shiftByteCount  = 0;  // The CMD_TAP_SHIFT commands only.
+  size_t rleByteCount    = 0;  // The same commands with the encoder.
+  size_t otherByteCount  = 0;
+
+  for ( size_t pos = 0; pos < trace.size(); )
+  {
+    const uint8_t cmdCode = trace[ pos ];
+    size_t cmdLen;
+
+    switch ( cmdCode )
+    {
+    case BIN_MODE_CHAR:
+    case OOCD_MODE_CHAR:
+    case BIN_MODE_EXIT_TO_CONSOLE:  cmdLen = 1; break;
+    case CMD_PORT_MODE:             cmdLen = 2; break;
+    case CMD_FEATURE:               cmdLen = 3; break;
+    case CMD_UART_SPEED:            cmdLen = 4; break;
+
+    case CMD_TAP_SHIFT:
+      {
+        if ( pos + TAP_SHIFT_CMD_HEADER_LEN > trace.size() )
+          throw std::runtime_error( "The trace file ends in the middle of a CMD_TAP_SHIFT command." );
+
+        const unsigned bitCount = unsigned( trace[ pos + 1 ] << 8 | trace[ pos + 2 ] );
+        cmdLen = TAP_SHIFT_CMD_HEADER_LEN + ( bitCount + 7 ) / 8 * 2;
+        break;
+      }
+
+    default:
+      throw std::runtime_error( "Unknown command code " + std::to_string( cmdCode ) +
+                                " at trace file offset " + std::to_string( pos ) + "." );
+    }
+
+    if ( pos + cmdLen > trace.size() )
+      throw std::runtime_error( "The trace file ends in the middle of a command." );
+
+    if ( cmdCode == CMD_TAP_SHIFT )
+    {
+      const std::vector< uint8_t > cmd( trace.begin() + ptrdiff_t( pos ), trace.begin() + ptrdiff_t( pos + cmdLen ) );
+      const std::vector< uint8_t > rleCmd = EncodeRleShiftCommand( cmd );
+
+      ++shiftCmdCount;
+      shiftByteCount += cmdLen;
+
+      if ( rleCmd.empty() )
+      {
+        rleByteCount += cmdLen;
+      }
+      else
+      {
+        ++rleCmdCount;
+        rleByteCount += rleCmd.size();
+      }
+    }
+    else
+    {
+      otherByteCount += cmdLen;
+    }
+
+    pos += cmdLen;
+  }
+
+  printf( "Trace size: %zu bytes, of which %zu bytes in %zu CMD_TAP_SHIFT command(s).\n",
+          trace.size(), shiftByteCount, shiftCmdCount );
+  printf( "With CMD_TAP_SHIFT_RLE: %zu bytes for the same commands, %zu of which were compressed.\n",
+          rleByteCount, rleCmdCount );
+
+  if ( !trace.empty() )
+  {
+    printf( "Total USB bytes from the host: %zu instead of %zu (%.1f %%).\n",
+            otherByteCount + rleByteCount, trace.size(),
+            double( otherByteCount + rleByteCount ) * 100 / double( trace.size() ) );
+  }
+}
+
+
+// ------ Command line ------
+
+static void PrintHelp ( void )
+{
+  printf( "Usage: ProtocolBenchmark [options] <serial port>\n"
+          "\n"
+          "Options:\n"
+          "  --bits-per-command=<n>  TDI bits per CMD_TAP_SHIFT command, 1-%u. The default is %u.\n"
+          "  --pipeline-depth=<n>    Maximum number of commands in flight. The default is 1.\n"
+          "  --command-count=<n>     Number of commands to send. The default is 1000.\n"
+          "  --timeout-ms=<n>        Maximum time without any progress. The default is 5000.\n"
+          "  --verify-bypass         Put the JTAG chain in BYPASS mode and verify the TDO data.\n"
+          "  --tdo-digest            Only read back a CRC-32 of the TDO data at the end.\n"
+          "                          The pipeline depth and the latency do not apply then.\n"
+          "  --tdi-pattern=<name>    Let the firmware generate the TDI data for a single long shift.\n"
+          "                          The patterns are const0, const1, alt, prbs7, prbs15 and prbs31.\n"
+          "  --pattern-bits=<n>      Number of bits for --tdi-pattern. The default is 8 Mbit.\n"
+          "  --rle                   Send the commands as CMD_TAP_SHIFT_RLE whenever they are smaller.\n"
+          "  --sparse-tdi            Generate TDI data with runs of 0x00 and 0xFF bytes.\n"
+          "  --measure-trace=<file>  Report the CMD_TAP_SHIFT_RLE savings on a raw capture of\n"
+          "                          the OpenOCD to DebugDue data stream. No serial port is needed then.\n"
+          "  --help                  Print this help text.\n"
+          "\n"
+          "Note that the firmware only processes a command once it is complete in its 4 KiB Rx Buffer,\n"
+          "so large commands with a deep pipeline do not gain much.\n",
+          MAX_BITS_PER_COMMAND,
+          DEFAULT_BITS_PER_COMMAND );
+}
+
+
+static unsigned ParseUnsigned ( const char * const optionName, const char * const str,
+                                const unsigned minValue, const unsigned maxValue )
+{
+  char * end;
+  errno = 0;
+  const unsigned long val = strtoul( str, &end, 0 );
+
+  if ( errno != 0 || end == str || *end != '\0' || *str == '-' || val < minValue || val > maxValue )
+  {
+    throw std::runtime_error( std::string( "Invalid value \"" ) + str + "\" for option --" + optionName +
+                              ", the valid range is " + std::to_string( minValue ) + "-" + std::to_string( maxValue ) + "." );
+  }
+
+  return unsigned( val );
+}
+
+
+int main ( const int argc, char ** const argv )
+{
+  enum
+  {
+    OPT_BITS_PER_COMMAND = 1,
+    OPT_PIPELINE_DEPTH,
+    OPT_COMMAND_COUNT,
+    OPT_TIMEOUT_MS,
+    OPT_VERIFY_BYPASS,
+    OPT_TDO_DIGEST,
+    OPT_TDI_PATTERN,
+    OPT_PATTERN_BITS,
+    OPT_RLE,
+    OPT_SPARSE_TDI,
+    OPT_MEASURE_TRACE,
+    OPT_HELP
+  };
+
+  static const option LONG_OPTIONS[] =
+  {
+    { "bits-per-command", required_argument, nullptr, OPT_BITS_PER_COMMAND },
+    { "pipeline-depth"  , required_argument, nullptr, OPT_PIPELINE_DEPTH   },
+    { "command-count"   , required_argument, nullptr, OPT_COMMAND_COUNT    },
+    { "timeout-ms"      , required_argument, nullptr, OPT_TIMEOUT_MS       },
+    { "verify-bypass"   , no_argument      , nullptr, OPT_VERIFY_BYPASS    },
+    { "tdo-digest"      , no_argument      , nullptr, OPT_TDO_DIGEST       },
+    { "tdi-pattern"     , required_argument, nullptr, OPT_TDI_PATTERN      },
+    { "pattern-bits"    , required_argument, nullptr, OPT_PATTERN_BITS     },
+    { "rle"             , no_argument      , nullptr, OPT_RLE              },
+    { "sparse-tdi"      , no_argument      , nullptr, OPT_SPARSE_TDI       },
+    { "measure-trace"   , required_argument, nullptr, OPT_MEASURE_TRACE    },
+    { "help"            , no_argument      , nullptr, OPT_HELP             },
+    { nullptr, 0, nullptr, 0 }
+  };
+
+  try
+  {
+    BenchmarkOptions options;
+
+    for ( ; ; )
+    {
+      const int opt = getopt_long( argc, argv, "", LONG_OPTIONS, nullptr );
+
+      if ( opt == -1 )
+        break;
+
+      switch ( opt )
+      {
+      case OPT_BITS_PER_COMMAND: options.bitsPerCommand = ParseUnsigned( "bits-per-command", optarg, 1, MAX_BITS_PER_COMMAND ); break;
+      case OPT_PIPELINE_DEPTH:   options.pipelineDepth  = ParseUnsigned( "pipeline-depth"  , optarg, 1, 1000 ); break;
+      case OPT_COMMAND_COUNT:    options.commandCount   = ParseUnsigned( "command-count"   , optarg, 1, 10000000 ); break;
+      case OPT_TIMEOUT_MS:       options.timeoutMs      = ParseUnsigned( "timeout-ms"      , optarg, 1, 3600000 ); break;
+      case OPT_VERIFY_BYPASS:    options.verifyBypass   = true; break;
+      case OPT_TDO_DIGEST:       options.tdoDigest      = true; break;
+      case OPT_TDI_PATTERN:      options.tdiPattern     = optarg; break;
+      case OPT_PATTERN_BITS:     options.patternBitCount = ParseUnsigned( "pattern-bits", optarg, 1, 0xFFFFFFFF ); break;
+      case OPT_RLE:              options.rle            = true; break;
+      case OPT_SPARSE_TDI:       options.sparseTdi      = true; break;
+      case OPT_MEASURE_TRACE:    options.traceFilename  = optarg; break;
+
+      case OPT_HELP:
+        PrintHelp();
+        return EXIT_SUCCESS;
+
+      default:
+        // getopt_long() has already printed an error message.
+        return EXIT_FAILURE;
+      }
+    }
+
+    if ( options.traceFilename != nullptr )
+    {
+      if ( optind != argc )
+        throw std::runtime_error( "Option --measure-trace does not take a serial port argument." );
+
+      MeasureTrace( options );
+      return EXIT_SUCCESS;
+    }
+
+    if ( optind + 1 != argc )
+      throw std::runtime_error( "Invalid number of command-line arguments, run this tool with --help for more information." );
+
+    options.portFilename = argv[ optind ];
+
+    CSerialPort port( options.portFilename );
+
+    EnterOpenOcdMode( port );
+    if ( options.tdiPattern != nullptr )
+      RunPatternBenchmark( port, options );
+    else if ( options.tdoDigest )
+      RunDigestBenchmark( port, options );
+    else
+      RunBenchmark( port, options );
+    LeaveOpenOcdMode( port );
+
+    return EXIT_SUCCESS;
+  }
+  catch ( const std::exception & e )
+  {
+    fprintf( stderr, "Error: %s\n", e.what() );
+    return EXIT_FAILURE;
+  }
+}
@@ -66,12 +66,78 @@ void RunUserCode ( void ) throw()
 }
 
 
+// The data segments are several KiB long, and copying and clearing them is a noticeable part
+// of the boot time. The LDM and STM instructions below move 4 words each, which means fewer
+// instruction fetches from Flash and fewer loop iterations than a word-by-word loop.
+// The linker script aligns all segment boundaries to 4 bytes, and the remaining
+// words after the last burst are handled one at a time.
+
+static const uint32_t * CopyWords ( uint32_t * dest,
+                                    const uint32_t * src,
+                                    const uint32_t * const destEnd ) throw()
+{
+  uint32_t burstCount = uint32_t( destEnd - dest ) / 4;
+
+  if ( burstCount != 0 )
+  {
+    asm volatile( "1:\n"
+                  "  ldmia %[src]!, {r3-r6}\n"
+                  "  stmia %[dest]!, {r3-r6}\n"
+                  "  subs %[count], %[count], #1\n"
+                  "  bne 1b\n"
+                  : [src] "+r" (src), [dest] "+r" (dest), [count] "+r" (burstCount)
+                  :
+                  : "r3", "r4", "r5", "r6", "cc", "memory" );
+  }
+
+  while ( dest < destEnd )
+  {
+    *dest++ = *src++;
+  }
+
+  return src;
+}
+
+
+static void ZeroWords ( uint32_t * dest, const uint32_t * const destEnd ) throw()
+{
+  uint32_t burstCount = uint32_t( destEnd - dest ) / 4;
+
+  if ( burstCount != 0 )
+  {
+    asm volatile( "  movs r3, #0\n"
+                  "  movs r4, #0\n"
+                  "  movs r5, #0\n"
+                  "  movs r6, #0\n"
+                  "1:\n"
+                  "  stmia %[dest]!, {r3-r6}\n"
+                  "  subs %[count], %[count], #1\n"
+                  "  bne 1b\n"
+                  : [dest] "+r" (dest), [count] "+r" (burstCount)
+                  :
+                  : "r3", "r4", "r5", "r6", "cc", "memory" );
+  }
+
+  while ( dest < destEnd )
+  {
+    *dest++ = 0;
+  }
+}
+
+
 void InitDataSegments ( void ) throw()
 {
-  // Relocate the initialised data from flash to SRAM.
+  // Copy the routines that should run from SRAM, and then relocate the initialised data
+  // from flash to SRAM. The linker script places both load images one after the other
+  // starting at __etext, so a single source pointer suffices.
+
+  const uint32_t * relocSrc = (const uint32_t *)&__etext;
 
-  const uint32_t * relocSrc  = (const uint32_t *)&__etext;
-        uint32_t * relocDest = (      uint32_t *)&__data_start__;
+  relocSrc = CopyWords( (uint32_t *)&__ramfunc_start__,
+                        relocSrc,
+                        (const uint32_t *) &__ramfunc_end__ );
+
+  uint32_t * const relocDest = (uint32_t *)&__data_start__;
 
   if ( relocSrc == relocDest )
   {
@@ -80,22 +146,13 @@ void InitDataSegments ( void ) throw()
   }
   else
   {
-    const uint32_t * const relocDestEnd = (const uint32_t *) &__data_end__;
-
-    while ( relocDest < relocDestEnd )
-    {
-      *relocDest++ = *relocSrc++;
-    }
+    CopyWords( relocDest, relocSrc, (const uint32_t *) &__data_end__ );
   }
 
-  // Clear the zero segment (BSS).
+  // Clear the zero segment (BSS). The .noinit segment that follows it is left alone,
+  // see NOINIT_DATA in NoInitData.h .
 
-  const uint32_t * const zeroSegEnd = (const uint32_t *) &__bss_end__;
-
-  for ( uint32_t * zeroSegPtr = (uint32_t *)&__bss_start__;  zeroSegPtr < zeroSegEnd;  ++zeroSegPtr )
-  {
-    *zeroSegPtr = 0;
-  }
+  ZeroWords( (uint32_t *)&__bss_start__, (const uint32_t *) &__bss_end__ );
 }
 
 
@@ -188,16 +245,22 @@ void TerminateLibc ( void ) throw()
 void PrintFirmwareSegmentSizesSync ( void ) throw()
 {
   const unsigned codeSize     = uintptr_t( &__etext      ) - uintptr_t( &_sfixed        );
+  const unsigned ramfuncSize  = uintptr_t( &__ramfunc_end__ ) - uintptr_t( &__ramfunc_start__ );
   const unsigned initDataSize = uintptr_t( &__data_end__ ) - uintptr_t( &__data_start__ );
   const unsigned bssDataSize  = uintptr_t( &__bss_end__  ) - uintptr_t( &__bss_start__  );
+  const unsigned noInitSize   = uintptr_t( &__noinit_end__ ) - uintptr_t( &__noinit_start__ );
   const unsigned heapSize     = uintptr_t( &__HeapLimit  ) - uintptr_t( &__end__        );
 
   SerialSyncWriteStr( "Code size: 0x" );
   SerialSyncWriteUint32Hex( codeSize );
+  SerialSyncWriteStr( ", code in SRAM size: 0x" );
+  SerialSyncWriteUint32Hex( ramfuncSize );
   SerialSyncWriteStr( ", initialised data size: 0x" );
   SerialSyncWriteUint32Hex( initDataSize );
   SerialSyncWriteStr( ", BSS size: 0x" );
   SerialSyncWriteUint32Hex( bssDataSize );
+  SerialSyncWriteStr( ", no-init data size: 0x" );
+  SerialSyncWriteUint32Hex( noInitSize );
   SerialSyncWriteStr( ", malloc heap size: 0x" );
   SerialSyncWriteUint32Hex( heapSize );
   SerialSyncWriteStr( "." EOL );
@@ -209,14 +272,18 @@ void PrintFirmwareSegmentSizesSync ( void ) throw()
 void PrintFirmwareSegmentSizesAsync ( void ) throw()
 {
   const unsigned codeSize     = uintptr_t( &__etext      ) - uintptr_t( &_sfixed        );
+  const unsigned ramfuncSize  = uintptr_t( &__ramfunc_end__ ) - uintptr_t( &__ramfunc_start__ );
   const unsigned initDataSize = uintptr_t( &__data_end__ ) - uintptr_t( &__data_start__ );
   const unsigned bssDataSize  = uintptr_t( &__bss_end__  ) - uintptr_t( &__bss_start__  );
+  const unsigned noInitSize   = uintptr_t( &__noinit_end__ ) - uintptr_t( &__noinit_start__ );
   const unsigned heapSize     = uintptr_t( &__HeapLimit  ) - uintptr_t( &__end__        );
 
-  SerialPrintf( "Code size: %u, initialised data size: %u, BSS size: %u, malloc heap size: %u." EOL,
+  SerialPrintf( "Code size: %u, code in SRAM size: %u, initialised data size: %u, BSS size: %u, no-init data size: %u, malloc heap size: %u." EOL,
                 codeSize,
+                ramfuncSize,
                 initDataSize,
                 bssDataSize,
+                noInitSize,
                 heapSize );
 }
 
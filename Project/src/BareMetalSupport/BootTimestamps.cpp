@@ -0,0 +1,80 @@
+
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#include "BootTimestamps.h"  // The include file for this module should come first.
+
+#include <assert.h>
+
+#include "CycleCounter.h"
+#include "NoInitData.h"
+
+
+// These variables must not be in .bss , see StartBootTimestamps().
+
+static uint32_t s_bootTimestamps[ bpCount ] NOINIT_DATA;
+static bool     s_isBootTimestampRecorded[ bpCount ] NOINIT_DATA;
+
+
+// This routine runs before the data segments have been initialised,
+// so it cannot rely on any global variables, and it is too early for asserts.
+
+void StartBootTimestamps ( void ) throw()
+{
+  EnableCycleCounter();
+
+  for ( unsigned i = 0; i < bpCount; ++i )
+    s_isBootTimestampRecorded[ i ] = false;
+}
+
+
+void RecordBootTimestamp ( const BootPhaseEnum phase ) throw()
+{
+  // This routine may be called before the data segments have been initialised, so no asserts here.
+
+  if ( s_isBootTimestampRecorded[ phase ] )
+    return;
+
+  s_bootTimestamps[ phase ] = GetCycleCount();
+  s_isBootTimestampRecorded[ phase ] = true;
+}
+
+
+bool GetBootTimestamp ( const BootPhaseEnum phase, uint32_t * const cycleCount ) throw()
+{
+  assert( phase < bpCount );
+
+  if ( !s_isBootTimestampRecorded[ phase ] )
+    return false;
+
+  *cycleCount = s_bootTimestamps[ phase ];
+  return true;
+}
+
+
+const char * GetBootPhaseName ( const BootPhaseEnum phase ) throw()
+{
+  switch ( phase )
+  {
+  case bpClockReady:        return "Clock ready";
+  case bpDataSegmentsReady: return "Data segments ready";
+  case bpUserCodeStart:     return "User code start";
+  case bpMainLoop:          return "Main loop";
+  case bpUsbReady:          return "USB ready";
+
+  default:
+    assert( false );
+    return "<unknown>";
+  }
+}
@@ -0,0 +1,52 @@
+
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+#include <stdint.h>
+
+
+// Records the CPU cycle counter at a few milestones during boot, so that the time to USB-ready
+// can be measured without a logic analyser. Command "BootTimestamps" prints them.
+//
+// StartBootTimestamps() must be called first thing in the reset handler. It starts the cycle counter
+// from zero, so that all timestamps are relative to reset. The storage lives in .noinit ,
+// because the timestamps are recorded before InitDataSegments() clears .bss .
+//
+// The cycle counter wraps around after about 51 seconds at 84 MHz, see CycleCounter.h ,
+// so callers should not record a phase that may happen later than BOOT_TIMESTAMP_MAX_UPTIME_MS.
+
+#define BOOT_TIMESTAMP_MAX_UPTIME_MS  50000
+
+enum BootPhaseEnum
+{
+  bpClockReady,         // SetupCpuClock() has finished.
+  bpDataSegmentsReady,  // InitDataSegments() has finished.
+  bpUserCodeStart,      // The C runtime has been initialised.
+  bpMainLoop,           // The firmware is entering its main loop.
+  bpUsbReady,           // The host has enabled the CDC interface for the console.
+
+  bpCount
+};
+
+void StartBootTimestamps ( void ) throw();
+
+// Only the first call for each phase is recorded.
+void RecordBootTimestamp ( BootPhaseEnum phase ) throw();
+
+// Returns false if the phase has not been recorded yet.
+bool GetBootTimestamp ( BootPhaseEnum phase, uint32_t * cycleCount ) throw();
+
+const char * GetBootPhaseName ( BootPhaseEnum phase ) throw();
@@ -92,6 +92,12 @@ class CCircularBuffer  // Also called Cyclic or Ring Buffer in the literature.
     return &m_buffer[ m_readPos ];
   }
 
+  const ElemType * PeekElementAt ( const SizeType offset ) const throw()
+  {
+    assert( offset < GetElemCount() );
+    return &m_buffer[ ( m_readPos + offset ) % MAX_ELEM_COUNT ];
+  }
+
 
   // This routine is convenient but slow, as it copies the elements
   // to another memory location. If speed is important, use
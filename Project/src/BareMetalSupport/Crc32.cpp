@@ -0,0 +1,60 @@
+
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "Crc32.h"  // The include file for this module should come first.
+
+
+// The lookup table is generated at compile time and lands in flash memory.
+// It takes 1 KiB, but it is much faster than calculating the CRC bit by bit.
+
+struct Crc32Table
+{
+  uint32_t entries[ 256 ];
+};
+
+static constexpr Crc32Table GenerateCrc32Table ( void )
+{
+  Crc32Table table = {};
+
+  for ( uint32_t i = 0; i < 256; ++i )
+  {
+    uint32_t crc = i;
+
+    for ( unsigned j = 0; j < 8; ++j )
+      crc = ( crc & 1 ) ? ( ( crc >> 1 ) ^ 0xEDB88320 ) : ( crc >> 1 );
+
+    table.entries[ i ] = crc;
+  }
+
+  return table;
+}
+
+static constexpr Crc32Table CRC32_TABLE = GenerateCrc32Table();
+
+static_assert( CRC32_TABLE.entries[ 1 ] == 0x77073096, "The CRC-32 table is wrong." );
+
+
+uint32_t UpdateCrc32 ( const uint32_t crc, const uint8_t * const data, const size_t byteCount ) throw()
+{
+  uint32_t c = ~crc;
+
+  for ( size_t i = 0; i < byteCount; ++i )
+  {
+    c = CRC32_TABLE.entries[ ( c ^ data[ i ] ) & 0xFF ] ^ ( c >> 8 );
+  }
+
+  return ~c;
+}
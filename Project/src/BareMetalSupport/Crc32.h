@@ -0,0 +1,30 @@
+
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+// This is the standard CRC-32 used by Ethernet, zlib, PNG and so on (reflected polynomial 0xEDB88320).
+// The results match zlib's crc32() and Python's zlib.crc32(), so that host tools can easily check them.
+//
+// You can calculate a CRC in several steps. Start with CRC32_INITIAL_VALUE,
+// and pass the previous result as 'crc' to each subsequent call.
+
+#define CRC32_INITIAL_VALUE  0
+
+uint32_t UpdateCrc32 ( uint32_t crc, const uint8_t * data, size_t byteCount ) throw();
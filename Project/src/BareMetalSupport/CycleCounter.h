@@ -0,0 +1,80 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+// The Cortex-M3 "Data Watchpoint and Trace" unit (DWT) has a free-running 32-bit counter
+// that increments on every CPU clock cycle. Unlike the SysTick routines, it can measure
+// intervals longer than SYSTEM_TICK_PERIOD_MS without having to deal with the reload value.
+// At 84 MHz, the counter wraps around after about 51 seconds, and unsigned
+// arithmetic copes with a single wrap-around.
+//
+// Note that a JTAG debugger may also use the DWT unit. OpenOCD normally leaves
+// the cycle counter alone, but it may reset flag TRCENA when it disconnects.
+// The counter then stops, so the firmware must turn it back on regularly,
+// see ResumeCycleCounterIfStopped().
+
+#include <stdint.h>
+#include <assert.h>
+
+#include <sam3xa.h>
+
+
+inline void EnableCycleCounter ( void ) throw()
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+
+inline bool IsCycleCounterEnabled ( void ) throw()
+{
+  return 0 != ( CoreDebug->DEMCR & CoreDebug_DEMCR_TRCENA_Msk ) &&
+         0 != ( DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk );
+}
+
+
+// Unlike EnableCycleCounter(), this routine does not reset the counter, so that any time references
+// taken beforehand remain valid. The time during which the counter was stopped is lost though.
+
+inline void ResumeCycleCounterIfStopped ( void ) throw()
+{
+  if ( !IsCycleCounterEnabled() )
+  {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  }
+}
+
+
+inline uint32_t GetCycleCount ( void ) throw()
+{
+  return DWT->CYCCNT;
+}
+
+
+inline uint32_t GetElapsedCycleCount ( const uint32_t referenceTimeInThePast ) throw()
+{
+  return GetCycleCount() - referenceTimeInThePast;
+}
+
+
+inline uint32_t CycleCountToUs ( const uint32_t cycleCount ) throw()
+{
+  // Otherwise you should adjust the logic below for better accuracy.
+  assert( 0 == ( CPU_CLOCK % 1000000 ) );
+
+  return cycleCount / ( CPU_CLOCK / 1000000 );
+}
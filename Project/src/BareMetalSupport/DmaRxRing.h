@@ -0,0 +1,108 @@
+
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+
+
+// Reception ring buffer filled by a DMA engine that never stops.
+//
+// Unlike CCircularBuffer, the writer does not look at the reader: the DMA engine keeps writing
+// round and round, and the reader only learns how far it has got. The reader passes in the total
+// number of bytes the DMA engine has written so far (modulo 2^32), and this class works out
+// what is available to read. If the DMA engine has overtaken the reader, the oldest data is lost,
+// and this class skips ahead and counts the lost bytes.
+//
+// Because the DMA engine may be overwriting the oldest data while the reader is reading it,
+// the reader should drain the buffer long before it becomes full.
+//
+// There is nothing hardware-specific here, so this class can be tested on the host.
+
+template< uint32_t BUFFER_SIZE >
+class CDmaRxRing
+{
+  static_assert( BUFFER_SIZE != 0 && 0 == ( BUFFER_SIZE & ( BUFFER_SIZE - 1 ) ),
+                 "The byte counters wrap around at 2^32, so the buffer size must be a power of 2." );
+
+  uint8_t  m_buffer[ BUFFER_SIZE ];
+  uint32_t m_readCount;  // Total number of bytes consumed, modulo 2^32.
+  uint32_t m_lostCount;
+
+ public:
+  static const uint32_t SIZE = BUFFER_SIZE;
+
+  CDmaRxRing ( void )
+  {
+    Reset( 0 );
+  }
+
+  // Discards all data the DMA engine has written so far.
+
+  void Reset ( const uint32_t dmaWriteCount ) throw()
+  {
+    m_readCount = dmaWriteCount;
+    m_lostCount = 0;
+  }
+
+  uint8_t * GetBuffer ( void ) throw() { return m_buffer; }
+
+  uint32_t GetLostCount ( void ) const throw() { return m_lostCount; }
+
+  uint32_t GetElemCount ( const uint32_t dmaWriteCount ) throw()
+  {
+    SkipOverwrittenData( dmaWriteCount );
+    return dmaWriteCount - m_readCount;
+  }
+
+
+  // The value returned in *elemCount is the maximum number of consecutive bytes
+  // that can be read at the returned memory location, see CCircularBuffer::GetReadPtr().
+
+  const uint8_t * GetReadPtr ( const uint32_t dmaWriteCount, uint32_t * const elemCount ) throw()
+  {
+    SkipOverwrittenData( dmaWriteCount );
+
+    const uint32_t readPos = m_readCount % BUFFER_SIZE;
+    const uint32_t availableCount = dmaWriteCount - m_readCount;
+    const uint32_t untilEndCount = BUFFER_SIZE - readPos;
+
+    *elemCount = availableCount < untilEndCount ? availableCount : untilEndCount;
+
+    return &m_buffer[ readPos ];
+  }
+
+  void ConsumeReadElements ( const uint32_t elemCountToConsume ) throw()
+  {
+    assert( elemCountToConsume != 0 );
+    assert( elemCountToConsume <= BUFFER_SIZE );
+    m_readCount += elemCountToConsume;
+  }
+
+ private:
+
+  void SkipOverwrittenData ( const uint32_t dmaWriteCount ) throw()
+  {
+    const uint32_t availableCount = dmaWriteCount - m_readCount;
+
+    if ( availableCount > BUFFER_SIZE )
+    {
+      const uint32_t overwrittenCount = availableCount - BUFFER_SIZE;
+      m_lostCount += overwrittenCount;
+      m_readCount += overwrittenCount;
+    }
+  }
+};
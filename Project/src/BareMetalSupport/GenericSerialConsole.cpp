@@ -16,7 +16,7 @@
 
 #include "GenericSerialConsole.h"  // The include file for this module should come first.
 
-#include <algorithm>
+#include <string.h>
 #include <inttypes.h>
 
 #include <Misc/AssertionUtils.h>
@@ -65,16 +65,80 @@ void CGenericSerialConsole::Reset ( void )
 {
   m_state = stIdle;
 
-  // Move the start position to BUF_LEN - 1 or a similar value
-  // in order to test the circular buffer's wrap-around logic during development.
+  m_historyFirstIndex  = 0;
+  m_historyEntryCount  = 0;
+  m_historyRecallDepth = 0;
+
+  for ( uint32_t i = 0; i < BUF_LEN; ++i )
+    m_buffer[ i ] = 0;
+
+  // Move the start position to BUF_LEN - MAX_SINGLE_CMD_LEN or a similar value in order to test
+  // the logic that restarts at the buffer beginning during development.
   const uint32_t startPos = 0;
 
+  StartNewCommand( startPos );
+}
+
+
+void CGenericSerialConsole::StartNewCommand ( const uint32_t beginPos )
+{
+  // A maximum-length command and its null terminator must fit without wrapping around the buffer end.
+  const uint32_t startPos = ( BUF_LEN - beginPos < MAX_SINGLE_CMD_LEN + 1 ) ? 0 : beginPos;
+
   m_cmdBeginPos = startPos;
   m_cursorPos   = startPos;
   m_cmdEndPos   = startPos;
 
-  for ( uint32_t i = 0; i < BUF_LEN; ++i )
-    m_buffer[ i ] = 0;
+  // Forget the history entries that the new command may overwrite. Because the commands
+  // are written one after the other, those entries are always the oldest ones.
+
+  while ( m_historyEntryCount > 0 )
+  {
+    const uint32_t entryBeginPos = m_historyEntries[ m_historyFirstIndex ];
+    const uint32_t entryEndPos   = entryBeginPos + uint32_t( strlen( &m_buffer[ entryBeginPos ] ) );  // The null terminator.
+
+    if ( entryEndPos < startPos || entryBeginPos > startPos + MAX_SINGLE_CMD_LEN )
+      break;
+
+    m_historyFirstIndex = uint8_t( ( m_historyFirstIndex + 1 ) % MAX_HISTORY_ENTRY_COUNT );
+    --m_historyEntryCount;
+  }
+}
+
+
+const char * CGenericSerialConsole::GetHistoryEntry ( const uint8_t depth ) const
+{
+  assert( depth >= 1 && depth <= m_historyEntryCount );
+
+  const uint32_t index = ( m_historyFirstIndex + m_historyEntryCount - depth ) % MAX_HISTORY_ENTRY_COUNT;
+
+  return &m_buffer[ m_historyEntries[ index ] ];
+}
+
+
+// Returns whether the current command has been added to the history. Empty commands
+// and repetitions of the last one are not, so that their space in the buffer can be reused.
+
+bool CGenericSerialConsole::AddToHistory ( void )
+{
+  const char * const cmd = &m_buffer[ m_cmdBeginPos ];
+
+  if ( m_cmdEndPos == m_cmdBeginPos )
+    return false;
+
+  if ( m_historyEntryCount > 0 && 0 == strcmp( GetHistoryEntry( 1 ), cmd ) )
+    return false;
+
+  if ( m_historyEntryCount == MAX_HISTORY_ENTRY_COUNT )
+  {
+    m_historyFirstIndex = uint8_t( ( m_historyFirstIndex + 1 ) % MAX_HISTORY_ENTRY_COUNT );
+    --m_historyEntryCount;
+  }
+
+  m_historyEntries[ ( m_historyFirstIndex + m_historyEntryCount ) % MAX_HISTORY_ENTRY_COUNT ] = uint16_t( m_cmdBeginPos );
+  ++m_historyEntryCount;
+
+  return true;
 }
 
 
@@ -84,17 +148,12 @@ void CGenericSerialConsole::Bell ( void )
 }
 
 
-// Returns non-nullptr if a command is ready to be executed. In this case,
-// the circular buffer is rotated so that the command starts at the first buffer position.
+// Returns non-nullptr if a command is ready to be executed. The command lies in consecutive memory locations
+// and is null-terminated, which simplifies the parsing code considerably. The pointer remains valid
+// until the next call to this routine.
 //
-// The rotation is a memory-intensive (slow) operation, but it simplifies the parsing code considerably,
-// because the command parser can assume that the whole command lies in consecutive memory locations.
-// Otherwise, the parsing logic gets tricky, or the caller needs to have yet another memory buffer
-// while parsing the command, and memory is short on many embedded devices.
-//
-// As a possible optimisation, we could rotate only if the command is fragmented (wraps around the end
-// of the circular buffer). However, every now and then a rotation must still take place. The user
-// may then wonder why some commands take much longer than others to process.
+// Commands never wrap around the end of the buffer, see StartNewCommand(), so there is no need to move
+// any data around, and the time it takes to process a character does not depend on the size of the history buffer.
 
 const char * CGenericSerialConsole::AddChar ( const uint8_t c,
                                               uint32_t * const retCmdLen )
@@ -149,30 +208,26 @@ const char * CGenericSerialConsole::AddChar ( const uint8_t c,
 
   if ( isCmdReady )
   {
-    assert( m_cmdBeginPos < BUF_LEN );
-    assert( m_cmdEndPos   < BUF_LEN );
+    assert( m_cmdBeginPos <= m_cmdEndPos );
+    assert( m_cmdEndPos   <  BUF_LEN );
 
     m_buffer[ m_cmdEndPos ] = 0;
-    const uint32_t cmdLen = GetCircularDistance( m_cmdBeginPos, m_cmdEndPos, BUF_LEN );
-
-    char * const first  = &m_buffer[0];
-    char * const last   = &m_buffer[BUF_LEN];
-    char * const middle = &m_buffer[m_cmdBeginPos];
+    const uint32_t cmdLen = m_cmdEndPos - m_cmdBeginPos;
+    const char * const cmd = &m_buffer[ m_cmdBeginPos ];
 
-    std::rotate( first, middle, last );
+    // SerialPrint( "Command ready." DBG_EOL );
 
-    assert( cmdLen < BUF_LEN );
+    assert( strlen( cmd ) == cmdLen );
 
-    m_cmdBeginPos = cmdLen;
-    m_cmdEndPos   = cmdLen;
-    m_cursorPos   = cmdLen;
+    const bool wasAddedToHistory = AddToHistory();
+    m_historyRecallDepth = 0;
 
-    // SerialPrint( "Command ready." DBG_EOL );
-
-    assert( strlen( m_buffer ) == cmdLen );
+    // The next command starts after the null terminator, so that this one remains valid
+    // while the caller processes it, and later as a history entry.
+    StartNewCommand( wasAddedToHistory ? m_cmdEndPos + 1 : m_cmdBeginPos );
 
     *retCmdLen = cmdLen;
-    return m_buffer;
+    return cmd;
   }
   else
   {
@@ -209,6 +264,14 @@ bool CGenericSerialConsole::ProcessChar ( const uint8_t c )
     RightArrow();
     break;
 
+  case 0x10: // ^P (up arrow)
+    UpArrow();
+    break;
+
+  case 0x0E: // ^N (down arrow)
+    DownArrow();
+    break;
+
   case 0x08: // Backspace (^H).
   case 0x7F: // For me, that's the backspace key.
     Backspace();
@@ -329,6 +392,8 @@ bool CGenericSerialConsole::ProcessCharAfterEscapeBracket ( const uint8_t c )
   {
   case 'D':  LeftArrow ();  break;
   case 'C':  RightArrow();  break;
+  case 'A':  UpArrow   ();  break;
+  case 'B':  DownArrow ();  break;
 
   // In order to implement the 'delete' key here, we need to process here sequence "ESC [ 3 ~",
   // which is made of these bytes:
@@ -376,6 +441,60 @@ void CGenericSerialConsole::RightArrow ( void )
 }
 
 
+void CGenericSerialConsole::UpArrow ( void )
+{
+  if ( m_historyRecallDepth == m_historyEntryCount )
+  {
+    Bell();
+    return;
+  }
+
+  ++m_historyRecallDepth;
+
+  ReplaceCommand( GetHistoryEntry( m_historyRecallDepth ) );
+}
+
+
+void CGenericSerialConsole::DownArrow ( void )
+{
+  if ( m_historyRecallDepth == 0 )
+  {
+    Bell();
+    return;
+  }
+
+  --m_historyRecallDepth;
+
+  // Going down past the newest entry yields an empty command line.
+  ReplaceCommand( m_historyRecallDepth == 0 ? "" : GetHistoryEntry( m_historyRecallDepth ) );
+}
+
+
+void CGenericSerialConsole::ReplaceCommand ( const char * const newCmd )
+{
+  // NOTE: If the following logic changes much, remeber to update MAX_TX_BUFFER_SIZE_NEEDED.
+
+  const uint32_t newCmdLen = uint32_t( strlen( newCmd ) );
+
+  assert( newCmdLen <= MAX_SINGLE_CMD_LEN );
+
+  // StartNewCommand() has made sure that no history entry overlaps the space for the current command.
+  memcpy( &m_buffer[ m_cmdBeginPos ], newCmd, newCmdLen );
+
+  // Move the terminal cursor to the beginning of the command.
+  const uint32_t distanceToBegin = m_cursorPos - m_cmdBeginPos;
+  if ( distanceToBegin > 0 )
+    Printf( "\x1B[%" PRIu32 "D", distanceToBegin );  // Move left n positions.
+
+  m_cmdEndPos = m_cmdBeginPos + newCmdLen;
+  m_cursorPos = m_cmdEndPos;
+
+  Printf( "%.*s", int( newCmdLen ), &m_buffer[ m_cmdBeginPos ] );
+
+  PrintStr( "\x1B[K" );  // Erase to the end of the line, in case the previous command was longer.
+}
+
+
 void CGenericSerialConsole::PrintStr ( const char * const str ) const
 {
   Printf( "%s", str );
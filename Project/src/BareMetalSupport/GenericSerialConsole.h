@@ -20,6 +20,8 @@
 #include <Misc/AssertionUtils.h>
 
 
+// The up and down arrow keys (or ^P and ^N) recall previous commands.
+//
 // Still to do:
 //  - Unicode support.
 //  - Handle more keys like these: home, end, del, Ctrl+arrow keys.
@@ -29,6 +31,7 @@ class CGenericSerialConsole
 private:
   enum { BUF_LEN = 1024 };
   enum { MAX_SINGLE_CMD_LEN = 256 };  // Not including the NULL character terminator.
+  enum { MAX_HISTORY_ENTRY_COUNT = 32 };
 
   enum StateEnum
   {
@@ -37,14 +40,22 @@ private:
     stEscapeBracketReceived
   };
 
-  char m_buffer[ BUF_LEN ];  // Circular buffer with the current command and the past history of commands.
+  // Buffer with the current command and the past history of commands, each one with a null terminator.
+  // A command never wraps around the end of the buffer: if there is not enough room left
+  // for a maximum-length command, the next one starts at the beginning again, overwriting the oldest history entries.
+  char m_buffer[ BUF_LEN ];
 
   uint32_t m_cmdBeginPos;  // First cmd character.
   uint32_t m_cmdEndPos;    // One position beyond the last cmd character, same as m_cmdBeginPos if empty.
-  uint32_t m_cursorPos;    // Where the character is, so that m_cmdBeginPos <= m_cursorPos <= m_cmdEndPos
-                           // (without taking into account the wrapping around at the end of the circular buffer).
+  uint32_t m_cursorPos;    // Where the character is, so that m_cmdBeginPos <= m_cursorPos <= m_cmdEndPos.
   StateEnum m_state;
 
+  // Circular list with the start positions in m_buffer of the past commands.
+  uint16_t m_historyEntries[ MAX_HISTORY_ENTRY_COUNT ];
+  uint8_t  m_historyFirstIndex;  // The oldest entry.
+  uint8_t  m_historyEntryCount;
+  uint8_t  m_historyRecallDepth;  // 0 means that the user is not browsing the history, 1 is the newest entry.
+
   void Bell ( void );
 
   bool ProcessChar ( uint8_t c );
@@ -52,9 +63,16 @@ private:
 
   void LeftArrow  ( void );
   void RightArrow ( void );
+  void UpArrow    ( void );
+  void DownArrow  ( void );
   void Backspace  ( void );
   void InsertChar ( uint8_t c );
 
+  const char * GetHistoryEntry ( uint8_t depth ) const;
+  bool AddToHistory ( void );
+  void StartNewCommand ( uint32_t beginPos );
+  void ReplaceCommand ( const char * newCmd );
+
   void PrintStr ( const char * str ) const;
   void PrintChar ( char c ) const;
 
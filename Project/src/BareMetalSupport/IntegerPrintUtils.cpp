@@ -17,6 +17,8 @@
 
 #include "IntegerPrintUtils.h"  // Include file for this module comes first.
 
+#include <stdint.h>
+
 
 static const char NULL_CHAR = '\0';
 
@@ -48,7 +50,94 @@ void ConvertUint32ToHex ( const uint32_t val,
 }
 
 
-char * convert_unsigned_to_dec_th ( uint64_t val,
+// Each pair of characters is the decimal representation of its index, so that a single division
+// yields 2 digits. This is much faster than converting digit by digit.
+
+static const char DIGIT_PAIRS[] =
+  "0001020304050607080910111213141516171819"
+  "2021222324252627282930313233343536373839"
+  "4041424344454647484950515253545556575859"
+  "6061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+static_assert( sizeof( DIGIT_PAIRS ) == 200 + 1, "" );
+
+
+// Writes 2 decimal digits backwards and returns the new position.
+
+static inline char * WriteTwoDigitsBackwards ( char * const p, const uint32_t val ) throw()
+{
+  assert( val < 100 );
+
+  const char * const pair = &DIGIT_PAIRS[ val * 2 ];
+
+  *( p - 1 ) = pair[ 1 ];
+  *( p - 2 ) = pair[ 0 ];
+
+  return p - 2;
+}
+
+
+// Writes the shortest decimal representation backwards and returns the new position.
+
+static inline char * WriteDecimalBackwards ( char * p, uint32_t val ) throw()
+{
+  while ( val >= 100 )
+  {
+    p = WriteTwoDigitsBackwards( p, val % 100 );
+    val /= 100;
+  }
+
+  if ( val >= 10 )
+  {
+    p = WriteTwoDigitsBackwards( p, val );
+  }
+  else
+  {
+    --p;
+    *p = char( '0' + val );
+  }
+
+  return p;
+}
+
+
+// Writes a group of exactly 3 digits backwards, preceded by the thousand separator,
+// and returns the new position.
+
+static inline char * WriteThousandGroupBackwards ( char * p,
+                                                   const uint32_t group,
+                                                   const char thousandSepChar ) throw()
+{
+  assert( group < 1000 );
+
+  p = WriteTwoDigitsBackwards( p, group % 100 );
+
+  --p;
+  *p = char( '0' + group / 100 );
+
+  --p;
+  *p = thousandSepChar;
+
+  return p;
+}
+
+
+char * ConvertUint32ToDec ( const uint32_t val, char * const buffer ) throw()
+{
+  char * const end = buffer + CONVERT_UINT32_TO_DEC_BUFSIZE - 1;
+
+  *end = NULL_CHAR;
+
+  char * const p = WriteDecimalBackwards( end, val );
+
+  assert( p >= buffer );
+
+  return p;
+}
+
+
+char * convert_unsigned_to_dec_th ( const uint64_t val,
                                     char * const buffer,
                                     const char thousandSepChar ) throw()
 {
@@ -57,41 +146,103 @@ char * convert_unsigned_to_dec_th ( uint64_t val,
   static_assert( CONVERT_TO_DEC_BUF_SIZE == 28, "" );
 
 
-  // Short-circuit 0, as it's a very common value.
+  // Start at the end of the buffer, fill the buffer backwards.
+  // There is only one division per group of 3 digits.
+
+  char * p = buffer + CONVERT_TO_DEC_BUF_SIZE - 1;
+
+  *p = NULL_CHAR;
+
+  // 64-bit divisions are slow library calls on a 32-bit CPU, so switch to
+  // 32-bit arithmetic as soon as possible. Most numbers printed are small anyway.
+
+  uint64_t v64 = val;
 
-  if ( val == 0 )
+  while ( v64 > UINT32_MAX )
   {
-    buffer[0] = '0';
-    buffer[1] = NULL_CHAR;
-    return buffer;
+    p = WriteThousandGroupBackwards( p, uint32_t( v64 % 1000 ), thousandSepChar );
+    v64 /= 1000;
   }
 
+  uint32_t v32 = uint32_t( v64 );
 
-  // Start at the end of the buffer, fill the buffer backwards.
+  while ( v32 >= 1000 )
+  {
+    p = WriteThousandGroupBackwards( p, v32 % 1000, thousandSepChar );
+    v32 /= 1000;
+  }
 
-  char * p = buffer + CONVERT_TO_DEC_BUF_SIZE - 1;
+  // The most significant group has no leading zeros.
+  p = WriteDecimalBackwards( p, v32 );
 
-  int i = 0;
+  assert( p >= buffer );
 
-  *p = NULL_CHAR;
+  return p;
+}
+
+
+size_t FormatHexDumpLine ( const uint8_t * const data,
+                           const size_t byteCount,
+                           const size_t bytesPerLine,
+                           const unsigned options,
+                           const char * const endOfLineChars,
+                           char * const buffer ) throw()
+{
+  assert( byteCount > 0 );
+  assert( byteCount <= bytesPerLine );
+  assert( bytesPerLine <= HEX_DUMP_MAX_BYTES_PER_LINE );
 
-  do
+  const bool withPrefix0x = 0 != ( options & hdloPrefix0x );
+
+  char * p = buffer;
+
+  if ( options & hdloAddress )
+  {
+    ConvertUint32ToHex( uint32_t( uintptr_t( data ) ), p, false );
+    p += CONVERT_UINT32_TO_HEX_BUFSIZE - 1;
+    *p++ = ':';
+    *p++ = ' ';
+  }
+
+  for ( size_t i = 0; i < byteCount; ++i )
   {
-    if ( i % 3 == 0 && i != 0 )
+    if ( withPrefix0x )
     {
-      --p;
-      *p = thousandSepChar;
+      *p++ = '0';
+      *p++ = 'x';
     }
 
-    --p;
-    *p = char( '0' + val % 10 );
-    val /= 10;
-    ++i;
+    p = ConvertByteToHex( data[ i ], p );
+    *p++ = ' ';
   }
-  while ( val != 0 );
 
+  if ( options & hdloAsciiColumn )
+  {
+    // Align the ASCII column of the last line with the lines above.
 
-  assert( p >= buffer );
+    const size_t charsPerByte = withPrefix0x ? 5 : 3;
 
-  return p;
+    for ( size_t i = byteCount * charsPerByte; i < bytesPerLine * charsPerByte; ++i )
+      *p++ = ' ';
+
+    *p++ = ' ';
+
+    for ( size_t i = 0; i < byteCount; ++i )
+    {
+      const uint8_t c = data[ i ];
+      *p++ = ( c >= 0x20 && c < 0x7F ) ? char( c ) : '.';
+    }
+  }
+
+  for ( const char * eol = endOfLineChars; *eol != NULL_CHAR; ++eol )
+  {
+    assert( eol - endOfLineChars < HEX_DUMP_MAX_EOL_LEN );
+    *p++ = *eol;
+  }
+
+  *p = NULL_CHAR;
+
+  assert( p < buffer + HEX_DUMP_LINE_BUFSIZE );
+
+  return size_t( p - buffer );
 }
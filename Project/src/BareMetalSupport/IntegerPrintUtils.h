@@ -16,6 +16,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 #include <assert.h>
 
 
@@ -48,6 +49,20 @@ inline char ConvertDigitToHex ( const unsigned digitValue,
 void ConvertUint32ToHex ( uint32_t val, char * buffer, bool useLowercaseHexChars ) throw();
 
 
+// Writes 2 uppercase hex digits without a null terminator and returns the position after them.
+// A nibble lookup table is faster than ConvertDigitToHex(), as it has no branches.
+
+inline char * ConvertByteToHex ( const uint8_t val, char * const dest ) throw()
+{
+  static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+  dest[0] = HEX_DIGITS[ val >> 4  ];
+  dest[1] = HEX_DIGITS[ val & 0xF ];
+
+  return dest + 2;
+}
+
+
 //------------------------------------------------------------------------
 //
 // Converts an integer number to its shortest decimal representation.
@@ -69,3 +84,45 @@ void ConvertUint32ToHex ( uint32_t val, char * buffer, bool useLowercaseHexChars
 char * convert_unsigned_to_dec_th ( uint64_t val,
                                     char * buffer,
                                     char thousandSepChar ) throw();
+
+// Like convert_unsigned_to_dec_th() above, but without thousand separators and for 32-bit values only.
+// Pass in a buffer of at least size CONVERT_UINT32_TO_DEC_BUFSIZE.
+// The pointer to the number's beginning is returned.
+
+#define CONVERT_UINT32_TO_DEC_BUFSIZE ( 10 + 1 )  // Max unsigned 32-bit number is 4294967295 (10 digits), plus NULL terminator (1).
+
+char * ConvertUint32ToDec ( uint32_t val, char * buffer ) throw();
+
+
+//------------------------------------------------------------------------
+//
+// Formats one line of a hex dump into a buffer, so that the caller can print it in one go.
+// This is much faster than printing each byte with printf().
+//
+// The line looks like this, depending on the options:
+//
+//   20070000: 48 65 6C 6C 6F 0D 0A  Hello..
+//
+// The last line of a dump may be shorter. Pass the normal line length in 'bytesPerLine',
+// so that the ASCII column stays aligned.
+//
+// The buffer must be at least HEX_DUMP_LINE_BUFSIZE bytes long. The end-of-line characters are
+// appended, and the result is null-terminated. Returns the line length.
+
+enum HexDumpLineOptionsEnum
+{
+  hdloPrefix0x    = 1,  // Print each byte as "0xXX " instead of "XX ".
+  hdloAddress     = 2,  // Start the line with the address of its first byte.
+  hdloAsciiColumn = 4   // End the line with the printable characters, the rest are shown as '.'.
+};
+
+#define HEX_DUMP_MAX_BYTES_PER_LINE 32
+#define HEX_DUMP_MAX_EOL_LEN 2
+#define HEX_DUMP_LINE_BUFSIZE ( 8 + 2 + HEX_DUMP_MAX_BYTES_PER_LINE * 5 + 1 + HEX_DUMP_MAX_BYTES_PER_LINE + HEX_DUMP_MAX_EOL_LEN + 1 )
+
+size_t FormatHexDumpLine ( const uint8_t * data,
+                           size_t byteCount,
+                           size_t bytesPerLine,
+                           unsigned options,  // See HexDumpLineOptionsEnum.
+                           const char * endOfLineChars,
+                           char * buffer ) throw();
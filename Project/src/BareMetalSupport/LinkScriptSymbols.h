@@ -29,13 +29,22 @@ extern "C" int _sfixed;  // The start of the interrupt vector table.
 extern "C" int __etext;  // End of the code, and start of the data that needs to be relocated.
                          // Atmel or Arduino tend to name it '_etext'.
 
-// This area is were the relocated data lands.
+// Routines copied to SRAM on start-up, see RAMFUNC in RamFunctions.h .
+// Their load image in Flash starts at __etext.
+extern "C" int __ramfunc_start__;
+extern "C" int __ramfunc_end__;
+
+// This area is were the relocated data lands. Its load image in Flash follows the .ramfunc one.
 extern "C" int __data_start__;  // Atmel or Arduino tend to name it '_srelocate'.
 extern "C" int __data_end__;    // Atmel or Arduino tend to name it '_erelocate'.
 
 extern "C" int __bss_start__;  // Atmel or Arduino tend to name it '_sbss' or '_szero'.
 extern "C" int __bss_end__;    // Atmel or Arduino tend to name it '_ebss' or '_ezero'.
 
+// Variables that are not zeroed on start-up, see NOINIT_DATA in NoInitData.h .
+extern "C" int __noinit_start__;
+extern "C" int __noinit_end__;
+
 extern "C" int __StackLimit;  // Start of the stack region, often called '_sstack'.
 extern "C" int __StackTop;    // End   of the stack region (one byte beyond the end). This value lands in the "stack start" entry in the interrupt vector table.
 
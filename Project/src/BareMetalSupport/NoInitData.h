@@ -0,0 +1,29 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+// Variables marked with NOINIT_DATA land in linker section .noinit, which InitDataSegments()
+// does not zero on start-up, unlike .bss .
+//
+// Zeroing the large buffers (USB, serial port, etc.) is a noticeable part of the boot time.
+// Use NOINIT_DATA only on variables whose contents are never read before being written. For example,
+// the constructor of a CCircularBuffer resets its read position and element count, but leaves
+// the data array alone. Note that static constructors run later, in InitLibc().
+// Do not use it on objects whose constructors clear their buffers anyway, like the serial consoles.
+//
+// The .noinit section follows .bss in the linker script. Its size is reported together
+// with the other segment sizes, see PrintFirmwareSegmentSizesSync().
+
+#define NOINIT_DATA  __attribute__ ((section (".noinit")))
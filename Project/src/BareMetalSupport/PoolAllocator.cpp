@@ -0,0 +1,374 @@
+
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "PoolAllocator.h"  // The include file for this module should come first.
+
+#include <newlib.h>  // For __PICOLIBC__, if we are actually using Picolibc.
+
+#include <assert.h>
+#include <string.h>
+#include <malloc.h>
+
+#ifndef __PICOLIBC__
+  #include <reent.h>  // For struct _reent.
+#endif
+
+#include <BareMetalSupport/LinkScriptSymbols.h>
+#include <BareMetalSupport/Miscellaneous.h>
+
+#include <Misc/AssertionUtils.h>
+
+#include <PoolAllocatorConfig.h>  // This file is provided by the firmware project.
+
+
+static const size_t POOL_COUNT = sizeof( POOL_ALLOCATOR_CONFIG ) / sizeof( POOL_ALLOCATOR_CONFIG[0] );
+
+static constexpr bool IsPoolConfigValid ( void )
+{
+  for ( size_t i = 0; i < POOL_COUNT; ++i )
+  {
+    const PoolAllocatorPoolConfig & cfg = POOL_ALLOCATOR_CONFIG[ i ];
+
+    // A free block must be able to hold the pointer to the next free block.
+    if ( cfg.blockSize < sizeof( void * ) ||
+         cfg.blockSize % POOL_ALLOCATOR_BLOCK_ALIGNMENT != 0 ||
+         cfg.blockCount == 0 )
+    {
+      return false;
+    }
+
+    if ( i > 0 && cfg.blockSize <= POOL_ALLOCATOR_CONFIG[ i - 1 ].blockSize )
+      return false;
+  }
+
+  return true;
+}
+
+static_assert( POOL_COUNT > 0, "There must be at least one pool." );
+static_assert( IsPoolConfigValid(), "Invalid pool allocator configuration." );
+
+
+struct PoolState
+{
+  uint8_t * begin;
+  uint8_t * end;
+  void * freeListHead;  // Each free block starts with a pointer to the next free block.
+
+  uint16_t usedBlockCount;
+  uint16_t peakUsedBlockCount;
+  uint32_t failedAllocationCount;
+};
+
+static PoolState s_pools[ POOL_COUNT ];
+static bool s_arePoolsInitialised = false;
+
+
+// The pools are initialised on the first allocation, because malloc() may be called
+// before any of our initialisation code runs.
+
+static void InitPools ( void )
+{
+  assert( !s_arePoolsInitialised );
+
+  uintptr_t nextAddr = ( uintptr_t( &__end__ ) + POOL_ALLOCATOR_BLOCK_ALIGNMENT - 1 ) & ~uintptr_t( POOL_ALLOCATOR_BLOCK_ALIGNMENT - 1 );
+
+  for ( size_t i = 0; i < POOL_COUNT; ++i )
+  {
+    const PoolAllocatorPoolConfig & cfg = POOL_ALLOCATOR_CONFIG[ i ];
+    PoolState & pool = s_pools[ i ];
+
+    const size_t poolSize = size_t( cfg.blockSize ) * cfg.blockCount;
+
+    if ( uintptr_t( &__HeapLimit ) - nextAddr < poolSize )
+      Panic( "The pool allocator configuration does not fit in the heap area." );
+
+    pool.begin = (uint8_t *) nextAddr;
+    pool.end   = pool.begin + poolSize;
+
+    // Chain all blocks together in the free list, the lowest address first.
+    // The list is built front to back, because walking backwards would form
+    // a pointer before the beginning of the pool, which is undefined behaviour.
+
+    void ** link = &pool.freeListHead;
+
+    for ( size_t j = 0; j < cfg.blockCount; ++j )
+    {
+      uint8_t * const block = pool.begin + j * cfg.blockSize;
+      *link = block;
+      link = (void **) block;
+    }
+
+    *link = nullptr;
+
+    pool.usedBlockCount        = 0;
+    pool.peakUsedBlockCount    = 0;
+    pool.failedAllocationCount = 0;
+
+    nextAddr += poolSize;
+  }
+
+  s_arePoolsInitialised = true;
+}
+
+
+static void * AllocateBlock ( const size_t byteCount )
+{
+  // Malloc is generally not safe in interrupt context, see also _sbrk().
+  assert( ! IsCpuHandlingAnInterrupt() );
+
+  if ( !s_arePoolsInitialised )
+    InitPools();
+
+  // There are only a few pools, so a linear search is fast enough. The time it takes
+  // does not depend on how many blocks are in use.
+
+  for ( size_t i = 0; i < POOL_COUNT; ++i )
+  {
+    if ( byteCount > POOL_ALLOCATOR_CONFIG[ i ].blockSize )
+      continue;
+
+    PoolState & pool = s_pools[ i ];
+
+    void * const block = pool.freeListHead;
+
+    if ( block == nullptr )
+    {
+      ++pool.failedAllocationCount;
+      continue;
+    }
+
+    pool.freeListHead = *(void **) block;
+
+    ++pool.usedBlockCount;
+
+    if ( pool.usedBlockCount > pool.peakUsedBlockCount )
+      pool.peakUsedBlockCount = pool.usedBlockCount;
+
+    return block;
+  }
+
+  // An out-of-memory situation is probably going to wreak havoc,
+  // and it should never happen in well-designed firmware.
+  // But if you trust your firmware, you can return an error instead.
+  if ( true )
+  {
+    Panic( "Out of pool allocator memory." );
+  }
+  else
+  {
+    return nullptr;
+  }
+}
+
+
+static size_t FindPoolIndex ( const void * const ptr )
+{
+  assert( s_arePoolsInitialised );
+
+  for ( size_t i = 0; i < POOL_COUNT; ++i )
+  {
+    const PoolState & pool = s_pools[ i ];
+
+    if ( ptr >= pool.begin && ptr < pool.end )
+    {
+      assert( ( (const uint8_t *) ptr - pool.begin ) % POOL_ALLOCATOR_CONFIG[ i ].blockSize == 0 );
+      return i;
+    }
+  }
+
+  Panic( "The pointer to free does not belong to the pool allocator." );
+}
+
+
+static void ReleaseBlock ( void * const ptr )
+{
+  assert( ! IsCpuHandlingAnInterrupt() );
+
+  if ( ptr == nullptr )
+    return;
+
+  PoolState & pool = s_pools[ FindPoolIndex( ptr ) ];
+
+  assert( pool.usedBlockCount > 0 );
+  --pool.usedBlockCount;
+
+  *(void **) ptr = pool.freeListHead;
+  pool.freeListHead = ptr;
+}
+
+
+static void * ReallocateBlock ( void * const ptr, const size_t byteCount )
+{
+  if ( ptr == nullptr )
+    return AllocateBlock( byteCount );
+
+  if ( byteCount == 0 )
+  {
+    ReleaseBlock( ptr );
+    return nullptr;
+  }
+
+  const size_t currentBlockSize = POOL_ALLOCATOR_CONFIG[ FindPoolIndex( ptr ) ].blockSize;
+
+  if ( byteCount <= currentBlockSize )
+    return ptr;
+
+  void * const newBlock = AllocateBlock( byteCount );
+
+  if ( newBlock != nullptr )
+  {
+    memcpy( newBlock, ptr, currentBlockSize );
+    ReleaseBlock( ptr );
+  }
+
+  return newBlock;
+}
+
+
+static void * AllocateZeroedBlock ( const size_t elementCount, const size_t elementSize )
+{
+  size_t byteCount;
+
+  if ( __builtin_mul_overflow( elementCount, elementSize, &byteCount ) )
+    return nullptr;
+
+  void * const block = AllocateBlock( byteCount );
+
+  if ( block != nullptr )
+    memset( block, 0, byteCount );
+
+  return block;
+}
+
+
+static struct mallinfo GetMallinfo ( void )
+{
+  struct mallinfo mi;
+  memset( &mi, 0, sizeof( mi ) );
+
+  // The pools do not grow like the normal malloc heap. In order to keep the checks in routines
+  // like RuntimeStartupChecks() meaningful, the arena is the peak memory usage.
+
+  size_t totalSize = 0;
+
+  for ( size_t i = 0; i < POOL_COUNT; ++i )
+  {
+    const size_t blockSize = POOL_ALLOCATOR_CONFIG[ i ].blockSize;
+
+    totalSize += blockSize * POOL_ALLOCATOR_CONFIG[ i ].blockCount;
+
+    if ( s_arePoolsInitialised )
+    {
+      mi.arena    += blockSize * s_pools[ i ].peakUsedBlockCount;
+      mi.uordblks += blockSize * s_pools[ i ].usedBlockCount;
+    }
+  }
+
+  mi.fordblks = totalSize - mi.uordblks;
+
+  return mi;
+}
+
+
+size_t GetPoolAllocatorPoolCount ( void ) throw()
+{
+  return POOL_COUNT;
+}
+
+
+void GetPoolAllocatorStats ( const size_t poolIndex, PoolAllocatorStats * const stats ) throw()
+{
+  assert( poolIndex < POOL_COUNT );
+
+  const PoolAllocatorPoolConfig & cfg = POOL_ALLOCATOR_CONFIG[ poolIndex ];
+
+  stats->blockSize  = cfg.blockSize;
+  stats->blockCount = cfg.blockCount;
+
+  if ( s_arePoolsInitialised )
+  {
+    const PoolState & pool = s_pools[ poolIndex ];
+
+    stats->usedBlockCount        = pool.usedBlockCount;
+    stats->peakUsedBlockCount    = pool.peakUsedBlockCount;
+    stats->failedAllocationCount = pool.failedAllocationCount;
+  }
+  else
+  {
+    stats->usedBlockCount        = 0;
+    stats->peakUsedBlockCount    = 0;
+    stats->failedAllocationCount = 0;
+  }
+}
+
+
+// These are the replacements for the C runtime library routines. Newlib uses the reentrant variants
+// with the '_r' suffix internally, and Picolibc does not have them at all.
+
+extern "C" void * __wrap_malloc ( const size_t byteCount )
+{
+  return AllocateBlock( byteCount );
+}
+
+extern "C" void __wrap_free ( void * const ptr )
+{
+  ReleaseBlock( ptr );
+}
+
+extern "C" void * __wrap_realloc ( void * const ptr, const size_t byteCount )
+{
+  return ReallocateBlock( ptr, byteCount );
+}
+
+extern "C" void * __wrap_calloc ( const size_t elementCount, const size_t elementSize )
+{
+  return AllocateZeroedBlock( elementCount, elementSize );
+}
+
+extern "C" struct mallinfo __wrap_mallinfo ( void )
+{
+  return GetMallinfo();
+}
+
+
+#ifndef __PICOLIBC__
+
+extern "C" void * __wrap__malloc_r ( struct _reent *, const size_t byteCount )
+{
+  return AllocateBlock( byteCount );
+}
+
+extern "C" void __wrap__free_r ( struct _reent *, void * const ptr )
+{
+  ReleaseBlock( ptr );
+}
+
+extern "C" void * __wrap__realloc_r ( struct _reent *, void * const ptr, const size_t byteCount )
+{
+  return ReallocateBlock( ptr, byteCount );
+}
+
+extern "C" void * __wrap__calloc_r ( struct _reent *, const size_t elementCount, const size_t elementSize )
+{
+  return AllocateZeroedBlock( elementCount, elementSize );
+}
+
+extern "C" struct mallinfo __wrap__mallinfo_r ( struct _reent * )
+{
+  return GetMallinfo();
+}
+
+#endif
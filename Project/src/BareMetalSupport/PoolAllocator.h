@@ -0,0 +1,60 @@
+
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// This is a fixed-block pool allocator that replaces the C runtime library's malloc() and friends.
+//
+// The generic malloc heap can fragment over time, and the time it takes to allocate memory depends
+// on the heap history. Allocating memory for C++ exceptions on the error paths is then not deterministic.
+// With fixed-size blocks, there is no fragmentation, and allocating or releasing a block
+// takes constant time. The price is that memory is wasted inside each block, and that
+// the pool sizes must be chosen at build time.
+//
+// The pools are carved out of the malloc heap area defined by the linker script file.
+// The firmware project must provide header file PoolAllocatorConfig.h with the following definition:
+//
+//   static constexpr PoolAllocatorPoolConfig POOL_ALLOCATOR_CONFIG[] = { { block size, block count }, ... };
+//
+// The block sizes must be multiples of POOL_ALLOCATOR_BLOCK_ALIGNMENT and must be in ascending order.
+// A request lands in the pool with the smallest block size that fits. If that pool is exhausted,
+// the next bigger pool is tried.
+//
+// The C runtime library's routines are replaced with linker option --wrap, see Makefile.am .
+// C++ exceptions are covered too, because __cxa_allocate_exception() in GCC's libsupc++ calls malloc(),
+// and we have patched out its emergency memory pool.
+
+#define POOL_ALLOCATOR_BLOCK_ALIGNMENT  8
+
+struct PoolAllocatorPoolConfig
+{
+  uint16_t blockSize;
+  uint16_t blockCount;
+};
+
+struct PoolAllocatorStats
+{
+  size_t blockSize;
+  size_t blockCount;
+  size_t usedBlockCount;
+  size_t peakUsedBlockCount;
+  size_t failedAllocationCount;  // How many times this pool was exhausted and a bigger pool had to be tried.
+};
+
+size_t GetPoolAllocatorPoolCount ( void ) throw();
+void GetPoolAllocatorStats ( size_t poolIndex, PoolAllocatorStats * stats ) throw();
@@ -0,0 +1,55 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+// Routines marked with RAMFUNC land in linker section .ramfunc and are copied
+// from Flash to SRAM on start-up, see InitDataSegments().
+//
+// On the Arduino Due, the Flash memory needs several wait states at 84 MHz. The Flash prefetch buffer
+// hides most of them in straight code, but not on every branch, so the timing of tight loops
+// like the JTAG bit-banging ones jitters. Code in SRAM has no such wait states, but it is fetched
+// over the system bus, which competes with data accesses. Therefore, whether a routine
+// runs faster from SRAM must be measured on a case by case basis, for example
+// with command "JtagShiftSpeedTest". Set ENABLE_RAMFUNC to 0 to compare.
+//
+// SRAM is scarce, so only use RAMFUNC on small, hot routines. Any routines they call
+// should be inlined, or they will run from Flash anyway. The linker generates long-branch veneers
+// for calls between Flash and SRAM, as they are too far apart for a normal BL instruction.
+//
+// Attribute 'noinline' is necessary, because a routine inlined into its caller would land
+// in the caller's section. Attribute 'long_call' avoids the veneer on calls from Flash.
+//
+// Small helpers like the CCircularBuffer accessors are not marked with RAMFUNC. They are inlined
+// into their callers, so they already run from SRAM when called from a RAMFUNC routine,
+// and making them 'noinline' would cost a call on every access.
+//
+// The USB interrupt handler comes from the Atmel Software Framework, so it cannot be marked
+// with RAMFUNC. Instead, the Arduino Due linker script moves the whole USB device driver
+// (uotghs_device.o) to section .ramfunc .
+//
+// Command "make disassemble" generates a report listing what ended up in SRAM.
+
+#define ENABLE_RAMFUNC  1
+
+#if ENABLE_RAMFUNC
+  #ifdef __arm__
+    #define RAMFUNC  __attribute__ ((section (".ramfunc"), noinline, long_call))
+  #else
+    // Attribute 'long_call' only exists on ARM. The host emulator compiles some of these routines too.
+    #define RAMFUNC  __attribute__ ((section (".ramfunc"), noinline))
+  #endif
+#else
+  #define RAMFUNC
+#endif
@@ -23,6 +23,7 @@
 
 #include "Miscellaneous.h"
 #include "CircularBuffer.h"
+#include "NoInitData.h"
 
 #include <BoardSupport-ArduinoDue/DebugConsoleSupport.h>
 
@@ -94,7 +95,7 @@ typedef CCircularBuffer< char, uint32_t, SERIAL_PORT_TX_BUFFER_SIZE > CSerialPor
 
 // This instance should be "volatile", but then I get difficult compilation errors,
 // more investigation is needed. In the mean time, see AssumeMemoryHasChanged() below.
-static CSerialPortTxBuffer s_serialPortTxBuffer;
+static CSerialPortTxBuffer s_serialPortTxBuffer NOINIT_DATA;
 
 static const char OVERFLOW_MSG[] = "[Some output is missing here due to serial port Tx buffer overflow]";
 static const size_t OVERFLOW_MSG_LEN = sizeof(OVERFLOW_MSG) - 1;
@@ -16,10 +16,12 @@
 #include <stdint.h>
 #include <stddef.h>  // For size_t.
 
+#include "RamFunctions.h"
+
 
 void InitSerialPortAsyncTx ( const char * eol );
 
-void SerialPortAsyncTxInterruptHandler ( void ) throw();
+void SerialPortAsyncTxInterruptHandler ( void ) throw() RAMFUNC;
 
 void SendSerialPortAsyncData ( const char * data, size_t dataLen );
 
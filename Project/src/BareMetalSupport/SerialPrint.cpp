@@ -20,9 +20,9 @@
 #include <string.h>
 #include <stdio.h>
 #include <inttypes.h>
-#include <stdexcept>
 
 #include "SerialPortAsyncTx.h"
+#include "IntegerPrintUtils.h"
 
 
 void SerialPrintStr ( const char * const msg )
@@ -42,11 +42,8 @@ void SerialPrintf ( const char * formatStr, ... )
 }
 
 
-// This routine could be improved in many ways:
-// - Make it faster by building a complete line and sending it at once.
-// - Provide memory addresses and/or offsets on the left.
-// - Provide an ASCII dump on the right.
-// - Use different data sizes (8 bits, 16 bits, 32 bits).
+// Each line is formatted in a buffer and sent in one go, which is much faster
+// than printing each byte separately.
 
 void SerialPrintHexDump ( const void * const ptr,
                           const size_t byteCount,
@@ -54,23 +51,24 @@ void SerialPrintHexDump ( const void * const ptr,
 {
   assert( byteCount > 0 );
 
-  const uint8_t * const bytePtr = static_cast< const uint8_t * >( ptr );
+  const size_t BYTES_PER_LINE = 20;
 
-  unsigned lineElemCount = 0;
+  const uint8_t * const bytePtr = static_cast< const uint8_t * >( ptr );
 
-  for ( size_t i = 0; i < byteCount; ++i )
+  for ( size_t offset = 0; offset < byteCount; offset += BYTES_PER_LINE )
   {
-    if ( lineElemCount == 20 )
-    {
-      lineElemCount = 0;
-      SerialPrintStr( endOfLineChars );
-    }
-    const uint8_t b = bytePtr[ i ];
-    SerialPrintf( "0x%02" PRIX8 " ", b );
-    ++lineElemCount;
-  }
+    const size_t lineByteCount = byteCount - offset < BYTES_PER_LINE ? byteCount - offset : BYTES_PER_LINE;
+
+    char line[ HEX_DUMP_LINE_BUFSIZE ];
 
-  SerialPrintStr( endOfLineChars );
+    const size_t lineLen = FormatHexDumpLine( bytePtr + offset,
+                                              lineByteCount,
+                                              BYTES_PER_LINE,
+                                              hdloPrefix0x,
+                                              endOfLineChars,
+                                              line );
+    SendSerialPortAsyncData( line, lineLen );
+  }
 }
 
 
@@ -91,7 +89,13 @@ void SerialPrintV ( const char * const formatStr, va_list argList )
   if ( len < 0 )
   {
     // I do not think that vsnprintf would ever fail, but you never know.
-    throw std::runtime_error( "vsnprintf failed." );
+    // This used to throw a C++ exception, but the firmware may have been built with -fno-exceptions,
+    // and a failed debug message is no reason to halt the whole probe. Print an error marker instead.
+    assert( false );
+
+    static const char VSNPRINTF_ERROR_MARKER[] = "<vsnprintf failed>";
+    SendSerialPortAsyncData( VSNPRINTF_ERROR_MARKER, sizeof( VSNPRINTF_ERROR_MARKER ) - 1 );
+    SendSerialPortAsyncData( GetSerialPortEol(), strlen( GetSerialPortEol() ) );
   }
   else if ( len >= MAX_SERIAL_PRINT_LEN + 1 )  // If the string needs to be truncated ...
   {
@@ -16,20 +16,39 @@
 
 #include "StackCheck.h"  // Include file for this module comes first.
 
-#include <string.h>  // For memset().
-
 #include <BareMetalSupport/LinkScriptSymbols.h>
 
 #include <Misc/AssertionUtils.h>
 
 
-static const uint8_t STACK_CANARY_VAL = 0xBA;
+// Byte value 0xBA in each byte of the word, which is easy to spot in a memory dump.
+static const uint32_t STACK_CANARY_VAL = 0xBABABABA;
+
+// The lowest stack word known to have been used, see UpdateStackUsageWatermark().
+static const uint32_t * s_watermark = nullptr;
+
+// Where the next incremental scan resumes.
+static const uint32_t * s_scanResumePos = nullptr;
+
+
+static const uint32_t * GetStackLimit ( void ) throw()
+{
+    return (const uint32_t *) & __StackLimit;
+}
+
+static const uint32_t * GetStackTop ( void ) throw()
+{
+    return (const uint32_t *) & __StackTop;
+}
+
 
 void FillStackCanary ( void ) throw()
 {
     const uintptr_t SAFETY_MARGIN = 32;
     const uintptr_t stackStartAddr = uintptr_t( & __StackLimit );
 
+    assert( stackStartAddr % sizeof( uint32_t ) == 0 );
+
     // Possible alternatives:
     //   register unsigned long current_sp __asm__ ("sp");
     //   __asm__ ("mov %0, r13" : "=r" (current_sp));
@@ -37,53 +56,115 @@ void FillStackCanary ( void ) throw()
 
     assert( stackStartAddr + SAFETY_MARGIN < currentStackPtr );
 
-    const size_t canarySize = currentStackPtr - stackStartAddr - SAFETY_MARGIN;
+    const size_t canaryWordCount = ( currentStackPtr - stackStartAddr - SAFETY_MARGIN ) / sizeof( uint32_t );
+
+    uint32_t * const canaryStart = (uint32_t *) stackStartAddr;
 
-    memset( (void *) stackStartAddr, STACK_CANARY_VAL, canarySize );
+    for ( size_t i = 0; i < canaryWordCount; ++i )
+      canaryStart[ i ] = STACK_CANARY_VAL;
+
+    s_watermark     = canaryStart + canaryWordCount;
+    s_scanResumePos = canaryStart;
 }
 
 
-// Returns 'false' if the canary region is not intact any more.
-// Note that this check is not watertight, as writing exactly the STACK_CANARY_VAL value
-// will not be detected. Therefore, use only for debug purposes!
+// Returns a pointer to the first word in [p, end) which does not hold the canary value,
+// or 'end' if all words are intact.
 // NOTE: This routine is always optimised with "__attribute__ ((optimize("O2")))",
 //       even in debug builds.
 
-bool CheckStackCanary ( const size_t canarySize ) throw()
+static const uint32_t * FindFirstNonCanaryWord ( const uint32_t * p, const uint32_t * end ) throw() __attribute__ ((optimize("O2")));
+
+static const uint32_t * FindFirstNonCanaryWord ( const uint32_t * p, const uint32_t * const end ) throw()
 {
-    const char * p = (const char *) ( & __StackLimit );
+    assert( p <= end );
 
-    for ( size_t i = 0; i < canarySize; ++i )
+    // Check 4 words per iteration. GCC loads them with a single LDM instruction,
+    // and there is only one conditional branch per iteration.
+    while ( end - p >= 4 )
+    {
+        const uint32_t diff = ( p[0] ^ STACK_CANARY_VAL ) |
+                              ( p[1] ^ STACK_CANARY_VAL ) |
+                              ( p[2] ^ STACK_CANARY_VAL ) |
+                              ( p[3] ^ STACK_CANARY_VAL );
+        if ( diff != 0 )
+            break;
+
+        p += 4;
+    }
+
+    for ( ; p < end; ++p )
     {
         if ( *p != STACK_CANARY_VAL )
-        {
-            return false;
-        }
-        ++p;
+            break;
     }
 
-    return true;
+    return p;
+}
+
+
+// Returns 'false' if the canary region is not intact any more.
+// The size is rounded up to a whole number of words.
+// Note that this check is not watertight, as writing exactly the STACK_CANARY_VAL value
+// will not be detected. Therefore, use only for debug purposes!
+
+bool CheckStackCanary ( const size_t canarySize ) throw()
+{
+    const uint32_t * const begin = GetStackLimit();
+    const uint32_t * const end   = begin + ( canarySize + sizeof( uint32_t ) - 1 ) / sizeof( uint32_t );
+
+    assert( end <= GetStackTop() );
+
+    return FindFirstNonCanaryWord( begin, end ) == end;
 }
 
 
 size_t GetStackSizeUsageEstimate ( void ) throw()
 {
-    const uint8_t * const startAddr = (const uint8_t *) & __StackLimit;
-    const uint8_t * const endAddr   = (const uint8_t *) & __StackTop;
+    const uint32_t * const startAddr = GetStackLimit();
+    const uint32_t * const endAddr   = GetStackTop();
+
+    const uint32_t * const firstUsed = FindFirstNonCanaryWord( startAddr, endAddr );
+
+    // It is very rare that the whole stack space has been used up.
+    assert( firstUsed != startAddr );
+
+    return uintptr_t( endAddr ) - uintptr_t( firstUsed );
+}
+
+
+size_t UpdateStackUsageWatermark ( const size_t maxWordCount ) throw()
+{
+    assert( s_watermark != nullptr );  // Otherwise, FillStackCanary() has not been called yet.
+    assert( maxWordCount > 0 );
+
+    // The words between the resume position and the watermark were intact during the current pass,
+    // and the words above the watermark are already accounted for.
+    // So there is no need to scan beyond the watermark.
+
+    const uint32_t * const scanEnd = size_t( s_watermark - s_scanResumePos ) > maxWordCount
+                                       ? s_scanResumePos + maxWordCount
+                                       : s_watermark;
 
-    for ( const uint8_t * scan = startAddr;
-          scan < endAddr;
-          ++scan )
+    const uint32_t * const firstUsed = FindFirstNonCanaryWord( s_scanResumePos, scanEnd );
+
+    if ( firstUsed != scanEnd )
+    {
+        // The stack has grown deeper. Words below this one may have changed since they were scanned,
+        // so start a new pass from the bottom.
+        s_watermark     = firstUsed;
+        s_scanResumePos = GetStackLimit();
+    }
+    else if ( scanEnd == s_watermark )
     {
-        if ( *scan != STACK_CANARY_VAL )
-        {
-            return size_t( endAddr - scan );
-        }
+        s_scanResumePos = GetStackLimit();  // Pass complete.
+    }
+    else
+    {
+        s_scanResumePos = scanEnd;
     }
 
-    // It is very rare that the whole stack space has been used up.
-    assert( false );
-    return size_t( endAddr - startAddr );
+    return uintptr_t( GetStackTop() ) - uintptr_t( s_watermark );
 }
 
 
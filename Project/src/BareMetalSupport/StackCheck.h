@@ -18,7 +18,17 @@
 #include <stddef.h>  // For size_t.
 #include <stdint.h>
 
+// All routines that scan the canary area work on whole 32-bit words,
+// so the results have a granularity of 4 bytes and always err on the safe side.
+
 void FillStackCanary ( void ) throw();
-bool CheckStackCanary ( size_t canarySize ) throw() __attribute__ ((optimize("O2")));
+bool CheckStackCanary ( size_t canarySize ) throw();
 size_t GetStackSizeUsageEstimate ( void ) throw();
 size_t GetCurrentStackDepth ( void ) throw();
+
+// Scanning the whole canary area takes too long to do on every main loop iteration.
+// This routine scans at most 'maxWordCount' words per call, resuming where the last call left off,
+// and returns the maximum stack usage detected so far. A complete pass takes
+// (canary area size / 4 / maxWordCount) calls, so a usage peak can be reported with some delay.
+// FillStackCanary() must have been called beforehand.
+size_t UpdateStackUsageWatermark ( size_t maxWordCount ) throw();
@@ -20,6 +20,7 @@
 
 #include <sam3xa.h>
 
+#include <BareMetalSupport/BootTimestamps.h>
 #include <BareMetalSupport/BusyWait.h>
 #include <BareMetalSupport/IoUtils.h>
 #include <BareMetalSupport/LinkScriptSymbols.h>
@@ -152,8 +153,12 @@ extern "C" void BareMetalSupport_Reset_Handler ( void );  // Prevent "no previou
 
 void BareMetalSupport_Reset_Handler ( void )
 {
+    StartBootTimestamps();
+
     SetupCpuClock();
 
+    RecordBootTimestamp( bpClockReady );
+
     // Delay the start-up sequence, so that an external JTAG debugger has a chance
     // to stop the firmware near the beginning.
     //
@@ -162,10 +167,20 @@ void BareMetalSupport_Reset_Handler ( void )
     // DebugDue firmware, I need around 34 ms. If you have a fast JTAG probe, you can probably
     // lower this time in order to get faster overall boot times.
     // When using a second Arduino Due, we need more time. 110 ms seems enough.
+    // This busy wait is by far the longest step before USB enumeration, see command "BootTimestamps".
     //
     // If you do not need to debug the firmware from the very beginning, or if you do not place
     // breakpoints somewhere during the initialisation code, then you can disable this busy wait.
-    if ( true )
+    //
+    // The busy wait is skipped if no debugger has enabled halting debug mode (bit C_DEBUGEN in register DHCSR),
+    // so that the board normally enumerates on USB around 120 ms earlier. That bit survives a system reset,
+    // so a debugger that resets the board still gets its pause. Only a power-on reset clears it.
+    // If you need to catch the firmware straight after powering the board on, set the constant below to false.
+    const bool SKIP_BUSY_WAIT_WITHOUT_DEBUGGER = true;
+
+    const bool isDebuggerAttached = 0 != ( CoreDebug->DHCSR & CoreDebug_DHCSR_C_DEBUGEN_Msk );
+
+    if ( isDebuggerAttached || !SKIP_BUSY_WAIT_WITHOUT_DEBUGGER )
     {
       // The watchdog is enabled by default. It runs off the slow clock (32 kHz or 32.768 kHz,
       // depending on where you look in the documentation), divided by 128.
@@ -183,6 +198,7 @@ void BareMetalSupport_Reset_Handler ( void )
 
     InitDataSegments();
 
+    RecordBootTimestamp( bpDataSegmentsReady );
 
     // Set the vector table base address.
     const uint32_t * const pVecSrc = (const uint32_t *) & _sfixed;
@@ -212,6 +228,8 @@ void BareMetalSupport_Reset_Handler ( void )
 
     // From this point on, all C/C++ support has been initialised, and the user code can run.
 
+    RecordBootTimestamp( bpUserCodeStart );
+
     RunUserCode();
 
     TerminateLibc();
@@ -1,6 +1,11 @@
 
 #include <BoardSupport-LM3S6965EVB/AngelInterface.h>  // Include file for this module comes first.
 
+#include <assert.h>
+#include <string.h>
+
+#include <stdexcept>
+
 #include <Misc/AssertionUtils.h>
 
 
@@ -29,6 +34,8 @@ static int CallAngel ( const int operation, const int arg1, const int arg2 ) thr
      // Clobber list
      :  // I do not think that any registers or flags are modified.
         // As an example, we could use "cc", which means "The instruction affects the condition code flags".
+       "memory"  // Many operations take a pointer to a parameter block in R1, and the host reads and writes
+                 // the memory it points to, as well as any data buffers referenced by it.
   );
 
   return result;
@@ -79,3 +86,177 @@ void Angel_ExitAppWithFailureIndication ( void ) throw()
 
   Panic( "Unexpected." );
 }
+
+
+// Most semihosting operations take a pointer to a parameter block in R1.
+
+static int CallAngelWithParamBlock ( const int operation, const uint32_t * const paramBlock ) throw()
+{
+  return CallAngel( operation, int( uintptr_t( paramBlock ) ), 0 );
+}
+
+
+static const int TARGET_SYS_OPEN     = 0x01;
+static const int TARGET_SYS_CLOSE    = 0x02;
+static const int TARGET_SYS_WRITE    = 0x05;
+static const int TARGET_SYS_READ     = 0x06;
+static const int TARGET_SYS_CLOCK    = 0x10;
+static const int TARGET_SYS_ELAPSED  = 0x30;
+static const int TARGET_SYS_TICKFREQ = 0x31;
+
+
+int Angel_OpenFile ( const char * const filename, const AngelFileModeEnum mode ) throw()
+{
+  const uint32_t paramBlock[3] = { uint32_t( uintptr_t( filename ) ),
+                                   uint32_t( mode ),
+                                   uint32_t( strlen( filename ) ) };
+
+  return CallAngelWithParamBlock( TARGET_SYS_OPEN, paramBlock );
+}
+
+
+bool Angel_CloseFile ( const int fileHandle ) throw()
+{
+  const uint32_t paramBlock[1] = { uint32_t( fileHandle ) };
+
+  return 0 == CallAngelWithParamBlock( TARGET_SYS_CLOSE, paramBlock );
+}
+
+
+size_t Angel_WriteToFile ( const int fileHandle, const void * const data, const size_t byteCount ) throw()
+{
+  const uint32_t paramBlock[3] = { uint32_t( fileHandle ),
+                                   uint32_t( uintptr_t( data ) ),
+                                   uint32_t( byteCount ) };
+
+  return size_t( CallAngelWithParamBlock( TARGET_SYS_WRITE, paramBlock ) );
+}
+
+
+size_t Angel_ReadFromFile ( const int fileHandle, void * const data, const size_t byteCount ) throw()
+{
+  const uint32_t paramBlock[3] = { uint32_t( fileHandle ),
+                                   uint32_t( uintptr_t( data ) ),
+                                   uint32_t( byteCount ) };
+
+  return size_t( CallAngelWithParamBlock( TARGET_SYS_READ, paramBlock ) );
+}
+
+
+int32_t Angel_GetClock ( void ) throw()
+{
+  return CallAngel( TARGET_SYS_CLOCK, 0, 0 );
+}
+
+
+bool Angel_GetElapsedTicks ( uint64_t * const tickCount ) throw()
+{
+  // The host writes the 64-bit tick count into the parameter block, least-significant word first.
+  uint32_t paramBlock[2] = { 0, 0 };
+
+  if ( 0 != CallAngelWithParamBlock( TARGET_SYS_ELAPSED, paramBlock ) )
+    return false;
+
+  *tickCount = ( uint64_t( paramBlock[1] ) << 32 ) | paramBlock[0];
+  return true;
+}
+
+
+int32_t Angel_GetTickFrequency ( void ) throw()
+{
+  return CallAngel( TARGET_SYS_TICKFREQ, 0, 0 );
+}
+
+
+void CAngelOutputFile::Open ( const char * const filename, const AngelFileModeEnum mode )
+{
+  assert( !IsOpen() );
+  assert( m_bufferSize != 0 );
+
+  m_fileHandle = Angel_OpenFile( filename, mode );
+
+  if ( m_fileHandle == -1 )
+  {
+    throw std::runtime_error( "Cannot open the host file." );
+  }
+
+  m_bufferedByteCount = 0;
+}
+
+
+void CAngelOutputFile::Flush ( void )
+{
+  assert( IsOpen() );
+
+  if ( m_bufferedByteCount == 0 )
+    return;
+
+  const size_t notWrittenCount = Angel_WriteToFile( m_fileHandle, m_buffer, m_bufferedByteCount );
+
+  m_bufferedByteCount = 0;
+
+  if ( notWrittenCount != 0 )
+  {
+    throw std::runtime_error( "Error writing to the host file." );
+  }
+}
+
+
+void CAngelOutputFile::Write ( const void * const data, const size_t byteCount )
+{
+  assert( IsOpen() );
+
+  const uint8_t * const src = static_cast< const uint8_t * >( data );
+
+  if ( byteCount > m_bufferSize - m_bufferedByteCount )
+  {
+    Flush();
+
+    // A block that would not fit in the buffer anyway is sent straight away, without copying it.
+    if ( byteCount >= m_bufferSize )
+    {
+      if ( 0 != Angel_WriteToFile( m_fileHandle, src, byteCount ) )
+      {
+        throw std::runtime_error( "Error writing to the host file." );
+      }
+
+      return;
+    }
+  }
+
+  memcpy( m_buffer + m_bufferedByteCount, src, byteCount );
+  m_bufferedByteCount += byteCount;
+}
+
+
+void CAngelOutputFile::WriteStr ( const char * const str )
+{
+  Write( str, strlen( str ) );
+}
+
+
+void CAngelOutputFile::Close ( void )
+{
+  assert( IsOpen() );
+
+  // Close the file even if writing the last block fails.
+
+  const bool writeFailed = m_bufferedByteCount != 0 &&
+                           0 != Angel_WriteToFile( m_fileHandle, m_buffer, m_bufferedByteCount );
+
+  m_bufferedByteCount = 0;
+
+  const bool closeFailed = !Angel_CloseFile( m_fileHandle );
+
+  m_fileHandle = -1;
+
+  if ( writeFailed )
+  {
+    throw std::runtime_error( "Error writing to the host file." );
+  }
+
+  if ( closeFailed )
+  {
+    throw std::runtime_error( "Error closing the host file." );
+  }
+}
@@ -1,8 +1,93 @@
-
 #pragma once
 
+#include <stddef.h>  // For size_t.
+#include <stdint.h>
+
 // This module uses the Angel interface for ARM processors.
 // Our main target is Qemu's semihosting.
 
 void Angel_ExitApp                      ( void ) throw() __attribute__ ((__noreturn__));
 void Angel_ExitAppWithFailureIndication ( void ) throw() __attribute__ ((__noreturn__));
+
+
+// ------ File access on the host ------
+//
+// Relative paths are relative to the host's current directory when Qemu was started.
+//
+// Each call transfers a whole block with a single semihosting trap, which is much faster
+// than writing the same data character by character to the emulated UART.
+
+enum AngelFileModeEnum
+{
+  // These values match the fopen() mode strings in the semihosting specification.
+  afmReadBinary   = 1,   // "rb"
+  afmWriteBinary  = 5,   // "wb", truncates or creates the file.
+  afmAppendBinary = 9    // "ab"
+};
+
+// Returns a non-negative file handle, or -1 on error.
+int Angel_OpenFile ( const char * filename, AngelFileModeEnum mode ) throw();
+
+// Returns false on error.
+bool Angel_CloseFile ( int fileHandle ) throw();
+
+// Returns the number of bytes that were NOT written, so 0 means success.
+size_t Angel_WriteToFile ( int fileHandle, const void * data, size_t byteCount ) throw();
+
+// Returns the number of bytes that were NOT read. A value equal to byteCount means end of file.
+size_t Angel_ReadFromFile ( int fileHandle, void * data, size_t byteCount ) throw();
+
+
+// ------ Time on the host ------
+
+// Returns the number of centiseconds since the simulation started, or -1 on error.
+int32_t Angel_GetClock ( void ) throw();
+
+// Returns the number of elapsed ticks since the simulation started, see Angel_GetTickFrequency().
+// Returns false on error.
+bool Angel_GetElapsedTicks ( uint64_t * tickCount ) throw();
+
+// Returns the number of ticks per second reported by Angel_GetElapsedTicks(), or -1 on error.
+int32_t Angel_GetTickFrequency ( void ) throw();
+
+
+// Buffers the data written and sends it to a host file in large blocks.
+// The buffer is passed in by the caller, because the stack is normally too small for it.
+// Errors throw std::runtime_error.
+
+class CAngelOutputFile
+{
+private:
+  uint8_t * const m_buffer;
+  const size_t m_bufferSize;
+  size_t m_bufferedByteCount;
+  int m_fileHandle;
+
+public:
+
+  CAngelOutputFile ( uint8_t * const buffer, const size_t bufferSize ) throw()
+    : m_buffer( buffer )
+    , m_bufferSize( bufferSize )
+    , m_bufferedByteCount( 0 )
+    , m_fileHandle( -1 )
+  {
+  }
+
+  // Note that the destructor does not close the file, because it cannot report errors.
+  // Call Close() beforehand.
+
+  bool IsOpen ( void ) const throw()
+  {
+    return m_fileHandle != -1;
+  }
+
+  void Open ( const char * filename, AngelFileModeEnum mode );
+
+  void Write ( const void * data, size_t byteCount );
+
+  void WriteStr ( const char * str );
+
+  void Flush ( void );
+
+  void Close ( void );
+};
@@ -72,4 +72,12 @@ static const void * ExceptionTable[] =
   (void *) 0,  // Reserved.
   (void *) PendSV_Handler,
   (void *) SysTick_Handler,
+
+  // Device-specific interrupts.
+  (void *) GPIOPortA_Handler,  // IRQ 0
+  (void *) GPIOPortB_Handler,
+  (void *) GPIOPortC_Handler,
+  (void *) GPIOPortD_Handler,
+  (void *) GPIOPortE_Handler,
+  (void *) UART0_Handler,      // IRQ 5
 };
@@ -10,3 +10,12 @@ extern "C" void SVC_Handler        ( void );
 extern "C" void DebugMon_Handler   ( void );
 extern "C" void PendSV_Handler     ( void );
 extern "C" void SysTick_Handler    ( void );
+
+// Device-specific interrupts. Only the first few ones are listed here,
+// because the vector table in BoardInit.cpp only extends as far as we need.
+extern "C" void GPIOPortA_Handler  ( void );
+extern "C" void GPIOPortB_Handler  ( void );
+extern "C" void GPIOPortC_Handler  ( void );
+extern "C" void GPIOPortD_Handler  ( void );
+extern "C" void GPIOPortE_Handler  ( void );
+extern "C" void UART0_Handler      ( void );
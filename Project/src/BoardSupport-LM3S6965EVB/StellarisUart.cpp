@@ -0,0 +1,424 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "StellarisUart.h"  // The include file for this module should come first.
+
+#include <assert.h>
+#include <string.h>
+
+#include <Misc/AssertionUtils.h>
+
+#include <BareMetalSupport/SerialPortAsyncTx.h>
+#include <BareMetalSupport/CircularBuffer.h>
+
+#include <BoardSupport-LM3S6965EVB/ExceptionHandlers.h>
+
+
+// We do not use the CMSIS or the Stellaris driver library yet, so we have not got the definitions for the UART registers.
+// The Stellaris UART is very similar to the ARM PrimeCell UART (PL011).
+
+static const uintptr_t UART0_BASE = 0x4000C000;
+
+static volatile uint32_t * const UART0_DR   = (uint32_t *) ( UART0_BASE + 0x000 );  // Data.
+static volatile uint32_t * const UART0_RSR  = (uint32_t *) ( UART0_BASE + 0x004 );  // Receive Status / Error Clear.
+static volatile uint32_t * const UART0_FR   = (uint32_t *) ( UART0_BASE + 0x018 );  // Flags.
+static volatile uint32_t * const UART0_LCRH = (uint32_t *) ( UART0_BASE + 0x02C );  // Line Control.
+static volatile uint32_t * const UART0_CTL  = (uint32_t *) ( UART0_BASE + 0x030 );  // Control.
+static volatile uint32_t * const UART0_IFLS = (uint32_t *) ( UART0_BASE + 0x034 );  // Interrupt FIFO Level Select.
+static volatile uint32_t * const UART0_IM   = (uint32_t *) ( UART0_BASE + 0x038 );  // Interrupt Mask.
+static volatile uint32_t * const UART0_MIS  = (uint32_t *) ( UART0_BASE + 0x040 );  // Masked Interrupt Status.
+static volatile uint32_t * const UART0_ICR  = (uint32_t *) ( UART0_BASE + 0x044 );  // Interrupt Clear.
+
+static const uint32_t UART_DR_FE = 1 << 8;   // Framing error.
+static const uint32_t UART_DR_OE = 1 << 11;  // Overrun error.
+
+static const uint32_t UART_FR_RXFE = 1 << 4;  // Rx FIFO empty.
+static const uint32_t UART_FR_TXFF = 1 << 5;  // Tx FIFO full.
+
+static const uint32_t UART_LCRH_FEN    = 1 << 4;  // Enable the FIFOs.
+static const uint32_t UART_LCRH_WLEN_8 = 3 << 5;  // 8 data bits.
+
+static const uint32_t UART_CTL_UARTEN = 1 << 0;
+static const uint32_t UART_CTL_TXE    = 1 << 8;
+static const uint32_t UART_CTL_RXE    = 1 << 9;
+
+// Interrupt bits, the same for registers IM, MIS and ICR.
+static const uint32_t UART_INT_RX = 1 << 4;   // The Rx FIFO reached its trigger level.
+static const uint32_t UART_INT_TX = 1 << 5;   // The Tx FIFO dropped below its trigger level.
+static const uint32_t UART_INT_RT = 1 << 6;   // Rx timeout: there is data in the Rx FIFO, but it has not reached its trigger level.
+static const uint32_t UART_INT_FE = 1 << 7;
+static const uint32_t UART_INT_OE = 1 << 10;
+
+// Interrupt at 1/8 full for Tx and at 1/2 full for Rx. Tx wants to refill early,
+// and Rx can rely on the receive timeout interrupt for the last few characters.
+static const uint32_t UART_IFLS_TX_1_8 = 0 << 0;
+static const uint32_t UART_IFLS_RX_4_8 = 2 << 3;
+
+static const unsigned UART0_IRQ_NUMBER = 5;
+
+static volatile uint32_t * const NVIC_ISER0 = (uint32_t *) 0xE000E100;  // Interrupt Set-Enable, IRQs 0 to 31.
+
+
+// The ASF routines in BareMetalSupport/Miscellaneous.h are not available for this board,
+// so this is a minimal version of CAutoDisableInterrupts.
+
+class CAutoDisableUartInterrupts
+{
+  uint32_t m_primask;
+
+public:
+
+  CAutoDisableUartInterrupts ( void ) throw()
+  {
+    __asm__ volatile( "mrs %[primask], primask\n"
+                      "cpsid i"
+                      // output operand list
+                      : [primask] "=&r" (m_primask)
+                      // input operand list
+                      :
+                      // clobber list
+                      : "memory" );
+  }
+
+  ~CAutoDisableUartInterrupts ( void ) throw()
+  {
+    __asm__ volatile( "msr primask, %[primask]"
+                      // output operand list
+                      :
+                      // input operand list
+                      : [primask] "r" (m_primask)
+                      // clobber list
+                      : "memory" );
+  }
+};
+
+
+// The clobber list in CAutoDisableUartInterrupts already acts as a memory barrier,
+// which compensates for the lack of 'volatile' in the circular buffers below.
+
+#define SERIAL_PORT_TX_BUFFER_SIZE 4096
+#define SERIAL_PORT_RX_BUFFER_SIZE 256
+
+// If the buffer overflows, the user will get a warning message. Wait until the buffer is
+// half empty before restarting normal behaviour, otherwise the user may get many
+// such messages in a row.
+#define OVERFLOW_REARM_THRESHOLD ( SERIAL_PORT_TX_BUFFER_SIZE / 2 )
+
+typedef CCircularBuffer< char   , uint32_t, SERIAL_PORT_TX_BUFFER_SIZE > CSerialPortTxBuffer;
+typedef CCircularBuffer< uint8_t, uint32_t, SERIAL_PORT_RX_BUFFER_SIZE > CSerialPortRxBuffer;
+
+static CSerialPortTxBuffer s_serialPortTxBuffer;
+static CSerialPortRxBuffer s_serialPortRxBuffer;
+
+static const unsigned MAX_EOL_LEN = 2;
+static const char * s_eol = nullptr;
+
+static const char OVERFLOW_MSG[] = "[Some output is missing here due to serial port Tx buffer overflow]";
+static const size_t OVERFLOW_MSG_LEN = sizeof(OVERFLOW_MSG) - 1;
+
+static volatile bool s_txBufferOverflowMode = false;
+static volatile bool s_hasDataBeenSentSinceLastCall = false;
+
+static volatile bool s_uartOverrun = false;
+static volatile bool s_uartFrameErr = false;
+static volatile bool s_rxBufferOverrun = false;
+
+static bool s_wasUartInitialised = false;
+
+
+void InitStellarisUart ( void ) throw()
+{
+  assert( !s_wasUartInitialised );
+
+  // This only works under Qemu. On the real hardware, we would have to enable the UART and GPIO clocks,
+  // route the pins and set the baud rate beforehand.
+
+  *UART0_CTL  = 0;
+  *UART0_LCRH = UART_LCRH_FEN | UART_LCRH_WLEN_8;
+  *UART0_IFLS = UART_IFLS_TX_1_8 | UART_IFLS_RX_4_8;
+  *UART0_ICR  = 0xFFFFFFFF;
+  *UART0_RSR  = 0;  // Any write clears the error flags.
+
+  // The Tx interrupt is only enabled while there is data left in the Tx buffer.
+  *UART0_IM   = UART_INT_RX | UART_INT_RT | UART_INT_FE | UART_INT_OE;
+
+  *UART0_CTL  = UART_CTL_UARTEN | UART_CTL_TXE | UART_CTL_RXE;
+
+  s_wasUartInitialised = true;
+
+  *NVIC_ISER0 = 1 << UART0_IRQ_NUMBER;
+}
+
+
+static void EnableTxInterrupt ( void ) throw()
+{
+  *UART0_IM |= UART_INT_TX;
+}
+
+static void DisableTxInterrupt ( void ) throw()
+{
+  *UART0_IM &= ~UART_INT_TX;
+}
+
+#ifndef NDEBUG
+static bool IsTxInterruptEnabled ( void ) throw()
+{
+  return 0 != ( *UART0_IM & UART_INT_TX );
+}
+#endif
+
+
+// Moves as many characters as possible from the Tx buffer to the Tx FIFO.
+// Interrupts must be disabled.
+
+static void FillTxFifo ( void ) throw()
+{
+  while ( !s_serialPortTxBuffer.IsEmpty() && 0 == ( *UART0_FR & UART_FR_TXFF ) )
+  {
+    *UART0_DR = uint8_t( s_serialPortTxBuffer.ReadElement() );
+  }
+}
+
+
+void InitSerialPortAsyncTx ( const char * const eol )
+{
+  assert( s_wasUartInitialised );
+
+  assert( eol != nullptr );
+  assert( s_eol == nullptr );
+
+  assert( strlen(eol) > 0 );
+  assert( strlen(eol) <= MAX_EOL_LEN );
+
+  s_eol = eol;
+}
+
+
+const char * GetSerialPortEol ( void ) throw()
+{
+  assert( s_eol != nullptr );
+  return s_eol;
+}
+
+
+// See the Arduino Due version of this routine about how reliable this flag is.
+
+bool HasSerialPortDataBeenSentSinceLastCall ( void ) throw()
+{
+  const bool ret = s_hasDataBeenSentSinceLastCall;
+
+  s_hasDataBeenSentSinceLastCall = false;
+
+  return ret;
+}
+
+
+void SendSerialPortAsyncData ( const char * const data, const size_t dataLen )
+{
+  // WARNING: This routine blocks interrupts for some time.
+  // WARNING: This routine may be called in interrupt context.
+
+  assert( s_eol != nullptr );
+
+  if ( dataLen == 0 )
+  {
+    // This could happen, but is unusual.
+    assert( false );
+    return;
+  }
+
+  s_hasDataBeenSentSinceLastCall = true;
+
+  CAutoDisableUartInterrupts autoDisableInterrupts;
+
+  if ( s_txBufferOverflowMode )
+    return;
+
+  const uint32_t freeCount = s_serialPortTxBuffer.GetFreeCount();
+  size_t dataLenToUse;
+
+  if ( dataLen <= freeCount )
+  {
+    dataLenToUse = dataLen;
+  }
+  else
+  {
+    dataLenToUse = freeCount;
+
+    s_txBufferOverflowMode = true;
+
+    if ( dataLenToUse == 0 )
+      return;
+  }
+
+  const bool wasEmpty = s_serialPortTxBuffer.IsEmpty();
+
+  s_serialPortTxBuffer.WriteElemArray( data, dataLenToUse );
+
+  // If the Tx buffer was empty, the Tx interrupt is disabled, so nobody else is filling the FIFO.
+  // Prime the Tx FIFO now. The Tx interrupt only triggers when the FIFO level drops,
+  // so it would never come if the FIFO were left empty.
+
+  if ( wasEmpty )
+  {
+    assert( !IsTxInterruptEnabled() );
+
+    FillTxFifo();
+
+    if ( !s_serialPortTxBuffer.IsEmpty() )
+      EnableTxInterrupt();
+  }
+  else
+  {
+    assert( IsTxInterruptEnabled() );
+  }
+}
+
+
+void SerialPortAsyncTxInterruptHandler ( void ) throw()
+{
+  // WARNING: This routine is always called in interrupt context.
+
+  CAutoDisableUartInterrupts autoDisableInterrupts;
+
+  *UART0_ICR = UART_INT_TX;
+
+  if ( s_serialPortTxBuffer.IsEmpty() )
+  {
+    assert( !IsTxInterruptEnabled() );
+    return;
+  }
+
+  FillTxFifo();
+
+  if ( s_serialPortTxBuffer.IsEmpty() )
+  {
+    DisableTxInterrupt();
+  }
+
+  if ( s_txBufferOverflowMode && s_serialPortTxBuffer.GetFreeCount() >= OVERFLOW_REARM_THRESHOLD )
+  {
+    STATIC_ASSERT( OVERFLOW_REARM_THRESHOLD > OVERFLOW_MSG_LEN + 2 * MAX_EOL_LEN, "The threshold is too low." );
+
+    const bool wasEmpty = s_serialPortTxBuffer.IsEmpty();
+
+    const size_t eolLen = strlen( s_eol );
+    s_serialPortTxBuffer.WriteElemArray( s_eol, eolLen );
+    s_serialPortTxBuffer.WriteElemArray( OVERFLOW_MSG, OVERFLOW_MSG_LEN );
+    s_serialPortTxBuffer.WriteElemArray( s_eol, eolLen );
+    s_txBufferOverflowMode = false;
+
+    if ( wasEmpty )
+    {
+      FillTxFifo();
+      EnableTxInterrupt();
+    }
+  }
+}
+
+
+bool IsStellarisUartTxBufferEmpty ( void ) throw()
+{
+  CAutoDisableUartInterrupts autoDisableInterrupts;
+
+  return s_serialPortTxBuffer.IsEmpty();
+}
+
+
+static void SerialPortRxInterruptHandler ( void ) throw()
+{
+  // Drain the whole Rx FIFO, so that the receive timeout interrupt does not trigger again straight away.
+
+  while ( 0 == ( *UART0_FR & UART_FR_RXFE ) )
+  {
+    const uint32_t dr = *UART0_DR;
+
+    if ( dr & UART_DR_OE )
+      s_uartOverrun = true;
+
+    if ( dr & UART_DR_FE )
+      s_uartFrameErr = true;
+
+    CAutoDisableUartInterrupts autoDisableInterrupts;
+
+    if ( s_serialPortRxBuffer.IsFull() )
+    {
+      s_rxBufferOverrun = true;
+    }
+    else
+    {
+      s_serialPortRxBuffer.WriteElem( uint8_t( dr ) );
+    }
+  }
+
+  *UART0_ICR = UART_INT_RX | UART_INT_RT | UART_INT_FE | UART_INT_OE;
+}
+
+
+bool ReadStellarisUartRxChar ( uint8_t * const c ) throw()
+{
+  CAutoDisableUartInterrupts autoDisableInterrupts;
+
+  if ( s_serialPortRxBuffer.IsEmpty() )
+    return false;
+
+  *c = s_serialPortRxBuffer.ReadElement();
+  return true;
+}
+
+
+bool IsStellarisUartRxBufferEmpty ( void ) throw()
+{
+  CAutoDisableUartInterrupts autoDisableInterrupts;
+
+  return s_serialPortRxBuffer.IsEmpty();
+}
+
+
+static bool FetchAndClearFlag ( volatile bool * const flag ) throw()
+{
+  CAutoDisableUartInterrupts autoDisableInterrupts;
+
+  const bool ret = *flag;
+  *flag = false;
+  return ret;
+}
+
+bool HasStellarisUartRxOverrunOccurred ( void ) throw()
+{
+  return FetchAndClearFlag( &s_uartOverrun );
+}
+
+bool HasStellarisUartRxFrameErrorOccurred ( void ) throw()
+{
+  return FetchAndClearFlag( &s_uartFrameErr );
+}
+
+bool HasStellarisUartRxBufferOverrunOccurred ( void ) throw()
+{
+  return FetchAndClearFlag( &s_rxBufferOverrun );
+}
+
+
+void UART0_Handler ( void )
+{
+  const uint32_t status = *UART0_MIS;
+
+  if ( status & ( UART_INT_RX | UART_INT_RT | UART_INT_FE | UART_INT_OE ) )
+    SerialPortRxInterruptHandler();
+
+  if ( status & UART_INT_TX )
+    SerialPortAsyncTxInterruptHandler();
+}
@@ -0,0 +1,43 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+#include <stdint.h>
+
+// Interrupt-driven driver for UART0 on the Stellaris LM3S6965EVB, which uses the Tx and Rx FIFOs.
+//
+// This module implements the interface in BareMetalSupport/SerialPortAsyncTx.h for this board,
+// so that SerialPrint.cpp and the consoles built on it work unchanged. The Rx side stores
+// the incoming characters in a circular buffer, to be collected later on from the main loop.
+//
+// Call InitStellarisUart() first, and then InitSerialPortAsyncTx() as usual.
+//
+// The synchronous routines in DebugConsoleSupport.cpp write to the same UART. Mixing both
+// is safe, but the output may be interleaved.
+
+void InitStellarisUart ( void ) throw();
+
+// Returns false if there is no received character available.
+bool ReadStellarisUartRxChar ( uint8_t * c ) throw();
+
+bool IsStellarisUartRxBufferEmpty ( void ) throw();
+
+// These routines return whether the error happened since the last call.
+bool HasStellarisUartRxOverrunOccurred       ( void ) throw();  // Data lost in the UART itself.
+bool HasStellarisUartRxFrameErrorOccurred    ( void ) throw();
+bool HasStellarisUartRxBufferOverrunOccurred ( void ) throw();  // Data lost because the Rx buffer was full.
+
+// Returns true if all data in the Tx buffer has been passed to the UART.
+bool IsStellarisUartTxBufferEmpty ( void ) throw();
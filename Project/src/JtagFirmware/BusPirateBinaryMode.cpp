@@ -17,13 +17,22 @@
 #include "BusPirateBinaryMode.h"  // The include file for this module should come first.
 
 #include <assert.h>
+#include <string.h>
+#include <inttypes.h>
 #include <stdexcept>
 
+#include <BareMetalSupport/SerialPrint.h>
 #include <BareMetalSupport/Miscellaneous.h>
 #include <BareMetalSupport/IoUtils.h>
+#include <BareMetalSupport/Crc32.h>
+#include <BareMetalSupport/CycleCounter.h>
 #include <Misc/AssertionUtils.h>
 
 #include "BusPirateConnection.h"
+#include "BusPirateSpiMode.h"
+#include "BusPirateSvfMode.h"
+#include "BusPirateLogicMode.h"
+#include "Globals.h"
 
 
 #ifndef NDEBUG
@@ -31,43 +40,341 @@
 #endif
 
 
+// A memory transfer can be much bigger than the USB buffers, so it is processed in chunks
+// over several main loop iterations.
+
+enum MemoryTransferStateEnum
+{
+  mtsIdle,
+  mtsReading,  // Sending the memory contents to the host.
+  mtsWriting   // Receiving the memory contents from the host.
+};
+
+static MemoryTransferStateEnum s_memoryTransferState;
+static uint8_t * s_memoryTransferAddr;
+static uint32_t  s_memoryTransferRemainingByteCount;
+static uint32_t  s_memoryTransferCrc;
+
+static const uint32_t MEMORY_TRANSFER_CMD_LEN = 1 + 4 + 4;
+static const uint32_t CRC_LEN = 4;
+
+
 static void SendBinaryModeWelcome ( CUsbTxBuffer * const txBuffer )
 {
   UsbPrintStr( txBuffer, "BBIO1" );
 }
 
 
-void BusPirateBinaryMode_ProcessData ( CUsbRxBuffer * const rxBuffer, CUsbTxBuffer * const txBuffer )
+static uint32_t ReadBigEndianUint32 ( const uint8_t * const data ) throw()
 {
-  assert( s_wasInitialised );
+  return ( uint32_t( data[0] ) << 24 ) |
+         ( uint32_t( data[1] ) << 16 ) |
+         ( uint32_t( data[2] ) <<  8 ) |
+         ( uint32_t( data[3] )       );
+}
+
+
+static void WriteBigEndianUint32 ( CUsbTxBuffer * const txBuffer, const uint32_t val )
+{
+  assert( txBuffer->GetFreeCount() >= 4 );
+
+  txBuffer->WriteElem( uint8_t( val >> 24 ) );
+  txBuffer->WriteElem( uint8_t( val >> 16 ) );
+  txBuffer->WriteElem( uint8_t( val >>  8 ) );
+  txBuffer->WriteElem( uint8_t( val       ) );
+}
+
+
+// The command table below guarantees that the whole command is available
+// and that there is enough space in the Tx Buffer for the reply code.
+
+static bool StartMemoryTransfer ( const uint8_t * const cmdData, CUsbTxBuffer * const txBuffer )
+{
+  assert( s_memoryTransferState == mtsIdle );
+
+  const uint32_t addr      = ReadBigEndianUint32( &cmdData[ 1 ] );
+  const uint32_t byteCount = ReadBigEndianUint32( &cmdData[ 5 ] );
+
+  if ( false )
+  {
+    SerialPrintf( "Memory transfer command 0x%02X, addr 0x%08" PRIX32 ", byte count %" PRIu32 "." EOL,
+                  cmdData[0], addr, byteCount );
+  }
+
+  s_memoryTransferAddr = (uint8_t *) uintptr_t( addr );
+  s_memoryTransferRemainingByteCount = byteCount;
+  s_memoryTransferCrc = CRC32_INITIAL_VALUE;
+
+  if ( cmdData[0] == BIN_CMD_MEMORY_READ )
+  {
+    txBuffer->WriteElem( 0x01 );
+    s_memoryTransferState = mtsReading;
+  }
+  else
+  {
+    assert( cmdData[0] == BIN_CMD_MEMORY_WRITE );
+    s_memoryTransferState = mtsWriting;
+  }
+
+  return true;
+}
+
+
+// Fills the Tx Buffer directly from memory, without any intermediate copies.
+// The USB connection wakes the main loop up whenever some data has been sent,
+// so this routine will be called again as soon as there is more space in the Tx Buffer.
+
+static void ContinueMemoryRead ( CUsbTxBuffer * const txBuffer )
+{
+  assert( s_memoryTransferState == mtsReading );
+
+  while ( s_memoryTransferRemainingByteCount != 0 )
+  {
+    uint32_t freeCount;
+    uint8_t * const writePtr = txBuffer->GetWritePtr( &freeCount );
 
-  // Speed is not important here (yet), so we favor simplicity. We only process one byte at a time,
-  // otherwise we would have to worry about whether there is enough space in the tx buffer
-  // for the next command reply.
+    if ( freeCount == 0 )
+      return;
 
-  if ( rxBuffer->IsEmpty() || !txBuffer->IsEmpty() )
+    const uint32_t chunkLen = MinFrom( freeCount, s_memoryTransferRemainingByteCount );
+
+    memcpy( writePtr, s_memoryTransferAddr, chunkLen );
+
+    s_memoryTransferCrc = UpdateCrc32( s_memoryTransferCrc, writePtr, chunkLen );
+
+    txBuffer->CommitWrittenElements( chunkLen );
+
+    s_memoryTransferAddr += chunkLen;
+    s_memoryTransferRemainingByteCount -= chunkLen;
+  }
+
+  if ( txBuffer->GetFreeCount() < CRC_LEN )
     return;
 
-  const uint8_t byte = rxBuffer->ReadElement();
+  WriteBigEndianUint32( txBuffer, s_memoryTransferCrc );
+
+  s_memoryTransferState = mtsIdle;
+}
+
 
-  switch ( byte )
+static void ContinueMemoryWrite ( CUsbRxBuffer * const rxBuffer, CUsbTxBuffer * const txBuffer )
+{
+  assert( s_memoryTransferState == mtsWriting );
+
+  while ( s_memoryTransferRemainingByteCount != 0 )
   {
-  case BIN_MODE_CHAR:
-    SendBinaryModeWelcome( txBuffer );
-    break;
-
-  case OOCD_MODE_CHAR:
-    ChangeBusPirateMode( bpOpenOcdMode, txBuffer );
-    break;
-
-  case 0x0F:
-    ChangeBusPirateMode( bpConsoleMode, txBuffer );
-    break;
-
-  default:
-    // The protocol does not allow for any better error indication.
-    SendBinaryModeWelcome( txBuffer );
-    break;
+    uint32_t availableCount;
+    const uint8_t * const readPtr = rxBuffer->GetReadPtr( &availableCount );
+
+    if ( availableCount == 0 )
+      return;
+
+    const uint32_t chunkLen = MinFrom( availableCount, s_memoryTransferRemainingByteCount );
+
+    s_memoryTransferCrc = UpdateCrc32( s_memoryTransferCrc, readPtr, chunkLen );
+
+    memcpy( s_memoryTransferAddr, readPtr, chunkLen );
+
+    rxBuffer->ConsumeReadElements( chunkLen );
+
+    s_memoryTransferAddr += chunkLen;
+    s_memoryTransferRemainingByteCount -= chunkLen;
+  }
+
+  const uint32_t REPLY_LEN = 1 + CRC_LEN;
+
+  if ( rxBuffer->GetElemCount() < CRC_LEN || txBuffer->GetFreeCount() < REPLY_LEN )
+    return;
+
+  uint8_t receivedCrc[ CRC_LEN ];
+  rxBuffer->PeekMultipleElements( CRC_LEN, receivedCrc );
+  rxBuffer->ConsumeReadElements( CRC_LEN );
+
+  const bool isCrcCorrect = ReadBigEndianUint32( receivedCrc ) == s_memoryTransferCrc;
+
+  txBuffer->WriteElem( isCrcCorrect ? 0x01 : 0x00 );
+  WriteBigEndianUint32( txBuffer, s_memoryTransferCrc );
+
+  s_memoryTransferState = mtsIdle;
+}
+
+
+static bool HandleBinModeChar ( const uint8_t * const cmdData, CUsbTxBuffer * const txBuffer )
+{
+  UNUSED_ALWAYS( cmdData );
+  SendBinaryModeWelcome( txBuffer );
+  return true;
+}
+
+
+static bool HandleUnknownCommand ( const uint8_t * const cmdData, CUsbTxBuffer * const txBuffer )
+{
+  UNUSED_ALWAYS( cmdData );
+
+  // The protocol does not allow for any better error indication.
+  SendBinaryModeWelcome( txBuffer );
+  return true;
+}
+
+
+// After changing modes, this mode is no longer active, so the mode change handlers return false
+// in order to stop processing any further data here.
+
+static bool EnterSpiMode ( const uint8_t * const cmdData, CUsbTxBuffer * const txBuffer )
+{
+  UNUSED_ALWAYS( cmdData );
+  ChangeBusPirateMode( bpSpiMode, txBuffer );
+  return false;
+}
+
+
+static bool EnterSvfMode ( const uint8_t * const cmdData, CUsbTxBuffer * const txBuffer )
+{
+  UNUSED_ALWAYS( cmdData );
+  ChangeBusPirateMode( bpSvfMode, txBuffer );
+  return false;
+}
+
+
+static bool EnterLogicMode ( const uint8_t * const cmdData, CUsbTxBuffer * const txBuffer )
+{
+  UNUSED_ALWAYS( cmdData );
+  ChangeBusPirateMode( bpLogicMode, txBuffer );
+  return false;
+}
+
+
+static bool EnterOpenOcdMode ( const uint8_t * const cmdData, CUsbTxBuffer * const txBuffer )
+{
+  UNUSED_ALWAYS( cmdData );
+  ChangeBusPirateMode( bpOpenOcdMode, txBuffer );
+  return false;
+}
+
+
+static bool EnterConsoleMode ( const uint8_t * const cmdData, CUsbTxBuffer * const txBuffer )
+{
+  UNUSED_ALWAYS( cmdData );
+  ChangeBusPirateMode( bpConsoleMode, txBuffer );
+  return false;
+}
+
+
+// Each command declares how many bytes it needs in the Rx Buffer and in the Tx Buffer,
+// so that the command loop can decide whether the next command can be processed straight away
+// without having to wait until the Tx Buffer is completely empty.
+
+typedef bool (* BinaryModeCmdHandler) ( const uint8_t * cmdData, CUsbTxBuffer * txBuffer );
+
+struct BinaryModeCmdInfo
+{
+  uint8_t cmdCode;
+  uint8_t requestLen;   // Including the command code.
+  uint8_t replyLen;     // Space needed in the Tx Buffer for the immediate reply. Data streamed afterwards does not count.
+  bool    changesMode;  // Mode changes need an empty Tx Buffer, see ChangeBusPirateMode().
+  BinaryModeCmdHandler handler;
+};
+
+static const uint8_t BIN_MODE_WELCOME_LEN = 5;  // "BBIO1"
+
+static const BinaryModeCmdInfo BINARY_MODE_COMMANDS[] =
+{
+  { BIN_MODE_CHAR        , 1                      , BIN_MODE_WELCOME_LEN, false, &HandleBinModeChar   },
+  { BIN_CMD_SPI_MODE     , 1                      , 0                   , true , &EnterSpiMode        },
+  { OOCD_MODE_CHAR       , 1                      , 0                   , true , &EnterOpenOcdMode    },
+  { BIN_CMD_SVF_MODE     , 1                      , 0                   , true , &EnterSvfMode        },
+  { BIN_CMD_LOGIC_MODE   , 1                      , 0                   , true , &EnterLogicMode      },
+  { 0x0F                 , 1                      , 0                   , true , &EnterConsoleMode    },
+  { BIN_CMD_MEMORY_READ  , MEMORY_TRANSFER_CMD_LEN, 1                   , false, &StartMemoryTransfer },
+  { BIN_CMD_MEMORY_WRITE , MEMORY_TRANSFER_CMD_LEN, 0                   , false, &StartMemoryTransfer },
+};
+
+static const BinaryModeCmdInfo UNKNOWN_COMMAND = { 0, 1, BIN_MODE_WELCOME_LEN, false, &HandleUnknownCommand };
+
+static const uint32_t MAX_REQUEST_LEN = MEMORY_TRANSFER_CMD_LEN;
+
+
+static const BinaryModeCmdInfo * LookUpCommand ( const uint8_t cmdCode ) throw()
+{
+  for ( size_t i = 0; i < sizeof( BINARY_MODE_COMMANDS ) / sizeof( BINARY_MODE_COMMANDS[0] ); ++i )
+  {
+    if ( BINARY_MODE_COMMANDS[ i ].cmdCode == cmdCode )
+      return &BINARY_MODE_COMMANDS[ i ];
+  }
+
+  return &UNKNOWN_COMMAND;
+}
+
+
+// Returns true if a command was processed and there may be more to process straight away.
+
+static bool ProcessCommand ( CUsbRxBuffer * const rxBuffer, CUsbTxBuffer * const txBuffer )
+{
+  assert( s_memoryTransferState == mtsIdle );
+
+  if ( rxBuffer->IsEmpty() )
+    return false;
+
+  const BinaryModeCmdInfo * const cmdInfo = LookUpCommand( *rxBuffer->PeekElement() );
+
+  assert( cmdInfo->requestLen <= MAX_REQUEST_LEN );
+
+  if ( rxBuffer->GetElemCount() < cmdInfo->requestLen )
+    return false;
+
+  if ( cmdInfo->changesMode ? !txBuffer->IsEmpty()
+                            : txBuffer->GetFreeCount() < cmdInfo->replyLen )
+  {
+    return false;
+  }
+
+  uint8_t cmdData[ MAX_REQUEST_LEN ];
+  rxBuffer->PeekMultipleElements( cmdInfo->requestLen, cmdData );
+  rxBuffer->ConsumeReadElements( cmdInfo->requestLen );
+
+  return cmdInfo->handler( cmdData, txBuffer );
+}
+
+
+// Host tools may pipeline binary mode commands, so process as many as possible in one go,
+// within the main loop time budget, see MAIN_LOOP_TIME_BUDGET_US.
+// Memory transfers are limited by the USB buffer sizes anyway.
+
+void BusPirateBinaryMode_ProcessData ( CUsbRxBuffer * const rxBuffer, CUsbTxBuffer * const txBuffer )
+{
+  assert( s_wasInitialised );
+
+  const uint32_t startTime = GetCycleCount();
+
+  for ( ; ; )
+  {
+    switch ( s_memoryTransferState )
+    {
+    case mtsIdle:
+      break;
+
+    case mtsReading:
+      ContinueMemoryRead( txBuffer );
+      break;
+
+    case mtsWriting:
+      ContinueMemoryWrite( rxBuffer, txBuffer );
+      break;
+
+    default:
+      assert( false );
+      break;
+    }
+
+    // If a memory transfer is still in progress, it is waiting for more data or for more space.
+    if ( s_memoryTransferState != mtsIdle )
+      break;
+
+    if ( !ProcessCommand( rxBuffer, txBuffer ) )
+      break;
+
+    if ( HasMainLoopTimeBudgetExpired( startTime ) )
+      break;
   }
 }
 
@@ -80,6 +387,8 @@ void BusPirateBinaryMode_Init ( CUsbTxBuffer * const txBuffer )
     s_wasInitialised = true;
   #endif
 
+  s_memoryTransferState = mtsIdle;
+
   // Note that there is an error path that might land here with a non-empty Tx Buffer.
   SendBinaryModeWelcome( txBuffer );
 }
@@ -5,6 +5,26 @@
 #define BIN_MODE_CHAR  (uint8_t( 0x00 ))
 #define OOCD_MODE_CHAR (uint8_t( 0x06 ))
 
+// These binary mode commands transfer raw memory contents at full USB speed, which is much faster
+// than the console's PrintMemory command. All multi-byte values are big endian.
+//
+// Memory read request:   0x30, address (4 bytes), byte count (4 bytes)
+//             reply:     0x01, data (byte count bytes), CRC-32 of the data (4 bytes)
+//
+// Memory write request:  0x31, address (4 bytes), byte count (4 bytes), data (byte count bytes), CRC-32 of the data (4 bytes)
+//              reply:    0x01 if the CRC matches or 0x00 otherwise, CRC-32 of the data actually received (4 bytes)
+//
+// The CRC-32 is the standard one, see Crc32.h . The data is written to memory as it arrives,
+// so a CRC mismatch does not prevent the memory contents from being modified.
+// The firmware does not check whether the address range is valid. Accessing invalid addresses
+// will trigger a CPU exception, just like the console's PrintMemory command does.
+
+// Host tools can pipeline binary mode commands, that is, send several commands without waiting
+// for each reply. The firmware processes as many commands as fit in the USB buffers in one go.
+
+#define BIN_CMD_MEMORY_READ   (uint8_t( 0x30 ))
+#define BIN_CMD_MEMORY_WRITE  (uint8_t( 0x31 ))
+
 void BusPirateBinaryMode_Init ( CUsbTxBuffer * txBuffer );
 void BusPirateBinaryMode_Terminate ( void );
 void BusPirateBinaryMode_ProcessData ( CUsbRxBuffer * rxBuffer, CUsbTxBuffer * txBuffer );
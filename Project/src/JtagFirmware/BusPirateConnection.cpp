@@ -18,10 +18,15 @@
 
 #include <BareMetalSupport/MainLoopSleep.h>
 #include <BareMetalSupport/SerialPrint.h>
+#include <BareMetalSupport/CycleCounter.h>
+#include <BareMetalSupport/SysTickUtils.h>
 
 #include "BusPirateConsole.h"
 #include "BusPirateBinaryMode.h"
+#include "BusPirateSpiMode.h"
+#include "BusPirateSvfMode.h"
 #include "BusPirateOpenOcdMode.h"
+#include "BusPirateLogicMode.h"
 #include "Globals.h"
 
 
@@ -37,7 +42,10 @@ static const char * GetModeName ( const BusPirateModeEnum mode )
   {
   case bpConsoleMode:  return "bpConsoleMode";
   case bpBinMode:      return "bpBinMode";
+  case bpSpiMode:      return "bpSpiMode";
+  case bpSvfMode:      return "bpSvfMode";
   case bpOpenOcdMode:  return "bpOpenOcdMode";
+  case bpLogicMode:    return "bpLogicMode";
 
   default:
     assert( false );
@@ -46,6 +54,19 @@ static const char * GetModeName ( const BusPirateModeEnum mode )
 }
 
 
+// Shared by all protocol modes, see MAIN_LOOP_TIME_BUDGET_US in Globals.h .
+
+bool HasMainLoopTimeBudgetExpired ( const uint32_t startTime )
+{
+  if ( GetElapsedCycleCount( startTime ) < UsToCpuClockTickCount( MAIN_LOOP_TIME_BUDGET_US ) )
+    return false;
+
+  // There may be more data waiting, so do not sleep in the main loop.
+  WakeFromMainLoopSleep();
+  return true;
+}
+
+
 // txBufferForWelcomeMsg must be empty, see below for more information.
 
 void ChangeBusPirateMode ( const BusPirateModeEnum newMode,
@@ -87,7 +108,10 @@ void ChangeBusPirateMode ( const BusPirateModeEnum newMode,
   {
   case bpConsoleMode:  BusPirateConsole_Terminate();     break;
   case bpBinMode:      BusPirateBinaryMode_Terminate();  break;
+  case bpSpiMode:      BusPirateSpiMode_Terminate();     break;
+  case bpSvfMode:      BusPirateSvfMode_Terminate();     break;
   case bpOpenOcdMode:  BusPirateOpenOcdMode_Terminate(); break;
+  case bpLogicMode:    BusPirateLogicMode_Terminate();   break;
 
   case bpInvalid:
       break;
@@ -110,7 +134,10 @@ void ChangeBusPirateMode ( const BusPirateModeEnum newMode,
   {
   case bpConsoleMode:  BusPirateConsole_Init    ( txBufferForWelcomeMsg ); break;
   case bpBinMode:      BusPirateBinaryMode_Init ( txBufferForWelcomeMsg ); break;
+  case bpSpiMode:      BusPirateSpiMode_Init    ( txBufferForWelcomeMsg ); break;
+  case bpSvfMode:      BusPirateSvfMode_Init    ( txBufferForWelcomeMsg ); break;
   case bpOpenOcdMode:  BusPirateOpenOcdMode_Init( txBufferForWelcomeMsg ); break;
+  case bpLogicMode:    BusPirateLogicMode_Init  ( txBufferForWelcomeMsg ); break;
 
   case bpInvalid:
     break;
@@ -126,29 +153,59 @@ void ChangeBusPirateMode ( const BusPirateModeEnum newMode,
 }
 
 
-void BusPirateConnection_ProcessData ( CUsbRxBuffer * const rxBuffer,
-                                       CUsbTxBuffer * const txBuffer,
-                                       const uint64_t currentTime )
+// Protocol errors are returned to the caller, who should then reset the connection.
+// See ProtocolResult.h about why we do not throw C++ exceptions here.
+
+ProtocolResult BusPirateConnection_ProcessData ( CUsbRxBuffer * const rxBuffer,
+                                                 CUsbTxBuffer * const txBuffer,
+                                                 const uint64_t currentTime )
 {
   assert( s_wasInitialised );
 
   switch ( s_busPirateMode )
   {
   case bpConsoleMode:
-    BusPirateConsole_ProcessData( rxBuffer, txBuffer, currentTime );
-    break;
+    return BusPirateConsole_ProcessData( rxBuffer, txBuffer, currentTime );
 
   case bpBinMode:
+    // The binary mode has no error conditions that warrant resetting the connection.
     BusPirateBinaryMode_ProcessData( rxBuffer, txBuffer );
-    break;
+    return ProtocolResult::Ok();
+
+  case bpSpiMode:
+    return BusPirateSpiMode_ProcessData( rxBuffer, txBuffer );
+
+  case bpSvfMode:
+    return BusPirateSvfMode_ProcessData( rxBuffer, txBuffer );
 
   case bpOpenOcdMode:
-    BusPirateOpenOcdMode_ProcessData( rxBuffer, txBuffer );
-    break;
+    return BusPirateOpenOcdMode_ProcessData( rxBuffer, txBuffer );
+
+  case bpLogicMode:
+    return BusPirateLogicMode_ProcessData( rxBuffer, txBuffer );
 
   default:
     assert( false );
-    break;
+    return ProtocolResult::Ok();
+  }
+}
+
+
+// This routine must not change the mode, see ChangeBusPirateMode(), as the main loop
+// may have been interrupted in the middle of something.
+
+bool BusPirateConnection_ProcessDataFromInterrupt ( CUsbRxBuffer * const rxBuffer,
+                                                    CUsbTxBuffer * const txBuffer )
+{
+  assert( s_wasInitialised );
+
+  switch ( s_busPirateMode )
+  {
+  case bpOpenOcdMode:
+    return BusPirateOpenOcdMode_ProcessSmallCommands( rxBuffer, txBuffer );
+
+  default:
+    return false;
   }
 }
 
@@ -1,18 +1,31 @@
 #pragma once
 
 #include "UsbBuffers.h"
+#include "ProtocolResult.h"
 
 void BusPirateConnection_Init        ( CUsbTxBuffer * txBuffer );
-void BusPirateConnection_ProcessData ( CUsbRxBuffer * rxBuffer, CUsbTxBuffer * txBuffer, uint64_t currentTime );
+ProtocolResult BusPirateConnection_ProcessData ( CUsbRxBuffer * rxBuffer, CUsbTxBuffer * txBuffer, uint64_t currentTime );
 void BusPirateConnection_Terminate   ( void );
 
+// Low-latency path for interrupt context, see ENABLE_USB_LOW_LATENCY_MODE. Only the modes that support it
+// process any data here, and only the commands that are quick and cannot fail. Everything else is left
+// for BusPirateConnection_ProcessData(). Returns whether any data was processed.
+bool BusPirateConnection_ProcessDataFromInterrupt ( CUsbRxBuffer * rxBuffer, CUsbTxBuffer * txBuffer );
+
 
 enum BusPirateModeEnum
 {
   bpInvalid = 0,
   bpConsoleMode,
   bpBinMode,
-  bpOpenOcdMode
+  bpSpiMode,
+  bpSvfMode,
+  bpOpenOcdMode,
+  bpLogicMode
 };
 
+// Returns whether the protocol mode processing data since startTime (a GetCycleCount() value) has used up
+// MAIN_LOOP_TIME_BUDGET_US. If so, there may be more data waiting, so the main loop will not sleep.
+bool HasMainLoopTimeBudgetExpired ( uint32_t startTime );
+
 void ChangeBusPirateMode ( BusPirateModeEnum newMode, CUsbTxBuffer * txBufferForWelcomeMsg );
@@ -20,6 +20,9 @@
 #include <BareMetalSupport/GenericSerialConsole.h>
 #include <BareMetalSupport/MainLoopSleep.h>
 #include <BareMetalSupport/DebugConsoleEol.h>
+#include <BareMetalSupport/CycleCounter.h>
+
+#include <Misc/AssertionUtils.h>
 
 #include <stdexcept>
 #include <string.h>
@@ -30,6 +33,7 @@
 #include "BusPirateConnection.h"
 #include "UsbConnection.h"
 #include "CommandProcessor.h"
+#include "UsbTxFlushPolicy.h"
 
 #include <udi_cdc.h>
 
@@ -75,19 +79,9 @@ const char * CUsbSerialConsole::AddSerialChar ( const uint8_t c,
                                                 CUsbTxBuffer * const txBuffer,
                                                 uint32_t * const cmdLen )
 {
-  const char * ret;
-
   m_txBuffer = txBuffer;
 
-  try
-  {
-    ret = AddChar( c, cmdLen );
-  }
-  catch ( ... )
-  {
-    m_txBuffer = nullptr;
-    throw;
-  }
+  const char * const ret = AddChar( c, cmdLen );
 
   m_txBuffer = nullptr;
 
@@ -134,10 +128,384 @@ void CNativeUsbCommandProcessor::PrintStr ( const char * const str )
 static CUsbSerialConsole s_console;
 
 
+// ----------- Measuring speed tests -----------
+
+// Bucket 0 counts the round trips under 1 us, and bucket n the ones from 2^(n-1) to 2^n - 1 us.
+// The last bucket also collects everything longer.
+static const uint32_t LATENCY_BUCKET_COUNT = 24;
+
+static const uint16_t SWEEP_WRITE_SIZES[] = { 1, 8, 32, 63, 64, 65, 128, 256, 511, 512, 513, 1000 };
+static const uint32_t SWEEP_STEP_COUNT = sizeof( SWEEP_WRITE_SIZES ) / sizeof( SWEEP_WRITE_SIZES[ 0 ] );
+
+// How long a TxSizeSweep burst may keep the main loop busy.
+static const uint32_t SWEEP_BURST_TIME_US = 1000;
+
+static const uint8_t FULL_DUPLEX_END_MARKER = 'X';
+
+struct SweepStepResult
+{
+  uint64_t byteCount;
+  uint32_t writeCallCount;
+  uint32_t durationMs;
+};
+
+struct MeasuringTestState
+{
+  uint64_t startTime;
+  bool     isFinishing;
+  bool     hasTimedOut;
+
+  // PingPong
+  uint32_t pingCount;
+  uint32_t lastEchoCycleCount;
+  uint32_t latencyMinUs;
+  uint32_t latencyMaxUs;
+  uint64_t latencySumUs;
+  uint32_t latencyHistogram[ LATENCY_BUCKET_COUNT ];
+
+  // FullDuplex
+  uint64_t rxByteCount;
+  uint64_t txByteCount;
+  uint32_t durationMs;
+
+  // TxSizeSweep
+  uint32_t sweepStepIndex;
+  bool     isSweepStepStarted;
+  uint64_t sweepStepStartTime;
+  SweepStepResult sweepResults[ SWEEP_STEP_COUNT ];
+};
+
+static MeasuringTestState s_measuringTest;
+
+
+static void StartMeasuringTest ( const uint64_t currentTime )
+{
+  s_measuringTest = MeasuringTestState();
+  s_measuringTest.startTime = currentTime;
+  s_measuringTest.latencyMinUs = UINT32_MAX;
+
+  for ( uint32_t i = 0; i < SWEEP_STEP_COUNT; ++i )
+    assert( SWEEP_WRITE_SIZES[ i ] <= sizeof( g_usbSpeedTestBuffer ) );
+}
+
+
+static void AddLatencySample ( const uint32_t latencyUs )
+{
+  MeasuringTestState * const s = &s_measuringTest;
+
+  s->latencyMinUs = MinFrom( s->latencyMinUs, latencyUs );
+  s->latencyMaxUs = MaxFrom( s->latencyMaxUs, latencyUs );
+  s->latencySumUs += latencyUs;
+
+  const uint32_t bucketIndex = latencyUs == 0 ? 0 : 32 - uint32_t( __builtin_clz( latencyUs ) );
+
+  ++s->latencyHistogram[ MinFrom( bucketIndex, LATENCY_BUCKET_COUNT - 1 ) ];
+}
+
+
+static uint64_t CalculateBytesPerSecond ( const uint64_t byteCount, const uint32_t durationMs )
+{
+  if ( durationMs == 0 )
+    return 0;
+
+  return byteCount * 1000 / durationMs;
+}
+
+
+static void PrintMeasuringTestResults ( CUsbTxBuffer * const txBuffer )
+{
+  const MeasuringTestState * const s = &s_measuringTest;
+  const char * const status = s->hasTimedOut ? "timeout" : "ok";
+
+  UsbTxStats usbTxStats;
+  UsbTxFlushPolicy_GetStats( &usbTxStats );
+
+  UsbPrintf( txBuffer, EOL "CONFIG packet_size=%u rx_buffer_size=%u tx_buffer_size=%u tx_coalescing=%u tx_flush_timeout_us=%u low_latency_mode=%u" EOL,
+             unsigned( usbTxStats.packetSize ),
+             unsigned( USB_RX_BUFFER_SIZE ),
+             unsigned( USB_TX_BUFFER_SIZE ),
+             ENABLE_USB_TX_COALESCING ? 1 : 0,
+             unsigned( USB_TX_FLUSH_TIMEOUT_US ),
+             ENABLE_USB_LOW_LATENCY_MODE ? 1 : 0 );
+
+  switch ( g_usbSpeedTestType )
+  {
+  case stPingPong:
+   {
+    // The first ping has no previous echo to measure against.
+    const uint32_t sampleCount = s->pingCount == 0 ? 0 : s->pingCount - 1;
+
+    UsbPrintf( txBuffer, "RESULT test=PingPong status=%s size=%u ping_count=%u sample_count=%u min_us=%u avg_us=%u max_us=%u" EOL,
+               status,
+               unsigned( g_usbSpeedTestParams.pingSize ),
+               unsigned( s->pingCount ),
+               unsigned( sampleCount ),
+               unsigned( sampleCount == 0 ? 0 : s->latencyMinUs ),
+               unsigned( sampleCount == 0 ? 0 : s->latencySumUs / sampleCount ),
+               unsigned( s->latencyMaxUs ) );
+
+    for ( uint32_t i = 0; i < LATENCY_BUCKET_COUNT; ++i )
+    {
+      if ( s->latencyHistogram[ i ] == 0 )
+        continue;
+
+      const uint32_t fromUs = i == 0 ? 0 : uint32_t( 1 ) << ( i - 1 );
+
+      if ( i == LATENCY_BUCKET_COUNT - 1 )
+      {
+        UsbPrintf( txBuffer, "HIST test=PingPong from_us=%u to_us=max count=%u" EOL,
+                   unsigned( fromUs ), unsigned( s->latencyHistogram[ i ] ) );
+      }
+      else
+      {
+        UsbPrintf( txBuffer, "HIST test=PingPong from_us=%u to_us=%u count=%u" EOL,
+                   unsigned( fromUs ), unsigned( ( uint32_t( 1 ) << i ) - 1 ), unsigned( s->latencyHistogram[ i ] ) );
+      }
+    }
+    break;
+   }
+
+  case stFullDuplex:
+    UsbPrintf( txBuffer, "RESULT test=FullDuplex status=%s duration_ms=%u rx_bytes=%" PRIu64 " tx_bytes=%" PRIu64 " rx_bytes_per_s=%" PRIu64 " tx_bytes_per_s=%" PRIu64 EOL,
+               status,
+               unsigned( s->durationMs ),
+               s->rxByteCount,
+               s->txByteCount,
+               CalculateBytesPerSecond( s->rxByteCount, s->durationMs ),
+               CalculateBytesPerSecond( s->txByteCount, s->durationMs ) );
+    break;
+
+  case stTxSizeSweep:
+    for ( uint32_t i = 0; i < s->sweepStepIndex; ++i )
+    {
+      const SweepStepResult * const r = &s->sweepResults[ i ];
+
+      UsbPrintf( txBuffer, "RESULT test=TxSizeSweep status=%s write_size=%u duration_ms=%u bytes=%" PRIu64 " write_calls=%u bytes_per_s=%" PRIu64 EOL,
+                 status,
+                 unsigned( SWEEP_WRITE_SIZES[ i ] ),
+                 unsigned( r->durationMs ),
+                 r->byteCount,
+                 unsigned( r->writeCallCount ),
+                 CalculateBytesPerSecond( r->byteCount, r->durationMs ) );
+    }
+    break;
+
+  default:
+    assert( false );
+    break;
+  }
+}
+
+
+static void PingPongTest ( CUsbRxBuffer * const rxBuffer,
+                           CUsbTxBuffer * const txBuffer,
+                           const uint64_t currentTime )
+{
+  MeasuringTestState * const s = &s_measuringTest;
+  const uint32_t pingSize = g_usbSpeedTestParams.pingSize;
+
+  // The host should wait for each echo, so there is normally space for it.
+  if ( rxBuffer->GetElemCount() < pingSize || txBuffer->GetFreeCount() < pingSize )
+    return;
+
+  if ( s->pingCount != 0 )
+    AddLatencySample( CycleCountToUs( GetElapsedCycleCount( s->lastEchoCycleCount ) ) );
+
+  for ( uint32_t i = 0; i < pingSize; ++i )
+    txBuffer->WriteElem( rxBuffer->ReadElement() );
+
+  // The echo actually leaves when the main loop calls SendData() shortly afterwards.
+  s->lastEchoCycleCount = GetCycleCount();
+
+  ++s->pingCount;
+  g_usbSpeedTestEndTime = currentTime + USB_SPEED_TEST_IDLE_TIMEOUT_MS;
+
+  if ( s->pingCount == g_usbSpeedTestParams.pingCount )
+    s->isFinishing = true;
+}
+
+
+static void FullDuplexTest ( CUsbRxBuffer * const rxBuffer,
+                             CUsbTxBuffer * const txBuffer,
+                             const uint64_t currentTime )
+{
+  MeasuringTestState * const s = &s_measuringTest;
+
+  for ( ; ; )
+  {
+    CUsbRxBuffer::SizeType elemCount;
+    const CUsbRxBuffer::ElemType * const readPtr = rxBuffer->GetReadPtr( &elemCount );
+
+    if ( elemCount == 0 )
+      break;
+
+    const void * const endMarker = memchr( readPtr, FULL_DUPLEX_END_MARKER, elemCount );
+
+    const CUsbRxBuffer::SizeType consumeCount = endMarker == nullptr
+                                                  ? elemCount
+                                                  : CUsbRxBuffer::SizeType( (const CUsbRxBuffer::ElemType *) endMarker - readPtr + 1 );
+
+    rxBuffer->ConsumeReadElements( consumeCount );
+    g_usbSpeedTestEndTime = currentTime + USB_SPEED_TEST_IDLE_TIMEOUT_MS;
+
+    if ( endMarker != nullptr )
+    {
+      s->rxByteCount += consumeCount - 1;
+      s->isFinishing = true;
+      break;
+    }
+
+    s->rxByteCount += consumeCount;
+  }
+
+  if ( s->isFinishing )
+    return;
+
+  // This is the same as test type stTxFastLoopCircularBuffer.
+  for ( ; ; )
+  {
+    CUsbTxBuffer::SizeType maxChunkElemCount;
+    CUsbTxBuffer::ElemType * const writePtr = txBuffer->GetWritePtr( &maxChunkElemCount );
+
+    if ( maxChunkElemCount == 0 )
+      break;
+
+    memset( writePtr, '.', maxChunkElemCount );
+
+    txBuffer->CommitWrittenElements( maxChunkElemCount );
+    s->txByteCount += maxChunkElemCount;
+  }
+}
+
+
+static void TxSizeSweepTest ( CUsbTxBuffer * const txBuffer,
+                              const uint64_t currentTime )
+{
+  MeasuringTestState * const s = &s_measuringTest;
+
+  // Do not overtake any console output that is still waiting in the Tx Buffer.
+  if ( !txBuffer->IsEmpty() )
+    return;
+
+  assert( s->sweepStepIndex < SWEEP_STEP_COUNT );
+  SweepStepResult * const r = &s->sweepResults[ s->sweepStepIndex ];
+
+  if ( !s->isSweepStepStarted )
+  {
+    s->isSweepStepStarted = true;
+    s->sweepStepStartTime = currentTime;
+  }
+
+  const uint32_t writeSize = SWEEP_WRITE_SIZES[ s->sweepStepIndex ];
+  const uint32_t burstStartCycleCount = GetCycleCount();
+
+  // On the DebugDue, udi_cdc_write_buf() waits until the USB stack has taken all data.
+  // Under the emulator, it stops when the pseudo-terminal is full.
+  do
+  {
+    const uint32_t remainingCount = udi_cdc_write_buf( g_usbSpeedTestBuffer, writeSize );
+
+    ++r->writeCallCount;
+    r->byteCount += writeSize - remainingCount;
+
+    if ( remainingCount != 0 )
+      break;
+  }
+  while ( CycleCountToUs( GetElapsedCycleCount( burstStartCycleCount ) ) < SWEEP_BURST_TIME_US );
+
+  if ( r->byteCount != 0 )
+    g_usbSpeedTestEndTime = currentTime + USB_SPEED_TEST_IDLE_TIMEOUT_MS;
+
+  const uint64_t elapsedMs = currentTime - s->sweepStepStartTime;
+
+  if ( elapsedMs >= g_usbSpeedTestParams.sweepStepTimeMs )
+  {
+    r->durationMs = uint32_t( elapsedMs );
+    ++s->sweepStepIndex;
+    s->isSweepStepStarted = false;
+
+    if ( s->sweepStepIndex == SWEEP_STEP_COUNT )
+    {
+      s->isFinishing = true;
+      return;
+    }
+  }
+
+  // Otherwise there would be idle time between bursts, like in test type stTxFastLoopRawUsb.
+  WakeFromMainLoopSleep();
+}
+
+
+static void MeasuringSpeedTest ( CUsbRxBuffer * const rxBuffer,
+                                 CUsbTxBuffer * const txBuffer,
+                                 const uint64_t currentTime )
+{
+  MeasuringTestState * const s = &s_measuringTest;
+
+  if ( !s->isFinishing && currentTime >= g_usbSpeedTestEndTime )
+  {
+    s->isFinishing = true;
+    s->hasTimedOut = true;
+  }
+
+  if ( !s->isFinishing )
+  {
+    switch ( g_usbSpeedTestType )
+    {
+    case stPingPong:
+      PingPongTest( rxBuffer, txBuffer, currentTime );
+      break;
+
+    case stFullDuplex:
+      FullDuplexTest( rxBuffer, txBuffer, currentTime );
+      break;
+
+    case stTxSizeSweep:
+      TxSizeSweepTest( txBuffer, currentTime );
+      break;
+
+    default:
+      assert( false );
+      break;
+    }
+
+    if ( !s->isFinishing )
+      return;
+
+    if ( g_usbSpeedTestType == stFullDuplex )
+      s->durationMs = uint32_t( currentTime - s->startTime );
+  }
+
+  // The results would not fit in the Tx Buffer together with a lot of test data,
+  // and the host would have a harder time finding them.
+  if ( !txBuffer->IsEmpty() )
+    return;
+
+  PrintMeasuringTestResults( txBuffer );
+
+  UsbPrintStr( txBuffer, "USB speed test finished." EOL );
+  UsbPrintStr( txBuffer, BUS_PIRATE_CONSOLE_PROMPT );
+
+  g_usbSpeedTestType = stNone;
+}
+
+
 static void SpeedTest ( CUsbRxBuffer * const rxBuffer,
                         CUsbTxBuffer * const txBuffer,
                         const uint64_t currentTime )
 {
+  switch ( g_usbSpeedTestType )
+  {
+  case stPingPong:
+  case stFullDuplex:
+  case stTxSizeSweep:
+    MeasuringSpeedTest( rxBuffer, txBuffer, currentTime );
+    return;
+
+  default:
+    break;
+  }
+
   if ( currentTime >= g_usbSpeedTestEndTime )
   {
     // This message may not make it to the console, depending on the test type.
@@ -235,9 +603,9 @@ static void SpeedTest ( CUsbRxBuffer * const rxBuffer,
 }
 
 
-void BusPirateConsole_ProcessData ( CUsbRxBuffer * const rxBuffer,
-                                    CUsbTxBuffer * const txBuffer,
-                                    const uint64_t currentTime )
+ProtocolResult BusPirateConsole_ProcessData ( CUsbRxBuffer * const rxBuffer,
+                                              CUsbTxBuffer * const txBuffer,
+                                              const uint64_t currentTime )
 {
   // If we are in speed test mode, and we have not finished testing yet, do nothing else.
 
@@ -246,7 +614,7 @@ void BusPirateConsole_ProcessData ( CUsbRxBuffer * const rxBuffer,
     SpeedTest( rxBuffer, txBuffer, currentTime );
 
     if ( g_usbSpeedTestType != stNone )
-      return;
+      return ProtocolResult::Ok();
   }
 
 
@@ -287,7 +655,13 @@ void BusPirateConsole_ProcessData ( CUsbRxBuffer * const rxBuffer,
 
         CNativeUsbCommandProcessor cmdProcessor( rxBuffer, txBuffer );
 
-        cmdProcessor.ProcessCommand( cmd, currentTime );
+        const ProtocolResult result = cmdProcessor.ProcessCommand( cmd, currentTime );
+
+        if ( !result.IsOk() )
+          return result;
+
+        if ( g_usbSpeedTestType != stNone )
+          StartMeasuringTest( currentTime );
 
         UsbPrintStr( txBuffer, BUS_PIRATE_CONSOLE_PROMPT );
 
@@ -298,6 +672,8 @@ void BusPirateConsole_ProcessData ( CUsbRxBuffer * const rxBuffer,
     if ( endLoop )
       break;
   }
+
+  return ProtocolResult::Ok();
 }
 
 
@@ -1,7 +1,8 @@
 #pragma once
 
 #include "UsbBuffers.h"
+#include "ProtocolResult.h"
 
 void BusPirateConsole_Init ( CUsbTxBuffer * txBufferForWelcomeMsg );
-void BusPirateConsole_ProcessData ( CUsbRxBuffer * rxBuffer, CUsbTxBuffer * txBuffer, uint64_t currentTime );
+ProtocolResult BusPirateConsole_ProcessData ( CUsbRxBuffer * rxBuffer, CUsbTxBuffer * txBuffer, uint64_t currentTime );
 void BusPirateConsole_Terminate ( void );
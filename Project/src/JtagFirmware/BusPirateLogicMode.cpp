@@ -0,0 +1,483 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "BusPirateLogicMode.h"  // The include file for this module should come first.
+
+#include <assert.h>
+#include <string.h>
+
+#include <BareMetalSupport/Miscellaneous.h>
+#include <BareMetalSupport/CycleCounter.h>
+#include <BareMetalSupport/MainLoopSleep.h>
+#include <BareMetalSupport/NoInitData.h>
+#include <Misc/AssertionUtils.h>
+
+#include "BusPirateConnection.h"
+#include "LogicSampler.h"
+#include "Globals.h"
+
+
+#ifndef NDEBUG
+  static bool s_wasInitialised = false;
+#endif
+
+
+// Command codes.
+static const uint8_t LOGIC_CMD_EXIT         = 0x00;
+static const uint8_t LOGIC_CMD_MODE_VERSION = 0x01;
+static const uint8_t LOGIC_CMD_CONFIGURE    = 0x02;
+static const uint8_t LOGIC_CMD_START        = 0x03;
+static const uint8_t LOGIC_CMD_STOP         = 0x04;
+
+// Frame types.
+static const uint8_t FRAME_DATA = 0x10;
+static const uint8_t FRAME_END  = 0x11;
+
+static const uint32_t LOGIC_MODE_WELCOME_LEN = 4;  // "LOG1"
+static const uint32_t CONFIGURE_CMD_LEN      = 1 + 4 + 2 + 4 + 1 + 1;
+static const uint32_t CONFIGURE_REPLY_LEN    = 1 + 4;
+static const uint32_t DATA_FRAME_HEADER_LEN  = 1 + 2 + 4;
+static const uint32_t END_FRAME_LEN          = 1 + 4 + 4 + 4;
+
+static const uint32_t MAX_PRE_TRIGGER_SAMPLE_COUNT = 1024;
+static const uint32_t MAX_FRAME_SAMPLE_COUNT       = LOGIC_SAMPLER_BLOCK_SAMPLE_COUNT;
+
+static const uint32_t NO_TRIGGER_INDEX = 0xFFFFFFFF;
+
+
+enum CaptureStateEnum
+{
+  csIdle,
+  csWaitingForTrigger,  // Filling the pre-trigger ring.
+  csStreaming,
+};
+
+static CaptureStateEnum s_captureState;
+
+
+// The capture configuration.
+static uint32_t s_sampleRateHz;
+static uint32_t s_preTriggerSampleCount;
+static uint32_t s_postTriggerSampleCount;
+static uint8_t  s_triggerMask;
+static uint8_t  s_triggerValue;
+
+// The last samples before the trigger.
+static uint8_t  s_preTriggerRing[ MAX_PRE_TRIGGER_SAMPLE_COUNT ] NOINIT_DATA;
+static uint32_t s_preTriggerRingPos;
+static uint32_t s_preTriggerRingCount;
+
+// The samples waiting to be sent. After the trigger, this holds the pre-trigger samples
+// and the rest of the block with the trigger sample. Afterwards, it holds one block at a time.
+static uint8_t  s_pendingSamples[ MAX_PRE_TRIGGER_SAMPLE_COUNT + LOGIC_SAMPLER_BLOCK_SAMPLE_COUNT ] NOINIT_DATA;
+static uint32_t s_pendingCount;
+static uint32_t s_pendingReadPos;
+static uint32_t s_pendingDroppedCount;  // Samples dropped before the pending ones.
+
+static bool     s_isStopRequested;
+static uint32_t s_remainingPostTriggerCount;
+static uint32_t s_sentSampleCount;
+static uint32_t s_totalDroppedCount;
+static uint32_t s_triggerIndex;
+
+
+static void SendLogicModeWelcome ( CUsbTxBuffer * const txBuffer )
+{
+  UsbPrintStr( txBuffer, "LOG1" );
+}
+
+
+static uint32_t ReadBigEndianUint32 ( const uint8_t * const data ) throw()
+{
+  return ( uint32_t( data[0] ) << 24 ) |
+         ( uint32_t( data[1] ) << 16 ) |
+         ( uint32_t( data[2] ) <<  8 ) |
+         ( uint32_t( data[3] )       );
+}
+
+
+static void WriteBigEndianUint32 ( CUsbTxBuffer * const txBuffer, const uint32_t val )
+{
+  assert( txBuffer->GetFreeCount() >= 4 );
+
+  txBuffer->WriteElem( uint8_t( val >> 24 ) );
+  txBuffer->WriteElem( uint8_t( val >> 16 ) );
+  txBuffer->WriteElem( uint8_t( val >>  8 ) );
+  txBuffer->WriteElem( uint8_t( val       ) );
+}
+
+
+static bool IsPostTriggerLimited ( void ) throw()
+{
+  return s_postTriggerSampleCount != 0;
+}
+
+
+// Appends samples to the pending ones, up to the post-trigger limit.
+
+static void AddPendingSamples ( const uint8_t * const samples, const uint32_t count )
+{
+  uint32_t countToAdd = count;
+
+  if ( IsPostTriggerLimited() )
+  {
+    countToAdd = MinFrom( countToAdd, s_remainingPostTriggerCount );
+    s_remainingPostTriggerCount -= countToAdd;
+  }
+
+  assert( s_pendingCount + countToAdd <= sizeof( s_pendingSamples ) );
+
+  memcpy( &s_pendingSamples[ s_pendingCount ], samples, countToAdd );
+  s_pendingCount += countToAdd;
+}
+
+
+// Looks for the trigger in the given samples. Returns the trigger sample position,
+// or 'count' if there is no trigger. The samples before the trigger go into the pre-trigger ring.
+
+static uint32_t ScanForTrigger ( const uint8_t * const samples, const uint32_t count )
+{
+  for ( uint32_t i = 0; i < count; ++i )
+  {
+    const uint8_t sample = samples[ i ];
+
+    if ( ( sample & s_triggerMask ) == s_triggerValue )
+      return i;
+
+    if ( s_preTriggerSampleCount == 0 )
+      continue;
+
+    s_preTriggerRing[ s_preTriggerRingPos ] = sample;
+
+    if ( ++s_preTriggerRingPos == s_preTriggerSampleCount )
+      s_preTriggerRingPos = 0;
+
+    if ( s_preTriggerRingCount < s_preTriggerSampleCount )
+      ++s_preTriggerRingCount;
+  }
+
+  return count;
+}
+
+
+static void ProcessSampleBlock ( const LogicSampler_Block * const block )
+{
+  assert( s_pendingCount == 0 );
+
+  s_totalDroppedCount += block->droppedSampleCountBefore;
+
+  if ( s_captureState == csStreaming )
+  {
+    s_pendingDroppedCount = block->droppedSampleCountBefore;
+    AddPendingSamples( block->samples, LOGIC_SAMPLER_BLOCK_SAMPLE_COUNT );
+    return;
+  }
+
+  assert( s_captureState == csWaitingForTrigger );
+
+  const uint32_t triggerPos = ScanForTrigger( block->samples, LOGIC_SAMPLER_BLOCK_SAMPLE_COUNT );
+
+  if ( triggerPos == LOGIC_SAMPLER_BLOCK_SAMPLE_COUNT )
+    return;
+
+  // The oldest pre-trigger sample is at the ring's current position once the ring is full.
+
+  const uint32_t ringStart = s_preTriggerRingCount < s_preTriggerSampleCount ? 0 : s_preTriggerRingPos;
+
+  for ( uint32_t i = 0; i < s_preTriggerRingCount; ++i )
+  {
+    s_pendingSamples[ i ] = s_preTriggerRing[ ( ringStart + i ) % s_preTriggerSampleCount ];
+  }
+
+  s_pendingCount        = s_preTriggerRingCount;
+  s_pendingDroppedCount = 0;
+  s_triggerIndex        = s_preTriggerRingCount;
+
+  AddPendingSamples( &block->samples[ triggerPos ], LOGIC_SAMPLER_BLOCK_SAMPLE_COUNT - triggerPos );
+
+  s_captureState = csStreaming;
+}
+
+
+// Returns whether a frame was sent.
+
+static bool SendDataFrame ( CUsbTxBuffer * const txBuffer )
+{
+  assert( s_pendingReadPos < s_pendingCount );
+
+  const uint32_t freeCount = txBuffer->GetFreeCount();
+
+  if ( freeCount <= DATA_FRAME_HEADER_LEN )
+    return false;
+
+  const uint32_t sampleCount = MinFrom( MinFrom( s_pendingCount - s_pendingReadPos, MAX_FRAME_SAMPLE_COUNT ),
+                                        freeCount - DATA_FRAME_HEADER_LEN );
+
+  txBuffer->WriteElem( FRAME_DATA );
+  txBuffer->WriteElem( uint8_t( sampleCount >> 8 ) );
+  txBuffer->WriteElem( uint8_t( sampleCount      ) );
+  WriteBigEndianUint32( txBuffer, s_pendingDroppedCount );
+  txBuffer->WriteElemArray( &s_pendingSamples[ s_pendingReadPos ], sampleCount );
+
+  s_pendingDroppedCount = 0;
+  s_pendingReadPos     += sampleCount;
+  s_sentSampleCount    += sampleCount;
+
+  if ( s_pendingReadPos == s_pendingCount )
+  {
+    s_pendingReadPos = 0;
+    s_pendingCount   = 0;
+  }
+
+  return true;
+}
+
+
+static bool SendEndFrame ( CUsbTxBuffer * const txBuffer )
+{
+  if ( txBuffer->GetFreeCount() < END_FRAME_LEN )
+    return false;
+
+  LogicSampler_Stop();
+
+  txBuffer->WriteElem( FRAME_END );
+  WriteBigEndianUint32( txBuffer, s_sentSampleCount );
+  WriteBigEndianUint32( txBuffer, s_totalDroppedCount );
+  WriteBigEndianUint32( txBuffer, s_triggerIndex );
+
+  s_captureState = csIdle;
+
+  return true;
+}
+
+
+static void StartCapture ( void )
+{
+  s_preTriggerRingPos         = 0;
+  s_preTriggerRingCount       = 0;
+  s_pendingCount              = 0;
+  s_pendingReadPos            = 0;
+  s_pendingDroppedCount       = 0;
+  s_isStopRequested           = false;
+  s_remainingPostTriggerCount = s_postTriggerSampleCount;
+  s_sentSampleCount           = 0;
+  s_totalDroppedCount         = 0;
+  s_triggerIndex              = NO_TRIGGER_INDEX;
+
+  s_captureState = csWaitingForTrigger;
+
+  VERIFY( s_sampleRateHz == LogicSampler_Start( s_sampleRateHz ) );
+}
+
+
+// Returns whether some progress was made.
+
+static ProtocolResult ContinueCapture ( CUsbRxBuffer * const rxBuffer,
+                                        CUsbTxBuffer * const txBuffer,
+                                        bool * const hasMadeProgress )
+{
+  if ( !rxBuffer->IsEmpty() )
+  {
+    if ( *rxBuffer->PeekElement() != LOGIC_CMD_STOP )
+      return ProtocolResult::Error( "Only the stop command is allowed during a logic capture." );
+
+    rxBuffer->ConsumeReadElements( 1 );
+    s_isStopRequested = true;
+    *hasMadeProgress = true;
+  }
+
+  if ( s_pendingCount != 0 )
+  {
+    if ( SendDataFrame( txBuffer ) )
+      *hasMadeProgress = true;
+
+    return ProtocolResult::Ok();
+  }
+
+  const bool isPostTriggerComplete = s_captureState == csStreaming &&
+                                     IsPostTriggerLimited() &&
+                                     s_remainingPostTriggerCount == 0;
+
+  if ( s_isStopRequested || isPostTriggerComplete )
+  {
+    if ( SendEndFrame( txBuffer ) )
+      *hasMadeProgress = true;
+
+    return ProtocolResult::Ok();
+  }
+
+  const LogicSampler_Block * const block = LogicSampler_GetFullBlock();
+
+  if ( block != nullptr )
+  {
+    ProcessSampleBlock( block );
+    LogicSampler_ReleaseBlock();
+    *hasMadeProgress = true;
+  }
+
+  return ProtocolResult::Ok();
+}
+
+
+static ProtocolResult ProcessCommand ( CUsbRxBuffer * const rxBuffer,
+                                       CUsbTxBuffer * const txBuffer,
+                                       bool * const hasMadeProgress )
+{
+  assert( s_captureState == csIdle );
+
+  if ( rxBuffer->IsEmpty() )
+    return ProtocolResult::Ok();
+
+  switch ( *rxBuffer->PeekElement() )
+  {
+  case LOGIC_CMD_EXIT:
+    // Mode switching speed is not important, so wait until the Tx Buffer is empty,
+    // see ChangeBusPirateMode() for more information.
+    if ( txBuffer->IsEmpty() )
+    {
+      rxBuffer->ConsumeReadElements( 1 );
+      ChangeBusPirateMode( bpBinMode, txBuffer );
+    }
+
+    // This mode is no longer active, so stop processing data here.
+    return ProtocolResult::Ok();
+
+  case LOGIC_CMD_MODE_VERSION:
+    if ( txBuffer->GetFreeCount() >= LOGIC_MODE_WELCOME_LEN )
+    {
+      rxBuffer->ConsumeReadElements( 1 );
+      SendLogicModeWelcome( txBuffer );
+      *hasMadeProgress = true;
+    }
+    return ProtocolResult::Ok();
+
+  case LOGIC_CMD_CONFIGURE:
+    {
+      if ( rxBuffer->GetElemCount() < CONFIGURE_CMD_LEN ||
+           txBuffer->GetFreeCount() < CONFIGURE_REPLY_LEN )
+      {
+        return ProtocolResult::Ok();
+      }
+
+      uint8_t cmdData[ CONFIGURE_CMD_LEN ];
+      rxBuffer->PeekMultipleElements( CONFIGURE_CMD_LEN, cmdData );
+      rxBuffer->ConsumeReadElements( CONFIGURE_CMD_LEN );
+
+      const uint32_t sampleRateHz = ReadBigEndianUint32( &cmdData[ 1 ] );
+      const uint32_t preTriggerSampleCount = uint32_t( cmdData[ 5 ] << 8 | cmdData[ 6 ] );
+
+      if ( sampleRateHz < LOGIC_SAMPLER_MIN_RATE_HZ ||
+           sampleRateHz > LOGIC_SAMPLER_MAX_RATE_HZ ||
+           preTriggerSampleCount > MAX_PRE_TRIGGER_SAMPLE_COUNT )
+      {
+        return ProtocolResult::Error( "Invalid logic capture configuration." );
+      }
+
+      // Find out the actual sample rate straight away.
+      s_sampleRateHz = LogicSampler_Start( sampleRateHz );
+      LogicSampler_Stop();
+
+      s_preTriggerSampleCount  = preTriggerSampleCount;
+      s_postTriggerSampleCount = ReadBigEndianUint32( &cmdData[ 7 ] );
+      s_triggerMask            = cmdData[ 11 ];
+      s_triggerValue           = cmdData[ 12 ] & s_triggerMask;
+
+      txBuffer->WriteElem( 0x01 );
+      WriteBigEndianUint32( txBuffer, s_sampleRateHz );
+
+      *hasMadeProgress = true;
+      return ProtocolResult::Ok();
+    }
+
+  case LOGIC_CMD_START:
+    rxBuffer->ConsumeReadElements( 1 );
+    StartCapture();
+    *hasMadeProgress = true;
+    return ProtocolResult::Ok();
+
+  default:
+    return ProtocolResult::Error( "Unknown logic analyser command." );
+  }
+}
+
+
+// Process as much data as possible in one go, within the main loop time budget,
+// see MAIN_LOOP_TIME_BUDGET_US.
+
+ProtocolResult BusPirateLogicMode_ProcessData ( CUsbRxBuffer * const rxBuffer, CUsbTxBuffer * const txBuffer )
+{
+  assert( s_wasInitialised );
+
+  const uint32_t startTime = GetCycleCount();
+
+  for ( ; ; )
+  {
+    bool hasMadeProgress = false;
+
+    const ProtocolResult result = s_captureState == csIdle
+                                    ? ProcessCommand ( rxBuffer, txBuffer, &hasMadeProgress )
+                                    : ContinueCapture( rxBuffer, txBuffer, &hasMadeProgress );
+    if ( !result.IsOk() )
+      return result;
+
+    if ( !hasMadeProgress )
+      break;
+
+    if ( HasMainLoopTimeBudgetExpired( startTime ) )
+      break;
+  }
+
+  // The sampler fills its blocks without waking the main loop, so keep polling while capturing.
+  // The mode may have changed in the meantime, see LOGIC_CMD_EXIT.
+  if ( s_captureState != csIdle )
+    WakeFromMainLoopSleep();
+
+  return ProtocolResult::Ok();
+}
+
+
+void BusPirateLogicMode_Init ( CUsbTxBuffer * const txBuffer )
+{
+  assert( !s_wasInitialised );
+
+  #ifndef NDEBUG
+    s_wasInitialised = true;
+  #endif
+
+  s_captureState = csIdle;
+
+  // The defaults capture straight away at 100 kHz until the host stops.
+  s_sampleRateHz           = 100000;
+  s_preTriggerSampleCount  = 0;
+  s_postTriggerSampleCount = 0;
+  s_triggerMask            = 0;
+  s_triggerValue           = 0;
+
+  SendLogicModeWelcome( txBuffer );
+}
+
+
+void BusPirateLogicMode_Terminate ( void )
+{
+  assert( s_wasInitialised );
+
+  // An error may terminate the mode in the middle of a capture.
+  LogicSampler_Stop();
+  s_captureState = csIdle;
+
+  #ifndef NDEBUG
+   s_wasInitialised = false;
+  #endif
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "UsbBuffers.h"
+#include "ProtocolResult.h"
+
+// This is a simple logic analyser for the JTAG pins, entered from the binary mode with command 0x21.
+// It samples the pins at a fixed rate (see LogicSampler.h) and streams the samples continuously to the host,
+// so the capture length is not limited by the DebugDue's RAM. Tools/LogicCapture.pl saves
+// the samples in sigrok's "binary" input format, with one byte per sample.
+//
+// The JTAG pins keep their current configuration, so the DebugDue can also watch another JTAG probe
+// on the same cable. The sample bits are: 0 TCK, 1 TMS, 2 TDI, 3 TDO, 4 nTRST, 5 nSRST.
+//
+// Commands:
+//   0x00  Go back to the binary mode, reply "BBIO1".
+//   0x01  Reply the mode version string "LOG1".
+//   0x02  Configure, followed by the sample rate in Hz (4 bytes), the pre-trigger sample count (2 bytes),
+//         the post-trigger sample count (4 bytes, 0 means no limit), the trigger mask (1 byte)
+//         and the trigger value (1 byte). The reply is 0x01 and the actual sample rate (4 bytes).
+//         The capture triggers on the first sample where ( sample & mask ) == value,
+//         so a mask of 0 triggers straight away. The post-trigger samples include the trigger sample.
+//   0x03  Start capturing. The DebugDue then sends frames, see below, until the capture ends.
+//   0x04  Stop capturing. This is the only command accepted during a capture.
+//         The capture also stops by itself after the post-trigger samples.
+//
+// Frames:
+//   0x10  Data, followed by the sample count (2 bytes), the number of samples dropped
+//         just before these ones (4 bytes), and the samples. The first data frame
+//         starts with the pre-trigger samples.
+//   0x11  End of capture, followed by the total number of samples sent (4 bytes), the total
+//         number of samples dropped (4 bytes), and the index of the trigger sample among the samples sent
+//         (4 bytes, 0xFFFFFFFF if the capture stopped before triggering).
+//
+// Samples get dropped when the USB connection cannot keep up with the sample rate.
+// All multi-byte values are big endian. An invalid command is a protocol error, which resets the connection.
+
+#define BIN_CMD_LOGIC_MODE  (uint8_t( 0x21 ))
+
+void BusPirateLogicMode_Init ( CUsbTxBuffer * txBuffer );
+void BusPirateLogicMode_Terminate ( void );
+ProtocolResult BusPirateLogicMode_ProcessData ( CUsbRxBuffer * rxBuffer, CUsbTxBuffer * txBuffer );
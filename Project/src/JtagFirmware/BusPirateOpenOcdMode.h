@@ -1,13 +1,24 @@
 #pragma once
 
 #include "UsbBuffers.h"
+#include "ProtocolResult.h"
 
 void InitJtagPins ( void );
 
 void BusPirateOpenOcdMode_Init ( CUsbTxBuffer * txBuffer );
 void BusPirateOpenOcdMode_Terminate ( void );
 
-void BusPirateOpenOcdMode_ProcessData ( CUsbRxBuffer * rxBuffer, CUsbTxBuffer * txBuffer );
+ProtocolResult BusPirateOpenOcdMode_ProcessData ( CUsbRxBuffer * rxBuffer, CUsbTxBuffer * txBuffer );
+
+// Processes the short TAP shift commands at the front of the Rx Buffer, and leaves the rest for
+// BusPirateOpenOcdMode_ProcessData(). This routine can be called from the low-latency interrupt path,
+// see ENABLE_USB_LOW_LATENCY_MODE. Returns whether any command was processed.
+bool BusPirateOpenOcdMode_ProcessSmallCommands ( CUsbRxBuffer * rxBuffer, CUsbTxBuffer * txBuffer );
+
+
+// The SVF player uses this routine too. It shifts between 1 and 8 bits, LSB first.
+// The unused TDI and TMS bits must be zero. The TDO bits returned are aligned to the LSB too.
+uint8_t ShiftJtagBits ( uint8_t tdi8, uint8_t tms8, uint8_t bitCount );
 
 
 // The following routines are only used from outside for test purposes.
@@ -28,7 +39,7 @@ enum JtagPinModeEnum
 
 
 JtagPinModeEnum GetJtagPinMode ( void );
-void SetJtagPinMode ( JtagPinModeEnum mode );
+ProtocolResult SetJtagPinMode ( JtagPinModeEnum mode );
 
 void SetJtagPullups ( bool enablePullUps );
 bool GetJtagPullups ( void );
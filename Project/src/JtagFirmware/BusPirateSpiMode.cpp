@@ -0,0 +1,397 @@
+
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "BusPirateSpiMode.h"  // The include file for this module should come first.
+
+#include <assert.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <BareMetalSupport/SerialPrint.h>
+#include <BareMetalSupport/Miscellaneous.h>
+#include <BareMetalSupport/CycleCounter.h>
+
+#include "BusPirateConnection.h"
+#include "SpiPort.h"
+
+
+#ifndef NDEBUG
+  static bool s_wasInitialised = false;
+#endif
+
+
+// Command codes.
+static const uint8_t SPI_CMD_EXIT                  = 0x00;
+static const uint8_t SPI_CMD_MODE_VERSION          = 0x01;
+static const uint8_t SPI_CMD_CS_LOW                = 0x02;
+static const uint8_t SPI_CMD_CS_HIGH               = 0x03;
+static const uint8_t SPI_CMD_WRITE_THEN_READ       = 0x04;
+static const uint8_t SPI_CMD_WRITE_THEN_READ_NO_CS = 0x05;
+static const uint8_t SPI_CMD_BULK_TRANSFER         = 0x10;
+static const uint8_t SPI_CMD_CONFIG_PERIPHERALS    = 0x40;
+static const uint8_t SPI_CMD_SET_SPEED             = 0x60;
+static const uint8_t SPI_CMD_CONFIG_BUS            = 0x80;
+
+static const uint8_t REPLY_SUCCESS = 0x01;
+static const uint8_t REPLY_FAILURE = 0x00;
+
+static const uint32_t WRITE_THEN_READ_CMD_LEN = 1 + 2 + 2;
+
+// This is the limit on the real Bus Pirate. Our implementation streams the data,
+// so it does not actually need any limit.
+static const uint32_t MAX_WRITE_THEN_READ_BYTE_COUNT = 4096;
+
+static const uint32_t MAX_BULK_TRANSFER_BYTE_COUNT = 16;
+
+// A write then read command transfers at most this many bytes per step, so that each step fits
+// in the main loop time budget, even at the slowest SPI clock: 256 bytes at 1 MHz take around 2 ms.
+static const uint32_t MAX_WRITE_THEN_READ_STEP_BYTE_COUNT = 256;
+
+
+// A write then read command can be much bigger than the USB buffers, so it is processed in chunks,
+// one chunk per step, over several main loop iterations if necessary. The SPI transfers are done with DMA directly
+// from the Rx Buffer and into the Tx Buffer, without any intermediate copies.
+
+enum WriteThenReadStateEnum
+{
+  wtrIdle,
+  wtrWriting,  // Sending the data from the host to the SPI bus.
+  wtrReading   // Sending the data read from the SPI bus to the host.
+};
+
+static WriteThenReadStateEnum s_writeThenReadState;
+static bool     s_writeThenReadHandlesChipSelect;
+static uint32_t s_writeThenReadRemainingWriteCount;
+static uint32_t s_writeThenReadRemainingReadCount;
+
+
+static void SendSpiModeWelcome ( CUsbTxBuffer * const txBuffer )
+{
+  UsbPrintStr( txBuffer, "SPI1" );
+}
+
+
+static uint16_t ReadBigEndianUint16 ( const uint8_t * const data ) throw()
+{
+  return uint16_t( ( data[0] << 8 ) | data[1] );
+}
+
+
+// All routines below return false if they could not make any progress,
+// because there is not enough data in the Rx Buffer or not enough space in the Tx Buffer.
+
+static bool StartWriteThenRead ( CUsbRxBuffer * const rxBuffer, CUsbTxBuffer * const txBuffer )
+{
+  assert( s_writeThenReadState == wtrIdle );
+
+  if ( rxBuffer->GetElemCount() < WRITE_THEN_READ_CMD_LEN || txBuffer->IsFull() )
+    return false;
+
+  uint8_t cmdData[ WRITE_THEN_READ_CMD_LEN ];
+  rxBuffer->PeekMultipleElements( WRITE_THEN_READ_CMD_LEN, cmdData );
+  rxBuffer->ConsumeReadElements( WRITE_THEN_READ_CMD_LEN );
+
+  const uint32_t writeCount = ReadBigEndianUint16( &cmdData[ 1 ] );
+  const uint32_t readCount  = ReadBigEndianUint16( &cmdData[ 3 ] );
+
+  if ( false )
+  {
+    SerialPrintf( "SPI write then read command 0x%02X, write count %" PRIu32 ", read count %" PRIu32 "." EOL,
+                  cmdData[0], writeCount, readCount );
+  }
+
+  if ( writeCount > MAX_WRITE_THEN_READ_BYTE_COUNT ||
+       readCount  > MAX_WRITE_THEN_READ_BYTE_COUNT )
+  {
+    // Like the real Bus Pirate, we do not skip the data to write, which will then be interpreted as commands.
+    txBuffer->WriteElem( REPLY_FAILURE );
+    return true;
+  }
+
+  s_writeThenReadHandlesChipSelect   = cmdData[0] == SPI_CMD_WRITE_THEN_READ;
+  s_writeThenReadRemainingWriteCount = writeCount;
+  s_writeThenReadRemainingReadCount  = readCount;
+
+  if ( s_writeThenReadHandlesChipSelect )
+    SpiPort_SetChipSelect( true );
+
+  s_writeThenReadState = wtrWriting;
+  return true;
+}
+
+
+static bool ContinueWriteThenReadWriting ( CUsbRxBuffer * const rxBuffer, CUsbTxBuffer * const txBuffer )
+{
+  assert( s_writeThenReadState == wtrWriting );
+
+  if ( s_writeThenReadRemainingWriteCount != 0 )
+  {
+    uint32_t availableCount;
+    const uint8_t * const readPtr = rxBuffer->GetReadPtr( &availableCount );
+
+    if ( availableCount == 0 )
+      return false;
+
+    const uint32_t chunkLen = MinFrom( MinFrom( availableCount, s_writeThenReadRemainingWriteCount ),
+                                       MAX_WRITE_THEN_READ_STEP_BYTE_COUNT );
+
+    SpiPort_Transfer( readPtr, nullptr, chunkLen );
+
+    rxBuffer->ConsumeReadElements( chunkLen );
+    s_writeThenReadRemainingWriteCount -= chunkLen;
+    return true;
+  }
+
+  // The real Bus Pirate sends the success code after reading all data from the SPI bus,
+  // but there is no way for this command to fail at this point, so we can send it straight away.
+
+  if ( txBuffer->IsFull() )
+    return false;
+
+  txBuffer->WriteElem( REPLY_SUCCESS );
+
+  s_writeThenReadState = wtrReading;
+  return true;
+}
+
+
+static bool ContinueWriteThenReadReading ( CUsbTxBuffer * const txBuffer )
+{
+  assert( s_writeThenReadState == wtrReading );
+
+  if ( s_writeThenReadRemainingReadCount != 0 )
+  {
+    uint32_t freeCount;
+    uint8_t * const writePtr = txBuffer->GetWritePtr( &freeCount );
+
+    if ( freeCount == 0 )
+      return false;
+
+    const uint32_t chunkLen = MinFrom( MinFrom( freeCount, s_writeThenReadRemainingReadCount ),
+                                       MAX_WRITE_THEN_READ_STEP_BYTE_COUNT );
+
+    // The Bus Pirate sends 0xFF while reading. We place the bytes to send in the Tx Buffer,
+    // and the data received overwrites them in place.
+    memset( writePtr, 0xFF, chunkLen );
+
+    SpiPort_Transfer( writePtr, writePtr, chunkLen );
+
+    txBuffer->CommitWrittenElements( chunkLen );
+    s_writeThenReadRemainingReadCount -= chunkLen;
+    return true;
+  }
+
+  if ( s_writeThenReadHandlesChipSelect )
+    SpiPort_SetChipSelect( false );
+
+  s_writeThenReadState = wtrIdle;
+  return true;
+}
+
+
+static bool BulkTransfer ( CUsbRxBuffer * const rxBuffer, CUsbTxBuffer * const txBuffer )
+{
+  const uint8_t cmdCode = *rxBuffer->PeekElement();
+
+  const uint32_t byteCount = ( cmdCode & 0x0F ) + 1;
+
+  if ( rxBuffer->GetElemCount() < 1 + byteCount ||
+       txBuffer->GetFreeCount() < 1 + byteCount )
+  {
+    return false;
+  }
+
+  uint8_t data[ 1 + MAX_BULK_TRANSFER_BYTE_COUNT ];
+
+  rxBuffer->PeekMultipleElements( 1 + byteCount, data );
+  rxBuffer->ConsumeReadElements( 1 + byteCount );
+
+  SpiPort_Transfer( &data[1], &data[1], byteCount );
+
+  data[0] = REPLY_SUCCESS;
+  txBuffer->WriteElemArray( data, 1 + byteCount );
+
+  return true;
+}
+
+
+// Processes the commands that have a single-byte reply. Returns whether the command succeeded.
+
+static bool ProcessSimpleCommand ( const uint8_t cmdCode )
+{
+  switch ( cmdCode & 0xF0 )
+  {
+  case SPI_CMD_CONFIG_PERIPHERALS:
+    SpiPort_SetPullUps( 0 != ( cmdCode & 0x04 ) );
+    SpiPort_SetChipSelect( 0 == ( cmdCode & 0x01 ) );
+    return true;
+
+  case SPI_CMD_SET_SPEED:
+    if ( ( cmdCode & 0x0F ) > 7 )
+      return false;
+
+    return SpiPort_SetSpeed( cmdCode & 0x07 );
+
+  case SPI_CMD_CONFIG_BUS:
+    SpiPort_SetBusConfig( 0 == ( cmdCode & 0x08 ),
+                          0 != ( cmdCode & 0x04 ),
+                          0 != ( cmdCode & 0x02 ) );
+    return true;
+
+  default:
+    break;
+  }
+
+  switch ( cmdCode )
+  {
+  case SPI_CMD_CS_LOW:
+    SpiPort_SetChipSelect( true );
+    return true;
+
+  case SPI_CMD_CS_HIGH:
+    SpiPort_SetChipSelect( false );
+    return true;
+
+  default:
+    // This includes the sniffer commands.
+    return false;
+  }
+}
+
+
+static bool ProcessCommand ( CUsbRxBuffer * const rxBuffer, CUsbTxBuffer * const txBuffer )
+{
+  assert( !rxBuffer->IsEmpty() );
+
+  const uint8_t cmdCode = *rxBuffer->PeekElement();
+
+  if ( ( cmdCode & 0xF0 ) == SPI_CMD_BULK_TRANSFER )
+    return BulkTransfer( rxBuffer, txBuffer );
+
+  switch ( cmdCode )
+  {
+  case SPI_CMD_WRITE_THEN_READ:
+  case SPI_CMD_WRITE_THEN_READ_NO_CS:
+    return StartWriteThenRead( rxBuffer, txBuffer );
+
+  case SPI_CMD_EXIT:
+    // Mode switching speed is not important, so wait until the Tx Buffer is empty,
+    // see ChangeBusPirateMode() for more information.
+    if ( !txBuffer->IsEmpty() )
+      return false;
+
+    rxBuffer->ConsumeReadElements( 1 );
+    ChangeBusPirateMode( bpBinMode, txBuffer );
+
+    // This mode is no longer active, so stop processing data here.
+    return false;
+
+  case SPI_CMD_MODE_VERSION:
+    if ( txBuffer->GetFreeCount() < 4 )
+      return false;
+
+    rxBuffer->ConsumeReadElements( 1 );
+    SendSpiModeWelcome( txBuffer );
+    return true;
+
+  default:
+    break;
+  }
+
+  if ( txBuffer->IsFull() )
+    return false;
+
+  rxBuffer->ConsumeReadElements( 1 );
+
+  txBuffer->WriteElem( ProcessSimpleCommand( cmdCode ) ? REPLY_SUCCESS : REPLY_FAILURE );
+
+  return true;
+}
+
+
+// flashrom sends many small commands, and speed matters when programming an SPI flash,
+// so process as many commands as possible in one go, within the main loop time budget,
+// see MAIN_LOOP_TIME_BUDGET_US.
+//
+// Like the real Bus Pirate, this mode reports errors with a reply code, so it never resets the connection.
+
+ProtocolResult BusPirateSpiMode_ProcessData ( CUsbRxBuffer * const rxBuffer, CUsbTxBuffer * const txBuffer )
+{
+  assert( s_wasInitialised );
+
+  const uint32_t startTime = GetCycleCount();
+
+  for ( ; ; )
+  {
+    bool hasMadeProgress;
+
+    switch ( s_writeThenReadState )
+    {
+    case wtrIdle:
+      hasMadeProgress = !rxBuffer->IsEmpty() && ProcessCommand( rxBuffer, txBuffer );
+      break;
+
+    case wtrWriting:
+      hasMadeProgress = ContinueWriteThenReadWriting( rxBuffer, txBuffer );
+      break;
+
+    case wtrReading:
+      hasMadeProgress = ContinueWriteThenReadReading( txBuffer );
+      break;
+
+    default:
+      assert( false );
+      hasMadeProgress = false;
+      break;
+    }
+
+    if ( !hasMadeProgress )
+      break;
+
+    if ( HasMainLoopTimeBudgetExpired( startTime ) )
+      break;
+  }
+
+  return ProtocolResult::Ok();
+}
+
+
+void BusPirateSpiMode_Init ( CUsbTxBuffer * const txBuffer )
+{
+  assert( !s_wasInitialised );
+
+  #ifndef NDEBUG
+    s_wasInitialised = true;
+  #endif
+
+  s_writeThenReadState = wtrIdle;
+
+  SpiPort_Init();
+
+  SendSpiModeWelcome( txBuffer );
+}
+
+
+void BusPirateSpiMode_Terminate ( void )
+{
+  assert( s_wasInitialised );
+
+  SpiPort_Terminate();
+
+  #ifndef NDEBUG
+   s_wasInitialised = false;
+  #endif
+}
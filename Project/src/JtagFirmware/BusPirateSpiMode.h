@@ -0,0 +1,32 @@
+#pragma once
+
+#include "UsbBuffers.h"
+#include "ProtocolResult.h"
+
+// This is the Bus Pirate's binary SPI mode, which is entered from the binary mode with command 0x01.
+// It is compatible with flashrom's 'buspirate_spi' programmer, which turns the DebugDue into an SPI flash programmer.
+//
+// Supported commands:
+//   0x00        Go back to the binary mode, reply "BBIO1".
+//   0x01        Reply the mode version string "SPI1".
+//   0x02/0x03   Chip select active (low) / inactive (high).
+//   0x04/0x05   Write then read, with/without automatic chip select handling:
+//               0x04, write byte count (2 bytes), read byte count (2 bytes), data to write
+//               The reply is 0x01 followed by the data read, or just 0x00 if a byte count is too big.
+//   0x1n        Bulk transfer of n+1 bytes (1-16), followed by the bytes to send.
+//               The reply is 0x01 followed by the bytes received.
+//   0x4w        Configure peripherals: bit 2 = pull-ups, bit 0 = chip select level.
+//               The power supply (bit 3) and AUX (bit 1) bits are ignored.
+//   0x60-0x67   Set the SPI clock speed, see SpiPort_SetSpeed(). The reply is 0x00 for the speeds
+//               the SAM3X cannot reach (0x60-0x62). The default speed is 1 MHz (0x63).
+//   0x8w        SPI configuration: bit 3 = push-pull outputs (otherwise open drain), bit 2 = clock idle high,
+//               bit 1 = output on the active to idle clock edge, bit 0 = sample at the end (ignored).
+//
+// All multi-byte values are big endian. All commands except for 0x00, 0x01 and the write then read command
+// reply with 0x01 on success. Unknown commands reply with 0x00. The sniffer commands are not supported.
+
+#define BIN_CMD_SPI_MODE  (uint8_t( 0x01 ))
+
+void BusPirateSpiMode_Init ( CUsbTxBuffer * txBuffer );
+void BusPirateSpiMode_Terminate ( void );
+ProtocolResult BusPirateSpiMode_ProcessData ( CUsbRxBuffer * rxBuffer, CUsbTxBuffer * txBuffer );
@@ -0,0 +1,712 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "BusPirateSvfMode.h"  // The include file for this module should come first.
+
+#include <assert.h>
+#include <inttypes.h>
+
+#include <BareMetalSupport/SerialPrint.h>
+#include <BareMetalSupport/Miscellaneous.h>
+#include <BareMetalSupport/IoUtils.h>
+#include <BareMetalSupport/CycleCounter.h>
+#include <BareMetalSupport/SysTickUtils.h>
+#include <BareMetalSupport/MainLoopSleep.h>
+#include <BareMetalSupport/Uptime.h>
+#include <Misc/AssertionUtils.h>
+
+#include "BusPirateConnection.h"
+#include "BusPirateOpenOcdMode.h"
+#include "Globals.h"
+#include "JtagPins.h"
+
+
+#ifndef NDEBUG
+  static bool s_wasInitialised = false;
+#endif
+
+
+// Command codes.
+static const uint8_t SVF_CMD_EXIT         = 0x00;
+static const uint8_t SVF_CMD_MODE_VERSION = 0x01;
+static const uint8_t SVF_CMD_REPORT       = 0x02;
+static const uint8_t SVF_CMD_TRST         = 0x03;
+static const uint8_t SVF_CMD_STATE        = 0x10;
+static const uint8_t SVF_CMD_RUNTEST      = 0x11;
+static const uint8_t SVF_CMD_SIR          = 0x12;
+static const uint8_t SVF_CMD_SDR          = 0x13;
+
+static const uint8_t SCAN_FLAG_COMPARE_TDO = 0x01;
+
+static const uint8_t TRST_OFF    = 0;
+static const uint8_t TRST_ON     = 1;
+static const uint8_t TRST_Z      = 2;
+static const uint8_t TRST_ABSENT = 3;
+
+static const uint32_t SVF_MODE_WELCOME_LEN = 4;  // "SVF1"
+static const uint32_t REPORT_LEN           = 16;
+
+static const uint32_t TRST_CMD_LEN    = 1 + 1;
+static const uint32_t STATE_CMD_LEN   = 1 + 1;
+static const uint32_t RUNTEST_CMD_LEN = 1 + 1 + 1 + 4 + 4;
+static const uint32_t SCAN_CMD_LEN    = 1 + 1 + 1 + 4;
+
+static const uint32_t MAX_CMD_LEN = RUNTEST_CMD_LEN;
+
+
+// The TAP states are numbered as documented in the header file.
+
+enum TapStateEnum
+{
+  tsReset,
+  tsIdle,
+  tsDrSelect,
+  tsDrCapture,
+  tsDrShift,
+  tsDrExit1,
+  tsDrPause,
+  tsDrExit2,
+  tsDrUpdate,
+  tsIrSelect,
+  tsIrCapture,
+  tsIrShift,
+  tsIrExit1,
+  tsIrPause,
+  tsIrExit2,
+  tsIrUpdate,
+
+  tsUnknown  // Not part of the protocol. We do not know the state until the first command moves the TAP.
+};
+
+static const uint8_t TAP_STATE_COUNT = tsUnknown;
+
+// The next state after a TCK cycle with TMS = 0 and with TMS = 1.
+
+static const uint8_t TAP_NEXT_STATE[ TAP_STATE_COUNT ][ 2 ] =
+{
+  { tsIdle     , tsReset    },  // tsReset
+  { tsIdle     , tsDrSelect },  // tsIdle
+  { tsDrCapture, tsIrSelect },  // tsDrSelect
+  { tsDrShift  , tsDrExit1  },  // tsDrCapture
+  { tsDrShift  , tsDrExit1  },  // tsDrShift
+  { tsDrPause  , tsDrUpdate },  // tsDrExit1
+  { tsDrPause  , tsDrExit2  },  // tsDrPause
+  { tsDrShift  , tsDrUpdate },  // tsDrExit2
+  { tsIdle     , tsDrSelect },  // tsDrUpdate
+  { tsIrCapture, tsReset    },  // tsIrSelect
+  { tsIrShift  , tsIrExit1  },  // tsIrCapture
+  { tsIrShift  , tsIrExit1  },  // tsIrShift
+  { tsIrPause  , tsIrUpdate },  // tsIrExit1
+  { tsIrPause  , tsIrExit2  },  // tsIrPause
+  { tsIrShift  , tsIrUpdate },  // tsIrExit2
+  { tsIdle     , tsDrSelect },  // tsIrUpdate
+};
+
+static uint8_t s_tapState;
+
+
+// Long SIR, SDR and RUNTEST commands are processed in chunks over several main loop iterations.
+
+enum PlayerStateEnum
+{
+  psIdle,
+  psScanning,         // Shifting the SIR or SDR data as it arrives.
+  psRunTestClocking,  // Generating the RUNTEST clock cycles.
+  psRunTestWaiting    // Waiting for the RUNTEST minimum time to elapse.
+};
+
+static PlayerStateEnum s_playerState;
+
+// When skipping, the current command is consumed but not executed, see s_hasFailed.
+static bool s_isSkipping;
+
+static bool     s_scanCompareTdo;
+static uint8_t  s_scanExit1State;
+static uint8_t  s_scanEndState;
+static uint32_t s_scanRemainingBitCount;
+static uint32_t s_scanBitOffset;
+
+static uint8_t  s_runTestEndState;
+static uint8_t  s_runTestTms8;
+static uint32_t s_runTestRemainingTckCount;
+static uint32_t s_runTestMinTimeUs;
+static uint32_t s_runTestStartCycleCount;
+static uint64_t s_runTestStartUptime;
+
+// The results since the last report.
+static uint32_t s_jtagCmdCount;
+static bool     s_hasFailed;
+static uint32_t s_failedCmdIndex;
+static uint32_t s_failedBitOffset;
+static uint8_t  s_failedTdo8;
+static uint8_t  s_failedExpectedTdo8;
+static uint8_t  s_failedMask8;
+
+
+static void SendSvfModeWelcome ( CUsbTxBuffer * const txBuffer )
+{
+  UsbPrintStr( txBuffer, "SVF1" );
+}
+
+
+static uint32_t ReadBigEndianUint32 ( const uint8_t * const data ) throw()
+{
+  return ( uint32_t( data[0] ) << 24 ) |
+         ( uint32_t( data[1] ) << 16 ) |
+         ( uint32_t( data[2] ) <<  8 ) |
+         ( uint32_t( data[3] )       );
+}
+
+
+static void WriteBigEndianUint32 ( CUsbTxBuffer * const txBuffer, const uint32_t val )
+{
+  assert( txBuffer->GetFreeCount() >= 4 );
+
+  txBuffer->WriteElem( uint8_t( val >> 24 ) );
+  txBuffer->WriteElem( uint8_t( val >> 16 ) );
+  txBuffer->WriteElem( uint8_t( val >>  8 ) );
+  txBuffer->WriteElem( uint8_t( val       ) );
+}
+
+
+static bool IsStableState ( const uint8_t state ) throw()
+{
+  return state == tsReset   ||
+         state == tsIdle    ||
+         state == tsDrPause ||
+         state == tsIrPause;
+}
+
+
+static void ResetResults ( void )
+{
+  s_jtagCmdCount       = 0;
+  s_hasFailed          = false;
+  s_failedCmdIndex     = 0;
+  s_failedBitOffset    = 0;
+  s_failedTdo8         = 0;
+  s_failedExpectedTdo8 = 0;
+  s_failedMask8        = 0;
+}
+
+
+// Moves the TAP to the given state along the shortest path.
+
+static void MoveToState ( const uint8_t targetState )
+{
+  assert( targetState < TAP_STATE_COUNT );
+
+  // 5 TCK cycles with TMS high reach the Test-Logic-Reset state from anywhere. SVF requires this path
+  // when moving to RESET, and it is also the only way to leave an unknown state.
+
+  if ( s_tapState == tsUnknown ||
+       ( targetState == tsReset && s_tapState != tsReset ) )
+  {
+    ShiftJtagBits( 0, 0x1F, 5 );
+    s_tapState = tsReset;
+  }
+
+  if ( s_tapState == targetState )
+    return;
+
+  // There are only 16 states, so a breadth-first search is fast enough.
+
+  bool    visited      [ TAP_STATE_COUNT ] = {};
+  uint8_t previousState[ TAP_STATE_COUNT ];
+  uint8_t previousTms  [ TAP_STATE_COUNT ];
+  uint8_t queue        [ TAP_STATE_COUNT ];
+
+  uint32_t queueHead = 0;
+  uint32_t queueTail = 0;
+
+  visited[ s_tapState ] = true;
+  queue[ queueTail++ ] = s_tapState;
+
+  while ( queueHead < queueTail && !visited[ targetState ] )
+  {
+    const uint8_t state = queue[ queueHead++ ];
+
+    for ( uint8_t tms = 0; tms < 2; ++tms )
+    {
+      const uint8_t nextState = TAP_NEXT_STATE[ state ][ tms ];
+
+      if ( !visited[ nextState ] )
+      {
+        visited      [ nextState ] = true;
+        previousState[ nextState ] = state;
+        previousTms  [ nextState ] = tms;
+        queue[ queueTail++ ] = nextState;
+      }
+    }
+  }
+
+  assert( visited[ targetState ] );
+
+  // Walk the path backwards, so that the first TMS bit ends up in the LSB.
+
+  uint8_t tms8 = 0;
+  uint8_t bitCount = 0;
+
+  for ( uint8_t state = targetState; state != s_tapState; state = previousState[ state ] )
+  {
+    tms8 = uint8_t( ( tms8 << 1 ) | previousTms[ state ] );
+    ++bitCount;
+  }
+
+  // The longest shortest path in the TAP state machine has 7 steps.
+  assert( bitCount > 0 && bitCount <= 8 );
+
+  ShiftJtagBits( 0, tms8, bitCount );
+
+  s_tapState = targetState;
+}
+
+
+static void ShiftScanGroup ( const uint8_t * const group )
+{
+  assert( s_scanRemainingBitCount > 0 );
+
+  const uint8_t bitCount = uint8_t( MinFrom( s_scanRemainingBitCount, uint32_t( 8 ) ) );
+  const uint8_t usedBitsMask = uint8_t( 0xFF >> ( 8 - bitCount ) );
+
+  if ( !s_isSkipping )
+  {
+    // The last bit leaves the Shift-xR state.
+    const bool isLastGroup = s_scanRemainingBitCount <= 8;
+    const uint8_t tms8 = isLastGroup ? uint8_t( 1 << ( bitCount - 1 ) ) : 0;
+
+    const uint8_t tdo8 = ShiftJtagBits( group[0] & usedBitsMask, tms8, bitCount );
+
+    if ( s_scanCompareTdo && !s_hasFailed )
+    {
+      const uint8_t mismatch = ( tdo8 ^ group[1] ) & group[2] & usedBitsMask;
+
+      if ( mismatch != 0 )
+      {
+        s_hasFailed          = true;
+        s_failedCmdIndex     = s_jtagCmdCount - 1;
+        s_failedBitOffset    = s_scanBitOffset + uint32_t( __builtin_ctz( mismatch ) );
+        s_failedTdo8         = tdo8;
+        s_failedExpectedTdo8 = group[1] & usedBitsMask;
+        s_failedMask8        = group[2] & usedBitsMask;
+
+        if ( false )
+        {
+          SerialPrintf( "SVF TDO mismatch in command %" PRIu32 " at bit %" PRIu32 "." EOL,
+                        s_failedCmdIndex, s_failedBitOffset );
+        }
+      }
+    }
+  }
+
+  s_scanBitOffset         += bitCount;
+  s_scanRemainingBitCount -= bitCount;
+}
+
+
+// All routines below return false if they could not make any progress,
+// because there is not enough data in the Rx Buffer or not enough space in the Tx Buffer.
+
+static bool ContinueScan ( CUsbRxBuffer * const rxBuffer )
+{
+  assert( s_playerState == psScanning );
+
+  const uint32_t groupLen = s_scanCompareTdo ? 3 : 1;
+
+  uint32_t availableCount;
+  const uint8_t * readPtr = rxBuffer->GetReadPtr( &availableCount );
+
+  uint32_t groupCount = availableCount / groupLen;
+
+  uint8_t wrappedGroup[ 3 ];
+
+  if ( groupCount == 0 )
+  {
+    // The next group wraps around the end of the circular buffer.
+    if ( rxBuffer->GetElemCount() < groupLen )
+      return false;
+
+    rxBuffer->PeekMultipleElements( groupLen, wrappedGroup );
+    readPtr = wrappedGroup;
+    groupCount = 1;
+  }
+
+  groupCount = MinFrom( groupCount, ( s_scanRemainingBitCount + 7 ) / 8 );
+
+  for ( uint32_t i = 0; i < groupCount; ++i )
+    ShiftScanGroup( &readPtr[ i * groupLen ] );
+
+  rxBuffer->ConsumeReadElements( groupCount * groupLen );
+
+  if ( s_scanRemainingBitCount == 0 )
+  {
+    if ( !s_isSkipping )
+    {
+      s_tapState = s_scanExit1State;
+      MoveToState( s_scanEndState );
+    }
+
+    s_playerState = psIdle;
+  }
+
+  return true;
+}
+
+
+static bool ContinueRunTestClocking ( void )
+{
+  assert( s_playerState == psRunTestClocking );
+
+  // Limit the amount of work per call, so that the time budget can be checked.
+  static const uint32_t MAX_TCK_COUNT_PER_CALL = 4096;
+
+  const uint32_t tckCount = MinFrom( s_runTestRemainingTckCount, MAX_TCK_COUNT_PER_CALL );
+
+  for ( uint32_t i = 0; i < tckCount; i += 8 )
+  {
+    const uint8_t bitCount = uint8_t( MinFrom( tckCount - i, uint32_t( 8 ) ) );
+
+    ShiftJtagBits( 0, s_runTestTms8 & uint8_t( 0xFF >> ( 8 - bitCount ) ), bitCount );
+  }
+
+  s_runTestRemainingTckCount -= tckCount;
+
+  if ( s_runTestRemainingTckCount == 0 )
+    s_playerState = psRunTestWaiting;
+
+  return true;
+}
+
+
+// The cycle counter wraps around after some 51 seconds at 84 MHz, so longer waits use the uptime,
+// which has a coarser resolution.
+
+static const uint32_t MAX_CYCLE_COUNTER_WAIT_US = 30 * 1000 * 1000;
+
+static bool ContinueRunTestWaiting ( void )
+{
+  assert( s_playerState == psRunTestWaiting );
+
+  bool hasElapsed;
+
+  if ( s_runTestMinTimeUs <= MAX_CYCLE_COUNTER_WAIT_US )
+  {
+    const uint32_t elapsedUs = CycleCountToUs( GetElapsedCycleCount( s_runTestStartCycleCount ) );
+
+    hasElapsed = elapsedUs >= s_runTestMinTimeUs;
+
+    // Do not let the main loop sleep for a whole system tick if the wait is about to end.
+    if ( !hasElapsed && s_runTestMinTimeUs - elapsedUs < SYSTEM_TICK_PERIOD_MS * 1000 )
+      WakeFromMainLoopSleep();
+  }
+  else
+  {
+    // The uptime is only updated once per system tick.
+    const uint64_t minTimeMs = ( uint64_t( s_runTestMinTimeUs ) + 999 ) / 1000 + SYSTEM_TICK_PERIOD_MS;
+
+    hasElapsed = GetUptime() >= s_runTestStartUptime + minTimeMs;
+  }
+
+  if ( !hasElapsed )
+    return false;
+
+  MoveToState( s_runTestEndState );
+
+  s_playerState = psIdle;
+  return true;
+}
+
+
+static ProtocolResult StartRunTest ( const uint8_t * const cmdData )
+{
+  const uint8_t runState = cmdData[ 1 ];
+  const uint8_t endState = cmdData[ 2 ];
+
+  if ( !IsStableState( runState ) || !IsStableState( endState ) )
+    return ProtocolResult::Error( "Invalid state in the SVF RUNTEST command." );
+
+  if ( s_isSkipping )
+    return ProtocolResult::Ok();
+
+  MoveToState( runState );
+
+  // TMS must keep the TAP in the run state.
+  s_runTestTms8               = runState == tsReset ? 0xFF : 0x00;
+  s_runTestEndState           = endState;
+  s_runTestRemainingTckCount  = ReadBigEndianUint32( &cmdData[ 3 ] );
+  s_runTestMinTimeUs          = ReadBigEndianUint32( &cmdData[ 7 ] );
+  s_runTestStartCycleCount    = GetCycleCount();
+  s_runTestStartUptime        = GetUptime();
+
+  s_playerState = psRunTestClocking;
+
+  return ProtocolResult::Ok();
+}
+
+
+static ProtocolResult StartScan ( const uint8_t * const cmdData )
+{
+  const uint8_t  endState = cmdData[ 1 ];
+  const uint8_t  flags    = cmdData[ 2 ];
+  const uint32_t bitCount = ReadBigEndianUint32( &cmdData[ 3 ] );
+
+  if ( endState >= TAP_STATE_COUNT ||
+       ( flags & ~SCAN_FLAG_COMPARE_TDO ) != 0 ||
+       bitCount == 0 )
+  {
+    return ProtocolResult::Error( "Invalid SVF SIR or SDR command." );
+  }
+
+  const bool isSir = cmdData[ 0 ] == SVF_CMD_SIR;
+
+  s_scanCompareTdo        = 0 != ( flags & SCAN_FLAG_COMPARE_TDO );
+  s_scanExit1State        = isSir ? tsIrExit1 : tsDrExit1;
+  s_scanEndState          = endState;
+  s_scanRemainingBitCount = bitCount;
+  s_scanBitOffset         = 0;
+
+  if ( !s_isSkipping )
+    MoveToState( isSir ? tsIrShift : tsDrShift );
+
+  s_playerState = psScanning;
+
+  return ProtocolResult::Ok();
+}
+
+
+static ProtocolResult ProcessTrst ( const uint8_t level )
+{
+  if ( level != TRST_OFF && level != TRST_ON && level != TRST_Z && level != TRST_ABSENT )
+    return ProtocolResult::Error( "Invalid SVF TRST level." );
+
+  if ( s_isSkipping )
+    return ProtocolResult::Ok();
+
+  // nTRST is active low.
+  SetOutputDataDrivenOnPin( JTAG_TRST_PIO, JTAG_TRST_PIN, level != TRST_ON );
+
+  // The TAP stays in Test-Logic-Reset while nTRST is asserted.
+  if ( level == TRST_ON )
+    s_tapState = tsReset;
+
+  return ProtocolResult::Ok();
+}
+
+
+static void SendReport ( CUsbTxBuffer * const txBuffer )
+{
+  assert( txBuffer->GetFreeCount() >= REPORT_LEN );
+
+  txBuffer->WriteElem( s_hasFailed ? 0x00 : 0x01 );
+  txBuffer->WriteElem( s_failedTdo8 );
+  txBuffer->WriteElem( s_failedExpectedTdo8 );
+  txBuffer->WriteElem( s_failedMask8 );
+
+  WriteBigEndianUint32( txBuffer, s_jtagCmdCount );
+  WriteBigEndianUint32( txBuffer, s_failedCmdIndex );
+  WriteBigEndianUint32( txBuffer, s_failedBitOffset );
+
+  STATIC_ASSERT( REPORT_LEN == 4 + 3 * 4, "Report length mismatch." );
+
+  ResetResults();
+}
+
+
+// Sets *callMeAgain to true if a command was processed and there may be more to process straight away.
+
+static ProtocolResult ProcessCommand ( CUsbRxBuffer * const rxBuffer,
+                                       CUsbTxBuffer * const txBuffer,
+                                       bool * const callMeAgain )
+{
+  assert( s_playerState == psIdle );
+  assert( !*callMeAgain );
+
+  if ( rxBuffer->IsEmpty() )
+    return ProtocolResult::Ok();
+
+  const uint8_t cmdCode = *rxBuffer->PeekElement();
+
+  uint32_t cmdLen;
+
+  switch ( cmdCode )
+  {
+  case SVF_CMD_EXIT:
+    // Mode switching speed is not important, so wait until the Tx Buffer is empty,
+    // see ChangeBusPirateMode() for more information.
+    if ( txBuffer->IsEmpty() )
+    {
+      rxBuffer->ConsumeReadElements( 1 );
+      ChangeBusPirateMode( bpBinMode, txBuffer );
+    }
+
+    // This mode is no longer active, so stop processing data here.
+    return ProtocolResult::Ok();
+
+  case SVF_CMD_MODE_VERSION:
+    if ( txBuffer->GetFreeCount() >= SVF_MODE_WELCOME_LEN )
+    {
+      rxBuffer->ConsumeReadElements( 1 );
+      SendSvfModeWelcome( txBuffer );
+      *callMeAgain = true;
+    }
+    return ProtocolResult::Ok();
+
+  case SVF_CMD_REPORT:
+    if ( txBuffer->GetFreeCount() >= REPORT_LEN )
+    {
+      rxBuffer->ConsumeReadElements( 1 );
+      SendReport( txBuffer );
+      *callMeAgain = true;
+    }
+    return ProtocolResult::Ok();
+
+  case SVF_CMD_TRST:    cmdLen = TRST_CMD_LEN;    break;
+  case SVF_CMD_STATE:   cmdLen = STATE_CMD_LEN;   break;
+  case SVF_CMD_RUNTEST: cmdLen = RUNTEST_CMD_LEN; break;
+  case SVF_CMD_SIR:
+  case SVF_CMD_SDR:     cmdLen = SCAN_CMD_LEN;    break;
+
+  default:
+    return ProtocolResult::Error( "Unknown SVF player command." );
+  }
+
+
+  // The rest are JTAG commands.
+
+  if ( rxBuffer->GetElemCount() < cmdLen )
+    return ProtocolResult::Ok();
+
+  uint8_t cmdData[ MAX_CMD_LEN ];
+  assert( cmdLen <= MAX_CMD_LEN );
+  rxBuffer->PeekMultipleElements( cmdLen, cmdData );
+  rxBuffer->ConsumeReadElements( cmdLen );
+
+  ++s_jtagCmdCount;
+  s_isSkipping = s_hasFailed;
+
+  *callMeAgain = true;
+
+  switch ( cmdCode )
+  {
+  case SVF_CMD_TRST:
+    return ProcessTrst( cmdData[ 1 ] );
+
+  case SVF_CMD_STATE:
+    if ( cmdData[ 1 ] >= TAP_STATE_COUNT )
+      return ProtocolResult::Error( "Invalid state in the SVF STATE command." );
+
+    if ( !s_isSkipping )
+      MoveToState( cmdData[ 1 ] );
+
+    return ProtocolResult::Ok();
+
+  case SVF_CMD_RUNTEST:
+    return StartRunTest( cmdData );
+
+  case SVF_CMD_SIR:
+  case SVF_CMD_SDR:
+    return StartScan( cmdData );
+
+  default:
+    assert( false );
+    return ProtocolResult::Ok();
+  }
+}
+
+
+// Process as much data as possible in one go, within the main loop time budget,
+// see MAIN_LOOP_TIME_BUDGET_US.
+
+ProtocolResult BusPirateSvfMode_ProcessData ( CUsbRxBuffer * const rxBuffer, CUsbTxBuffer * const txBuffer )
+{
+  assert( s_wasInitialised );
+
+  const uint32_t startTime = GetCycleCount();
+
+  for ( ; ; )
+  {
+    bool hasMadeProgress = false;
+
+    switch ( s_playerState )
+    {
+    case psIdle:
+      {
+        const ProtocolResult result = ProcessCommand( rxBuffer, txBuffer, &hasMadeProgress );
+
+        if ( !result.IsOk() )
+          return result;
+      }
+      break;
+
+    case psScanning:
+      hasMadeProgress = ContinueScan( rxBuffer );
+      break;
+
+    case psRunTestClocking:
+      hasMadeProgress = ContinueRunTestClocking();
+      break;
+
+    case psRunTestWaiting:
+      hasMadeProgress = ContinueRunTestWaiting();
+      break;
+
+    default:
+      assert( false );
+      break;
+    }
+
+    if ( !hasMadeProgress )
+      break;
+
+    if ( HasMainLoopTimeBudgetExpired( startTime ) )
+      break;
+  }
+
+  return ProtocolResult::Ok();
+}
+
+
+void BusPirateSvfMode_Init ( CUsbTxBuffer * const txBuffer )
+{
+  assert( !s_wasInitialised );
+
+  #ifndef NDEBUG
+    s_wasInitialised = true;
+  #endif
+
+  s_playerState = psIdle;
+  s_isSkipping  = false;
+  s_tapState    = tsUnknown;
+
+  ResetResults();
+
+  const ProtocolResult result = SetJtagPinMode( MODE_JTAG );
+  assert( result.IsOk() );
+  UNUSED_IN_RELEASE( result );
+
+  SendSvfModeWelcome( txBuffer );
+}
+
+
+void BusPirateSvfMode_Terminate ( void )
+{
+  assert( s_wasInitialised );
+
+  InitJtagPins();
+
+  #ifndef NDEBUG
+   s_wasInitialised = false;
+  #endif
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "UsbBuffers.h"
+#include "ProtocolResult.h"
+
+// This is an SVF player that runs on the DebugDue itself. It is entered from the binary mode with command 0x20.
+//
+// The host does not send the SVF text, but a compact binary stream compiled from it by Tools/SvfPlayer.pl .
+// The stream is executed as it arrives, so the host can send it in one go without waiting for any replies.
+// The TDO data is compared on the DebugDue, which only reports pass or fail and the first mismatch.
+// Therefore, the USB round-trip latency does not limit the speed.
+//
+// Standard XSVF cannot be streamed in this way, because XSDRTDO places all expected TDO data
+// after all TDI data for the same scan. In the format below, the data is interleaved in 8-bit groups.
+//
+// Commands:
+//   0x00  Go back to the binary mode, reply "BBIO1".
+//   0x01  Reply the mode version string "SVF1".
+//   0x02  Report the results so far and reset them. The reply has 16 bytes:
+//           - 0x01 if all TDO comparisons passed, or 0x00 otherwise.
+//           - The TDO, expected TDO and mask bytes for the 8-bit group where the first mismatch occurred.
+//           - The number of JTAG commands received since the last report (4 bytes).
+//           - The index of the first failed JTAG command since the last report (4 bytes).
+//           - The bit offset of the first mismatch inside that command (4 bytes).
+//         After the first mismatch, all JTAG commands up to the next report are discarded
+//         without touching the JTAG pins, like SVF players do when they stop at the first error.
+//   0x03  TRST, followed by 1 byte: 0 = off, 1 = on, 2 = Z, 3 = absent. Z and absent leave nTRST high.
+//
+// JTAG commands:
+//   0x10  STATE, followed by the target state (1 byte). The TAP moves to that state along the shortest path.
+//   0x11  RUNTEST, followed by the run state (1 byte), the end state (1 byte), the TCK count (4 bytes)
+//         and the minimum time in microseconds (4 bytes). The run and end states must be stable states.
+//   0x12  SIR, followed by the end state (1 byte), flags (1 byte), the bit count (4 bytes) and the data.
+//   0x13  SDR, same as SIR.
+//         Flag 0x01 means that TDO should be compared. The data consists of 8-bit groups, LSB first,
+//         and each group has 1 byte of TDI data, or 3 bytes if TDO is compared: TDI, expected TDO and mask.
+//         The unused bits in the last group must be zero. The bit count must not be zero.
+//
+// The states are numbered like this:  0 RESET     1 IDLE       2 DRSELECT   3 DRCAPTURE
+//                                     4 DRSHIFT   5 DREXIT1    6 DRPAUSE    7 DREXIT2
+//                                     8 DRUPDATE  9 IRSELECT  10 IRCAPTURE 11 IRSHIFT
+//                                    12 IREXIT1  13 IRPAUSE   14 IREXIT2   15 IRUPDATE
+// The stable states are RESET, IDLE, DRPAUSE and IRPAUSE.
+//
+// All multi-byte values are big endian. An invalid stream is a protocol error, which resets the connection.
+// Entering this mode drives the JTAG pins, and leaving it sets them back to high impedance.
+
+#define BIN_CMD_SVF_MODE  (uint8_t( 0x20 ))
+
+void BusPirateSvfMode_Init ( CUsbTxBuffer * txBuffer );
+void BusPirateSvfMode_Terminate ( void );
+ProtocolResult BusPirateSvfMode_ProcessData ( CUsbRxBuffer * rxBuffer, CUsbTxBuffer * txBuffer );
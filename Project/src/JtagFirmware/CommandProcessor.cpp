@@ -18,6 +18,13 @@
 #include <BareMetalSupport/IntegerPrintUtils.h>
 #include <BareMetalSupport/DebugConsoleEol.h>
 #include <BareMetalSupport/LinkScriptSymbols.h>
+#include <BareMetalSupport/CycleCounter.h>
+#include <BareMetalSupport/BootTimestamps.h>
+#include <BareMetalSupport/NoInitData.h>
+
+#if USE_POOL_ALLOCATOR
+  #include <BareMetalSupport/PoolAllocator.h>
+#endif
 
 #include <Misc/AssertionUtils.h>
 
@@ -26,6 +33,7 @@
 #include "Globals.h"
 #include "BusPirateOpenOcdMode.h"
 #include "JtagPins.h"
+#include "UsbTxFlushPolicy.h"
 
 #include <rstc.h>
 
@@ -33,9 +41,10 @@
 static const char SPACE_AND_TAB[] = " \t";
 
 
-uint8_t g_usbSpeedTestBuffer[ 1000 ];
+uint8_t g_usbSpeedTestBuffer[ 1000 ] NOINIT_DATA;
 uint64_t g_usbSpeedTestEndTime;
 UsbSpeedTestEnum g_usbSpeedTestType;
+UsbSpeedTestParams g_usbSpeedTestParams;
 
 
 static bool DoesStrMatch ( const char * const strBegin,
@@ -108,13 +117,16 @@ static bool IsCmd ( const char * const cmdBegin,
 
 
 
-// This routine could be improved in many ways:
-// - Make it faster by building a complete line and sending it at once.
-// - Provide memory addresses and/or offsets on the left.
-// - Provide an ASCII dump on the right.
-// - Use different data sizes (8 bits, 16 bits, 32 bits).
-//
-//  There is a similar routine in this project called SerialHexDump().
+// Each line of the hex dump is formatted in a buffer and printed in one go.
+// There is a similar routine in this project called SerialPrintHexDump().
+
+static const size_t HEX_DUMP_BYTES_PER_LINE = 32;
+
+// The line length is "XX " per byte + end of line.
+static const size_t HEX_DUMP_LINE_LEN = HEX_DUMP_BYTES_PER_LINE * 3 + HEX_DUMP_MAX_EOL_LEN;
+
+// Due to the USB buffer size limit and the watchdog period, the whole hex dump must fit in the Tx Buffer.
+static const size_t PRINT_MEMORY_MAX_BYTE_COUNT = 1024;
 
 void CCommandProcessor::HexDump ( const void * const ptr,
                                   const size_t byteCount,
@@ -122,50 +134,31 @@ void CCommandProcessor::HexDump ( const void * const ptr,
 {
   assert( byteCount > 0 );
 
-  const unsigned LINE_BYTE_COUNT = 32;
-  const size_t eolLen = strlen( endOfLineChars );
-  const size_t lineCount = ( byteCount + LINE_BYTE_COUNT - 1 ) / LINE_BYTE_COUNT;
-  const size_t expectedOutputLen = byteCount * 3 + lineCount * eolLen;
-
-  // Example on how to use expectedOutputLen beforehand:
-  // if ( expectedOutputLen > txBuffer->GetFreeCount() )
-  //   throw std::runtime_error( "Not enough room in the Tx buffer for the hex dump." );
-  UNUSED_IN_RELEASE( expectedOutputLen );
-
   const uint8_t * const bytePtr = static_cast< const uint8_t * >( ptr );
 
-  unsigned lineElemCount = 0;
-  size_t actualOutputLen = 0;
-
-  for ( size_t i = 0; i < byteCount; ++i )
+  for ( size_t offset = 0; offset < byteCount; offset += HEX_DUMP_BYTES_PER_LINE )
   {
-    if ( lineElemCount == LINE_BYTE_COUNT )
-    {
-      lineElemCount = 0;
-      Printf( "%s", endOfLineChars );
-      actualOutputLen += eolLen;
-    }
-    const uint8_t b = bytePtr[ i ];
-
-    Printf( "%02X ", b );
-    actualOutputLen += 3;
-
-    ++lineElemCount;
-  }
-
-  Printf( "%s", endOfLineChars );
-  actualOutputLen += eolLen;
-
-  if ( actualOutputLen != expectedOutputLen )
-  {
-    assert( false );
+    char line[ HEX_DUMP_LINE_BUFSIZE ];
+
+    const size_t lineLen = FormatHexDumpLine( bytePtr + offset,
+                                              MinFrom( byteCount - offset, HEX_DUMP_BYTES_PER_LINE ),
+                                              HEX_DUMP_BYTES_PER_LINE,
+                                              0,
+                                              endOfLineChars,
+                                              line );
+    assert( lineLen <= HEX_DUMP_LINE_LEN );
+    UNUSED_IN_RELEASE( lineLen );
+
+    PrintStr( line );
   }
 }
 
 
-static unsigned int ParseUnsignedIntArg ( const char * const begin )
+// Returns false and prints an error message if the value is not valid.
+
+bool CCommandProcessor::ParseUnsignedIntArg ( const char * const begin, unsigned int * const val )
 {
-  const char ERR_MSG[] = "Invalid unsigned integer value.";
+  const char ERR_MSG[] = "Invalid unsigned integer value." EOL;
 
   int base = 10;
   const char * p = begin;
@@ -181,19 +174,24 @@ static unsigned int ParseUnsignedIntArg ( const char * const begin )
   // strtoul() interprets a leading '-', but we always want an unsigned positive value
   // and the user should not be allowed to enter a negative value.
   if ( *p == '-' )
-    throw std::runtime_error( ERR_MSG );
+  {
+    PrintStr( ERR_MSG );
+    return false;
+  }
 
   char * end2;
   errno = 0;
-  const unsigned long val = strtoul( p, &end2, base );
+  const unsigned long parsedVal = strtoul( p, &end2, base );
 
   if ( errno != 0 || ( *end2 != 0 && !IsCharInSet( *end2, SPACE_AND_TAB ) ) )
   {
-    throw std::runtime_error( ERR_MSG );
+    PrintStr( ERR_MSG );
+    return false;
   }
 
   STATIC_ASSERT( sizeof(unsigned int) == sizeof(unsigned long), "You may want to rethink this routine's data types." );
-  return (unsigned int) val;
+  *val = (unsigned int) parsedVal;
+  return true;
 }
 
 
@@ -212,8 +210,14 @@ void CCommandProcessor::PrintMemory ( const char * const paramBegin )
 
   assert( countBegin > paramBegin );
 
-  const unsigned addr  = ParseUnsignedIntArg( paramBegin );
-  const unsigned count = ParseUnsignedIntArg( countBegin );
+  unsigned addr;
+  unsigned count;
+
+  if ( !ParseUnsignedIntArg( paramBegin, &addr  ) ||
+       !ParseUnsignedIntArg( countBegin, &count ) )
+  {
+    return;
+  }
 
   // SerialPrint( "Addr : %u" EOL, unsigned(addr ) );
   // SerialPrint( "Count: %u" EOL, unsigned(count) );
@@ -224,11 +228,14 @@ void CCommandProcessor::PrintMemory ( const char * const paramBegin )
     return;
   }
 
-  // We could calculate the maximum byte count more accurately using the USB buffer sizes.
-  // Routine HexDump() has also logic to calculate the number of characters needed in advance.
-  if ( count > 1024 )
+  STATIC_ASSERT( PRINT_MEMORY_MAX_BYTE_COUNT / HEX_DUMP_BYTES_PER_LINE * HEX_DUMP_LINE_LEN + 200 < USB_TX_BUFFER_SIZE,
+                 "The hex dump may not fit in the Tx Buffer." );
+
+  if ( count > PRINT_MEMORY_MAX_BYTE_COUNT )
   {
-    PrintStr( "Due to the USB buffer size limit and the watchdog period, the byte count cannot exceed 1024 bytes with the current implementation." EOL );
+    Printf( "Due to the USB buffer size limit and the watchdog period, the byte count cannot exceed %u bytes with the current implementation." EOL,
+            unsigned( PRINT_MEMORY_MAX_BYTE_COUNT ) );
+    PrintStr( "Use the binary mode memory read command for bigger transfers." EOL );
     return;
   }
 
@@ -247,7 +254,10 @@ void CCommandProcessor::BusyWait ( const char * const paramBegin )
     return;
   }
 
-  const unsigned delayMs = ParseUnsignedIntArg( paramBegin );
+  unsigned delayMs;
+
+  if ( !ParseUnsignedIntArg( paramBegin, &delayMs ) )
+    return;
 
   if ( delayMs == 0 || delayMs > 60 * 1000 )
   {
@@ -266,6 +276,33 @@ void CCommandProcessor::BusyWait ( const char * const paramBegin )
 }
 
 
+// Parses up to argCount optional unsigned integer arguments.
+// The caller fills argValues with the default values beforehand.
+
+bool CCommandProcessor::ParseUsbSpeedTestArgs ( const char * const argBegin,
+                                                const unsigned argCount,
+                                                unsigned * const argValues )
+{
+  const char * p = SkipCharsInSet( argBegin, SPACE_AND_TAB );
+
+  for ( unsigned i = 0; i < argCount && *p != 0; ++i )
+  {
+    if ( !ParseUnsignedIntArg( p, &argValues[ i ] ) )
+      return false;
+
+    p = SkipCharsInSet( SkipCharsNotInSet( p, SPACE_AND_TAB ), SPACE_AND_TAB );
+  }
+
+  if ( *p != 0 )
+  {
+    PrintStr( "Too many arguments." EOL );
+    return false;
+  }
+
+  return true;
+}
+
+
 void CCommandProcessor::ProcessUsbSpeedTestCmd ( const char * const paramBegin,
                                                  const uint64_t currentTime )
 {
@@ -274,9 +311,42 @@ void CCommandProcessor::ProcessUsbSpeedTestCmd ( const char * const paramBegin,
   //     echo "UsbSpeedTest TxFastLoopRawUsb" | socat - /dev/debugdue1,b115200,raw,echo=0,crnl | pv -pertb >/dev/null
   //   Tests where the Arduino Due is receiving:
   //     (echo "UsbSpeedTest RxWithCircularBuffer" && yes ".") | pv -pertb - | socat - /dev/debugdue1,b115200,raw,echo=0,crnl >/dev/null
+  //
+  // The following tests measure on the DebugDue itself and need a host-side partner,
+  // see Tools/UsbSpeedTest.pl :
+  //
+  //   PingPong [<count> [<size>]]
+  //     The host sends <count> pings of <size> bytes each, and waits for the echo before sending the next one.
+  //     The DebugDue measures the time from queueing an echo until the next ping has arrived in full,
+  //     so the round trip includes the host's turnaround time.
+  //   FullDuplex
+  //     The DebugDue sends dots as fast as it can while discarding everything it receives,
+  //     until the host sends an 'X'.
+  //   TxSizeSweep [<ms per size>]
+  //     The DebugDue sends dots with udi_cdc_write_buf() for a while with each write size in a fixed list.
+  //     This is the routine that the Tx Buffer ends up calling, so the results show which
+  //     transfer sizes the USB stack handles best.
+  //
+  // When a measuring test finishes, the DebugDue waits for the Tx Buffer to drain and then prints
+  // an empty line followed by lines made of a keyword and "name=value" pairs separated by spaces:
+  //   CONFIG  The compile-time USB settings, printed first.
+  //   RESULT  The test results, one line per write size in TxSizeSweep. Field "status" is "timeout"
+  //           if the test gave up after USB_SPEED_TEST_IDLE_TIMEOUT_MS without any activity.
+  //   HIST    PingPong only, one line for each non-empty bucket of the round-trip histogram.
+  // Then comes the usual "USB speed test finished." message and the prompt.
 
   const uint32_t TEST_TIME_IN_MS = 5000;  // We could make a user parameter out of this value.
 
+  const unsigned PING_PONG_DEFAULT_COUNT = 1000;
+  const unsigned PING_PONG_DEFAULT_SIZE  = 1;
+  // The echo and the results printed at the end must fit in the Tx Buffer.
+  const unsigned PING_PONG_MAX_SIZE      = 1024;
+  STATIC_ASSERT( PING_PONG_MAX_SIZE <= USB_RX_BUFFER_SIZE && PING_PONG_MAX_SIZE <= USB_TX_BUFFER_SIZE, "Otherwise a ping may never fit." );
+
+  const unsigned SWEEP_DEFAULT_STEP_TIME_MS = 500;
+  const unsigned SWEEP_MIN_STEP_TIME_MS     = 10;
+  const unsigned SWEEP_MAX_STEP_TIME_MS     = 10000;
+
   if ( *paramBegin == 0 )
   {
     PrintStr( "Please specify the test type as an argument:" EOL );
@@ -285,6 +355,9 @@ void CCommandProcessor::ProcessUsbSpeedTestCmd ( const char * const paramBegin,
     PrintStr( "  TxFastLoopCircularBuffer" EOL );
     PrintStr( "  TxFastLoopRawUsb" EOL );
     PrintStr( "  RxWithCircularBuffer" EOL );
+    Printf( "  PingPong [<count> [<size>]]  (defaults %u and %u)" EOL, PING_PONG_DEFAULT_COUNT, PING_PONG_DEFAULT_SIZE );
+    PrintStr( "  FullDuplex" EOL );
+    Printf( "  TxSizeSweep [<ms per size>]  (default %u)" EOL, SWEEP_DEFAULT_STEP_TIME_MS );
 
     return;
   }
@@ -295,6 +368,7 @@ void CCommandProcessor::ProcessUsbSpeedTestCmd ( const char * const paramBegin,
   UsbSpeedTestEnum testType = stNone;
 
   bool extraParamsFound = false;
+  uint32_t testTimeMs = TEST_TIME_IN_MS;
 
   if ( IsCmd( paramBegin, paramEnd, "TxSimpleWithTimestamps", false, false, &extraParamsFound ) )
     testType = stTxSimpleWithTimestamps;
@@ -306,13 +380,57 @@ void CCommandProcessor::ProcessUsbSpeedTestCmd ( const char * const paramBegin,
     testType = stTxFastLoopRawUsb;
   else if ( IsCmd( paramBegin, paramEnd, "RxWithCircularBuffer", false, false, &extraParamsFound ) )
     testType = stRxWithCircularBuffer;
+  else if ( IsCmd( paramBegin, paramEnd, "PingPong", false, true, &extraParamsFound ) )
+  {
+    unsigned args[ 2 ] = { PING_PONG_DEFAULT_COUNT, PING_PONG_DEFAULT_SIZE };
+
+    if ( !ParseUsbSpeedTestArgs( paramEnd, 2, args ) )
+      return;
+
+    if ( args[ 0 ] == 0 || args[ 1 ] == 0 || args[ 1 ] > PING_PONG_MAX_SIZE )
+    {
+      Printf( "The ping count must be at least 1, and the ping size must be between 1 and %u bytes." EOL,
+              PING_PONG_MAX_SIZE );
+      return;
+    }
+
+    g_usbSpeedTestParams.pingCount = args[ 0 ];
+    g_usbSpeedTestParams.pingSize  = args[ 1 ];
+    testType = stPingPong;
+    testTimeMs = USB_SPEED_TEST_IDLE_TIMEOUT_MS;
+  }
+  else if ( IsCmd( paramBegin, paramEnd, "FullDuplex", false, false, &extraParamsFound ) )
+  {
+    testType = stFullDuplex;
+    testTimeMs = USB_SPEED_TEST_IDLE_TIMEOUT_MS;
+  }
+  else if ( IsCmd( paramBegin, paramEnd, "TxSizeSweep", false, true, &extraParamsFound ) )
+  {
+    unsigned stepTimeMs = SWEEP_DEFAULT_STEP_TIME_MS;
+
+    if ( !ParseUsbSpeedTestArgs( paramEnd, 1, &stepTimeMs ) )
+      return;
+
+    if ( stepTimeMs < SWEEP_MIN_STEP_TIME_MS || stepTimeMs > SWEEP_MAX_STEP_TIME_MS )
+    {
+      Printf( "The time per write size must be between %u and %u ms." EOL,
+              SWEEP_MIN_STEP_TIME_MS, SWEEP_MAX_STEP_TIME_MS );
+      return;
+    }
+
+    g_usbSpeedTestParams.sweepStepTimeMs = stepTimeMs;
+    testType = stTxSizeSweep;
+    testTimeMs = USB_SPEED_TEST_IDLE_TIMEOUT_MS;
+  }
 
   if ( testType != stNone )
   {
     for ( size_t i = 0; i < sizeof( g_usbSpeedTestBuffer ); ++i )
       g_usbSpeedTestBuffer[ i ] = '.';
 
-    g_usbSpeedTestEndTime = currentTime + TEST_TIME_IN_MS;
+    // For the measuring tests, this is only the first deadline, which gets pushed back
+    // every time there is some activity.
+    g_usbSpeedTestEndTime = currentTime + testTimeMs;
     g_usbSpeedTestType = testType;
 
     // This message may not make it to the console, depending on the test type.
@@ -368,6 +486,38 @@ void CCommandProcessor::DisplayResetCause ( void )
 }
 
 
+// The CPU load tables have many lines, and this is much faster than
+// Printf( "%3" PRIu32 " %%" EOL, percentage ).
+
+static const size_t PERCENTAGE_LINE_BUFSIZE = 3 + sizeof( " %" EOL );
+
+static const char * FormatPercentageLine ( const uint32_t percentage,
+                                           const size_t minDigitCount,
+                                           char * const buffer )
+{
+  assert( percentage <= 100 );
+  assert( minDigitCount <= 3 );
+
+  char decBuffer[ CONVERT_UINT32_TO_DEC_BUFSIZE ];
+  const char * const digits = ConvertUint32ToDec( percentage, decBuffer );
+  const size_t digitCount = strlen( digits );
+
+  char * p = buffer;
+
+  for ( size_t i = digitCount; i < minDigitCount; ++i )
+    *p++ = ' ';
+
+  memcpy( p, digits, digitCount );
+  p += digitCount;
+
+  strcpy( p, " %" EOL );
+
+  assert( p + strlen( p ) < buffer + PERCENTAGE_LINE_BUFSIZE );
+
+  return buffer;
+}
+
+
 void CCommandProcessor::DisplayCpuLoad ( void )
 {
   const uint8_t * lastMinute;
@@ -401,7 +551,8 @@ void CCommandProcessor::DisplayCpuLoad ( void )
 
     assert( val <= 100 );
 
-    Printf( "%3" PRIu32 " %%" EOL, val );
+    char line[ PERCENTAGE_LINE_BUFSIZE ];
+    PrintStr( FormatPercentageLine( val, 3, line ) );
   }
 
 
@@ -428,7 +579,8 @@ void CCommandProcessor::DisplayCpuLoad ( void )
 
     assert( val <= 100 );
 
-    Printf( "%2" PRIu32 " %%" EOL, val );
+    char line[ PERCENTAGE_LINE_BUFSIZE ];
+    PrintStr( FormatPercentageLine( val, 2, line ) );
   }
 
   Printf( "Average CPU load in the last 60 seconds: %2" PRIu32 " %%" EOL, minuteAverage );
@@ -436,6 +588,72 @@ void CCommandProcessor::DisplayCpuLoad ( void )
 }
 
 
+void CCommandProcessor::DisplayUsbStats ( void )
+{
+  UsbTxStats stats;
+  UsbTxFlushPolicy_GetStats( &stats );
+
+  char buffer[ CONVERT_TO_DEC_BUF_SIZE ];
+
+  Printf( "USB Tx statistics since start-up (current bulk packet size: %" PRIu32 " bytes):" EOL, stats.packetSize );
+  Printf( "Bytes sent: %s" EOL, convert_unsigned_to_dec_th( stats.byteCount, buffer, ',' ) );
+  Printf( "Packets sent (estimated): %s" EOL, convert_unsigned_to_dec_th( stats.packetCount, buffer, ',' ) );
+
+  if ( stats.packetCapacityCount != 0 )
+  {
+    const uint32_t averageFill = uint32_t( stats.byteCount * 100 / stats.packetCapacityCount );
+    Printf( "Average packet fill: %" PRIu32 " %%" EOL, averageFill );
+  }
+
+  PrintStr( "Flushes by reason:" EOL );
+
+  for ( unsigned i = 0; i < utfReasonCount; ++i )
+  {
+    Printf( "  %s: %" PRIu32 EOL, UsbTxFlushPolicy_GetReasonName( UsbTxFlushReasonEnum( i ) ), stats.flushCount[ i ] );
+  }
+}
+
+
+void CCommandProcessor::DisplayBootTimestamps ( void )
+{
+  // The CPU runs at 4 MHz until SetupCpuClock() switches to CPU_CLOCK, so the cycle count
+  // for that phase cannot be converted to time. The rest are relative to that phase.
+  // On the host emulator, only the main loop phase is recorded, relative to the emulator's start-up.
+
+  uint32_t referenceTime;
+
+  if ( GetBootTimestamp( bpClockReady, &referenceTime ) )
+  {
+    Printf( "%s: %" PRIu32 " CPU cycles after reset." EOL, GetBootPhaseName( bpClockReady ), referenceTime );
+    PrintStr( "Microseconds since the clock was ready:" EOL );
+  }
+  else
+  {
+    referenceTime = 0;
+    PrintStr( "Microseconds since start-up:" EOL );
+  }
+
+  char buffer[ CONVERT_TO_DEC_BUF_SIZE ];
+
+  for ( unsigned i = bpClockReady + 1; i < bpCount; ++i )
+  {
+    const BootPhaseEnum phase = BootPhaseEnum( i );
+
+    uint32_t timestamp;
+
+    if ( GetBootTimestamp( phase, &timestamp ) )
+    {
+      const uint32_t elapsedUs = CycleCountToUs( timestamp - referenceTime );
+      Printf( "  %s: %s" EOL, GetBootPhaseName( phase ), convert_unsigned_to_dec_th( elapsedUs, buffer, ',' ) );
+    }
+    else
+    {
+      Printf( "  %s: not recorded" EOL, GetBootPhaseName( phase ) );
+    }
+  }
+}
+
+
 void CCommandProcessor::SimulateError ( const char * const paramBegin )
 {
   if ( *paramBegin == 0 )
@@ -455,7 +673,13 @@ void CCommandProcessor::SimulateError ( const char * const paramBegin )
 
   if ( DoesStrMatch( paramBegin, paramEnd, "command", false ) )
   {
-    throw std::runtime_error( "Simulated command error." );
+    #ifdef __EXCEPTIONS
+      throw std::runtime_error( "Simulated command error." );
+    #else
+      // Without C++ exceptions, there is no error path to exercise in ProcessCommand().
+      PrintStr( "Error processing command: Simulated command error." EOL );
+      return;
+    #endif
   }
 
   if ( DoesStrMatch( paramBegin, paramEnd, "protocol", false ) )
@@ -471,11 +695,14 @@ void CCommandProcessor::SimulateError ( const char * const paramBegin )
 static const char * const CMDNAME_QUESTION_MARK = "?";
 static const char * const CMDNAME_HELP = "help";
 static const char * const CMDNAME_I = "i";
+static const char * const CMDNAME_BUS_PIRATE_RESET = "#";
 static const char * const CMDNAME_USBSPEEDTEST = "UsbSpeedTest";
 static const char * const CMDNAME_JTAGPINS = "JtagPins";
 static const char * const CMDNAME_JTAGSHIFTSPEEDTEST = "JtagShiftSpeedTest";
 static const char * const CMDNAME_MALLOCTEST = "MallocTest";
-static const char * const CMDNAME_CPP_EXCEPTION_TEST = "ExceptionTest";
+#ifdef __EXCEPTIONS
+  static const char * const CMDNAME_CPP_EXCEPTION_TEST = "ExceptionTest";
+#endif
 #ifndef NDEBUG
   static const char * const CMDNAME_ASSERT_TEST = "Assert";
 #endif
@@ -487,6 +714,8 @@ static const char * const CMDNAME_RESET_CAUSE = "ResetCause";
 static const char * const CMDNAME_PRINT_MEMORY = "PrintMemory";
 static const char * const CMDNAME_BUSY_WAIT = "BusyWait";
 static const char * const CMDNAME_UPTIME = "Uptime";
+static const char * const CMDNAME_USB_STATS = "UsbStats";
+static const char * const CMDNAME_BOOT_TIMESTAMPS = "BootTimestamps";
 
 
 void CCommandProcessor::ParseCommand ( const char * const cmdBegin,
@@ -509,11 +738,14 @@ void CCommandProcessor::ParseCommand ( const char * const cmdBegin,
 
     Printf( "  %s, %s: Show this help text." EOL, CMDNAME_QUESTION_MARK, CMDNAME_HELP );
     Printf( "  %s: Show version information." EOL, CMDNAME_I );
+    Printf( "  %s: Show a Bus Pirate reset banner, for tools like flashrom." EOL, CMDNAME_BUS_PIRATE_RESET );
     Printf( "  %s: Test USB transfer speed." EOL, CMDNAME_USBSPEEDTEST );
     Printf( "  %s: Show JTAG pin status (read as inputs)." EOL, CMDNAME_JTAGPINS );
     Printf( "  %s: Test JTAG shift speed. WARNING: Do NOT connect any JTAG device." EOL, CMDNAME_JTAGSHIFTSPEEDTEST );
     Printf( "  %s: Exercises malloc()." EOL, CMDNAME_MALLOCTEST );
-    Printf( "  %s: Exercises C++ exceptions." EOL, CMDNAME_CPP_EXCEPTION_TEST );
+    #ifdef __EXCEPTIONS
+      Printf( "  %s: Exercises C++ exceptions." EOL, CMDNAME_CPP_EXCEPTION_TEST );
+    #endif
 
     #ifndef NDEBUG
       Printf( "  %s: Triggers an assertion." EOL, CMDNAME_ASSERT_TEST );
@@ -522,6 +754,8 @@ void CCommandProcessor::ParseCommand ( const char * const cmdBegin,
     Printf( "  %s: Shows memory usage." EOL, CMDNAME_MEMORY_USAGE );
     Printf( "  %s" EOL, CMDNAME_CPU_LOAD );
     Printf( "  %s" EOL, CMDNAME_UPTIME );
+    Printf( "  %s: Shows USB transmission statistics." EOL, CMDNAME_USB_STATS );
+    Printf( "  %s: Shows how long the boot phases took." EOL, CMDNAME_BOOT_TIMESTAMPS );
     Printf( "  %s" EOL, CMDNAME_RESET );
     Printf( "  %s" EOL, CMDNAME_RESET_CAUSE );
     Printf( "  %s <addr> <byte count>" EOL, CMDNAME_PRINT_MEMORY );
@@ -547,6 +781,23 @@ void CCommandProcessor::ParseCommand ( const char * const cmdBegin,
   }
 
 
+  // The real Bus Pirate resets itself on '#' and prints its version information.
+  // flashrom's 'buspirate_spi' programmer waits for the "HiZ>" prompt and looks at the version numbers
+  // in order to decide which SPI commands it can use. Firmware version 6.2 tells it
+  // that the write then read command and all SPI speeds are available.
+  // There is nothing to actually reset here.
+
+  if ( IsCmd( cmdBegin, cmdEnd, CMDNAME_BUS_PIRATE_RESET, true, false, &extraParamsFound ) )
+  {
+    PrintStr( "RESET" EOL EOL );
+    Printf( "Bus Pirate v3 compatible, DebugDue %s" EOL, PACKAGE_VERSION );
+    PrintStr( "Firmware v6.2 compatible" EOL );
+    PrintStr( "HiZ>" EOL );
+
+    return;
+  }
+
+
   if ( IsCmd( cmdBegin, cmdEnd, CMDNAME_RESET, false, false, &extraParamsFound ) )
   {
     // This message does not reach the other side, we would need to add some delay.
@@ -582,6 +833,20 @@ void CCommandProcessor::ParseCommand ( const char * const cmdBegin,
   }
 
 
+  if ( IsCmd( cmdBegin, cmdEnd, CMDNAME_USB_STATS, false, false, &extraParamsFound ) )
+  {
+    DisplayUsbStats();
+    return;
+  }
+
+
+  if ( IsCmd( cmdBegin, cmdEnd, CMDNAME_BOOT_TIMESTAMPS, false, false, &extraParamsFound ) )
+  {
+    DisplayBootTimestamps();
+    return;
+  }
+
+
   if ( IsCmd( cmdBegin, cmdEnd, CMDNAME_RESET_CAUSE, false, false, &extraParamsFound ) )
   {
     DisplayResetCause();
@@ -619,7 +884,10 @@ void CCommandProcessor::ParseCommand ( const char * const cmdBegin,
   if ( IsCmd( cmdBegin, cmdEnd, CMDNAME_JTAGSHIFTSPEEDTEST, false, false, &extraParamsFound ) )
   {
     if ( !IsNativeUsbPort() )
-      throw std::runtime_error( "This command is only available on the 'Native' USB port." );
+    {
+      PrintStr( "This command is only available on the 'Native' USB port." EOL );
+      return;
+    }
 
 
     // Fill the Rx buffer with some test data.
@@ -640,7 +908,7 @@ void CCommandProcessor::ParseCommand ( const char * const cmdBegin,
     SetJtagPullups( false );
 
     const JtagPinModeEnum oldMode = GetJtagPinMode();
-    SetJtagPinMode ( MODE_JTAG );
+    VERIFY( SetJtagPinMode( MODE_JTAG ).IsOk() );
 
 
     // Each JTAG transfer needs 2 bits in the Rx buffer, TMS and TDI,
@@ -681,7 +949,7 @@ void CCommandProcessor::ParseCommand ( const char * const cmdBegin,
     m_txBuffer->Reset();
     const unsigned kBitsPerSec = unsigned( uint64_t(bitCount) * iterCount * 1000 / elapsedTime / 1024 );
 
-    SetJtagPinMode( oldMode );
+    VERIFY( SetJtagPinMode( oldMode ).IsOk() );
     SetJtagPullups( oldPullUps );
 
     // I am getting 221 KiB/s with GCC 4.7.3 and optimisation level "-O3".
@@ -709,6 +977,7 @@ void CCommandProcessor::ParseCommand ( const char * const cmdBegin,
   }
 
 
+  #ifdef __EXCEPTIONS
   if ( IsCmd( cmdBegin, cmdEnd, CMDNAME_CPP_EXCEPTION_TEST, false, false, &extraParamsFound ) )
   {
     try
@@ -726,6 +995,7 @@ void CCommandProcessor::ParseCommand ( const char * const cmdBegin,
 
     return;
   }
+  #endif
 
   #ifndef NDEBUG
   if ( IsCmd( cmdBegin, cmdEnd, CMDNAME_ASSERT_TEST, false, false, &extraParamsFound ) )
@@ -757,10 +1027,37 @@ void CCommandProcessor::ParseCommand ( const char * const cmdBegin,
 
     assert ( mi.arena <= heapAreaSize );
 
-    Printf( "Heap: %zu allocated bytes, %zu area size, %zu area limit." EOL,
-            mi.uordblks,
-            mi.arena,
-            heapAreaSize );
+    #if USE_POOL_ALLOCATOR
+
+      // With the pool allocator, the arena is the peak memory usage.
+      Printf( "Heap: %zu allocated bytes, %zu peak, %zu free in the pools, %zu area limit." EOL,
+              mi.uordblks,
+              mi.arena,
+              mi.fordblks,
+              heapAreaSize );
+
+      for ( size_t i = 0; i < GetPoolAllocatorPoolCount(); ++i )
+      {
+        PoolAllocatorStats stats;
+        GetPoolAllocatorStats( i, &stats );
+
+        Printf( "Pool %zu: block size %zu, %zu blocks, %zu used, %zu peak, %zu times exhausted." EOL,
+                i,
+                stats.blockSize,
+                stats.blockCount,
+                stats.usedBlockCount,
+                stats.peakUsedBlockCount,
+                stats.failedAllocationCount );
+      }
+
+    #else
+
+      Printf( "Heap: %zu allocated bytes, %zu area size, %zu area limit." EOL,
+              mi.uordblks,
+              mi.arena,
+              heapAreaSize );
+
+    #endif
 
     return;
   }
@@ -772,12 +1069,17 @@ void CCommandProcessor::ParseCommand ( const char * const cmdBegin,
 }
 
 
-void CCommandProcessor::ProcessCommand ( const char * const cmdStr,
-                                         const uint64_t currentTime )
+// Errors in the command itself are reported on the console. Only errors that should
+// reset the connection are returned to the caller.
+
+ProtocolResult CCommandProcessor::ProcessCommand ( const char * const cmdStr,
+                                                   const uint64_t currentTime )
 {
   m_simulateProcolError = false;
 
+  #ifdef __EXCEPTIONS
   try
+  #endif
   {
     const char * const s = SkipCharsInSet( cmdStr, SPACE_AND_TAB );
 
@@ -786,15 +1088,19 @@ void CCommandProcessor::ProcessCommand ( const char * const cmdStr,
       ParseCommand( s, currentTime );
     }
   }
+  #ifdef __EXCEPTIONS
   catch ( const std::exception & e )
   {
     Printf( "Error processing command: %s" EOL, e.what() );
   }
+  #endif
 
   if ( m_simulateProcolError )
   {
-    throw std::runtime_error( "Simulated protocol error." );
+    return ProtocolResult::Error( "Simulated protocol error." );
   }
+
+  return ProtocolResult::Ok();
 }
 
 
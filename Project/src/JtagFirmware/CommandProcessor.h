@@ -1,6 +1,7 @@
 #pragma once
 
 #include "UsbBuffers.h"
+#include "ProtocolResult.h"
 
 #include <BareMetalSupport/IoUtils.h>
 
@@ -14,13 +15,31 @@ enum UsbSpeedTestEnum
   stTxSimpleLoop,
   stTxFastLoopCircularBuffer,
   stTxFastLoopRawUsb,
-  stRxWithCircularBuffer
+  stRxWithCircularBuffer,
+
+  // The following tests measure on the DebugDue and print machine-readable results at the end,
+  // see ProcessUsbSpeedTestCmd() and Tools/UsbSpeedTest.pl .
+  stPingPong,
+  stFullDuplex,
+  stTxSizeSweep
 };
 
 extern uint8_t g_usbSpeedTestBuffer[ 1000 ];
 extern uint64_t g_usbSpeedTestEndTime;
 extern UsbSpeedTestEnum g_usbSpeedTestType;
 
+struct UsbSpeedTestParams
+{
+  uint32_t pingCount;        // stPingPong only.
+  uint32_t pingSize;         // stPingPong only.
+  uint32_t sweepStepTimeMs;  // stTxSizeSweep only.
+};
+
+extern UsbSpeedTestParams g_usbSpeedTestParams;
+
+// The measuring tests give up if nothing happens for this long, for example if the host stops sending pings.
+#define USB_SPEED_TEST_IDLE_TIMEOUT_MS  5000
+
 
 class CCommandProcessor
 {
@@ -29,11 +48,15 @@ private:
 
   void ParseCommand ( const char * cmdBegin, uint64_t currentTime );
   void HexDump ( const void * ptr, size_t byteCount, const char * endOfLineChars );
+  bool ParseUnsignedIntArg ( const char * begin, unsigned int * val );
   void PrintMemory ( const char * paramBegin );
   void BusyWait ( const char * paramBegin );
   void ProcessUsbSpeedTestCmd ( const char * paramBegin, uint64_t currentTime );
+  bool ParseUsbSpeedTestArgs ( const char * argBegin, unsigned argCount, unsigned * argValues );
   void DisplayResetCause ( void );
   void DisplayCpuLoad ( void );
+  void DisplayUsbStats ( void );
+  void DisplayBootTimestamps ( void );
   void SimulateError ( const char * paramBegin );
   void PrintJtagPinStatus ( void );
   void PrintPinStatus ( const char * const pinName,
@@ -61,6 +84,6 @@ public:
   {
   }
 
-  void ProcessCommand ( const char * cmdStr,
-                        uint64_t currentTime );
+  ProtocolResult ProcessCommand ( const char * cmdStr,
+                                  uint64_t currentTime );
 };
@@ -98,8 +98,9 @@
  * @{
  */
 
-// We just have 1 CDC interface on the USB connection.
-#define  UDI_CDC_PORT_NB 1
+// Port 0 is the Bus Pirate connection, and port 1 is the UART bridge to the target's debug serial port,
+// see UartBridge.h . With more than one port, the device becomes a composite device, see below.
+#define  UDI_CDC_PORT_NB 2
 
 //! Interface callback definition
 #define  UDI_CDC_ENABLE_EXT(port)         MyUsbCallback_cdc_enable(port)
@@ -133,6 +134,61 @@
  */
 //@}
 
+
+/**
+ * Description of the composite device with 2 CDC ports,
+ * each with its own Interface Association Descriptor (IAD).
+ * @{
+ */
+#define  USB_DEVICE_EP_CTRL_SIZE       64
+
+#define  UDI_CDC_DATA_EP_IN_0          ( 1 | USB_EP_DIR_IN  )  // Tx
+#define  UDI_CDC_DATA_EP_OUT_0         ( 2 | USB_EP_DIR_OUT )  // Rx
+#define  UDI_CDC_COMM_EP_0             ( 3 | USB_EP_DIR_IN  )  // Notifications
+#define  UDI_CDC_DATA_EP_IN_1          ( 4 | USB_EP_DIR_IN  )
+#define  UDI_CDC_DATA_EP_OUT_1         ( 5 | USB_EP_DIR_OUT )
+#define  UDI_CDC_COMM_EP_1             ( 6 | USB_EP_DIR_IN  )
+
+#define  UDI_CDC_COMM_IFACE_NUMBER_0   0
+#define  UDI_CDC_DATA_IFACE_NUMBER_0   1
+#define  UDI_CDC_COMM_IFACE_NUMBER_1   2
+#define  UDI_CDC_DATA_IFACE_NUMBER_1   3
+
+#define  USB_DEVICE_NB_INTERFACE       4
+#define  USB_DEVICE_MAX_EP             6
+
+#define UDI_COMPOSITE_DESC_T \
+  usb_iad_desc_t      udi_cdc_iad_0;  \
+  udi_cdc_comm_desc_t udi_cdc_comm_0; \
+  udi_cdc_data_desc_t udi_cdc_data_0; \
+  usb_iad_desc_t      udi_cdc_iad_1;  \
+  udi_cdc_comm_desc_t udi_cdc_comm_1; \
+  udi_cdc_data_desc_t udi_cdc_data_1;
+
+#define UDI_COMPOSITE_DESC_FS \
+  .udi_cdc_iad_0  = UDI_CDC_IAD_DESC_0,     \
+  .udi_cdc_comm_0 = UDI_CDC_COMM_DESC_0,    \
+  .udi_cdc_data_0 = UDI_CDC_DATA_DESC_0_FS, \
+  .udi_cdc_iad_1  = UDI_CDC_IAD_DESC_1,     \
+  .udi_cdc_comm_1 = UDI_CDC_COMM_DESC_1,    \
+  .udi_cdc_data_1 = UDI_CDC_DATA_DESC_1_FS,
+
+#define UDI_COMPOSITE_DESC_HS \
+  .udi_cdc_iad_0  = UDI_CDC_IAD_DESC_0,     \
+  .udi_cdc_comm_0 = UDI_CDC_COMM_DESC_0,    \
+  .udi_cdc_data_0 = UDI_CDC_DATA_DESC_0_HS, \
+  .udi_cdc_iad_1  = UDI_CDC_IAD_DESC_1,     \
+  .udi_cdc_comm_1 = UDI_CDC_COMM_DESC_1,    \
+  .udi_cdc_data_1 = UDI_CDC_DATA_DESC_1_HS,
+
+#define UDI_COMPOSITE_API \
+  &udi_api_cdc_comm, \
+  &udi_api_cdc_data, \
+  &udi_api_cdc_comm, \
+  &udi_api_cdc_data
+//@}
+
+
 //! The includes of classes and other headers must be done at the end of this file to avoid compile error
-#include "udi_cdc_conf.h"
+#include "udi_cdc.h"
 #include "my_usb_callbacks.h"
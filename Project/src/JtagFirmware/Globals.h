@@ -2,4 +2,28 @@
 
 #define ENABLE_WDT  true
 
+#define WATCHDOG_PERIOD_MS  1000
+
 #define SYSTEM_TICK_PERIOD_MS  50
+
+// The protocol modes process as much data as they can in one go, but they must not starve the main loop.
+// Counting commands is not good enough, as a short command takes a few microseconds and a long TAP shift
+// takes milliseconds. Therefore, there is a time budget per main loop iteration instead,
+// see HasMainLoopTimeBudgetExpired().
+//
+// The main loop asserts that an iteration takes less than WATCHDOG_PERIOD_MS / 3,
+// and the USB connection must be serviced often enough, so that the host does not see
+// long pauses. A fraction of the system tick period is well below both limits,
+// so short commands still get drained in one go.
+//
+// The budget is only checked between commands, so a single long command can overrun it.
+// At the measured speed of around 267 KiB/s, a maximum-length TAP shift takes about 8 ms,
+// so the check below leaves a 10 ms margin for that.
+#define MAIN_LOOP_TIME_BUDGET_US  ( SYSTEM_TICK_PERIOD_MS * 1000 / 10 )
+
+static_assert( MAIN_LOOP_TIME_BUDGET_US / 1000 + 10 < WATCHDOG_PERIOD_MS / 3, "The time budget is too high." );
+
+// If enabled, short OpenOCD commands are processed straight away in a low-priority interrupt (PendSV),
+// which the USB reception notification triggers, instead of waiting for the main loop to get round to it.
+// This reduces the round-trip time of OpenOCD's many small scans. See UsbConnection.cpp for details.
+#define ENABLE_USB_LOW_LATENCY_MODE  false
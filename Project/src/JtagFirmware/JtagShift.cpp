@@ -0,0 +1,230 @@
+
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+
+
+#include "JtagShift.h"  // The include file for this module should come first.
+
+
+static uint8_t Shift2BitsHelper ( uint8_t tdiMsb, uint8_t tdiLsb,
+                                  uint8_t tmsMsb, uint8_t tmsLsb )
+{
+  const bool lsb = ShiftSingleBit( tdiLsb, tmsLsb );
+  const bool msb = ShiftSingleBit( tdiMsb, tmsMsb );
+
+  if ( lsb )
+  {
+    if ( msb )
+      return 3;
+    else
+      return 1;
+  }
+  else
+  {
+    if ( msb )
+      return 2;
+    else
+      return 0;
+  }
+}
+
+
+static uint8_t Shift2Bits ( uint8_t tdi8,
+                            uint8_t tms8 )
+{
+  if ( SHIFT_2_BITS_LOOP_IMPLEMENTATION )
+  {
+    uint8_t byteToSend = 0;
+
+    for ( unsigned j = 0; j < 2; ++j )
+    {
+      // LSB goes out first.
+      const bool tdiBit = 0 != ( tdi8 & 1 );
+      const bool tmsBit = 0 != ( tms8 & 1 );
+
+      tdi8 >>= 1;
+      tms8 >>= 1;
+
+      const bool isTdoSet = ShiftSingleBit( tdiBit, tmsBit );
+
+      // MSB comes in first.
+      byteToSend = (byteToSend >> 1) | uint8_t( isTdoSet ? (1<<1) : 0 );
+    }
+
+    return byteToSend;
+  }
+  else if ( false )
+  {
+    // This is an alternative implementation which does not get optimised properly by GCC 4.7.3 .
+    switch ( tdi8 & 3 )
+    {
+    case 0:
+     {
+      const bool tdiMsb = false;
+      const bool tdiLsb = false;
+
+      switch ( tms8 & 3 )
+      {
+      case 0: return Shift2BitsHelper( tdiMsb, tdiLsb, false, false );
+      case 1: return Shift2BitsHelper( tdiMsb, tdiLsb, false, true  );
+      case 2: return Shift2BitsHelper( tdiMsb, tdiLsb, true,  false );
+      case 3: return Shift2BitsHelper( tdiMsb, tdiLsb, true,  true  );
+      default:
+        assert( false );
+        return 0;
+      }
+      break;
+     }
+
+    case 1:
+     {
+      const bool tdiMsb = false;
+      const bool tdiLsb = true;
+
+      switch ( tms8 & 3 )
+      {
+      case 0: return Shift2BitsHelper( tdiMsb, tdiLsb, false, false );
+      case 1: return Shift2BitsHelper( tdiMsb, tdiLsb, false, true  );
+      case 2: return Shift2BitsHelper( tdiMsb, tdiLsb, true,  false );
+      case 3: return Shift2BitsHelper( tdiMsb, tdiLsb, true,  true  );
+      default:
+        assert( false );
+        return 0;
+      }
+      break;
+     }
+
+    case 2:
+     {
+      const bool tdiMsb = true;
+      const bool tdiLsb = false;
+
+      switch ( tms8 & 3 )
+      {
+      case 0: return Shift2BitsHelper( tdiMsb, tdiLsb, false, false );
+      case 1: return Shift2BitsHelper( tdiMsb, tdiLsb, false, true  );
+      case 2: return Shift2BitsHelper( tdiMsb, tdiLsb, true,  false );
+      case 3: return Shift2BitsHelper( tdiMsb, tdiLsb, true,  true  );
+      default:
+        assert( false );
+        return 0;
+      }
+      break;
+     }
+
+    case 3:
+     {
+      const bool tdiMsb = true;
+      const bool tdiLsb = true;
+
+      switch ( tms8 & 3 )
+      {
+      case 0: return Shift2BitsHelper( tdiMsb, tdiLsb, false, false );
+      case 1: return Shift2BitsHelper( tdiMsb, tdiLsb, false, true  );
+      case 2: return Shift2BitsHelper( tdiMsb, tdiLsb, true,  false );
+      case 3: return Shift2BitsHelper( tdiMsb, tdiLsb, true,  true  );
+      default:
+        assert( false );
+        return 0;
+      }
+      break;
+     }
+
+    default:
+      assert( false );
+      return 0;
+    }
+  }
+  else
+  {
+    switch ( (tdi8 & 3) << 2 | (tms8 & 3) )
+    {
+    case 0b0000:
+      return Shift2BitsHelper( false, false, false, false );
+    case 0b0001:
+      return Shift2BitsHelper( false, false, false, true  );
+    case 0b0010:
+      return Shift2BitsHelper( false, false, true , false );
+    case 0b0011:
+      return Shift2BitsHelper( false, false, true , true  );
+    case 0b0100:
+      return Shift2BitsHelper( false, true , false, false );
+    case 0b0101:
+      return Shift2BitsHelper( false, true , false, true  );
+    case 0b0110:
+      return Shift2BitsHelper( false, true , true , false );
+    case 0b0111:
+      return Shift2BitsHelper( false, true , true , true  );
+    case 0b1000:
+      return Shift2BitsHelper( true , false, false, false );
+    case 0b1001:
+      return Shift2BitsHelper( true , false, false, true  );
+    case 0b1010:
+      return Shift2BitsHelper( true , false, true , false );
+    case 0b1011:
+      return Shift2BitsHelper( true , false, true , true  );
+    case 0b1100:
+      return Shift2BitsHelper( true , true , false, false );
+    case 0b1101:
+      return Shift2BitsHelper( true , true , false, true  );
+    case 0b1110:
+      return Shift2BitsHelper( true , true , true , false );
+    case 0b1111:
+      return Shift2BitsHelper( true , true , true , true  );
+
+    default:
+      assert( false );
+      return 0;
+    }
+  }
+}
+
+
+uint8_t ShiftFullByte ( const uint8_t tdi8,
+                        const uint8_t tms8 )
+{
+  // SerialPrint( "TDI8: 0x%02X" EOL, tdi8 );
+  // SerialPrint( "TMS8: 0x%02X" EOL, tms8 );
+
+  const uint8_t tdo1 = Shift2Bits( tdi8,      tms8 );
+  const uint8_t tdo2 = Shift2Bits( tdi8 >> 2, tms8 >> 2 );
+  const uint8_t tdo3 = Shift2Bits( tdi8 >> 4, tms8 >> 4 );
+  const uint8_t tdo4 = Shift2Bits( tdi8 >> 6, tms8 >> 6 );
+
+  const uint8_t tdo = uint8_t( tdo4 << 6 ) |
+                      uint8_t( tdo3 << 4 ) |
+                      uint8_t( tdo2 << 2 ) |
+                               tdo1;
+  return tdo;
+}
+
+
+void ShiftMemBlock ( const uint8_t * const __restrict__ readPtr,
+                           uint8_t * const __restrict__ writePtr,
+                     const uint16_t iterationCount )
+{
+  for ( uint32_t i = 0; i < iterationCount; ++i )
+  {
+    const uint8_t tdi8 = readPtr[ i*2     ];
+    const uint8_t tms8 = readPtr[ i*2 + 1 ];
+
+    uint8_t tdo8;
+
+    if ( FULL_BYTE_IMPLEMENTATION )
+      tdo8 = ShiftFullByte( tdi8, tms8 );
+    else
+      tdo8 = ShiftSeveralBits( tdi8, tms8, 8 );
+
+    writePtr[i] = tdo8;
+  }
+}
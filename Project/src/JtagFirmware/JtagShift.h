@@ -0,0 +1,169 @@
+
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+#include <inttypes.h>
+
+#include <BareMetalSupport/IoUtils.h>
+#include <BareMetalSupport/SerialPrint.h>
+#include <BareMetalSupport/RamFunctions.h>
+
+#include "JtagPins.h"
+
+// This is the JTAG bit-banging kernel used by the OpenOCD mode.
+//
+// It lives in its own module so that the Qemu benchmark firmware can compile the real code
+// against a fake PIO in SRAM, see src/QemuBenchmark/FakePio .
+
+
+// Below are some performance settings you can tweak, they choose different implementations.
+// I would keep even the slowest implementations, as they can serve as examples
+// or test case helpers when writing  new FPGA or assembly code.
+// The current settings yield the maximum performance with GCC 4.7.3, -O3.
+// Command "JtagShiftSpeedTest" displays a speed of 267 KiB/s.
+
+// You would think that FULL_BYTE_IMPLEMENTATION should always be faster, but it is not,
+// at least with GCC 4.7.3 . If you disable SHIFT_USE_BLOCKS in BusPirateOpenOcdMode.cpp,
+// you will get a faster performance with this option also turned off.
+static const bool FULL_BYTE_IMPLEMENTATION = false;
+
+// This option only has an effect if FULL_BYTE_IMPLEMENTATION is enabled.
+// The loop implementation in Shift2Bits() ends up being faster, at least with GCC 4.7.3 .
+static const bool SHIFT_2_BITS_LOOP_IMPLEMENTATION = true;
+
+
+// This flag allows you to check whether the TDO value read stays constant for some time.
+// If that's not the case, the firmware is probably reading TDO too soon after TCK's falling edge.
+// This kind of test does not help if the JTAG TAP switches TDO to a high impedance on those
+// TAP state machine states that do not deliver any data, as required by the JTAG standard.
+// That is, this TDO test only works for non-conformant JTAG TAPs, like is often the case
+// with FPGA-based implementations.
+//
+// A value of 0 below means this kind of test is disabled (the default).
+//
+// Note that, if you set the iteration value too high, you will delay the JTAG shifts and
+// you may then trigger OpenOCD time-outs.
+//
+// This variable could be unsigned, but then you get a compilation warning when it's 0.
+static const int32_t TDO_STABILITY_TEST_LOOP_COUNT = 0;
+
+static const bool TRACE_JTAG_SHIFTING = false;
+
+
+// The bit-shifting routines must be inlined into ShiftMemBlock(), so that they run from SRAM too.
+inline bool ShiftSingleBit ( bool tdiBit, bool tmsBit ) __attribute__ ((always_inline));
+inline uint8_t ShiftSeveralBits ( uint8_t tdi8, uint8_t tms8, uint8_t bitCount ) __attribute__ ((always_inline));
+
+inline bool ShiftSingleBit ( const bool tdiBit, const bool tmsBit )
+{
+  // I have measured TCK once with the oscilloscope and, with GCC 4.7.3 and optimisation level "-O3",
+  // I got around 3.04 MHz (in 8-bit bursts), and around 4.88 us (204-222 KHz) between 8-bit bursts,
+  // as there is a longer pause between the 8-bit bursts.
+  // All these measurements were rather inaccurate.
+  // The main limiting factor will probably be the short time between the TCK's falling edge and
+  // the reading of TDO.
+  //
+  // Unfortunately, the SPI interface on Atmel's ATSAM3X8 is not flexible enough to help
+  // drive the JTAG signals (we would need an extra line CPU -> JTAG slave). The USART interfaces
+  // don't have enough flexibility and speed either, so we have to toggle the pins manually
+  // for maximum performance.
+
+
+  assert( GetOutputDataDrivenOnPin( JTAG_TCK_PIO, JTAG_TCK_PIN ) );
+  SetOutputDataDrivenOnPinToLow( JTAG_TCK_PIO, JTAG_TCK_PIN );
+
+  SetOutputDataDrivenOnPin( JTAG_TDI_PIO, JTAG_TDI_PIN, tdiBit );
+  SetOutputDataDrivenOnPin( JTAG_TMS_PIO, JTAG_TMS_PIN, tmsBit );
+
+  SetOutputDataDrivenOnPinToHigh( JTAG_TCK_PIO, JTAG_TCK_PIN );
+
+  // The new TDO value appears on the line after TCK's falling edge. Therefore, at this point
+  // we are reading the TDO value left behind by the last shift operation, that is,
+  // by the previous call to this routine.
+  // Or maybe the current TAP state does not deliver any data, the TDO is in high-impedance mode,
+  // and the data read back is rubbish anyway and will be thrown away.
+  const bool isTdoSet = IsInputPinHigh( JTAG_TDO_PIO, JTAG_TDO_PIN );
+
+  // This loop does not normally run, see TDO_STABILITY_TEST_LOOP_COUNT
+  // for more information about this test.
+  for ( int32_t i = 0; i < TDO_STABILITY_TEST_LOOP_COUNT; ++i )
+  {
+    if ( isTdoSet != IsInputPinHigh( JTAG_TDO_PIO, JTAG_TDO_PIN ) )
+    {
+      SerialPrintf( "TDO stability check failed at iteration %" PRId32 "." EOL, i );
+      assert( false );
+      break;
+    }
+  }
+
+  return isTdoSet;
+}
+
+
+inline uint8_t ShiftSeveralBits ( const uint8_t tdi8,
+                                         const uint8_t tms8,
+                                         const uint8_t bitCount )
+{
+  assert( bitCount > 0 && bitCount <= 8 );
+
+  uint8_t shiftingTdi8 = tdi8;
+  uint8_t shiftingTms8 = tms8;
+  uint8_t tdo8 = 0;
+
+  for ( unsigned j = 0; j < bitCount; ++j )
+  {
+    // LSB goes out first.
+    const bool tdiBit = 0 != ( shiftingTdi8 & 1 );
+    const bool tmsBit = 0 != ( shiftingTms8 & 1 );
+
+    shiftingTdi8 >>= 1;
+    shiftingTms8 >>= 1;
+
+    const bool isTdoSet = ShiftSingleBit( tdiBit, tmsBit );
+
+    // MSB comes in first.
+    tdo8 = (tdo8 >> 1) | uint8_t( isTdoSet ? (1<<7) : 0 );
+  }
+
+  if ( TRACE_JTAG_SHIFTING )
+    SerialPrintf( "TDI8: 0x%02X, TMS8: 0x%02X, TDO8: 0x%02X" EOL, tdi8, tms8, tdo8 );
+
+
+  // Note that OpenOCD 0.8.0's Bus Pirate driver does not bother clearing the last buffer
+  // contents before sending a new one, so, if the bit count is not a multiple of 8,
+  // the last TDI and TMS bits may not be zero, they may be rubbish from the data previously sent.
+  // However, I have changed my OpenOCD locally to clear those bits, I intend to submit a patch soon.
+  if ( true )
+  {
+    assert( shiftingTdi8 == 0 );
+    assert( shiftingTms8 == 0 );
+  }
+
+  return tdo8;
+}
+
+
+uint8_t ShiftFullByte ( uint8_t tdi8, uint8_t tms8 );
+
+// This is the innermost JTAG shifting loop, so it runs from SRAM in order to avoid
+// the Flash wait states, see RAMFUNC for more information.
+//
+// For each byte pair (TDI, TMS) read, one TDO byte is written.
+
+void ShiftMemBlock ( const uint8_t * __restrict__ readPtr,
+                           uint8_t * __restrict__ writePtr,
+                     uint16_t iterationCount ) RAMFUNC;
@@ -0,0 +1,170 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "LogicSampler.h"  // The include file for this module should come first.
+
+#include <assert.h>
+
+#include <BareMetalSupport/RamFunctions.h>
+#include <BareMetalSupport/NoInitData.h>
+#include <Misc/AssertionUtils.h>
+
+#include <sam3xa.h>
+#include <pmc.h>
+#include <tc.h>
+
+
+// The PIO has no DMA channel of its own (the parallel capture mode only works on other pins),
+// so a timer interrupt reads the pin levels instead.
+
+#define SAMPLER_TC          TC0
+#define SAMPLER_TC_CHANNEL  0
+#define SAMPLER_TC_ID       ID_TC0
+#define SAMPLER_TC_IRQ      TC0_IRQn
+
+// TIMER_CLOCK1 runs at MCK / 2.
+static const uint32_t TIMER_CLOCK_HZ = CPU_CLOCK / 2;
+
+
+// The interrupt handler owns the block with index s_fillBlockIndex, unless it is full,
+// in which case the main loop owns it until it calls LogicSampler_ReleaseBlock().
+// There is only one writer for each variable below, so no locking is needed.
+
+static LogicSampler_Block s_blocks[ 2 ] NOINIT_DATA;
+
+static volatile bool     s_isBlockFull[ 2 ];
+static volatile uint8_t  s_fillBlockIndex;
+static volatile uint32_t s_fillPos;
+static volatile uint32_t s_droppedSampleCount;  // Since the last block started.
+static          uint8_t  s_readBlockIndex;
+
+static bool s_isRunning = false;
+
+
+void TC0_Handler ( void ) RAMFUNC;
+
+void TC0_Handler ( void )
+{
+  // Reading the status register acknowledges the interrupt.
+  const uint32_t status = SAMPLER_TC->TC_CHANNEL[ SAMPLER_TC_CHANNEL ].TC_SR;
+  UNUSED_ALWAYS( status );
+
+  const uint8_t sample = LogicSampler_PackJtagPins( PIOA->PIO_PDSR, PIOC->PIO_PDSR );
+
+  const uint8_t blockIndex = s_fillBlockIndex;
+
+  if ( s_isBlockFull[ blockIndex ] )
+  {
+    // The main loop has not caught up yet.
+    ++s_droppedSampleCount;
+    return;
+  }
+
+  LogicSampler_Block * const block = &s_blocks[ blockIndex ];
+  const uint32_t pos = s_fillPos;
+
+  if ( pos == 0 )
+  {
+    block->droppedSampleCountBefore = s_droppedSampleCount;
+    s_droppedSampleCount = 0;
+  }
+
+  block->samples[ pos ] = sample;
+
+  if ( pos + 1 == LOGIC_SAMPLER_BLOCK_SAMPLE_COUNT )
+  {
+    s_fillPos = 0;
+    s_isBlockFull[ blockIndex ] = true;
+    s_fillBlockIndex = uint8_t( blockIndex ^ 1 );
+  }
+  else
+  {
+    s_fillPos = pos + 1;
+  }
+}
+
+
+uint32_t LogicSampler_Start ( const uint32_t sampleRateHz )
+{
+  assert( !s_isRunning );
+  assert( sampleRateHz >= LOGIC_SAMPLER_MIN_RATE_HZ && sampleRateHz <= LOGIC_SAMPLER_MAX_RATE_HZ );
+
+  s_isBlockFull[ 0 ]   = false;
+  s_isBlockFull[ 1 ]   = false;
+  s_fillBlockIndex     = 0;
+  s_fillPos            = 0;
+  s_droppedSampleCount = 0;
+  s_readBlockIndex     = 0;
+
+  const uint32_t divisor = ( TIMER_CLOCK_HZ + sampleRateHz / 2 ) / sampleRateHz;
+
+  VERIFY( 0 == pmc_enable_periph_clk( SAMPLER_TC_ID ) );
+
+  tc_init( SAMPLER_TC, SAMPLER_TC_CHANNEL, TC_CMR_TCCLKS_TIMER_CLOCK1 | TC_CMR_WAVE | TC_CMR_WAVSEL_UP_RC );
+  tc_write_rc( SAMPLER_TC, SAMPLER_TC_CHANNEL, divisor );
+  tc_enable_interrupt( SAMPLER_TC, SAMPLER_TC_CHANNEL, TC_IER_CPCS );
+
+  // The sample rate should not suffer from the other interrupts, like USB.
+  NVIC_SetPriority( SAMPLER_TC_IRQ, 0 );
+  NVIC_ClearPendingIRQ( SAMPLER_TC_IRQ );
+  NVIC_EnableIRQ( SAMPLER_TC_IRQ );
+
+  tc_start( SAMPLER_TC, SAMPLER_TC_CHANNEL );
+
+  s_isRunning = true;
+
+  return TIMER_CLOCK_HZ / divisor;
+}
+
+
+void LogicSampler_Stop ( void )
+{
+  if ( !s_isRunning )
+    return;
+
+  tc_stop( SAMPLER_TC, SAMPLER_TC_CHANNEL );
+  tc_disable_interrupt( SAMPLER_TC, SAMPLER_TC_CHANNEL, TC_IDR_CPCS );
+
+  NVIC_DisableIRQ( SAMPLER_TC_IRQ );
+  NVIC_ClearPendingIRQ( SAMPLER_TC_IRQ );
+
+  VERIFY( 0 == pmc_disable_periph_clk( SAMPLER_TC_ID ) );
+
+  s_isRunning = false;
+}
+
+
+const LogicSampler_Block * LogicSampler_GetFullBlock ( void )
+{
+  assert( s_isRunning );
+
+  if ( !s_isBlockFull[ s_readBlockIndex ] )
+    return nullptr;
+
+  return &s_blocks[ s_readBlockIndex ];
+}
+
+
+void LogicSampler_ReleaseBlock ( void )
+{
+  assert( s_isBlockFull[ s_readBlockIndex ] );
+
+  // Make sure that all reads from the block have completed before the interrupt handler
+  // can overwrite it.
+  __DMB();
+
+  s_isBlockFull[ s_readBlockIndex ] = false;
+  s_readBlockIndex = uint8_t( s_readBlockIndex ^ 1 );
+}
@@ -0,0 +1,77 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+#include <stdint.h>
+
+#include "JtagPins.h"
+
+// The logic sampler reads the JTAG pins at a fixed rate and packs them into one byte per sample.
+// A timer interrupt (TC0 channel 0) does the sampling, and stores the samples into 2 RAM blocks
+// in turns (double buffering). The main loop fetches the full blocks with LogicSampler_GetFullBlock().
+// If the main loop does not release a block in time, the interrupt handler drops the samples
+// and counts them, see LogicSampler_Block::droppedSampleCountBefore.
+//
+// The sampler only reads the pins, it does not change their configuration.
+//
+// The host emulator replaces this module with a simulated sampler, see HostEmulator/SimulatedLogicSampler.cpp .
+
+#define LOGIC_SAMPLER_BLOCK_SAMPLE_COUNT  512
+
+// The interrupt overhead limits the sample rate. At 1 MHz, the interrupt handler
+// already takes a sizable part of the CPU time.
+#define LOGIC_SAMPLER_MIN_RATE_HZ  1000
+#define LOGIC_SAMPLER_MAX_RATE_HZ  1000000
+
+// Bit positions in each sample.
+#define LOGIC_SAMPLER_BIT_TCK    0
+#define LOGIC_SAMPLER_BIT_TMS    1
+#define LOGIC_SAMPLER_BIT_TDI    2
+#define LOGIC_SAMPLER_BIT_TDO    3
+#define LOGIC_SAMPLER_BIT_TRST   4
+#define LOGIC_SAMPLER_BIT_SRST   5
+#define LOGIC_SAMPLER_CHANNEL_COUNT  6
+
+struct LogicSampler_Block
+{
+  uint8_t  samples[ LOGIC_SAMPLER_BLOCK_SAMPLE_COUNT ];
+  uint32_t droppedSampleCountBefore;  // Samples dropped between the previous block and this one.
+};
+
+
+// Returns the actual sample rate, which may differ slightly from the requested one,
+// because the timer divides the peripheral clock by an integer.
+uint32_t LogicSampler_Start ( uint32_t sampleRateHz );
+
+void LogicSampler_Stop ( void );
+
+// Returns nullptr if there is no full block yet. The caller must release the block
+// with LogicSampler_ReleaseBlock() when done with it. Blocks come in the order they were filled.
+const LogicSampler_Block * LogicSampler_GetFullBlock ( void );
+void LogicSampler_ReleaseBlock ( void );
+
+
+// The JTAG pins are scattered across 2 ports: TDI is on PIOA, and the rest are on PIOC, see JtagPins.h .
+// This routine is shared with the host emulator.
+
+inline uint8_t LogicSampler_PackJtagPins ( const uint32_t pioaLevels, const uint32_t piocLevels )
+{
+  return uint8_t( ( ( piocLevels >> JTAG_TCK_PIN  ) & 1 ) << LOGIC_SAMPLER_BIT_TCK  |
+                  ( ( piocLevels >> JTAG_TMS_PIN  ) & 1 ) << LOGIC_SAMPLER_BIT_TMS  |
+                  ( ( pioaLevels >> JTAG_TDI_PIN  ) & 1 ) << LOGIC_SAMPLER_BIT_TDI  |
+                  ( ( piocLevels >> JTAG_TDO_PIN  ) & 1 ) << LOGIC_SAMPLER_BIT_TDO  |
+                  ( ( piocLevels >> JTAG_TRST_PIN ) & 1 ) << LOGIC_SAMPLER_BIT_TRST |
+                  ( ( piocLevels >> JTAG_SRST_PIN ) & 1 ) << LOGIC_SAMPLER_BIT_SRST );
+}
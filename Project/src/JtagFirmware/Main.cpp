@@ -28,12 +28,15 @@
 #include <BareMetalSupport/SerialPortAsyncTx.h>
 #include <BareMetalSupport/SerialPrint.h>
 #include <BareMetalSupport/MainLoopSleep.h>
+#include <BareMetalSupport/CycleCounter.h>
+#include <BareMetalSupport/BootTimestamps.h>
 
 #include <ArduinoDueUtils/ArduinoDueUtils.h>
 
 #include "Globals.h"
 #include "UsbConnection.h"
 #include "UsbSupport.h"
+#include "UartBridgeConnection.h"
 #include "Led.h"
 #include "SerialPortConsole.h"
 #include "BusPirateOpenOcdMode.h"
@@ -44,10 +47,11 @@
 #include <wdt.h>
 
 
-const uint32_t WATCHDOG_PERIOD_MS = 1000;
-
 #ifndef NDEBUG
   static const size_t MIN_UNUSED_STACK_SIZE = size_t( MaxFrom( MaxFrom( ASSERT_MSG_BUFSIZE, MAX_SERIAL_PRINT_LEN ), MAX_USB_PRINT_LEN ) + 200 );
+
+  // With a 4 KiB stack, a complete watermark pass takes 16 main loop iterations.
+  static const size_t STACK_WATERMARK_WORDS_PER_ITERATION = 64;
 #endif
 
 
@@ -103,6 +107,15 @@ static void Configure ( void )
     Panic( "SysTick error." );
 
 
+  // ------- Configure the CPU cycle counter -------
+
+  // The OpenOCD mode uses it in order to limit the time spent per main loop iteration.
+  // StartBootTimestamps() has already enabled it at reset. Restarting it from zero here
+  // would invalidate the boot timestamps, so only resume it if a JTAG debugger
+  // has turned it off in the meantime. The main loop does the same on every iteration.
+  ResumeCycleCounterIfStopped();
+
+
   // ------- Configure the USB interface -------
 
   // Configure the I/O pins of the 'native' USB interface.
@@ -112,6 +125,12 @@ static void Configure ( void )
                          PIO_PB11A_UOTGID | PIO_PB10A_UOTGVBOF,
                          PIO_DEFAULT ) );
   InitUsb();
+  InitUsbConnection();
+
+
+  // ------- Configure the UART bridge to the target -------
+
+  InitUartBridgeConnection();
 
 
   // ------- Setup the stack size and canary check -------
@@ -236,25 +255,38 @@ void StartOfUserCode ( void )
 
     uint64_t lastReferenceTimeForPeriodicAction = 0;
 
+    RecordBootTimestamp( bpMainLoop );
+
     for (;;)
     {
       if ( ENABLE_WDT )
         wdt_restart( WDT );
 
+      // The time budgets in the Bus Pirate modes and the USB Tx flush timeout rely on the cycle counter,
+      // but a JTAG debugger may have stopped it, see CycleCounter.h .
+      ResumeCycleCounterIfStopped();
+
       const uint64_t currentTime = GetUptime();
 
       ServiceUsbConnection( currentTime );
 
-      ServiceSerialPortConsole( currentTime );
+      ServiceUartBridgeConnection();
+
+      {
+        // The serial console has JTAG commands too.
+        const CHoldOffUsbLowLatencyService holdOffLowLatencyService;
+        ServiceSerialPortConsole( currentTime );
+      }
 
       if ( HasUptimeElapsedMs( currentTime, lastReferenceTimeForPeriodicAction, 500 ) )
       {
         lastReferenceTimeForPeriodicAction = currentTime;
         PeriodicAction();
-
-        assert( CheckStackCanary( MIN_UNUSED_STACK_SIZE ) );
       }
 
+      // The incremental scan is cheap enough to run on every main loop iteration.
+      assert( UpdateStackUsageWatermark( STACK_WATERMARK_WORDS_PER_ITERATION ) + MIN_UNUSED_STACK_SIZE <= STACK_SIZE );
+
       // If somebody forgets to re-enable the interrupts after disabling them, detect it as soon as possible.
       assert( AreInterruptsEnabled() );
 
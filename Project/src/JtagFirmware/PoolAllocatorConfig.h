@@ -0,0 +1,33 @@
+
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+#include <BareMetalSupport/PoolAllocator.h>
+
+// The pool sizes for this firmware, see PoolAllocator.h for more information.
+//
+// This firmware allocates very little memory dynamically. The main user is the C++ exception machinery:
+// each std::runtime_error thrown needs around 136 bytes on ARM, including the exception header.
+// Command "MemoryUsage" shows the peak number of blocks used in each pool, which helps
+// adjust these values.
+
+static constexpr PoolAllocatorPoolConfig POOL_ALLOCATOR_CONFIG[] =
+{
+  {  32, 8 },
+  {  64, 4 },
+  { 160, 4 },  // C++ exception objects.
+  { 512, 2 }
+};
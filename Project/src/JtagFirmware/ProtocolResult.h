@@ -0,0 +1,66 @@
+
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+#include <assert.h>
+
+// Protocol errors are returned with this type instead of being thrown as C++ exceptions.
+//
+// Throwing is expensive on ARM: each throw allocates the exception object on the heap
+// and runs the EHABI unwinder, which costs thousands of CPU cycles, and the unwind tables
+// take up flash space. Besides, the JTAG firmware can be built with -fno-exceptions,
+// see option --enable-cpp-exceptions in configure.ac .
+//
+// The error message must be a string literal, or at least it must remain valid
+// until the caller has printed it. There is no dynamic memory involved.
+//
+// An error normally travels up to ServiceUsbConnection() or ServiceSerialPortConsole(),
+// which print it on the serial port and reset the connection, like they do for exceptions.
+
+class [[nodiscard]] ProtocolResult
+{
+private:
+  const char * m_errMsg;  // nullptr means success.
+
+  explicit ProtocolResult ( const char * const errMsg ) throw()
+    : m_errMsg( errMsg )
+  {
+  }
+
+public:
+
+  static ProtocolResult Ok ( void ) throw()
+  {
+    return ProtocolResult( nullptr );
+  }
+
+  static ProtocolResult Error ( const char * const errMsg ) throw()
+  {
+    assert( errMsg != nullptr );
+    return ProtocolResult( errMsg );
+  }
+
+  bool IsOk ( void ) const throw()
+  {
+    return m_errMsg == nullptr;
+  }
+
+  const char * GetErrMsg ( void ) const throw()
+  {
+    assert( !IsOk() );
+    return m_errMsg;
+  }
+};
@@ -24,6 +24,7 @@
 #include <BareMetalSupport/CircularBuffer.h>
 #include <BareMetalSupport/MainLoopSleep.h>
 #include <BareMetalSupport/Miscellaneous.h>
+#include <BareMetalSupport/RamFunctions.h>
 
 #include <uart.h>
 
@@ -107,7 +108,7 @@ void CProgrammingUsbCommandProcessor::PrintStr ( const char * const str )
 static CSerialPortConsole s_serialPortConsole;
 
 
-static void ServiceSerialPortRx ( const uint64_t currentTime )
+static ProtocolResult ServiceSerialPortRx ( const uint64_t currentTime )
 {
   const bool uartOverrun     = s_uartOverrun;
   const bool uartFrameErr    = s_uartFrameErr;
@@ -161,13 +162,18 @@ static void ServiceSerialPortRx ( const uint64_t currentTime )
 
       CProgrammingUsbCommandProcessor cmdProcessor;
 
-      cmdProcessor.ProcessCommand( cmd, currentTime );
+      const ProtocolResult result = cmdProcessor.ProcessCommand( cmd, currentTime );
+
+      if ( !result.IsOk() )
+        return result;
 
       SerialPrintStr( BUS_PIRATE_CONSOLE_PROMPT );
     }
 
     HasSerialPortDataBeenSentSinceLastCall();  // Reset the flag.
   }
+
+  return ProtocolResult::Ok();
 }
 
 
@@ -181,10 +187,18 @@ static void HandleError ( const char * const errMsg )
 
 void ServiceSerialPortConsole ( const uint64_t currentTime )
 {
+  // C++ exceptions are only caught here, at the outermost level, see ProtocolResult.h .
+
+  #ifdef __EXCEPTIONS
   try
+  #endif
   {
-    ServiceSerialPortRx( currentTime );
+    const ProtocolResult result = ServiceSerialPortRx( currentTime );
+
+    if ( !result.IsOk() )
+      HandleError( result.GetErrMsg() );
   }
+  #ifdef __EXCEPTIONS
   catch ( const std::exception & e )
   {
     HandleError( e.what() );
@@ -193,10 +207,15 @@ void ServiceSerialPortConsole ( const uint64_t currentTime )
   {
     HandleError( "Unexpected C++ exception." );
   }
+  #endif
 }
 
 
-static void SerialPortRxInterruptHandler ( void )
+// This routine must be inlined into UART_Handler(), which runs from SRAM, see RAMFUNC.
+
+static inline void SerialPortRxInterruptHandler ( void ) __attribute__ ((always_inline));
+
+static inline void SerialPortRxInterruptHandler ( void )
 {
   // There is no FIFO in our UART, so we process just 1 character every time this interrupt is triggered.
 
@@ -247,6 +266,11 @@ static void SerialPortRxInterruptHandler ( void )
 }
 
 
+// The UART has no FIFO, so this interrupt handler runs once per character in each direction.
+// Running it from SRAM reduces its latency.
+
+void UART_Handler ( void ) RAMFUNC;
+
 void UART_Handler ( void )
 {
   SerialPortRxInterruptHandler();
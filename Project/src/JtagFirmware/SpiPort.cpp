@@ -0,0 +1,184 @@
+
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "SpiPort.h"  // The include file for this module should come first.
+
+#include <assert.h>
+
+#include <BareMetalSupport/IoUtils.h>
+#include <Misc/AssertionUtils.h>
+
+#include <sam3xa.h>
+#include <pio.h>
+#include <pmc.h>
+#include <spi.h>
+#include <pdc.h>
+
+
+#define SPI_CS_PIO  PIOB
+#define SPI_CS_PIN  21
+
+static const uint32_t SPI_BUS_PINS = PIO_PA25A_SPI0_MISO | PIO_PA26A_SPI0_MOSI | PIO_PA27A_SPI0_SPCK;
+
+// We drive the chip select pin ourselves, but the SPI peripheral still needs
+// a chip select register for the clock settings. Pin NPCS0 is left in PIO mode.
+static const uint32_t SPI_CHIP_SEL = 0;
+
+
+void SpiPort_Init ( void )
+{
+  spi_enable_clock( SPI0 );
+
+  spi_disable( SPI0 );
+  spi_reset( SPI0 );
+  spi_set_master_mode( SPI0 );
+  spi_disable_mode_fault_detect( SPI0 );
+  spi_set_fixed_peripheral_select( SPI0 );
+  spi_set_peripheral_chip_select_value( SPI0, SPI_CHIP_SEL );
+  spi_set_bits_per_transfer( SPI0, SPI_CHIP_SEL, SPI_CSR_BITS_8_BIT );
+
+  // pio_set_output() also configures the open-drain mode, so it must come before SpiPort_SetBusConfig() below.
+  pio_set_output( SPI_CS_PIO, BV(SPI_CS_PIN), HIGH, DISABLE, DISABLE );
+
+  // These are the Bus Pirate defaults, except for the speed, as the Bus Pirate's 30 kHz are too slow for us.
+  VERIFY( SpiPort_SetSpeed( SPI_PORT_DEFAULT_SPEED_INDEX ) );
+  SpiPort_SetBusConfig( true, false, true );
+
+  spi_enable( SPI0 );
+
+  VERIFY( pio_configure( PIOA, PIO_PERIPH_A, SPI_BUS_PINS, PIO_DEFAULT ) );
+}
+
+
+void SpiPort_Terminate ( void )
+{
+  pdc_disable_transfer( spi_get_pdc_base( SPI0 ), PERIPH_PTCR_RXTDIS | PERIPH_PTCR_TXTDIS );
+
+  spi_disable( SPI0 );
+
+  // Leave all pins in high impedance, like the Bus Pirate does when leaving the SPI mode.
+  pio_set_input( PIOA, SPI_BUS_PINS, 0 );
+  pio_set_input( SPI_CS_PIO, BV(SPI_CS_PIN), 0 );
+
+  spi_disable_clock( SPI0 );
+}
+
+
+void SpiPort_SetChipSelect ( const bool isActive )
+{
+  SetOutputDataDrivenOnPin( SPI_CS_PIO, SPI_CS_PIN, !isActive );
+}
+
+
+bool SpiPort_SetSpeed ( const uint8_t speedIndex )
+{
+  static const uint32_t SPEEDS_HZ[] = { 30000, 125000, 250000, 1000000, 2000000, 2600000, 4000000, 8000000 };
+
+  assert( speedIndex < sizeof( SPEEDS_HZ ) / sizeof( SPEEDS_HZ[0] ) );
+
+  // Round the divisor up, so that we never exceed the requested speed.
+  const uint32_t divisor = ( CPU_CLOCK + SPEEDS_HZ[ speedIndex ] - 1 ) / SPEEDS_HZ[ speedIndex ];
+
+  if ( divisor > 255 )
+  {
+    assert( speedIndex < SPI_PORT_DEFAULT_SPEED_INDEX );
+    return false;
+  }
+
+  VERIFY( 0 == spi_set_baudrate_div( SPI0, SPI_CHIP_SEL, uint8_t( divisor ) ) );
+  return true;
+}
+
+
+void SpiPort_SetBusConfig ( const bool isOpenDrain,
+                            const bool isClockIdleHigh,
+                            const bool isOutputOnActiveToIdleEdge )
+{
+  // The chip select output follows the same setting.
+  pio_set_multi_driver( PIOA, PIO_PA26A_SPI0_MOSI | PIO_PA27A_SPI0_SPCK, isOpenDrain ? ENABLE : DISABLE );
+  pio_set_multi_driver( SPI_CS_PIO, BV(SPI_CS_PIN), isOpenDrain ? ENABLE : DISABLE );
+
+  spi_set_clock_polarity( SPI0, SPI_CHIP_SEL, isClockIdleHigh ? 1 : 0 );
+
+  // The SAM3X's NCPHA bit is the inverse of the usual CPHA, so it matches the Bus Pirate's "clock edge" setting.
+  spi_set_clock_phase( SPI0, SPI_CHIP_SEL, isOutputOnActiveToIdleEdge ? 1 : 0 );
+}
+
+
+void SpiPort_SetPullUps ( const bool enablePullUps )
+{
+  pio_pull_up( PIOA, SPI_BUS_PINS, enablePullUps ? ENABLE : DISABLE );
+  pio_pull_up( SPI_CS_PIO, BV(SPI_CS_PIN), enablePullUps ? ENABLE : DISABLE );
+}
+
+
+// The PDC moves the data between memory and the SPI peripheral, so the CPU only needs to wait
+// for the end of the transfer. Even at the highest SPI clock speed, the CPU would not be able
+// to keep the SPI transmitter busy all the time with a software loop.
+
+void SpiPort_Transfer ( const uint8_t * const txData, uint8_t * const rxData, const uint32_t byteCount )
+{
+  assert( byteCount <= UINT16_MAX );  // The PDC counter registers are 16 bits wide.
+
+  if ( byteCount == 0 )
+    return;
+
+  Pdc * const pdc = spi_get_pdc_base( SPI0 );
+
+  // Discard any data left over from a previous transfer without reception.
+  // Reading the status register clears the overrun error flag.
+  (void) SPI0->SPI_RDR;
+  (void) SPI0->SPI_SR;
+
+  pdc_packet_t txPacket;
+  txPacket.ul_addr = uint32_t( uintptr_t( txData ) );
+  txPacket.ul_size = byteCount;
+  pdc_tx_init( pdc, &txPacket, nullptr );
+
+  if ( rxData == nullptr )
+  {
+    pdc_enable_transfer( pdc, PERIPH_PTCR_TXTEN );
+
+    // Flag TXEMPTY is already set while the SPI is idle, before the PDC has written the first byte,
+    // so wait first for the PDC to write the last byte (its counter reaches zero, flag ENDTX).
+    while ( 0 == ( SPI0->SPI_SR & SPI_SR_ENDTX ) )
+    {
+    }
+
+    // Flag TXEMPTY only gets set after the last bit has been shifted out.
+    while ( 0 == ( SPI0->SPI_SR & SPI_SR_TXEMPTY ) )
+    {
+    }
+  }
+  else
+  {
+    // Receiving in place works because the PDC always reads a byte to transmit
+    // before the byte received at the same position arrives.
+
+    pdc_packet_t rxPacket;
+    rxPacket.ul_addr = uint32_t( uintptr_t( rxData ) );
+    rxPacket.ul_size = byteCount;
+    pdc_rx_init( pdc, &rxPacket, nullptr );
+
+    pdc_enable_transfer( pdc, PERIPH_PTCR_RXTEN | PERIPH_PTCR_TXTEN );
+
+    while ( 0 == ( SPI0->SPI_SR & SPI_SR_ENDRX ) )
+    {
+    }
+  }
+
+  pdc_disable_transfer( pdc, PERIPH_PTCR_RXTDIS | PERIPH_PTCR_TXTDIS );
+}
@@ -0,0 +1,56 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+#include <stdint.h>
+
+// The SPI port drives an SPI bus with the SAM3X's SPI0 peripheral and its PDC (DMA) channels.
+//
+// Pins on the Arduino Due:
+//   SPI header (next to the SAM3X): MISO (PA25), MOSI (PA26) and SCK (PA27).
+//   Chip select: Arduino pin 52 (PB21). It is driven as a normal output, so that the Bus Pirate protocol
+//                can keep it active across several transfers.
+//
+// The host emulator replaces this module with a simulated SPI flash, see HostEmulator/SimulatedSpiFlash.h .
+
+void SpiPort_Init ( void );
+void SpiPort_Terminate ( void );
+
+// The chip select signal is active low.
+void SpiPort_SetChipSelect ( bool isActive );
+
+// Bus Pirate speed index: 0 = 30 kHz, 1 = 125 kHz, 2 = 250 kHz, 3 = 1 MHz, 4 = 2 MHz, 5 = 2.6 MHz, 6 = 4 MHz, 7 = 8 MHz.
+// The SPI clock never runs faster than requested. The SPI clock divisor is only 8 bits wide,
+// so the slowest possible speed is around 330 kHz (84 MHz / 255). Therefore, the first 3 settings
+// are not supported, and this routine returns false for them without changing the speed.
+// The speed after SpiPort_Init() is SPI_PORT_DEFAULT_SPEED_INDEX, the slowest supported one.
+static const uint8_t SPI_PORT_DEFAULT_SPEED_INDEX = 3;
+
+bool SpiPort_SetSpeed ( uint8_t speedIndex );
+
+// The Bus Pirate calls "clock edge" what most data sheets call the clock phase (CPHA = !clockEdge).
+// There is no way to sample at the end of the data output time on the SAM3X,
+// so the corresponding Bus Pirate setting is ignored.
+void SpiPort_SetBusConfig ( bool isOpenDrain, bool isClockIdleHigh, bool isOutputOnActiveToIdleEdge );
+
+void SpiPort_SetPullUps ( bool enablePullUps );
+
+// Transmits and receives byteCount bytes at the same time.
+//
+// If rxData is nullptr, the received data is discarded.
+// rxData may point to the same buffer as txData, so that the received data overwrites
+// the transmitted data in place.
+
+void SpiPort_Transfer ( const uint8_t * txData, uint8_t * rxData, uint32_t byteCount );
@@ -0,0 +1,222 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "UartBridge.h"  // The include file for this module should come first.
+
+#include <assert.h>
+
+#include <interrupt.h>
+
+#include <BareMetalSupport/Miscellaneous.h>
+#include <BareMetalSupport/CircularBuffer.h>
+#include <BareMetalSupport/DmaRxRing.h>
+#include <BareMetalSupport/SerialPrint.h>
+#include <BareMetalSupport/NoInitData.h>
+#include <Misc/AssertionUtils.h>
+
+#include "UartPort.h"
+
+
+#ifndef NDEBUG
+  static bool s_wasInitialised = false;
+#endif
+
+static CDmaRxRing< UART_BRIDGE_RX_BUFFER_SIZE > s_rxRing NOINIT_DATA;
+
+typedef CCircularBuffer< uint8_t, uint32_t, UART_BRIDGE_TX_BUFFER_SIZE > CUartBridgeTxBuffer;
+static CUartBridgeTxBuffer s_txBuffer NOINIT_DATA;
+
+// The first bytes in s_txBuffer that the UART DMA is sending. They can only be consumed
+// once the transfer has completed.
+static uint32_t s_txInFlightCount;
+
+// The bytes after the ones in flight that UartBridge_DiscardData() has dropped.
+static uint32_t s_txSkipCount;
+
+static uint32_t s_baudRate;
+static uint64_t s_hostToTargetByteCount;
+static uint64_t s_targetToHostByteCount;
+static uint32_t s_rejectedLineCodingCount;
+
+// The line coding requested from the USB interrupt context.
+static volatile bool     s_isLineCodingPending;
+static volatile uint32_t s_pendingBaudRate;
+static volatile uint8_t  s_pendingDataBits;
+static volatile uint8_t  s_pendingParity;
+static volatile uint8_t  s_pendingStopBits;
+
+
+void UartBridge_Init ( void )
+{
+  assert( !s_wasInitialised );
+
+  #ifndef NDEBUG
+    s_wasInitialised = true;
+  #endif
+
+  s_txBuffer.Reset();
+  s_txInFlightCount = 0;
+  s_txSkipCount = 0;
+  s_hostToTargetByteCount = 0;
+  s_targetToHostByteCount = 0;
+  s_rejectedLineCodingCount = 0;
+  s_isLineCodingPending = false;
+
+  UartPort_Init( s_rxRing.GetBuffer(), s_rxRing.SIZE );
+
+  s_baudRate = UART_BRIDGE_DEFAULT_BAUD_RATE;
+  VERIFY( UartPort_SetLineCoding( s_baudRate, 8, upNone, sb1 ) );
+
+  s_rxRing.Reset( UartPort_GetRxWriteCount() );
+}
+
+
+void UartBridge_RequestLineCoding ( const uint32_t baudRate,
+                                    const uint8_t dataBits,
+                                    const uint8_t parity,
+                                    const uint8_t stopBits )
+{
+  s_pendingBaudRate     = baudRate;
+  s_pendingDataBits     = dataBits;
+  s_pendingParity       = parity;
+  s_pendingStopBits     = stopBits;
+  s_isLineCodingPending = true;
+}
+
+
+static void ApplyPendingLineCoding ( void )
+{
+  uint32_t baudRate;
+  uint8_t  dataBits;
+  uint8_t  parity;
+  uint8_t  stopBits;
+
+  {
+    CAutoDisableInterrupts autoDisableInterrupts;
+
+    if ( !s_isLineCodingPending )
+      return;
+
+    baudRate = s_pendingBaudRate;
+    dataBits = s_pendingDataBits;
+    parity   = s_pendingParity;
+    stopBits = s_pendingStopBits;
+
+    s_isLineCodingPending = false;
+  }
+
+  if ( baudRate == 0 ||
+       parity > upSpace ||
+       stopBits > sb2 ||
+       !UartPort_SetLineCoding( baudRate, dataBits, UartParityEnum( parity ), UartStopBitsEnum( stopBits ) ) )
+  {
+    // The CDC protocol has no way to reject the settings, so just keep the old ones.
+    ++s_rejectedLineCodingCount;
+    return;
+  }
+
+  s_baudRate = baudRate;
+
+  if ( false )
+  {
+    SerialPrintf( "UART bridge: %u baud." EOL, unsigned( baudRate ) );
+  }
+}
+
+
+void UartBridge_DiscardData ( void )
+{
+  assert( s_wasInitialised );
+
+  s_rxRing.Reset( UartPort_GetRxWriteCount() );
+
+  // The bytes in flight cannot be taken back, so skip the rest once the transfer has completed.
+  s_txSkipCount = s_txBuffer.GetElemCount() - s_txInFlightCount;
+}
+
+
+uint8_t * UartBridge_GetTxWritePtr ( uint32_t * const elemCount )
+{
+  return s_txBuffer.GetWritePtr( elemCount );
+}
+
+
+void UartBridge_CommitTxData ( const uint32_t elemCount )
+{
+  s_txBuffer.CommitWrittenElements( elemCount );
+  s_hostToTargetByteCount += elemCount;
+}
+
+
+const uint8_t * UartBridge_GetRxReadPtr ( uint32_t * const elemCount )
+{
+  return s_rxRing.GetReadPtr( UartPort_GetRxWriteCount(), elemCount );
+}
+
+
+void UartBridge_ConsumeRxData ( const uint32_t elemCount )
+{
+  s_rxRing.ConsumeReadElements( elemCount );
+  s_targetToHostByteCount += elemCount;
+}
+
+
+void UartBridge_Service ( void )
+{
+  assert( s_wasInitialised );
+
+  ApplyPendingLineCoding();
+
+  if ( UartPort_IsTxBusy() )
+    return;
+
+  if ( s_txInFlightCount != 0 )
+  {
+    s_txBuffer.ConsumeReadElements( s_txInFlightCount );
+    s_txInFlightCount = 0;
+  }
+
+  if ( s_txSkipCount != 0 )
+  {
+    s_txBuffer.ConsumeReadElements( s_txSkipCount );
+    s_txSkipCount = 0;
+  }
+
+  // Send the data up to the end of the circular buffer in one go. Any data after the wrap-around
+  // goes in the next transfer.
+
+  uint32_t availableCount;
+  const uint8_t * const readPtr = s_txBuffer.GetReadPtr( &availableCount );
+
+  if ( availableCount == 0 )
+    return;
+
+  UartPort_StartTx( readPtr, availableCount );
+  s_txInFlightCount = availableCount;
+}
+
+
+void UartBridge_GetStats ( UartBridgeStats * const stats )
+{
+  // Update the lost byte count.
+  s_rxRing.GetElemCount( UartPort_GetRxWriteCount() );
+
+  stats->baudRate                = s_baudRate;
+  stats->hostToTargetByteCount   = s_hostToTargetByteCount;
+  stats->targetToHostByteCount   = s_targetToHostByteCount;
+  stats->lostRxByteCount         = s_rxRing.GetLostCount();
+  stats->rxErrorCount            = UartPort_GetRxErrorCount();
+  stats->rejectedLineCodingCount = s_rejectedLineCodingCount;
+}
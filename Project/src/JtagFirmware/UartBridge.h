@@ -0,0 +1,68 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+#include <stdint.h>
+
+// The UART bridge connects the second USB CDC serial port to the target's debug serial port,
+// so that you do not need a separate USB serial adapter for it. See UartPort.h for the pins.
+//
+// This module only manages the buffers between the host side (see UartBridgeConnection.cpp)
+// and the UART (see UartPort.h), so it has nothing hardware-specific and runs in the host emulator too.
+// The DMA moves the UART data, so the main loop only needs to pass the data along now and then,
+// which takes little time away from the JTAG work.
+//
+// The buffers are sized so that the main loop can fall behind by around 25 ms at 3 Mbaud.
+// There is no flow control on the UART side. If the host does not fetch the received data in time,
+// the oldest data is lost and counted, see UartBridgeStats.
+
+#define UART_BRIDGE_RX_BUFFER_SIZE  8192  // Target to host, must be a power of 2.
+#define UART_BRIDGE_TX_BUFFER_SIZE  4096  // Host to target.
+
+#define UART_BRIDGE_DEFAULT_BAUD_RATE  115200
+
+void UartBridge_Init ( void );
+
+// The USB side calls this from its interrupt context whenever the host changes the serial port settings.
+// The new settings take effect in the next UartBridge_Service() call.
+void UartBridge_RequestLineCoding ( uint32_t baudRate, uint8_t dataBits, uint8_t parity, uint8_t stopBits );
+
+// Drops all data in both directions, for example when the host connects. The data already handed over
+// to the UART DMA still gets sent.
+void UartBridge_DiscardData ( void );
+
+// Host to target. These routines work like CCircularBuffer::GetWritePtr() and CommitWrittenElements().
+uint8_t * UartBridge_GetTxWritePtr ( uint32_t * elemCount );
+void UartBridge_CommitTxData ( uint32_t elemCount );
+
+// Target to host. These routines work like CCircularBuffer::GetReadPtr() and ConsumeReadElements().
+const uint8_t * UartBridge_GetRxReadPtr ( uint32_t * elemCount );
+void UartBridge_ConsumeRxData ( uint32_t elemCount );
+
+// Applies any new line settings and hands the next block of host data over to the UART DMA.
+void UartBridge_Service ( void );
+
+
+struct UartBridgeStats
+{
+  uint32_t baudRate;
+  uint64_t hostToTargetByteCount;
+  uint64_t targetToHostByteCount;
+  uint32_t lostRxByteCount;   // Since the last UartBridge_DiscardData(). Received from the target, but overwritten before the host could fetch them.
+  uint32_t rxErrorCount;      // Framing, parity and overrun errors.
+  uint32_t rejectedLineCodingCount;
+};
+
+void UartBridge_GetStats ( UartBridgeStats * stats );
@@ -0,0 +1,132 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "UartBridgeConnection.h"  // The include file for this module should come first.
+
+#include <assert.h>
+
+#include <BareMetalSupport/Miscellaneous.h>
+#include <BareMetalSupport/SerialPrint.h>
+#include <BareMetalSupport/MainLoopSleep.h>
+
+#include "UartBridge.h"
+#include "UsbSupport.h"
+
+#include <udi_cdc.h>
+
+
+static bool s_isConnectionOpen = false;
+
+
+void InitUartBridgeConnection ( void )
+{
+  UartBridge_Init();
+}
+
+
+// Routines udi_cdc_multi_read_buf() and udi_cdc_multi_write_buf() wait until they can transfer
+// all the data requested, so ask for no more than what is already available.
+
+static void TransferHostToTarget ( void )
+{
+  for ( ; ; )
+  {
+    uint32_t freeCount;
+    uint8_t * const writePtr = UartBridge_GetTxWritePtr( &freeCount );
+
+    if ( freeCount == 0 )
+      break;
+
+    const uint32_t inUsbBufferCount = udi_cdc_multi_get_nb_received_data( USB_UART_BRIDGE_CDC_PORT );
+
+    if ( inUsbBufferCount == 0 )
+      break;
+
+    const uint32_t toReceiveCount = MinFrom( inUsbBufferCount, freeCount );
+
+    const uint32_t remainingCount = udi_cdc_multi_read_buf( USB_UART_BRIDGE_CDC_PORT, writePtr, toReceiveCount );
+
+    assert( remainingCount <= toReceiveCount );
+
+    const uint32_t readCount = toReceiveCount - remainingCount;
+
+    if ( readCount == 0 )
+      break;
+
+    UartBridge_CommitTxData( readCount );
+  }
+}
+
+
+static void TransferTargetToHost ( void )
+{
+  for ( ; ; )
+  {
+    uint32_t availableCount;
+    const uint8_t * const readPtr = UartBridge_GetRxReadPtr( &availableCount );
+
+    if ( availableCount == 0 )
+      break;
+
+    const uint32_t freeInUsbBufferCount = udi_cdc_multi_get_free_tx_buffer( USB_UART_BRIDGE_CDC_PORT );
+
+    if ( freeInUsbBufferCount == 0 )
+      break;
+
+    const uint32_t toSendCount = MinFrom( availableCount, freeInUsbBufferCount );
+
+    const uint32_t remainingCount = udi_cdc_multi_write_buf( USB_UART_BRIDGE_CDC_PORT, readPtr, toSendCount );
+
+    assert( remainingCount <= toSendCount );
+
+    const uint32_t writtenCount = toSendCount - remainingCount;
+
+    if ( writtenCount == 0 )
+      break;
+
+    UartBridge_ConsumeRxData( writtenCount );
+  }
+}
+
+
+void ServiceUartBridgeConnection ( void )
+{
+  const bool isOpen = IsUartBridgeUsbConnectionOpen();
+
+  if ( isOpen != s_isConnectionOpen )
+  {
+    s_isConnectionOpen = isOpen;
+
+    if ( false )
+      SerialPrintStr( isOpen ? "UART bridge opened." EOL : "UART bridge closed." EOL );
+
+    // Do not deliver old target output to the next client.
+    UartBridge_DiscardData();
+  }
+
+  if ( isOpen )
+  {
+    TransferHostToTarget();
+    TransferTargetToHost();
+  }
+  else
+  {
+    // Nobody is listening, so keep the reception buffer from filling up and counting lost bytes.
+    UartBridge_DiscardData();
+  }
+
+  // Hand the new host data over to the UART DMA.
+  UartBridge_Service();
+}
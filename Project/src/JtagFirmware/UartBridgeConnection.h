@@ -0,0 +1,10 @@
+#pragma once
+
+// This module connects the UART bridge (see UartBridge.h) to the second USB CDC serial port.
+// The main loop calls ServiceUartBridgeConnection() after ServiceUsbConnection(). It never waits
+// for the USB or for the UART, so it does not delay the JTAG work on the first serial port.
+//
+// The host emulator replaces this module with a second pseudo-terminal, see HostEmulator/PtyUartBridge.cpp .
+
+void InitUartBridgeConnection ( void );
+void ServiceUartBridgeConnection ( void );
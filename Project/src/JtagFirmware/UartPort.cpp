@@ -0,0 +1,256 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "UartPort.h"  // The include file for this module should come first.
+
+#include <assert.h>
+
+#include <BareMetalSupport/Miscellaneous.h>
+#include <BareMetalSupport/MainLoopSleep.h>
+#include <Misc/AssertionUtils.h>
+
+#include <sam3xa.h>
+#include <pio.h>
+#include <pmc.h>
+#include <usart.h>
+#include <pdc.h>
+
+
+#define BRIDGE_USART      USART0
+#define BRIDGE_USART_ID   ID_USART0
+#define BRIDGE_USART_IRQ  USART0_IRQn
+
+static const uint32_t BRIDGE_USART_PINS = PIO_PA10A_RXD0 | PIO_PA11A_TXD0;
+
+// The receiver time-out wakes the main loop up when the target stops sending,
+// so that the last bytes do not wait in the ring buffer until the next half is full.
+static const uint32_t RX_TIMEOUT_BIT_PERIODS = 20;
+
+static const uint32_t USART_RX_ERROR_FLAGS = US_CSR_OVRE | US_CSR_FRAME | US_CSR_PARE;
+
+
+// The PDC fills the ring buffer in 2 halves. While it fills one half, the other one is
+// programmed as the next buffer, so the reception never stops. The interrupt handler
+// reprograms the half that has just been completed as the next buffer again.
+
+static uint8_t * s_rxRingBuffer;
+static uint32_t  s_rxRingBufferSize;
+
+static volatile uint32_t s_completedRxHalfCount;
+static volatile uint32_t s_rxErrorCount;
+
+
+void USART0_Handler ( void )
+{
+  const uint32_t status = BRIDGE_USART->US_CSR;
+
+  if ( status & USART_RX_ERROR_FLAGS )
+  {
+    ++s_rxErrorCount;
+    BRIDGE_USART->US_CR = US_CR_RSTSTA;
+  }
+
+  if ( status & US_CSR_ENDRX )
+  {
+    const uint32_t halfSize = s_rxRingBufferSize / 2;
+    const uint32_t completedHalfIndex = s_completedRxHalfCount % 2;
+
+    ++s_completedRxHalfCount;
+
+    // Writing the next counter register clears flag ENDRX.
+    Pdc * const pdc = usart_get_pdc_base( BRIDGE_USART );
+    pdc->PERIPH_RNPR = uint32_t( uintptr_t( s_rxRingBuffer + completedHalfIndex * halfSize ) );
+    pdc->PERIPH_RNCR = halfSize;
+  }
+
+  // Flag ENDTX remains set while the transmitter is idle, so its interrupt is only enabled during a transfer.
+  if ( ( status & US_CSR_ENDTX ) && ( BRIDGE_USART->US_IMR & US_IMR_ENDTX ) )
+  {
+    // Let the main loop start the next transfer.
+    BRIDGE_USART->US_IDR = US_IDR_ENDTX;
+  }
+
+  if ( status & US_CSR_TIMEOUT )
+  {
+    // Wait for the next character before starting the time-out again.
+    BRIDGE_USART->US_CR = US_CR_STTTO;
+  }
+
+  WakeFromMainLoopSleep();
+}
+
+
+void UartPort_Init ( uint8_t * const rxRingBuffer, const uint32_t rxRingBufferSize )
+{
+  assert( 0 == ( rxRingBufferSize & ( rxRingBufferSize - 1 ) ) );
+  assert( rxRingBufferSize / 2 <= UINT16_MAX );  // The PDC counter registers are 16 bits wide.
+
+  s_rxRingBuffer = rxRingBuffer;
+  s_rxRingBufferSize = rxRingBufferSize;
+  s_completedRxHalfCount = 0;
+  s_rxErrorCount = 0;
+
+  VERIFY( 0 == pmc_enable_periph_clk( BRIDGE_USART_ID ) );
+
+  // The target's transmit line may be left floating.
+  VERIFY( pio_configure( PIOA, PIO_PERIPH_A, BRIDGE_USART_PINS, PIO_PULLUP ) );
+
+  Pdc * const pdc = usart_get_pdc_base( BRIDGE_USART );
+
+  const uint32_t halfSize = rxRingBufferSize / 2;
+
+  pdc_packet_t rxPacket;
+  rxPacket.ul_addr = uint32_t( uintptr_t( rxRingBuffer ) );
+  rxPacket.ul_size = halfSize;
+
+  pdc_packet_t rxNextPacket;
+  rxNextPacket.ul_addr = uint32_t( uintptr_t( rxRingBuffer + halfSize ) );
+  rxNextPacket.ul_size = halfSize;
+
+  pdc_rx_init( pdc, &rxPacket, &rxNextPacket );
+
+  pdc_enable_transfer( pdc, PERIPH_PTCR_RXTEN | PERIPH_PTCR_TXTEN );
+
+  // The lowest priority, so that the bridge never delays the USB interrupt.
+  NVIC_SetPriority( BRIDGE_USART_IRQ, 15 );
+  NVIC_ClearPendingIRQ( BRIDGE_USART_IRQ );
+  NVIC_EnableIRQ( BRIDGE_USART_IRQ );
+
+  // The caller must set the line coding before the USART starts.
+}
+
+
+bool UartPort_SetLineCoding ( const uint32_t baudRate,
+                              const uint8_t dataBits,
+                              const UartParityEnum parity,
+                              const UartStopBitsEnum stopBits )
+{
+  // The USART can oversample by 16 or by 8, and its clock divisor has 16 bits.
+  if ( baudRate == 0 ||
+       baudRate > CPU_CLOCK / 8 ||
+       CPU_CLOCK / 16 / baudRate > UINT16_MAX )
+  {
+    return false;
+  }
+
+  sam_usart_opt_t options;
+
+  options.baudrate     = baudRate;
+  options.channel_mode = US_MR_CHMODE_NORMAL;
+  options.irda_filter  = 0;
+
+  switch ( dataBits )
+  {
+  case 5: options.char_length = US_MR_CHRL_5_BIT; break;
+  case 6: options.char_length = US_MR_CHRL_6_BIT; break;
+  case 7: options.char_length = US_MR_CHRL_7_BIT; break;
+  case 8: options.char_length = US_MR_CHRL_8_BIT; break;
+  default: return false;  // The ring buffers hold bytes, so 9-bit characters are not supported.
+  }
+
+  switch ( parity )
+  {
+  case upNone:  options.parity_type = US_MR_PAR_NO;    break;
+  case upOdd:   options.parity_type = US_MR_PAR_ODD;   break;
+  case upEven:  options.parity_type = US_MR_PAR_EVEN;  break;
+  case upMark:  options.parity_type = US_MR_PAR_MARK;  break;
+  case upSpace: options.parity_type = US_MR_PAR_SPACE; break;
+  default: return false;
+  }
+
+  switch ( stopBits )
+  {
+  case sb1:   options.stop_bits = US_MR_NBSTOP_1_BIT;   break;
+  case sb1_5: options.stop_bits = US_MR_NBSTOP_1_5_BIT; break;
+  case sb2:   options.stop_bits = US_MR_NBSTOP_2_BIT;   break;
+  default: return false;
+  }
+
+  // This resets the USART, including its interrupt mask and receiver time-out, but not the PDC.
+  if ( 0 != usart_init_rs232( BRIDGE_USART, &options, CPU_CLOCK ) )
+    return false;
+
+  usart_set_rx_timeout( BRIDGE_USART, RX_TIMEOUT_BIT_PERIODS );
+  usart_start_rx_timeout( BRIDGE_USART );
+
+  usart_enable_interrupt( BRIDGE_USART, US_IER_ENDRX | US_IER_TIMEOUT | US_IER_OVRE | US_IER_FRAME | US_IER_PARE );
+
+  if ( UartPort_IsTxBusy() )
+    usart_enable_interrupt( BRIDGE_USART, US_IER_ENDTX );
+
+  usart_enable_tx( BRIDGE_USART );
+  usart_enable_rx( BRIDGE_USART );
+
+  return true;
+}
+
+
+uint32_t UartPort_GetRxWriteCount ( void )
+{
+  const Pdc * const pdc = usart_get_pdc_base( BRIDGE_USART );
+
+  uint32_t halfCount;
+  uint32_t status;
+  uint32_t rxPointer;
+
+  {
+    CAutoDisableInterrupts autoDisableInterrupts;
+
+    // Read the status before the pointer. If the PDC switches to the next half in between,
+    // the pointer is already in the next half, which the calculation below takes into account.
+    halfCount = s_completedRxHalfCount;
+    status    = BRIDGE_USART->US_CSR;
+    rxPointer = pdc->PERIPH_RPR;
+  }
+
+  // If a half has just been completed, but the interrupt handler has not run yet,
+  // the pointer is already in the next half, or at the end of the completed half, which is the same position.
+  if ( status & US_CSR_ENDRX )
+    ++halfCount;
+
+  const uint32_t halfSize = s_rxRingBufferSize / 2;
+  const uint32_t rxPos = ( rxPointer - uint32_t( uintptr_t( s_rxRingBuffer ) ) ) % s_rxRingBufferSize;
+  const uint32_t halfStartPos = ( halfCount % 2 ) * halfSize;
+
+  // The position within the current half can exceed the half size, see above.
+  return halfCount * halfSize + ( rxPos - halfStartPos ) % s_rxRingBufferSize;
+}
+
+
+uint32_t UartPort_GetRxErrorCount ( void )
+{
+  return s_rxErrorCount;
+}
+
+
+bool UartPort_IsTxBusy ( void )
+{
+  return 0 != usart_get_pdc_base( BRIDGE_USART )->PERIPH_TCR;
+}
+
+
+void UartPort_StartTx ( const uint8_t * const data, const uint32_t dataLen )
+{
+  assert( !UartPort_IsTxBusy() );
+  assert( dataLen != 0 && dataLen <= UINT16_MAX );
+
+  pdc_packet_t txPacket;
+  txPacket.ul_addr = uint32_t( uintptr_t( data ) );
+  txPacket.ul_size = dataLen;
+
+  pdc_tx_init( usart_get_pdc_base( BRIDGE_USART ), &txPacket, nullptr );
+
+  usart_enable_interrupt( BRIDGE_USART, US_IER_ENDTX );
+}
@@ -0,0 +1,59 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+#include <stdint.h>
+
+// The UART that UartBridge.cpp connects to the target's debug serial port.
+//
+// On the Arduino Due, this is USART0 on pins 19 (RX1) and 18 (TX1). The PDC moves the data
+// in both directions. The reception DMA runs forever into the ring buffer passed to UartPort_Init(),
+// see CDmaRxRing, and the main loop learns how far it has got with UartPort_GetRxWriteCount().
+//
+// The host emulator replaces this module with a loopback, see HostEmulator/SimulatedUartPort.cpp .
+
+// The values are the same as in the USB CDC line coding.
+enum UartStopBitsEnum
+{
+  sb1   = 0,
+  sb1_5 = 1,
+  sb2   = 2
+};
+
+enum UartParityEnum
+{
+  upNone  = 0,
+  upOdd   = 1,
+  upEven  = 2,
+  upMark  = 3,
+  upSpace = 4
+};
+
+// The ring buffer size must be a power of 2.
+void UartPort_Init ( uint8_t * rxRingBuffer, uint32_t rxRingBufferSize );
+
+// Returns false if the UART does not support the given settings, and then the settings do not change.
+// Any reception or transmission in progress may get corrupted.
+bool UartPort_SetLineCoding ( uint32_t baudRate, uint8_t dataBits, UartParityEnum parity, UartStopBitsEnum stopBits );
+
+// The total number of bytes received so far into the ring buffer, modulo 2^32.
+uint32_t UartPort_GetRxWriteCount ( void );
+
+// The number of framing, parity and overrun errors so far.
+uint32_t UartPort_GetRxErrorCount ( void );
+
+// The data must remain untouched until UartPort_IsTxBusy() returns false.
+bool UartPort_IsTxBusy ( void );
+void UartPort_StartTx ( const uint8_t * data, uint32_t dataLen );
@@ -17,13 +17,16 @@
 #include "UsbBuffers.h"  // The include file for this module should come first.
 
 #include <stdio.h>
-#include <stdexcept>
 
 #include <BareMetalSupport/DebugConsoleEol.h>
 
 #include "Globals.h"
 
 
+// Set when the Tx Buffer overflows, see CheckAndClearUsbTxBufferOverflow().
+static bool s_hasTxBufferOverflowed = false;
+
+
 static void SendData ( CUsbTxBuffer * const txBuffer, const uint8_t * data, const size_t dataLen )
 {
   if ( dataLen == 0 )
@@ -33,6 +36,11 @@ static void SendData ( CUsbTxBuffer * const txBuffer, const uint8_t * data, cons
     return;
   }
 
+  // After an overflow, the rest of the reply is dropped too, because the connection
+  // will be reset anyway, and a reply with gaps in it could be mistaken for a valid one.
+  if ( s_hasTxBufferOverflowed )
+    return;
+
   if ( dataLen > txBuffer->GetFreeCount() )
   {
     // The caller should always make sure that there is enough space in the Tx Buffer
@@ -46,16 +54,31 @@ static void SendData ( CUsbTxBuffer * const txBuffer, const uint8_t * data, cons
     // you should strive to avoid it.
     //
     // Remember that, with the current implementation, data does not just get truncated
-    // at this point, but the whole connection gets reset.
+    // at this point, but the whole connection gets reset. This used to throw a C++ exception,
+    // but throwing is expensive, and the firmware may have been built with -fno-exceptions.
+    // Therefore, a sticky flag records the overflow, and the connection code turns it into
+    // a protocol error after processing the received data.
     assert( false );
 
-    throw std::runtime_error( "Tx Buffer overflow." );
+    s_hasTxBufferOverflowed = true;
+    return;
   }
 
   txBuffer->WriteElemArray( data, dataLen );
 }
 
 
+ProtocolResult CheckAndClearUsbTxBufferOverflow ( void )
+{
+  if ( !s_hasTxBufferOverflowed )
+    return ProtocolResult::Ok();
+
+  s_hasTxBufferOverflowed = false;
+
+  return ProtocolResult::Error( "Tx Buffer overflow." );
+}
+
+
 // It is hard to keep the last discarded characters, and there is often an end-of-line sequence there.
 // As a (cheap) work-around, insert always an EOL.
 static const char TRUNCATION_SUFFIX[] = "[...]" EOL;
@@ -75,7 +98,10 @@ void UsbPrintV ( CUsbTxBuffer * const txBuffer, const char * const formatStr, va
   if ( len < 0 )
   {
     // I do not think that vsnprintf would ever fail, but you never know.
-    throw std::runtime_error( "vsnprintf failed." );
+    // This used to throw a C++ exception, which reset the whole connection. Use the same
+    // sticky flag as a Tx Buffer overflow, so that the connection still gets reset.
+    assert( false );
+    s_hasTxBufferOverflowed = true;
   }
   else if ( len >= MAX_USB_PRINT_LEN + 1 )  // If the string needs to be truncated ...
   {
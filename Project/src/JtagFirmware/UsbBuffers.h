@@ -19,6 +19,8 @@
 
 #include <BareMetalSupport/CircularBuffer.h>
 
+#include "ProtocolResult.h"
+
 // The way we handle the USB reception and transmission buffers is a compromise
 // between memory usage and speed. After all, we have a slow embedded processor
 // with very little RAM.
@@ -72,3 +74,10 @@ void UsbPrintV ( CUsbTxBuffer * const txBuffer, const char * const formatStr, va
 
 void UsbPrintChar ( CUsbTxBuffer * txBuffer, const char c );
 void UsbPrintStr ( CUsbTxBuffer * txBuffer, const char * str );
+
+// The print routines above do not write anything if the data does not fit in the Tx Buffer.
+// Instead, they set a sticky overflow flag, and drop all further data until the flag is cleared.
+// UsbPrintV() sets the same flag if vsnprintf() fails.
+// The connection code checks the flag with this routine after processing the received data,
+// and the resulting error resets the connection like any other protocol error.
+ProtocolResult CheckAndClearUsbTxBufferOverflow ( void );
@@ -19,6 +19,7 @@
 #include "UsbBuffers.h"
 
 #include <interrupt.h>
+#include <sam3xa.h>
 
 #include <string.h>
 #include <inttypes.h>
@@ -27,13 +28,16 @@
 #include <BareMetalSupport/Uptime.h>
 #include <BareMetalSupport/SerialPrint.h>
 #include <BareMetalSupport/MainLoopSleep.h>
+#include <BareMetalSupport/NoInitData.h>
 #include <Misc/AssertionUtils.h>
 
 #include "UsbSupport.h"
 #include "Globals.h"
 #include "BusPirateConnection.h"
+#include "UsbTxFlushPolicy.h"
 
 #include <udi_cdc.h>
+#include <udd.h>
 
 
 enum ConnectionStatusEnum
@@ -47,8 +51,66 @@ enum ConnectionStatusEnum
 
 static ConnectionStatusEnum s_connectionStatus = csNoConnection;
 
-static CUsbTxBuffer s_usbTxBuffer;
-static CUsbRxBuffer s_usbRxBuffer;
+static CUsbTxBuffer s_usbTxBuffer NOINIT_DATA;
+static CUsbRxBuffer s_usbRxBuffer NOINIT_DATA;
+
+
+// Low-latency mode
+//
+// The USB reception notification (rx_notify) comes in the USB interrupt, and normally only wakes the main loop.
+// The main loop may be busy with something else, like the console or the UART bridge, so OpenOCD's next
+// command may have to wait. In low-latency mode, rx_notify also triggers PendSV, which has the lowest
+// interrupt priority. Its handler reads the new data, runs the short OpenOCD commands straight away
+// (see BusPirateConnection_ProcessDataFromInterrupt()) and sends the replies. Anything else, like long TAP shifts,
+// other commands or connection state changes, is left for the main loop, which gets woken up as usual.
+//
+// The USB buffers, the connection state and the current Bus Pirate mode are owned by the main loop
+// while s_isLowLatencyServiceHeldOff is set, and are otherwise free for the PendSV handler to use.
+// PendSV can interrupt the main loop, but not the other way round, so a simple flag is enough.
+// The other interrupt handlers do not touch any of that state.
+//
+// If PendSV finds the flag set, it just returns. The main loop has been woken up by rx_notify anyway,
+// and will process the data the normal way.
+
+static volatile bool s_isLowLatencyServiceHeldOff = false;
+
+
+CHoldOffUsbLowLatencyService::CHoldOffUsbLowLatencyService ( void ) throw()
+{
+  assert( !s_isLowLatencyServiceHeldOff );
+  s_isLowLatencyServiceHeldOff = true;
+
+  // Make sure that the compiler and the CPU do not move any buffer accesses before setting the flag.
+  __DMB();
+}
+
+
+CHoldOffUsbLowLatencyService::~CHoldOffUsbLowLatencyService ( void ) throw()
+{
+  __DMB();
+
+  assert( s_isLowLatencyServiceHeldOff );
+  s_isLowLatencyServiceHeldOff = false;
+}
+
+
+void InitUsbConnection ( void )
+{
+  if ( ENABLE_USB_LOW_LATENCY_MODE )
+  {
+    // PendSV should not delay any other interrupt handler.
+    NVIC_SetPriority( PendSV_IRQn, ( 1 << __NVIC_PRIO_BITS ) - 1 );
+  }
+}
+
+
+void TriggerUsbLowLatencyService ( void ) throw()
+{
+  if ( ENABLE_USB_LOW_LATENCY_MODE )
+  {
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+  }
+}
 
 
 static void ResetBuffers ( void )
@@ -65,6 +127,7 @@ static void UsbConnectionEstablished ( void )
   // SerialPrint( "Rx buffer size: %u, Tx buffer size: %u" EOL, unsigned(USB_RX_BUFFER_SIZE), unsigned(USB_TX_BUFFER_SIZE) );
 
   ResetBuffers();
+  UsbTxFlushPolicy_Reset( udd_is_high_speed() ? USB_HIGH_SPEED_BULK_PACKET_SIZE : USB_FULL_SPEED_BULK_PACKET_SIZE );
   BusPirateConnection_Init( &s_usbTxBuffer );
 }
 
@@ -124,23 +187,49 @@ static const uint32_t USB_CONNECTION_STABLE_DELAY = 50;  // In milliseconds.
 static uint64_t s_lastReferenceTimeForUsbOpen = 0;
 
 
-static bool SendData ( void )
+// The host is waiting for the replies if it has nothing more to send.
+
+static bool IsRxIdle ( void )
 {
-  bool wasAtLeastOneByteTransferred = false;
+  return s_usbRxBuffer.IsEmpty() &&
+         udi_cdc_get_nb_received_data() == 0;
+}
 
-  for ( ; ; )
+
+// Routine udi_cdc_write_buf() waits until it can send all data. The main loop can afford that,
+// but the low-latency interrupt handler must not wait, so it only sends what fits now (canWait = false).
+//
+// How much data gets sent depends on the flush policy, see UsbTxFlushPolicy.h .
+
+static bool SendData ( const bool canWait )
+{
+  uint32_t toFlushCount = UsbTxFlushPolicy_GetByteCountToSend( s_usbTxBuffer.GetElemCount(), IsRxIdle() );
+
+  if ( toFlushCount == 0 )
+    return false;
+
+  uint32_t sentCount = 0;
+
+  while ( toFlushCount != 0 )
   {
     uint32_t availableByteCount;
     const uint8_t * const readPtr = s_usbTxBuffer.GetReadPtr( &availableByteCount );
 
-    if ( availableByteCount == 0 )
+    assert( availableByteCount != 0 );
+
+    uint32_t toSendCount = MinFrom( availableByteCount, toFlushCount );
+
+    if ( !canWait )
+      toSendCount = MinFrom( toSendCount, uint32_t( udi_cdc_get_free_tx_buffer() ) );
+
+    if ( toSendCount == 0 )
       break;
 
-    const uint32_t remainingCount = udi_cdc_write_buf( readPtr, availableByteCount );
+    const uint32_t remainingCount = udi_cdc_write_buf( readPtr, toSendCount );
 
-    assert( remainingCount <= availableByteCount );
+    assert( remainingCount <= toSendCount );
 
-    const uint32_t writtenCount = availableByteCount - remainingCount;
+    const uint32_t writtenCount = toSendCount - remainingCount;
 
     if ( writtenCount == 0 )
     {
@@ -154,10 +243,13 @@ static bool SendData ( void )
     }
 
     s_usbTxBuffer.ConsumeReadElements( writtenCount );
-    wasAtLeastOneByteTransferred = true;
+    sentCount    += writtenCount;
+    toFlushCount -= writtenCount;
   }
 
-  return wasAtLeastOneByteTransferred;
+  UsbTxFlushPolicy_DataSent( sentCount, s_usbTxBuffer.GetElemCount() );
+
+  return sentCount != 0;
 }
 
 
@@ -219,7 +311,7 @@ static bool ReceiveData ( void )
 }
 
 
-static void ServiceUsbConnectionData ( const uint64_t currentTime )
+static ProtocolResult ServiceUsbConnectionData ( const uint64_t currentTime )
 {
   // We could write here a loop in order to process as much data as we can,
   // but we don't want to starve the main loop for too long.
@@ -233,10 +325,19 @@ static void ServiceUsbConnectionData ( const uint64_t currentTime )
   {
     s_connectionStatus = csNoConnection;
     UsbConnectionLost();
-    return;
+    return ProtocolResult::Ok();
   }
 
-  BusPirateConnection_ProcessData( &s_usbRxBuffer, &s_usbTxBuffer, currentTime );
+  const ProtocolResult result = BusPirateConnection_ProcessData( &s_usbRxBuffer, &s_usbTxBuffer, currentTime );
+
+  if ( !result.IsOk() )
+    return result;
+
+  // This also catches any overflow in the low-latency interrupt handler since the last call.
+  const ProtocolResult txOverflowResult = CheckAndClearUsbTxBufferOverflow();
+
+  if ( !txOverflowResult.IsOk() )
+    return txOverflowResult;
 
   if ( s_connectionStatus == csLastRxDataAfterConnectionLost )
   {
@@ -248,15 +349,19 @@ static void ServiceUsbConnectionData ( const uint64_t currentTime )
   }
   else
   {
-    const bool atLeastOneByteSent = SendData();
+    const bool atLeastOneByteSent = SendData( true );
 
     // If we have sent at least one byte of data, then there is more space available in the tx buffer,
     // which means that perhaps the next command already waiting in the rx buffer could be processed
     // straight away, for its reply would fit now in the tx buffer.
+    //
+    // If the flush policy is holding some data back, keep polling, so that its time-out can trigger.
 
-    if ( atLeastOneByteSent )
+    if ( atLeastOneByteSent || UsbTxFlushPolicy_IsHoldingData() )
       WakeFromMainLoopSleep();
   }
+
+  return ProtocolResult::Ok();
 }
 
 
@@ -286,51 +391,92 @@ static void HandleError ( const char * const errMsg )
 }
 
 
-void ServiceUsbConnection ( const uint64_t currentTime )
+static ProtocolResult ServiceUsbConnectionStatus ( const uint64_t currentTime )
 {
-  try
+  switch ( s_connectionStatus )
   {
-    switch ( s_connectionStatus )
+  case csNoConnection:
+    if ( IsUsbConnectionOpen() )
     {
-    case csNoConnection:
-      if ( IsUsbConnectionOpen() )
-      {
-        s_lastReferenceTimeForUsbOpen = currentTime;
-        s_connectionStatus = csInitialDelay;
-        if ( false )
-          SerialPrintStr( "Connection detected, starting the delay timer." EOL );
-      }
-      break;
+      s_lastReferenceTimeForUsbOpen = currentTime;
+      s_connectionStatus = csInitialDelay;
+      if ( false )
+        SerialPrintStr( "Connection detected, starting the delay timer." EOL );
+    }
+    break;
 
-    case csInitialDelay:
-      if ( !IsUsbConnectionOpen() )
-      {
-        s_connectionStatus = csNoConnection;
-      }
-      else if ( HasUptimeElapsedMs( currentTime, s_lastReferenceTimeForUsbOpen, USB_CONNECTION_STABLE_DELAY ) )
-      {
-          s_connectionStatus = csStable;
-          UsbConnectionEstablished();
-      }
-      break;
+  case csInitialDelay:
+    if ( !IsUsbConnectionOpen() )
+    {
+      s_connectionStatus = csNoConnection;
+    }
+    else if ( HasUptimeElapsedMs( currentTime, s_lastReferenceTimeForUsbOpen, USB_CONNECTION_STABLE_DELAY ) )
+    {
+        s_connectionStatus = csStable;
+        UsbConnectionEstablished();
+    }
+    break;
 
-    case csStable:
-      if ( !IsUsbConnectionOpen() )
-      {
-        s_connectionStatus = csLastRxDataAfterConnectionLost;
-      }
-      ServiceUsbConnectionData( currentTime );
-      break;
+  case csStable:
+    if ( !IsUsbConnectionOpen() )
+    {
+      s_connectionStatus = csLastRxDataAfterConnectionLost;
+    }
+    return ServiceUsbConnectionData( currentTime );
 
-    case csLastRxDataAfterConnectionLost:
-      ServiceUsbConnectionData( currentTime );
-      break;
+  case csLastRxDataAfterConnectionLost:
+    return ServiceUsbConnectionData( currentTime );
 
-    default:
-      assert( false );
-      break;
-    }
+  default:
+    assert( false );
+    break;
+  }
+
+  return ProtocolResult::Ok();
+}
+
+
+void PendSV_Handler ( void )
+{
+  assert( ENABLE_USB_LOW_LATENCY_MODE );
+
+  if ( s_isLowLatencyServiceHeldOff ||
+       s_connectionStatus != csStable ||
+       !IsUsbConnectionOpen() )
+  {
+    return;
+  }
+
+  ReceiveData();
+
+  if ( BusPirateConnection_ProcessDataFromInterrupt( &s_usbRxBuffer, &s_usbTxBuffer ) )
+  {
+    SendData( false );
+  }
+
+  // The main loop takes care of any data left in the buffers.
+  WakeFromMainLoopSleep();
+}
+
+
+void ServiceUsbConnection ( const uint64_t currentTime )
+{
+  const CHoldOffUsbLowLatencyService holdOffLowLatencyService;
+
+  // Protocol errors are returned as a ProtocolResult, because throwing is too expensive
+  // in the OpenOCD hot path. C++ exceptions are only caught here, at the outermost level,
+  // and only if the firmware was built with them.
+
+  #ifdef __EXCEPTIONS
+  try
+  #endif
+  {
+    const ProtocolResult result = ServiceUsbConnectionStatus( currentTime );
+
+    if ( !result.IsOk() )
+      HandleError( result.GetErrMsg() );
   }
+  #ifdef __EXCEPTIONS
   catch ( const std::exception & e )
   {
     HandleError( e.what() );
@@ -339,4 +485,5 @@ void ServiceUsbConnection ( const uint64_t currentTime )
   {
     HandleError( "Unexpected C++ exception." );
   }
+  #endif
 }
@@ -2,4 +2,22 @@
 
 #include <stdint.h>
 
+void InitUsbConnection ( void );
+
 void ServiceUsbConnection ( uint64_t currentTime );
+
+
+// The USB reception notification calls this routine in interrupt context, see ENABLE_USB_LOW_LATENCY_MODE.
+void TriggerUsbLowLatencyService ( void ) throw();
+
+
+// While an object of this class exists, the low-latency interrupt leaves the USB connection alone.
+// ServiceUsbConnection() does this automatically. The main loop should also hold the interrupt off
+// while running any other code that drives the JTAG pins, like the serial console's JTAG commands.
+
+class CHoldOffUsbLowLatencyService
+{
+public:
+  CHoldOffUsbLowLatencyService ( void ) throw();
+  ~CHoldOffUsbLowLatencyService ( void ) throw();
+};
@@ -25,12 +25,16 @@
 #include <udi_cdc.h>
 
 #include <BareMetalSupport/MainLoopSleep.h>
+#include <BareMetalSupport/BootTimestamps.h>
+#include <BareMetalSupport/Uptime.h>
 #include <BareMetalSupport/SerialPrint.h>
 #include <Misc/AssertionUtils.h>
 
 #include "my_usb_callbacks.h"
 
 #include "Globals.h"
+#include "UartBridge.h"
+#include "UsbConnection.h"
 
 
 void InitUsb ( void )
@@ -40,12 +44,11 @@ void InitUsb ( void )
 
 static const bool TRACE_USB_CONNECTION_NOTIFICATIONS = false;
 
-static const uint8_t USB_CALLBACK_PORT_NUMBER = 0;
+static volatile bool s_isUsbCableConnected = false;
 
-
-static volatile bool s_isUsbCableConnected   = false;
-static volatile bool s_isCdcInterfaceEnabled = false;  // Note that this interface remains enabled even if the cable is pulled.
-static volatile bool s_isChannelOpen         = false;
+// Indexed by CDC port number.
+static volatile bool s_isCdcInterfaceEnabled[ UDI_CDC_PORT_NB ];  // Note that this interface remains enabled even if the cable is pulled.
+static volatile bool s_isChannelOpen        [ UDI_CDC_PORT_NB ];
 
 
 void MyUsbCallback_udc_resume ( void )
@@ -82,17 +85,15 @@ bool MyUsbCallback_cdc_enable ( const uint8_t port )
   if ( TRACE_USB_CONNECTION_NOTIFICATIONS )
     SerialPrintStr( "MyUsbCallback_cdc_enable()" EOL );
 
-  // With this 'if' we reference both 'port' and 'USB_CALLBACK_PORT_NUMBER'.
-  // Otherwise, we would get "unused" warnings for both of them in release builds.
-  if ( port != USB_CALLBACK_PORT_NUMBER )
-  {
-    assert( false );
-  }
+  assert( port < UDI_CDC_PORT_NB );
 
   assert( s_isUsbCableConnected );
-  assert( !s_isCdcInterfaceEnabled );
+  assert( !s_isCdcInterfaceEnabled[ port ] );
 
-  s_isCdcInterfaceEnabled = true;
+  s_isCdcInterfaceEnabled[ port ] = true;
+
+  if ( port == USB_BUS_PIRATE_CDC_PORT && GetUptime() < BOOT_TIMESTAMP_MAX_UPTIME_MS )
+    RecordBootTimestamp( bpUsbReady );
 
   return true;  // Indicate success.
 }
@@ -102,12 +103,11 @@ void MyUsbCallback_cdc_disable ( const uint8_t port )
   if ( TRACE_USB_CONNECTION_NOTIFICATIONS )
     SerialPrintStr( "MyUsbCallback_cdc_disable()" EOL );
 
-  assert( port == USB_CALLBACK_PORT_NUMBER );
-  UNUSED_IN_RELEASE( port );
+  assert( port < UDI_CDC_PORT_NB );
 
   assert( s_isUsbCableConnected );
-  assert( s_isCdcInterfaceEnabled );
-  s_isCdcInterfaceEnabled = false;
+  assert( s_isCdcInterfaceEnabled[ port ] );
+  s_isCdcInterfaceEnabled[ port ] = false;
 
   WakeFromMainLoopSleep();  // Notify the main loop if we loose the USB connection.
 }
@@ -121,11 +121,10 @@ void MyUsbCallback_cdc_set_dtr ( const uint8_t port, const bool enable )
                   enable ? "enable" : "disable" );
   }
 
-  assert( port == USB_CALLBACK_PORT_NUMBER );
-  UNUSED_IN_RELEASE( port );
+  assert( port < UDI_CDC_PORT_NB );
 
   assert( s_isUsbCableConnected );
-  assert( s_isCdcInterfaceEnabled );
+  assert( s_isCdcInterfaceEnabled[ port ] );
 
 
   // If the user pulls the USB cable, we don't get this notification. When the USB cable
@@ -134,7 +133,7 @@ void MyUsbCallback_cdc_set_dtr ( const uint8_t port, const bool enable )
   // Under Windows, if you connect with Cygwin socat, you get several notifications in a row
   // that the channel is open.
 
-  s_isChannelOpen = enable;
+  s_isChannelOpen[ port ] = enable;
 
   WakeFromMainLoopSleep();
 }
@@ -148,16 +147,18 @@ void MyUsbCallback_cdc_rx_notify ( const uint8_t port )
   // Print the received packet size (not quite reliable), for performance research purposes only:
   if ( false )
   {
-    const uint32_t v = udi_cdc_get_nb_received_data();
+    const uint32_t v = udi_cdc_multi_get_nb_received_data( port );
     SerialPrintf( "%" PRIu32 EOL, v );
   }
 
-  assert( port == USB_CALLBACK_PORT_NUMBER );
-  UNUSED_IN_RELEASE( port );
+  assert( port < UDI_CDC_PORT_NB );
 
   // This can trigger if the caller closes the connection quickly.
   //   ASSERT( IsUsbConnectionOpen() );
 
+  if ( port == USB_BUS_PIRATE_CDC_PORT )
+    TriggerUsbLowLatencyService();
+
   WakeFromMainLoopSleep();
 }
 
@@ -167,7 +168,7 @@ void MyUsbCallback_cdc_tx_empty_notify ( const uint8_t port )
   if ( false )
     SerialPrintStr( "MyUsbCallback_cdc_tx_empty_notify()" EOL );
 
-  assert( port == USB_CALLBACK_PORT_NUMBER );
+  assert( port < UDI_CDC_PORT_NB );
   UNUSED_IN_RELEASE( port );
 
   // This can trigger if the caller closes the connection quickly.
@@ -182,25 +183,45 @@ void MyUsbCallback_cdc_set_coding ( const uint8_t port, usb_cdc_line_coding_t *
   if ( false )
     SerialPrintStr( "MyUsbCallback_cdc_set_coding()" EOL );
 
-  assert( port == USB_CALLBACK_PORT_NUMBER );
-  UNUSED_IN_RELEASE( port );
+  assert( port < UDI_CDC_PORT_NB );
 
   assert( s_isUsbCableConnected );
 
-  // cfg->bCharFormat can be CDC_STOP_BITS_2, US_MR_NBSTOP_1_5_BIT or US_MR_NBSTOP_1_BIT.
-  // cfg->bParityType can be US_MR_PAR_EVEN, CDC_PAR_ODD, CDC_PAR_MARK, US_MR_PAR_SPACE or US_MR_PAR_NO.
-  // cfg->bDataBits can be 5, 6, 7 or 8.
+  // cfg->bCharFormat can be CDC_STOP_BITS_1, CDC_STOP_BITS_1_5 or CDC_STOP_BITS_2.
+  // cfg->bParityType can be CDC_PAR_NONE, CDC_PAR_ODD, CDC_PAR_EVEN, CDC_PAR_MARK or CDC_PAR_SPACE.
+  // cfg->bDataBits can be 5, 6, 7, 8 or 16.
+  // These values match UartStopBitsEnum and UartParityEnum.
 
-  // We don't actually need the encoding information here.
-  UNUSED_ALWAYS( cfg );
+  // The Bus Pirate connection does not need the encoding information, but the UART bridge
+  // passes it on to the target's serial port.
+  if ( port == USB_UART_BRIDGE_CDC_PORT )
+  {
+    UartBridge_RequestLineCoding( LE32_TO_CPU( cfg->dwDTERate ),
+                                  cfg->bDataBits,
+                                  cfg->bParityType,
+                                  cfg->bCharFormat );
+    WakeFromMainLoopSleep();
+  }
 }
 
 
-bool IsUsbConnectionOpen ( void )
+static bool IsCdcPortOpen ( const uint8_t port )
 {
   return s_isUsbCableConnected &&
-         s_isCdcInterfaceEnabled &&
-         s_isChannelOpen;
+         s_isCdcInterfaceEnabled[ port ] &&
+         s_isChannelOpen[ port ];
+}
+
+
+bool IsUsbConnectionOpen ( void )
+{
+  return IsCdcPortOpen( USB_BUS_PIRATE_CDC_PORT );
+}
+
+
+bool IsUartBridgeUsbConnectionOpen ( void )
+{
+  return IsCdcPortOpen( USB_UART_BRIDGE_CDC_PORT );
 }
 
 
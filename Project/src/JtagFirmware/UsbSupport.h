@@ -17,10 +17,18 @@
 
 #include <stddef.h>
 
+// The USB device has 2 CDC serial ports, see conf_usb.h .
+#define USB_BUS_PIRATE_CDC_PORT   0
+#define USB_UART_BRIDGE_CDC_PORT  1
+
 void InitUsb ( void );
 
+// Whether the host has opened the Bus Pirate serial port.
 bool IsUsbConnectionOpen ( void );
 
+// Whether the host has opened the UART bridge serial port.
+bool IsUartBridgeUsbConnectionOpen ( void );
+
 void UsbWriteData ( const void * data, size_t dataLen );
 void UsbWriteStr ( const char * str );
 
@@ -0,0 +1,137 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "UsbTxFlushPolicy.h"  // The include file for this module should come first.
+
+#include <assert.h>
+
+#include <BareMetalSupport/CycleCounter.h>
+#include <BareMetalSupport/SysTickUtils.h>
+
+
+static uint32_t s_packetSize = USB_FULL_SPEED_BULK_PACKET_SIZE;
+
+// When the oldest data still in the Tx Buffer was first seen. Only valid if s_isTimerRunning.
+static bool     s_isTimerRunning = false;
+static uint32_t s_timerStart;
+
+static UsbTxFlushReasonEnum s_lastReason;
+
+// The packet count is an estimate. It assumes that every flush starts a new packet,
+// and that the USB stack splits the data into as many full packets as possible.
+// The USB stack may merge the data from several flushes into a single packet,
+// if the previous packet has not been sent yet.
+static UsbTxStats s_stats = { USB_FULL_SPEED_BULK_PACKET_SIZE, 0, 0, 0, { 0 } };
+
+
+void UsbTxFlushPolicy_Reset ( const uint32_t packetSize )
+{
+  assert( packetSize != 0 );
+
+  s_packetSize = packetSize;
+  s_isTimerRunning = false;
+
+  s_stats.packetSize = packetSize;
+}
+
+
+uint32_t UsbTxFlushPolicy_GetByteCountToSend ( const uint32_t txBufferElemCount, const bool isRxIdle )
+{
+  if ( txBufferElemCount == 0 )
+  {
+    s_isTimerRunning = false;
+    return 0;
+  }
+
+  if ( !ENABLE_USB_TX_COALESCING )
+  {
+    s_lastReason = utfDisabled;
+    return txBufferElemCount;
+  }
+
+  if ( isRxIdle )
+  {
+    s_lastReason = ( txBufferElemCount % s_packetSize == 0 ) ? utfFullPacket : utfRxIdle;
+    return txBufferElemCount;
+  }
+
+  if ( txBufferElemCount >= s_packetSize )
+  {
+    s_lastReason = utfFullPacket;
+    return txBufferElemCount - txBufferElemCount % s_packetSize;
+  }
+
+  if ( !s_isTimerRunning )
+  {
+    s_isTimerRunning = true;
+    s_timerStart = GetCycleCount();
+    return 0;
+  }
+
+  if ( GetElapsedCycleCount( s_timerStart ) >= UsToCpuClockTickCount( USB_TX_FLUSH_TIMEOUT_US ) )
+  {
+    s_lastReason = utfTimeout;
+    return txBufferElemCount;
+  }
+
+  return 0;
+}
+
+
+void UsbTxFlushPolicy_DataSent ( const uint32_t sentByteCount, const uint32_t remainingElemCount )
+{
+  if ( sentByteCount != 0 )
+  {
+    const uint32_t packetCount = ( sentByteCount + s_packetSize - 1 ) / s_packetSize;
+
+    s_stats.byteCount           += sentByteCount;
+    s_stats.packetCount         += packetCount;
+    s_stats.packetCapacityCount += uint64_t( packetCount ) * s_packetSize;
+    ++s_stats.flushCount[ s_lastReason ];
+  }
+
+  // Any data left behind starts a new wait. This is not exact, as that data may be older,
+  // but it only delays a partial packet by one more time-out period at most.
+  if ( remainingElemCount == 0 || sentByteCount != 0 )
+    s_isTimerRunning = false;
+}
+
+
+bool UsbTxFlushPolicy_IsHoldingData ( void )
+{
+  return s_isTimerRunning;
+}
+
+
+void UsbTxFlushPolicy_GetStats ( UsbTxStats * const stats )
+{
+  *stats = s_stats;
+}
+
+
+const char * UsbTxFlushPolicy_GetReasonName ( const UsbTxFlushReasonEnum reason )
+{
+  switch ( reason )
+  {
+  case utfFullPacket: return "full packet";
+  case utfRxIdle:     return "Rx idle";
+  case utfTimeout:    return "time-out";
+  case utfDisabled:   return "coalescing disabled";
+
+  default:
+    assert( false );
+    return "<unknown>";
+  }
+}
@@ -0,0 +1,82 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+#include <stdint.h>
+
+// Decides when the data in the USB Tx Buffer should be handed over to the USB stack.
+//
+// Sending every reply as soon as it is ready generates many short USB packets when OpenOCD
+// sends a batch of small commands. This policy holds the data back while more commands are arriving,
+// and only flushes:
+// - Whole bulk packets, as soon as there is enough data for at least one.
+// - Everything, as soon as the Rx side is idle. The host is then waiting for the replies,
+//   so the last reply of a batch does not suffer any extra latency.
+// - Everything, if the oldest data has been waiting for longer than USB_TX_FLUSH_TIMEOUT_US.
+//   This covers the cases where the host is still sending, but not enough replies accumulate.
+//
+// The caller must keep calling UsbTxFlushPolicy_GetByteCountToSend() while UsbTxFlushPolicy_IsHoldingData()
+// returns true, so that the time-out can trigger.
+//
+// There is nothing hardware-specific here, so the host emulator uses this module too.
+
+// Set this to false in order to send all data straight away, like before this policy existed.
+#define ENABLE_USB_TX_COALESCING  true
+
+#define USB_TX_FLUSH_TIMEOUT_US  250
+
+#define USB_FULL_SPEED_BULK_PACKET_SIZE  64
+#define USB_HIGH_SPEED_BULK_PACKET_SIZE  512
+
+
+enum UsbTxFlushReasonEnum
+{
+  utfFullPacket = 0,
+  utfRxIdle,
+  utfTimeout,
+  utfDisabled,  // ENABLE_USB_TX_COALESCING is false.
+
+  utfReasonCount
+};
+
+// These counters accumulate since start-up, so that the serial console can show them after a session.
+
+struct UsbTxStats
+{
+  uint32_t packetSize;           // For the current or last connection.
+  uint64_t byteCount;
+  uint64_t packetCount;          // See the note about the packet count in UsbTxFlushPolicy.cpp .
+  uint64_t packetCapacityCount;  // The sum of the packet sizes, for the average packet fill.
+  uint32_t flushCount[ utfReasonCount ];
+};
+
+
+// Call this when a new connection starts.
+void UsbTxFlushPolicy_Reset ( uint32_t packetSize );
+
+// Returns how many bytes from the front of the Tx Buffer should be sent now, which may be 0.
+// If it is not 0, call UsbTxFlushPolicy_DataSent() afterwards.
+uint32_t UsbTxFlushPolicy_GetByteCountToSend ( uint32_t txBufferElemCount, bool isRxIdle );
+
+// Tells the policy how many bytes were actually sent, which may be less than requested,
+// and how many are left in the Tx Buffer.
+void UsbTxFlushPolicy_DataSent ( uint32_t sentByteCount, uint32_t remainingElemCount );
+
+// Whether the policy has held data back and is waiting for the time-out.
+bool UsbTxFlushPolicy_IsHoldingData ( void );
+
+void UsbTxFlushPolicy_GetStats ( UsbTxStats * stats );
+
+const char * UsbTxFlushPolicy_GetReasonName ( UsbTxFlushReasonEnum reason );
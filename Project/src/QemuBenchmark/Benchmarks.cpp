@@ -0,0 +1,309 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "Benchmarks.h"  // The include file for this module should come first.
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <BareMetalSupport/DebugConsoleEol.h>
+#include <BareMetalSupport/DebugConsoleSerialSync.h>
+#include <BareMetalSupport/IntegerPrintUtils.h>
+#include <BareMetalSupport/CircularBuffer.h>
+#include <BareMetalSupport/GenericSerialConsole.h>
+
+#include <Misc/AssertionUtils.h>
+
+#include <JtagFirmware/JtagShift.h>
+
+#include <BoardSupport-LM3S6965EVB/AngelInterface.h>
+
+#include "SysTickTimer.h"
+
+
+// The benchmark results are accumulated here, so that the compiler cannot optimise the kernels away.
+static volatile uint32_t s_benchmarkSink;
+
+
+// The results go both to the console and to a file on the host, which is easier to parse automatically.
+// The file lands in the current directory when Qemu was started.
+static const char RESULTS_FILENAME[] = "QemuBenchmarkResults.txt";
+
+static uint8_t s_resultsFileBuffer[ 512 ];
+static CAngelOutputFile s_resultsFile( s_resultsFileBuffer, sizeof( s_resultsFileBuffer ) );
+
+
+static void WriteResultStr ( const char * const str )
+{
+  SerialSyncWriteStr( str );
+  s_resultsFile.WriteStr( str );
+}
+
+
+static void ReportBenchmarkResult ( const char * const name,
+                                    const uint32_t iterationCount,
+                                    const uint64_t tickCount )
+{
+  char buffer[ CONVERT_TO_DEC_BUF_SIZE ];
+
+  WriteResultStr( "BENCHMARK " );
+  WriteResultStr( name );
+  WriteResultStr( " iterations=" );
+  WriteResultStr( convert_unsigned_to_dec_th( iterationCount, buffer, ',' ) );
+  WriteResultStr( " ticks=" );
+  WriteResultStr( convert_unsigned_to_dec_th( tickCount, buffer, ',' ) );
+  WriteResultStr( EOL );
+}
+
+
+typedef uint32_t (* BenchmarkKernel ) ( uint32_t iterationCount );
+
+static void RunBenchmark ( const char * const name,
+                           const BenchmarkKernel kernel,
+                           const uint32_t iterationCount )
+{
+  // Run the kernel once beforehand, so that the first-time effects (like lazy initialisation)
+  // do not distort the results.
+  s_benchmarkSink = s_benchmarkSink + kernel( 1 );
+
+  const uint64_t startTime = GetSysTickTimerCount();
+
+  s_benchmarkSink = s_benchmarkSink + kernel( iterationCount );
+
+  const uint64_t elapsedTime = GetSysTickTimerCount() - startTime;
+
+  ReportBenchmarkResult( name, iterationCount, elapsedTime );
+}
+
+
+// ------ Circular buffer ------
+
+// Same size and types as the USB buffers in the DebugDue firmware.
+typedef CCircularBuffer< uint8_t, uint32_t, 4096 > CBenchmarkCircularBuffer;
+
+static CBenchmarkCircularBuffer s_circularBuffer;
+
+static uint32_t CircularBufferKernel ( const uint32_t iterationCount )
+{
+  // A typical OpenOCD TAP shift command is a few hundred bytes long,
+  // and this size causes the buffer to wrap around every now and then.
+  const uint32_t BLOCK_SIZE = 300;
+
+  static uint8_t s_block[ BLOCK_SIZE ];
+
+  uint32_t checksum = 0;
+
+  for ( uint32_t i = 0; i < iterationCount; ++i )
+  {
+    s_circularBuffer.WriteElemArray( s_block, BLOCK_SIZE );
+
+    // Read it back the fast way, like ShiftJtagData_InBufferBlocks() does.
+    while ( !s_circularBuffer.IsEmpty() )
+    {
+      uint32_t readCount;
+      const uint8_t * const readPtr = s_circularBuffer.GetReadPtr( &readCount );
+
+      for ( uint32_t j = 0; j < readCount; ++j )
+        checksum += readPtr[ j ];
+
+      s_circularBuffer.ConsumeReadElements( readCount );
+    }
+
+    // Now element by element, like the command parsers do.
+    for ( uint32_t j = 0; j < BLOCK_SIZE; ++j )
+      s_circularBuffer.WriteElem( uint8_t( j ) );
+
+    for ( uint32_t j = 0; j < BLOCK_SIZE; ++j )
+      checksum += s_circularBuffer.ReadElement();
+  }
+
+  return checksum;
+}
+
+
+// ------ JTAG shifting ------
+
+// The real JTAG shifting kernel from the DebugDue firmware runs here against fake PIOs in SRAM,
+// see FakePio/sam3xa.h . The memory accesses are the same as on the Arduino Due.
+
+Pio g_fakePios[ 4 ];
+
+static uint32_t JtagShiftKernel ( const uint32_t iterationCount )
+{
+  // Half the size of the Rx buffer, like the largest TAP shift command in OpenOCD mode.
+  const uint32_t BYTE_COUNT = 2048;
+
+  STATIC_ASSERT( BYTE_COUNT <= UINT16_MAX, "ShiftMemBlock() takes a 16-bit iteration count." );
+
+  static uint8_t s_tdiTms[ BYTE_COUNT * 2 ];
+  static uint8_t s_tdo   [ BYTE_COUNT     ];
+
+  for ( uint32_t i = 0; i < BYTE_COUNT * 2; ++i )
+    s_tdiTms[ i ] = uint8_t( i * 7 );
+
+  // The fake PIO_ODSR does not follow the PIO_SODR and PIO_CODR writes, so make TCK look high,
+  // as ShiftSingleBit() asserts it.
+  JTAG_TCK_PIO->PIO_ODSR = BV( JTAG_TCK_PIN );
+
+  uint32_t checksum = 0;
+
+  for ( uint32_t i = 0; i < iterationCount; ++i )
+  {
+    // Let the fake TDO toggle every now and then.
+    JTAG_TDO_PIO->PIO_PDSR = ( i & 1 ) ? BV( JTAG_TDO_PIN ) : 0;
+
+    ShiftMemBlock( s_tdiTms, s_tdo, uint16_t( BYTE_COUNT ) );
+
+    checksum += s_tdo[ i % BYTE_COUNT ];
+  }
+
+  return checksum;
+}
+
+
+// ------ Decimal conversion ------
+
+static uint32_t DecimalConversionKernel ( const uint32_t iterationCount )
+{
+  const uint32_t VALUES_PER_ITERATION = 100;
+
+  uint32_t checksum = 0;
+  uint64_t val = 1;
+
+  for ( uint32_t i = 0; i < iterationCount; ++i )
+  {
+    for ( uint32_t j = 0; j < VALUES_PER_ITERATION; ++j )
+    {
+      // A simple linear congruential generator, so that the numbers have different lengths.
+      val = val * 6364136223846793005ULL + 1442695040888963407ULL;
+
+      char buffer[ CONVERT_TO_DEC_BUF_SIZE ];
+
+      // Most numbers printed in the firmware are 32-bit values.
+      const char * const str = convert_unsigned_to_dec_th( uint32_t( val >> ( j % 32 ) ), buffer, ',' );
+
+      checksum += uint8_t( str[0] );
+    }
+  }
+
+  return checksum;
+}
+
+
+// ------ Hex dump ------
+
+static uint32_t HexDumpKernel ( const uint32_t iterationCount )
+{
+  // Like the PrintMemory command does, 16 bytes per line with an ASCII column.
+  const uint32_t BYTE_COUNT = 256;
+  const uint32_t BYTES_PER_LINE = 16;
+
+  static uint8_t s_data[ BYTE_COUNT ];
+
+  for ( uint32_t i = 0; i < BYTE_COUNT; ++i )
+    s_data[ i ] = uint8_t( i * 13 );
+
+  uint32_t checksum = 0;
+
+  for ( uint32_t i = 0; i < iterationCount; ++i )
+  {
+    for ( uint32_t offset = 0; offset < BYTE_COUNT; offset += BYTES_PER_LINE )
+    {
+      char line[ HEX_DUMP_LINE_BUFSIZE ];
+
+      checksum += uint32_t( FormatHexDumpLine( &s_data[ offset ], BYTES_PER_LINE, BYTES_PER_LINE,
+                                               hdloAddress | hdloAsciiColumn, EOL, line ) );
+    }
+  }
+
+  return checksum;
+}
+
+
+// ------ Serial console ------
+
+class CBenchmarkSerialConsole : public CGenericSerialConsole
+{
+private:
+  virtual void Printf ( const char * formatStr, ... ) const override __attribute__ ((format(printf, 2, 3)));
+
+public:
+  mutable uint32_t m_outputCharCount = 0;
+};
+
+
+void CBenchmarkSerialConsole::Printf ( const char * const formatStr, ... ) const
+{
+  // Format the text like the real consoles do, but discard it.
+
+  char buffer[ 64 ];
+
+  va_list argList;
+  va_start( argList, formatStr );
+
+  const int len = vsnprintf( buffer, sizeof( buffer ), formatStr, argList );
+
+  va_end( argList );
+
+  if ( len > 0 )
+    m_outputCharCount += uint32_t( len );
+}
+
+
+static CBenchmarkSerialConsole s_serialConsole;
+
+static uint32_t SerialConsoleKernel ( const uint32_t iterationCount )
+{
+  // A typical interactive session: type a command, go back with the arrow keys,
+  // fix a typo with backspace, and press Enter.
+  static const char USER_INPUT[] = "JtagShiftSpeedTest" "\x1B[D" "\x1B[D" "\x08" "t" "\x1B[C" "\r"
+                                   "MemoryUsage" "\r"
+                                   "PrintMemory 0x20000000 100" "\r";
+
+  uint32_t checksum = 0;
+
+  for ( uint32_t i = 0; i < iterationCount; ++i )
+  {
+    for ( uint32_t j = 0; j < sizeof( USER_INPUT ) - 1; ++j )
+    {
+      uint32_t cmdLen;
+      const char * const cmd = s_serialConsole.AddChar( uint8_t( USER_INPUT[ j ] ), &cmdLen );
+
+      if ( cmd != nullptr )
+        checksum += cmdLen;
+    }
+  }
+
+  return checksum + s_serialConsole.m_outputCharCount;
+}
+
+
+void RunAllBenchmarks ( void )
+{
+  s_resultsFile.Open( RESULTS_FILENAME, afmWriteBinary );
+
+  // The iteration counts are chosen so that each benchmark runs for a few seconds under Qemu.
+
+  RunBenchmark( "CircularBuffer"   , &CircularBufferKernel   , 2000 );
+  RunBenchmark( "JtagShift"        , &JtagShiftKernel        ,  100 );
+  RunBenchmark( "DecimalConversion", &DecimalConversionKernel, 2000 );
+  RunBenchmark( "HexDump"          , &HexDumpKernel          , 2000 );
+  RunBenchmark( "SerialConsole"    , &SerialConsoleKernel    , 2000 );
+
+  s_resultsFile.Close();
+}
@@ -0,0 +1,29 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+// These benchmarks run the hot kernels of the DebugDue firmware on the emulated Cortex-M3.
+//
+// Each result is printed on a line of its own with the following format,
+// so that scripts can easily extract them from the console output:
+//
+//   BENCHMARK <name> iterations=<n> ticks=<n>
+//
+// The numbers have thousand separators. See SysTickTimer.h about how to get reproducible tick counts.
+//
+// The same lines are written over semihosting to host file QemuBenchmarkResults.txt .
+// Errors throw std::runtime_error.
+
+void RunAllBenchmarks ( void );
@@ -0,0 +1,28 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+// This header replaces the Atmel Software Framework header of the same name for the Qemu benchmark firmware,
+// see sam3xa.h in this directory.
+
+#include <stdint.h>
+
+#include "sam3xa.h"
+
+inline uint32_t pmc_is_periph_clk_enabled ( uint32_t ) throw()
+{
+  // The fake PIOs need no clock.
+  return 1;
+}
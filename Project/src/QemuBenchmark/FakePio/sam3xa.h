@@ -0,0 +1,50 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+// This header replaces the CMSIS header of the same name for the Qemu benchmark firmware,
+// so that the JTAG shifting kernel in JtagFirmware/JtagShift.cpp compiles for the LM3S6965 too.
+//
+// Only the PIO definitions that IoUtils.h uses are provided. The PIO registers are
+// plain variables in SRAM, so the kernel performs the same memory accesses
+// as on the Arduino Due, but the pins do not go anywhere.
+
+#include <stdint.h>
+
+
+struct Pio
+{
+  volatile uint32_t PIO_PSR;   // PIO Status Register.
+  volatile uint32_t PIO_PUSR;  // Pull-up Status Register.
+  volatile uint32_t PIO_OWSR;  // Output Write Status Register.
+  volatile uint32_t PIO_SODR;  // Set Output Data Register.
+  volatile uint32_t PIO_CODR;  // Clear Output Data Register.
+  volatile uint32_t PIO_ODSR;  // Output Data Status Register.
+  volatile uint32_t PIO_PDSR;  // Pin Data Status Register.
+};
+
+extern Pio g_fakePios[ 4 ];
+
+#define PIOA  ( &g_fakePios[ 0 ] )
+#define PIOB  ( &g_fakePios[ 1 ] )
+#define PIOC  ( &g_fakePios[ 2 ] )
+#define PIOD  ( &g_fakePios[ 3 ] )
+
+#define PIO_DELTA  ( sizeof( Pio ) )
+
+#define ID_PIOA  11
+#define ID_PIOB  12
+#define ID_PIOC  13
+#define ID_PIOD  14
@@ -0,0 +1,75 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+
+#include "SysTickTimer.h"  // The include file for this module should come first.
+
+#include <assert.h>
+
+#include <BoardSupport-LM3S6965EVB/ExceptionHandlers.h>
+
+
+// We do not use the CMSIS yet, so we have not got the definitions for the SysTick registers.
+
+static volatile uint32_t * const SYST_CSR = (uint32_t *) 0xE000E010;  // Control and Status Register.
+static volatile uint32_t * const SYST_RVR = (uint32_t *) 0xE000E014;  // Reload Value Register.
+static volatile uint32_t * const SYST_CVR = (uint32_t *) 0xE000E018;  // Current Value Register.
+
+static const uint32_t SYST_CSR_ENABLE    = 1 << 0;
+static const uint32_t SYST_CSR_TICKINT   = 1 << 1;
+static const uint32_t SYST_CSR_CLKSOURCE = 1 << 2;  // Use the processor clock.
+
+static const uint32_t SYST_RELOAD_VALUE = 0x00FFFFFF;  // The SysTick counter is only 24 bits wide.
+
+static volatile uint32_t s_wrapAroundCount = 0;
+
+
+void SysTick_Handler ( void )
+{
+  s_wrapAroundCount = s_wrapAroundCount + 1;
+}
+
+
+void InitSysTickTimer ( void ) throw()
+{
+  *SYST_CSR = 0;
+  *SYST_RVR = SYST_RELOAD_VALUE;
+  *SYST_CVR = 0;  // Any write clears the current value.
+
+  s_wrapAroundCount = 0;
+
+  *SYST_CSR = SYST_CSR_ENABLE | SYST_CSR_TICKINT | SYST_CSR_CLKSOURCE;
+}
+
+
+uint64_t GetSysTickTimerCount ( void ) throw()
+{
+  // The SysTick counts down. If it wraps around between reading the wrap-around counter
+  // and the current value, the interrupt handler will have incremented the wrap-around counter,
+  // so try again.
+
+  uint32_t wrapAroundCount;
+  uint32_t currentValue;
+
+  do
+  {
+    wrapAroundCount = s_wrapAroundCount;
+    currentValue    = *SYST_CVR;
+  }
+  while ( wrapAroundCount != s_wrapAroundCount );
+
+  assert( currentValue <= SYST_RELOAD_VALUE );
+
+  return uint64_t( wrapAroundCount ) * ( uint64_t( SYST_RELOAD_VALUE ) + 1 ) + ( SYST_RELOAD_VALUE - currentValue );
+}
@@ -0,0 +1,28 @@
+// Copyright (C) 2012 R. Diez
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the Affero GNU General Public License version 3
+// as published by the Free Software Foundation.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero GNU General Public License version 3 for more details.
+//
+// You should have received a copy of the Affero GNU General Public License version 3
+// along with this program. If not, see http://www.gnu.org/licenses/ .
+
+#pragma once
+
+#include <stdint.h>
+
+// This module turns the Cortex-M3 SysTick into a free-running 64-bit counter.
+//
+// When running under Qemu with option "-icount", the virtual clock advances by a fixed amount
+// per instruction executed, so the tick counts are deterministic and proportional to the number of
+// instructions executed. Without "-icount", the virtual clock follows the host's real time,
+// and the results will vary from run to run.
+
+void InitSysTickTimer ( void ) throw();
+
+uint64_t GetSysTickTimerCount ( void ) throw();
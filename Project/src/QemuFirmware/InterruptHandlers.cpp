@@ -21,3 +21,10 @@ void SVC_Handler        (void) __attribute__ ((weak, alias("__halt")));
 void DebugMon_Handler   (void) __attribute__ ((weak, alias("__halt")));
 void PendSV_Handler     (void) __attribute__ ((weak, alias("__halt")));
 void SysTick_Handler    (void) __attribute__ ((weak, alias("__halt")));
+
+void GPIOPortA_Handler  (void) __attribute__ ((weak, alias("__halt")));
+void GPIOPortB_Handler  (void) __attribute__ ((weak, alias("__halt")));
+void GPIOPortC_Handler  (void) __attribute__ ((weak, alias("__halt")));
+void GPIOPortD_Handler  (void) __attribute__ ((weak, alias("__halt")));
+void GPIOPortE_Handler  (void) __attribute__ ((weak, alias("__halt")));
+void UART0_Handler      (void) __attribute__ ((weak, alias("__halt")));
@@ -16,16 +16,22 @@
 #include <assert.h>
 #include <stdint.h>
 #include <malloc.h>
+#include <string.h>
+#include <stdarg.h>
 
 #include <stdexcept>
 
 #include <BareMetalSupport/DebugConsoleEol.h>
 #include <BareMetalSupport/DebugConsoleSerialSync.h>
 #include <BareMetalSupport/BoardInitUtils.h>
+#include <BareMetalSupport/SerialPortAsyncTx.h>
+#include <BareMetalSupport/SerialPrint.h>
+#include <BareMetalSupport/GenericSerialConsole.h>
 
 #include <Misc/AssertionUtils.h>
 
 #include <BoardSupport-LM3S6965EVB/ExceptionHandlers.h>
+#include <BoardSupport-LM3S6965EVB/StellarisUart.h>
 
 
 static void PrintPanicMsg ( const char * const msg )
@@ -41,6 +47,112 @@ static void PrintPanicMsg ( const char * const msg )
 }
 
 
+// The interactive console is disabled by default, because script SelfTest.sh
+// runs the simulation and expects it to exit on its own.
+static const bool ENABLE_INTERACTIVE_CONSOLE = false;
+
+static const char CONSOLE_PROMPT[] = "> ";
+
+
+class CQemuSerialConsole : public CGenericSerialConsole
+{
+private:
+  virtual void Printf ( const char * formatStr, ... ) const override __attribute__ ((format(printf, 2, 3)));
+};
+
+
+void CQemuSerialConsole::Printf ( const char * const formatStr, ... ) const
+{
+  va_list argList;
+  va_start( argList, formatStr );
+
+  SerialPrintV( formatStr, argList );
+
+  va_end( argList );
+}
+
+
+static CQemuSerialConsole s_serialConsole;
+
+
+// Sleeps until the next interrupt. Instruction WFI wakes up on a pending interrupt even if
+// interrupts are disabled, so checking the condition with interrupts disabled beforehand avoids
+// the race condition where an interrupt comes between the check and the WFI.
+
+static void WaitForInterruptIf ( bool (* const condition) ( void ) ) throw()
+{
+  __asm__ volatile( "cpsid i" ::: "memory" );
+
+  if ( condition() )
+  {
+    __asm__ volatile( "wfi" ::: "memory" );
+  }
+
+  __asm__ volatile( "cpsie i" ::: "memory" );
+}
+
+
+static bool IsTxBufferNotEmpty ( void ) throw()
+{
+  return !IsStellarisUartTxBufferEmpty();
+}
+
+
+static bool IsRxBufferEmpty ( void ) throw()
+{
+  return IsStellarisUartRxBufferEmpty();
+}
+
+
+static void PrintUartErrors ( void )
+{
+  if ( HasStellarisUartRxOverrunOccurred() )
+    SerialPrintStr( "UART overrun." EOL );
+
+  if ( HasStellarisUartRxFrameErrorOccurred() )
+    SerialPrintStr( "UART frame error." EOL );
+
+  if ( HasStellarisUartRxBufferOverrunOccurred() )
+    SerialPrintStr( "UART Rx Buffer overrun." EOL );
+}
+
+
+static void RunInteractiveConsole ( void )
+{
+  SerialPrintStr( "Type 'exit' to terminate the simulation." EOL );
+  SerialPrintStr( CONSOLE_PROMPT );
+
+  for ( ; ; )
+  {
+    PrintUartErrors();
+
+    uint8_t c;
+
+    if ( !ReadStellarisUartRxChar( &c ) )
+    {
+      WaitForInterruptIf( &IsRxBufferEmpty );
+      continue;
+    }
+
+    uint32_t cmdLen;
+    const char * const cmd = s_serialConsole.AddChar( c, &cmdLen );
+
+    if ( cmd == nullptr )
+      continue;
+
+    SerialPrintStr( EOL );
+
+    if ( 0 == strcmp( cmd, "exit" ) )
+      break;
+
+    if ( cmdLen != 0 )
+      SerialPrintf( "Unknown command \"%s\"." EOL, cmd );
+
+    SerialPrintStr( CONSOLE_PROMPT );
+  }
+}
+
+
 #define STACK_SIZE ( 4 * 1024 )
 static_assert( 0 == STACK_SIZE % sizeof( uint32_t ), "" );
 static uint32_t s_stackSpace[ STACK_SIZE / sizeof( uint32_t ) ] __attribute__ ((section (".placeInStackArea"),used));
@@ -110,7 +222,22 @@ void StartOfUserCode ( void )
     }
   }
 
-  SerialSyncWriteStr( "Place your application code here." EOL );
+  InitStellarisUart();
+  InitSerialPortAsyncTx( EOL );
+
+  SerialPrintStr( "Place your application code here." EOL );
+
+  if ( ENABLE_INTERACTIVE_CONSOLE )
+  {
+    RunInteractiveConsole();
+  }
+
+  // Wait for the asynchronous output to drain before the synchronous messages below,
+  // and before exiting the simulation.
+  while ( !IsStellarisUartTxBufferEmpty() )
+  {
+    WaitForInterruptIf( &IsTxBufferNotEmpty );
+  }
 
   if ( IsDebugBuild() )
   {
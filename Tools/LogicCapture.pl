@@ -0,0 +1,438 @@
+#!/usr/bin/perl
+
+# This script captures the JTAG pin levels with the DebugDue's logic analyser mode
+# and saves them in sigrok's "binary" input format, with one byte per sample.
+# See BusPirateLogicMode.h for a description of the protocol.
+#
+# The DebugDue streams the samples while capturing, so the capture length is only limited
+# by the --duration and --post options. If the USB connection cannot keep up with the sample rate,
+# the DebugDue drops samples and reports how many, so you can tell where the gaps are.
+#
+# Usage:
+#   perl LogicCapture.pl [options] --device=<serial port> --output=<filename>
+#
+# Options:
+#   --device=<serial port>  The DebugDue's serial port, like /dev/ttyACM0 .
+#                           The DebugDue must be in the Bus Pirate console mode.
+#   --output=<filename>     Write the samples to this file.
+#   --rate=<Hz>             The sample rate, between 1000 and 1000000 Hz. The default is 100000 Hz.
+#   --trigger=<pin>=<0|1>   Start capturing when the pin has the given level. The pin names are
+#                           TCK, TMS, TDI, TDO, TRST and SRST. This option can be repeated,
+#                           and then all conditions must hold at the same time.
+#                           Without a trigger, the capture starts straight away.
+#   --pre=<count>           How many samples before the trigger to keep, up to 1024. The default is 0.
+#   --post=<count>          Stop after this many samples from the trigger on.
+#   --duration=<seconds>    Stop after this time. The default is 1 second if --post is not specified.
+#
+# Afterwards, you can load the samples into PulseView or sigrok-cli, see the command printed at the end.
+#
+# Copyright (c) 2012 - R. Diez - Licensed under the GNU AGPLv3.
+
+use strict;
+use warnings;
+
+use FindBin qw( $Bin $Script );
+use Getopt::Long;
+use IO::Handle;
+use IO::Select;
+use Fcntl;
+use Time::HiRes qw( time );
+
+use constant EXIT_CODE_SUCCESS       => 0;
+use constant EXIT_CODE_FAILURE_ARGS  => 1;
+use constant EXIT_CODE_FAILURE_ERROR => 2;
+
+use constant TRUE  => 1;
+use constant FALSE => 0;
+
+# Command codes, see BusPirateLogicMode.h .
+use constant BIN_MODE_CHAR        => 0x00;
+use constant BIN_CMD_CONSOLE_MODE => 0x0F;
+use constant BIN_CMD_LOGIC_MODE   => 0x21;
+
+use constant LOGIC_CMD_EXIT      => 0x00;
+use constant LOGIC_CMD_CONFIGURE => 0x02;
+use constant LOGIC_CMD_START     => 0x03;
+use constant LOGIC_CMD_STOP      => 0x04;
+
+use constant FRAME_DATA => 0x10;
+use constant FRAME_END  => 0x11;
+
+use constant NO_TRIGGER_INDEX => 0xFFFFFFFF;
+
+use constant MAX_PRE_TRIGGER_SAMPLE_COUNT => 1024;
+
+# The bit positions in each sample, see LogicSampler.h .
+my %PIN_BITS = ( TCK => 0, TMS => 1, TDI => 2, TDO => 3, TRST => 4, SRST => 5 );
+
+use constant CHANNEL_COUNT => 6;
+
+
+sub write_stdout ( $ )
+{
+  ( print STDOUT $_[0] ) or die "Error writing to standard output: $!\n";
+}
+
+
+# ------------ Serial port ------------
+
+sub read_with_timeout ( $ $ $ )
+{
+  my $fh        = shift;
+  my $byteCount = shift;
+  my $timeout   = shift;
+
+  my $data = "";
+  my $select = IO::Select->new( $fh );
+  my $endTime = time() + $timeout;
+
+  while ( length( $data ) < $byteCount )
+  {
+    my $remaining = $endTime - time();
+
+    last if $remaining <= 0;
+
+    next if !$select->can_read( $remaining );
+
+    my $readCount = sysread( $fh, $data, $byteCount - length( $data ), length( $data ) );
+
+    if ( !defined( $readCount ) )
+    {
+      die "Error reading from the serial port: $!\n";
+    }
+
+    if ( $readCount == 0 )
+    {
+      die "The serial port has been closed.\n";
+    }
+  }
+
+  return $data;
+}
+
+
+sub read_exactly ( $ $ $ )
+{
+  my $fh        = shift;
+  my $byteCount = shift;
+  my $context   = shift;
+
+  my $data = read_with_timeout( $fh, $byteCount, 3 );
+
+  if ( length( $data ) != $byteCount )
+  {
+    die "Timeout waiting for $context.\n";
+  }
+
+  return $data;
+}
+
+
+sub write_all ( $ $ )
+{
+  my $fh   = shift;
+  my $data = shift;
+
+  my $offset = 0;
+
+  while ( $offset < length( $data ) )
+  {
+    my $writtenCount = syswrite( $fh, $data, length( $data ) - $offset, $offset );
+
+    if ( !defined( $writtenCount ) )
+    {
+      die "Error writing to the serial port: $!\n";
+    }
+
+    $offset += $writtenCount;
+  }
+}
+
+
+sub expect_reply ( $ $ $ )
+{
+  my $fh       = shift;
+  my $expected = shift;
+  my $context  = shift;
+
+  my $reply = read_with_timeout( $fh, length( $expected ), 3 );
+
+  if ( $reply ne $expected )
+  {
+    die qq<Unexpected reply "$reply" $context, expected "$expected".\n>;
+  }
+}
+
+
+sub enter_binary_mode ( $ )
+{
+  my $fh = shift;
+
+  # Discard anything the console may have printed so far.
+  read_with_timeout( $fh, 1000000, 0.2 );
+
+  # Like with the Bus Pirate, send zeros until the binary mode answers.
+
+  for ( my $i = 0; $i < 20; ++$i )
+  {
+    write_all( $fh, pack( "C", BIN_MODE_CHAR ) );
+
+    my $reply = read_with_timeout( $fh, 1000000, 0.05 );
+
+    if ( $reply =~ m/BBIO1/ )
+    {
+      # Each zero sent after the first one has generated another welcome string.
+      read_with_timeout( $fh, 1000000, 0.2 );
+      return;
+    }
+  }
+
+  die "The DebugDue did not enter the binary mode.\n";
+}
+
+
+# ------------ Capture ------------
+
+sub parse_triggers ( $ )
+{
+  my $triggers = shift;
+
+  my $mask  = 0;
+  my $value = 0;
+
+  foreach my $trigger ( @$triggers )
+  {
+    if ( $trigger !~ m/\A(\w+)=([01])\z/ || !exists $PIN_BITS{ uc( $1 ) } )
+    {
+      die qq<Invalid trigger condition "$trigger".\n>;
+    }
+
+    my $bit = 1 << $PIN_BITS{ uc( $1 ) };
+
+    $mask  |= $bit;
+    $value |= $bit if $2;
+  }
+
+  return ( $mask, $value );
+}
+
+
+sub capture ( $ $ $ $ $ $ $ $ )
+{
+  my $device     = shift;
+  my $outputFh   = shift;
+  my $rate       = shift;
+  my $preCount   = shift;
+  my $postCount  = shift;
+  my $mask       = shift;
+  my $value      = shift;
+  my $duration   = shift;
+
+  system( "stty", "-F", $device, "raw", "-echo" ) == 0
+    or die qq<Cannot configure serial port "$device" with stty.\n>;
+
+  sysopen( my $fh, $device, O_RDWR | O_NOCTTY ) or die qq<Cannot open serial port "$device": $!\n>;
+
+  enter_binary_mode( $fh );
+
+  write_all( $fh, pack( "C", BIN_CMD_LOGIC_MODE ) );
+  expect_reply( $fh, "LOG1", "when entering the logic analyser mode" );
+
+  write_all( $fh, pack( "CNnNCC", LOGIC_CMD_CONFIGURE, $rate, $preCount, $postCount, $mask, $value ) );
+
+  my ( $status, $actualRate ) = unpack( "CN", read_exactly( $fh, 5, "the configuration reply" ) );
+
+  if ( $status != 1 )
+  {
+    die "The DebugDue rejected the capture configuration.\n";
+  }
+
+  write_all( $fh, pack( "C", LOGIC_CMD_START ) );
+
+  my $startTime = time();
+  my $isStopSent = FALSE;
+
+  my $frameCount = 0;
+  my $sampleCount = 0;
+  my @gaps;
+
+  for ( ; ; )
+  {
+    if ( !$isStopSent && defined( $duration ) && time() - $startTime >= $duration )
+    {
+      write_all( $fh, pack( "C", LOGIC_CMD_STOP ) );
+      $isStopSent = TRUE;
+    }
+
+    # Waiting for the trigger can take a long time, so poll for the frame type.
+    my $frameType = read_with_timeout( $fh, 1, 0.1 );
+
+    next if length( $frameType ) == 0;
+
+    $frameType = unpack( "C", $frameType );
+
+    if ( $frameType == FRAME_DATA )
+    {
+      my ( $count, $droppedCount ) = unpack( "nN", read_exactly( $fh, 6, "a data frame header" ) );
+
+      if ( $droppedCount != 0 )
+      {
+        push @gaps, [ $sampleCount, $droppedCount ];
+      }
+
+      my $samples = read_exactly( $fh, $count, "the data frame samples" );
+
+      ( print $outputFh $samples ) or die "Cannot write to the output file: $!\n";
+
+      $sampleCount += $count;
+      ++$frameCount;
+    }
+    elsif ( $frameType == FRAME_END )
+    {
+      my ( $sentCount, $totalDroppedCount, $triggerIndex ) = unpack( "NNN", read_exactly( $fh, 12, "the end frame" ) );
+
+      if ( $sentCount != $sampleCount )
+      {
+        die "The DebugDue sent $sentCount samples, but $sampleCount were received.\n";
+      }
+
+      write_stdout( sprintf( "Received %u samples at %u Hz in %u frames, %.2f seconds.\n",
+                             $sampleCount, $actualRate, $frameCount, time() - $startTime ) );
+
+      if ( $triggerIndex == NO_TRIGGER_INDEX )
+      {
+        write_stdout( "The capture stopped before the trigger.\n" );
+      }
+      else
+      {
+        write_stdout( "The trigger sample is at index $triggerIndex.\n" );
+      }
+
+      if ( $totalDroppedCount == 0 )
+      {
+        write_stdout( "No samples were dropped.\n" );
+      }
+      else
+      {
+        write_stdout( sprintf( "%u samples were dropped in %u gaps, because the USB connection could not keep up.\n",
+                               $totalDroppedCount, scalar( @gaps ) ) );
+
+        foreach my $gap ( @gaps )
+        {
+          write_stdout( sprintf( "  %u samples dropped before index %u.\n", $gap->[1], $gap->[0] ) );
+        }
+      }
+
+      last;
+    }
+    else
+    {
+      die sprintf( "Unexpected frame type 0x%02X.\n", $frameType );
+    }
+  }
+
+  write_all( $fh, pack( "C", LOGIC_CMD_EXIT ) );
+  expect_reply( $fh, "BBIO1", "when leaving the logic analyser mode" );
+
+  write_all( $fh, pack( "C", BIN_CMD_CONSOLE_MODE ) );
+
+  close( $fh ) or die "Cannot close the serial port: $!\n";
+
+  return $actualRate;
+}
+
+
+sub main ()
+{
+  my $arg_device;
+  my $arg_output;
+  my $arg_rate = 100000;
+  my @arg_triggers;
+  my $arg_pre = 0;
+  my $arg_post = 0;
+  my $arg_duration;
+  my $arg_help = FALSE;
+
+  Getopt::Long::Configure( "no_auto_abbrev", "prefix_pattern=(--|-)", "no_ignore_case" );
+
+  my $result = GetOptions(
+                 'help'       => \$arg_help,
+                 'device=s'   => \$arg_device,
+                 'output=s'   => \$arg_output,
+                 'rate=i'     => \$arg_rate,
+                 'trigger=s'  => \@arg_triggers,
+                 'pre=i'      => \$arg_pre,
+                 'post=i'     => \$arg_post,
+                 'duration=f' => \$arg_duration
+               );
+
+  if ( not $result )
+  {
+    # GetOptions has already printed an error message.
+    return EXIT_CODE_FAILURE_ARGS;
+  }
+
+  if ( $arg_help )
+  {
+    write_stdout( "See the comments at the beginning of script $Bin/$Script for usage information.\n" );
+    return EXIT_CODE_SUCCESS;
+  }
+
+  if ( !defined( $arg_device ) || !defined( $arg_output ) )
+  {
+    die "Please specify options --device and --output.\n";
+  }
+
+  if ( $arg_rate < 1000 || $arg_rate > 1000000 )
+  {
+    die "The sample rate must be between 1000 and 1000000 Hz.\n";
+  }
+
+  if ( $arg_pre < 0 || $arg_pre > MAX_PRE_TRIGGER_SAMPLE_COUNT )
+  {
+    die "The pre-trigger sample count must be between 0 and " . MAX_PRE_TRIGGER_SAMPLE_COUNT . ".\n";
+  }
+
+  if ( $arg_post < 0 || $arg_post > 0xFFFFFFFF )
+  {
+    die "Invalid post-trigger sample count.\n";
+  }
+
+  if ( $arg_post == 0 && !defined( $arg_duration ) )
+  {
+    $arg_duration = 1;
+  }
+
+  my ( $mask, $value ) = parse_triggers( \@arg_triggers );
+
+  open( my $outputFh, ">:raw", $arg_output ) or die qq<Cannot create file "$arg_output": $!\n>;
+
+  my $actualRate = capture( $arg_device, $outputFh, $arg_rate, $arg_pre, $arg_post, $mask, $value, $arg_duration );
+
+  close( $outputFh ) or die qq<Cannot close file "$arg_output": $!\n>;
+
+  write_stdout( "\nTo view the capture, run:\n" .
+                "  sigrok-cli -I binary:numchannels=" . CHANNEL_COUNT . ":samplerate=$actualRate -i $arg_output\n" .
+                "The channels are D0 TCK, D1 TMS, D2 TDI, D3 TDO, D4 nTRST and D5 nSRST.\n" );
+
+  return EXIT_CODE_SUCCESS;
+}
+
+
+# ------------ Script entry point ------------
+
+eval
+{
+  my $exitCode = main();
+  exit $exitCode;
+};
+
+my $errorMessage = $@;
+
+# We want the error message to be the last thing on the screen,
+# so we need to flush the standard output first.
+STDOUT->flush();
+
+print STDERR "\nError running \"$Bin/$Script\": $errorMessage";
+
+exit EXIT_CODE_FAILURE_ERROR;
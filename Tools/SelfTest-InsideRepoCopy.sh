@@ -557,10 +557,76 @@ build_firmwares ()
           "$BUILD_BASE_CMD  --project=QemuFirmware --build-type=release --simulate" \
           both  "${FW_BUILD_LOG_FILE_PREFIX}QemuFirmware-simulate-release.txt"
 
+  run_qemu_benchmarks  "$L_TOOLCHAIN_BIN_DIR"  "$OUTPUT_BASE_DIR"  "$FW_BUILD_LOG_FILE_PREFIX"
+
   popd >/dev/null
 }
 
 
+# Builds the QemuBenchmark firmware with different optimisation settings and runs
+# each variant under the simulator. The benchmark results are then collected into a single summary file,
+# so that it is easy to compare the compiler settings and the toolchain variants.
+#
+# The compiler flags passed with CXXFLAGS land after the project's own flags on the command line,
+# so they override the default optimisation level of the release build.
+
+run_qemu_benchmarks ()
+{
+  local -r L_TOOLCHAIN_BIN_DIR="$1"
+  local -r L_OUTPUT_BASE_DIR="$2"
+  local -r L_LOG_FILE_PREFIX="$3"
+
+  local -r -a VARIANT_NAMES=( "O2"  "O3"  "Os"  "O3-NoLto"     )
+  local -r -a VARIANT_FLAGS=( "-O2" "-O3" "-Os" "-O3 -fno-lto" )
+
+  local -r SUMMARY_FILENAME="${L_LOG_FILE_PREFIX}QemuBenchmark-Summary.txt"
+
+  echo "QemuBenchmark results, toolchain \"$L_TOOLCHAIN_BIN_DIR\"." >"$SUMMARY_FILENAME"
+
+  local -i INDEX
+  for (( INDEX=0; INDEX < ${#VARIANT_NAMES[@]}; INDEX++ )); do
+
+    local VARIANT_NAME="${VARIANT_NAMES[$INDEX]}"
+
+    local LOG_FILENAME="${L_LOG_FILE_PREFIX}QemuBenchmark-$VARIANT_NAME.txt"
+
+    # Each variant needs its own output directory, because changing CXXFLAGS does not trigger a rebuild.
+    local CMD
+    printf -v CMD \
+           "%q  --toolchain-dir=%q  --build-output-base-dir=%q  --project=QemuBenchmark --build-type=release --make-arg=%q --build --disassemble --simulate" \
+           "./DebugDueBuilder.sh" \
+           "$L_TOOLCHAIN_BIN_DIR" \
+           "$L_OUTPUT_BASE_DIR/QemuBenchmark-$VARIANT_NAME" \
+           "CXXFLAGS=${VARIANT_FLAGS[$INDEX]}"
+
+    # The firmware writes its results over semihosting to this file in Qemu's current directory.
+    local RESULTS_FILENAME="QemuBenchmarkResults.txt"
+
+    rm -f -- "$RESULTS_FILENAME"
+
+    run_cmd "Building and running QemuBenchmark with ${VARIANT_FLAGS[$INDEX]}..." \
+            "$CMD" \
+            both  "$LOG_FILENAME"
+
+    if ! [ -s "$RESULTS_FILENAME" ]; then
+      abort "The QemuBenchmark firmware did not write any results to file \"$RESULTS_FILENAME\"."
+    fi
+
+    {
+      echo
+      echo "Variant $VARIANT_NAME (${VARIANT_FLAGS[$INDEX]}):"
+      tr -d '\r' <"$RESULTS_FILENAME"
+    } >>"$SUMMARY_FILENAME"
+
+    mv -- "$RESULTS_FILENAME"  "${L_LOG_FILE_PREFIX}QemuBenchmark-$VARIANT_NAME-Results.txt"
+
+  done
+
+  echo
+  echo "The QemuBenchmark summary is in file: $SUMMARY_FILENAME"
+}
+
+
 quote_and_append_args ()
 {
   local -n VAR="$1"
@@ -612,6 +678,32 @@ collect_filenames ()
 }
 
 
+check_host_emulator ()
+{
+  echo
+  echo "Checking the host emulator..."
+
+  local -r BUILD_DIR="$ROTATED_DIR/HostEmulator"
+
+  # In case we are reusing an output directory, delete any existing build, so that we rebuild from scratch.
+  rm -rf -- "$BUILD_DIR"
+
+  get_make_parallel_args
+
+  # The debug build has the assertions enabled, so it catches more errors.
+  local CMD
+  printf -v CMD \
+         "make  -C %q  DEBUG=1  BUILD_DIR=%q  %s  check" \
+         "$COPY_OF_REPOSITORY/HostEmulator" \
+         "$BUILD_DIR" \
+         "$PARALLEL_ARGS"
+
+  run_cmd "Building the host emulator and running its checks..." \
+          "$CMD" \
+          stdout  "$LOG_FILES_DIRNAME/HostEmulator-check.txt"
+}
+
+
 lint_sources ()
 {
   pushd "$COPY_OF_REPOSITORY" >/dev/null
@@ -690,6 +782,7 @@ mkdir --parents -- "$LOG_FILES_DIRNAME"
 
 declare -r SHOULD_LINT="${DEBUGDUE_SHOULD_LINT:-true}"
 declare -r SHOULD_BUILD_FIRMWARES="${DEBUGDUE_SHOULD_BUILD_FIRMWARES:-true}"
+declare -r SHOULD_CHECK_HOST_EMULATOR="${DEBUGDUE_SHOULD_CHECK_HOST_EMULATOR:-true}"
 
 
 # Environment variable DEBUGDUE_LIBC_VARIANTS should contain a space-separated list of libcs.
@@ -705,6 +798,10 @@ if $SHOULD_LINT; then
   lint_sources
 fi
 
+if $SHOULD_CHECK_HOST_EMULATOR; then
+  check_host_emulator
+fi
+
 declare -a TOOLCHAIN_BIN_DIR_ARRAY=()
 
 # The calling script always passes DEBUGDUE_SHOULD_BUILD_TOOLCHAINS in the environment.
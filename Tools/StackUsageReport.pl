@@ -0,0 +1,476 @@
+#!/usr/bin/perl
+
+# This script combines the call graph information that GCC generates with option
+# -fcallgraph-info=su,da into a worst-case stack usage report per entry point.
+#
+# GCC writes one .ci file per object file. Each file describes the functions defined in
+# that translation unit, their static stack frame sizes (like -fstack-usage does),
+# and all direct calls they make. This script loads all .ci files together,
+# so that calls across translation units can be followed.
+#
+# The entry points are normally the reset handler, which ends up running the main loop,
+# and all interrupt handlers. By default, all functions whose name ends in "_Handler"
+# are considered entry points.
+#
+# The results are only as good as the information the compiler can provide:
+# - Indirect calls (through function pointers or virtual methods) cannot be followed.
+# - Functions in libraries compiled without -fcallgraph-info, like the C runtime library,
+#   have no stack usage information. Use option --assume-stack-usage for them.
+# - Recursion cannot be bounded. The recursive call is ignored.
+# - Frames with a dynamic size, like those using alloca() or variable-length arrays,
+#   are reported with their static part only.
+# All such cases are listed in the report, so that you can judge how much margin to leave.
+#
+# Usage:
+#   perl StackUsageReport.pl [options] <.ci files or directories to scan recursively>
+#
+# Options:
+#   --entry-point=<name>  Report on this function. Can be specified several times.
+#                         The default is all functions ending in "_Handler".
+#   --assume-stack-usage=<name>=<bytes>  Stack usage for a function without information,
+#                         including everything it calls. Can be specified several times.
+#   --exception-frame-size=<bytes>  Stack space the CPU uses to enter an interrupt handler.
+#                         The default is 36 bytes, that is, the 32-byte basic frame on an ARM Cortex-M3
+#                         plus 4 bytes of alignment padding.
+#   --reset-handler=<name>  The entry point that does not run as an interrupt.
+#                         The default is "BareMetalSupport_Reset_Handler".
+#
+# Copyright (c) 2012 - R. Diez - Licensed under the GNU AGPLv3.
+
+use strict;
+use warnings;
+
+use FindBin qw( $Bin $Script );
+use Getopt::Long;
+use File::Find;
+use IO::Handle;
+
+use constant EXIT_CODE_SUCCESS       => 0;
+use constant EXIT_CODE_FAILURE_ARGS  => 1;
+use constant EXIT_CODE_FAILURE_ERROR => 2;
+
+use constant TRUE  => 1;
+use constant FALSE => 0;
+
+use constant INDIRECT_CALL_NODE => "__indirect_call";
+
+
+# Function information, indexed by the node title in the .ci files. That is the mangled name,
+# prefixed with the source filename for functions with internal linkage.
+my %g_functions;
+
+# Callees, indexed by caller title. Each entry is a hash of callee titles.
+my %g_calls;
+
+# Stack usage assumptions from the command line, indexed by title or by displayed name.
+my %g_assumedStackUsage;
+
+# Results of the worst-case analysis, indexed by title.
+my %g_worstCase;
+
+
+sub write_stdout ( $ )
+{
+  ( print STDOUT $_[0] ) or die "Error writing to standard output: $!\n";
+}
+
+
+sub format_number ( $ )
+{
+  my $str = reverse( "$_[0]" );
+  $str =~ s/(\d{3})(?=\d)/$1,/g;
+  return scalar reverse( $str );
+}
+
+
+sub collect_ci_files ( $ )
+{
+  my $args = shift;
+
+  my @files;
+
+  foreach my $arg ( @$args )
+  {
+    if ( -d $arg )
+    {
+      File::Find::find( { wanted => sub { push @files, $File::Find::name if ( -f $_ && m/\.ci\z/ ) },
+                          no_chdir => TRUE },
+                        $arg );
+    }
+    elsif ( -f $arg )
+    {
+      push @files, $arg;
+    }
+    else
+    {
+      die qq<"$arg" is neither a file nor a directory.\n>;
+    }
+  }
+
+  return sort @files;
+}
+
+
+sub parse_ci_file ( $ )
+{
+  my $filename = shift;
+
+  open( my $fh, "<", $filename ) or die qq<Cannot open file "$filename": $!\n>;
+
+  while ( my $line = <$fh> )
+  {
+    if ( $line =~ m/^node: \{ title: "((?:[^"\\]|\\.)*)" label: "((?:[^"\\]|\\.)*)"/ )
+    {
+      my $title = $1;
+      my @labelLines = split( /\\n/, $2 );
+
+      my %info = ( name => $labelLines[ 0 ] );
+
+      # GCC sometimes writes a truncated name in the label, like ")" for variadic functions
+      # or "0(...)" for split function parts. Fall back to the mangled name then.
+      if ( $info{ name } !~ m/[A-Za-z_]\w*\s*\(/ )
+      {
+        ( $info{ name } = $title ) =~ s/\A.*://;
+      }
+
+      if ( @labelLines >= 3 && $labelLines[ 2 ] =~ m/^(\d+) bytes \(([^)]*)\)/ )
+      {
+        $info{ location  } = $labelLines[ 1 ];
+        $info{ stackSize } = $1;
+        $info{ isDynamic } = ( $2 ne "static" );
+      }
+
+      # Functions defined in several translation units, like inline functions or templates,
+      # may have different frame sizes depending on the compilation flags. Keep the biggest one.
+      # Nodes without stack usage information are just references to functions defined elsewhere.
+
+      my $existing = $g_functions{ $title };
+
+      if ( !defined( $existing ) ||
+           ( defined( $info{ stackSize } ) &&
+             ( !defined( $existing->{ stackSize } ) || $info{ stackSize } > $existing->{ stackSize } ) ) )
+      {
+        $g_functions{ $title } = \%info;
+      }
+    }
+    elsif ( $line =~ m/^edge: \{ sourcename: "((?:[^"\\]|\\.)*)" targetname: "((?:[^"\\]|\\.)*)"/ )
+    {
+      $g_calls{ $1 }{ $2 } = TRUE;
+    }
+  }
+
+  close( $fh ) or die qq<Cannot close file "$filename": $!\n>;
+}
+
+
+sub get_display_name ( $ )
+{
+  my $title = shift;
+
+  my $info = $g_functions{ $title };
+
+  return defined( $info ) ? $info->{ name } : $title;
+}
+
+
+sub get_assumed_stack_usage ( $ )
+{
+  my $title = shift;
+
+  return $g_assumedStackUsage{ $title } if exists( $g_assumedStackUsage{ $title } );
+
+  my $name = get_display_name( $title );
+
+  return $g_assumedStackUsage{ $name } if exists( $g_assumedStackUsage{ $name } );
+
+  # Demangled names carry the parameter list, like "int vsnprintf(char*, ...)".
+  if ( $name =~ m/([A-Za-z_][\w:]*)\(/ )
+  {
+    return $g_assumedStackUsage{ $1 } if exists( $g_assumedStackUsage{ $1 } );
+  }
+
+  return undef;
+}
+
+
+# Computes the worst-case stack usage for the given function, including all functions it calls.
+#
+# The result is a hash with the following fields:
+#   total      Worst-case stack usage in bytes.
+#   nextCall   Title of the callee on the worst-case path, or undef.
+#   issues     Hash of issue descriptions found on any path below this function.
+
+sub analyse_function ( $ $ );
+
+sub analyse_function ( $ $ )
+{
+  my $title      = shift;
+  my $inProgress = shift;  # Hash of the functions on the current call path, for recursion detection.
+
+  my $cached = $g_worstCase{ $title };
+  return $cached if defined( $cached );
+
+  my %issues;
+  my $ownSize = 0;
+
+  my $info = $g_functions{ $title };
+
+  my $assumed = get_assumed_stack_usage( $title );
+
+  if ( defined( $assumed ) )
+  {
+    my %result = ( total => $assumed, nextCall => undef, issues => {} );
+    $g_worstCase{ $title } = \%result;
+    return \%result;
+  }
+
+  if ( $title eq INDIRECT_CALL_NODE )
+  {
+    my %result = ( total => 0, nextCall => undef, issues => {} );
+    return \%result;
+  }
+
+  if ( not defined( $info ) or not defined( $info->{ stackSize } ) )
+  {
+    $issues{ "No stack usage information for: " . get_display_name( $title ) } = TRUE;
+  }
+  else
+  {
+    $ownSize = $info->{ stackSize };
+
+    if ( $info->{ isDynamic } )
+    {
+      $issues{ "Dynamic stack frame, only the static part is counted: " . $info->{ name } } = TRUE;
+    }
+  }
+
+  $inProgress->{ $title } = TRUE;
+
+  my $worstCalleeTotal = 0;
+  my $worstCallee;
+  my $isRecursive = FALSE;
+
+  foreach my $callee ( sort keys %{ $g_calls{ $title } // {} } )
+  {
+    if ( $callee eq INDIRECT_CALL_NODE )
+    {
+      $issues{ "Indirect call from: " . get_display_name( $title ) } = TRUE;
+      next;
+    }
+
+    if ( $inProgress->{ $callee } )
+    {
+      $issues{ "Recursion, not bounded: " . get_display_name( $title ) . " calls " . get_display_name( $callee ) } = TRUE;
+      $isRecursive = TRUE;
+      next;
+    }
+
+    my $calleeResult = analyse_function( $callee, $inProgress );
+
+    %issues = ( %issues, %{ $calleeResult->{ issues } } );
+
+    if ( !defined( $worstCallee ) || $calleeResult->{ total } > $worstCalleeTotal )
+    {
+      $worstCalleeTotal = $calleeResult->{ total };
+      $worstCallee      = $callee;
+    }
+  }
+
+  delete $inProgress->{ $title };
+
+  my %result = ( total    => $ownSize + $worstCalleeTotal,
+                 nextCall => $worstCallee,
+                 issues   => \%issues );
+
+  # Results inside a recursive cycle depend on the path we came from, so do not cache them.
+  $g_worstCase{ $title } = \%result if not $isRecursive;
+
+  return \%result;
+}
+
+
+sub print_entry_point ( $ $ )
+{
+  my $title  = shift;
+  my $result = shift;
+
+  write_stdout( "Entry point: " . get_display_name( $title ) . "\n" );
+  write_stdout( "  Worst-case stack usage: " . format_number( $result->{ total } ) . " bytes\n" );
+  write_stdout( "  Worst-case call path:\n" );
+
+  my $current = $title;
+
+  while ( defined( $current ) )
+  {
+    my $info = $g_functions{ $current };
+    my $assumed = get_assumed_stack_usage( $current );
+
+    my $sizeStr;
+    my $location = "";
+
+    if ( defined( $assumed ) )
+    {
+      $sizeStr = format_number( $assumed ) . " (assumed)";
+    }
+    elsif ( defined( $info ) && defined( $info->{ stackSize } ) )
+    {
+      $sizeStr  = format_number( $info->{ stackSize } );
+      $location = "  " . $info->{ location };
+    }
+    else
+    {
+      $sizeStr = "?";
+    }
+
+    write_stdout( sprintf( "    %8s  %s%s\n", $sizeStr, get_display_name( $current ), $location ) );
+
+    last if defined( $assumed );
+
+    my $next = analyse_function( $current, {} )->{ nextCall };
+
+    $current = $next;
+  }
+
+  my @issues = sort keys %{ $result->{ issues } };
+
+  if ( @issues )
+  {
+    write_stdout( "  The worst case may be higher because of the following issues:\n" );
+
+    foreach my $issue ( @issues )
+    {
+      write_stdout( "    - $issue\n" );
+    }
+  }
+
+  write_stdout( "\n" );
+}
+
+
+sub main ()
+{
+  my @arg_entryPoints;
+  my @arg_assumedStackUsage;
+  my $arg_exceptionFrameSize = 36;
+  my $arg_resetHandler = "BareMetalSupport_Reset_Handler";
+  my $arg_help = FALSE;
+
+  Getopt::Long::Configure( "no_auto_abbrev", "prefix_pattern=(--|-)", "no_ignore_case" );
+
+  my $result = GetOptions(
+                 'help'                   => \$arg_help,
+                 'entry-point=s'          => \@arg_entryPoints,
+                 'assume-stack-usage=s'   => \@arg_assumedStackUsage,
+                 'exception-frame-size=i' => \$arg_exceptionFrameSize,
+                 'reset-handler=s'        => \$arg_resetHandler
+               );
+
+  if ( not $result )
+  {
+    # GetOptions has already printed an error message.
+    return EXIT_CODE_FAILURE_ARGS;
+  }
+
+  if ( $arg_help )
+  {
+    write_stdout( "See the comments at the beginning of script $Bin/$Script for usage information.\n" );
+    return EXIT_CODE_SUCCESS;
+  }
+
+  if ( @ARGV == 0 )
+  {
+    die "No call graph files or directories specified.\n";
+  }
+
+  foreach my $assumption ( @arg_assumedStackUsage )
+  {
+    if ( $assumption !~ m/\A(.+)=(\d+)\z/ )
+    {
+      die qq<Invalid value "$assumption" for option --assume-stack-usage, the syntax is <name>=<bytes> .\n>;
+    }
+
+    $g_assumedStackUsage{ $1 } = $2;
+  }
+
+  my @ciFiles = collect_ci_files( \@ARGV );
+
+  if ( @ciFiles == 0 )
+  {
+    die "No .ci files found. Did you compile with GCC option -fcallgraph-info=su,da , and without LTO?\n";
+  }
+
+  foreach my $filename ( @ciFiles )
+  {
+    parse_ci_file( $filename );
+  }
+
+  my @entryPoints;
+
+  if ( @arg_entryPoints )
+  {
+    foreach my $name ( @arg_entryPoints )
+    {
+      my @matches = grep { $_ eq $name || get_display_name( $_ ) eq $name } keys %g_functions;
+
+      if ( @matches == 0 )
+      {
+        die qq<Entry point "$name" not found in the call graph.\n>;
+      }
+
+      push @entryPoints, @matches;
+    }
+  }
+  else
+  {
+    @entryPoints = grep { m/_Handler\z/ && defined( $g_functions{ $_ }{ stackSize } ) } keys %g_functions;
+  }
+
+  @entryPoints = sort @entryPoints;
+
+  write_stdout( "Stack usage report generated from " . scalar( @ciFiles ) . " call graph files.\n" );
+  write_stdout( "The sizes are in bytes. Interrupt handlers need another " . $arg_exceptionFrameSize . " bytes for the exception frame.\n\n" );
+
+  my $mainTotal = 0;
+  my $interruptTotal = 0;
+
+  foreach my $title ( @entryPoints )
+  {
+    my $entryResult = analyse_function( $title, {} );
+
+    print_entry_point( $title, $entryResult );
+
+    if ( $title eq $arg_resetHandler )
+    {
+      $mainTotal = $entryResult->{ total };
+    }
+    else
+    {
+      $interruptTotal += $entryResult->{ total } + $arg_exceptionFrameSize;
+    }
+  }
+
+  write_stdout( "Worst case if all interrupt handlers nest on top of the reset handler: " .
+                format_number( $mainTotal + $interruptTotal ) . " bytes.\n" );
+  write_stdout( "Handlers with the same priority cannot nest, so the real worst case is probably lower.\n" );
+
+  return EXIT_CODE_SUCCESS;
+}
+
+
+# ------------ Script entry point ------------
+
+eval
+{
+  my $exitCode = main();
+  exit $exitCode;
+};
+
+my $errorMessage = $@;
+
+# We want the error message to be the last thing on the screen,
+# so we need to flush the standard output first.
+STDOUT->flush();
+
+print STDERR "\nError running \"$Bin/$Script\": $errorMessage";
+
+exit EXIT_CODE_FAILURE_ERROR;
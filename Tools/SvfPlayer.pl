@@ -0,0 +1,797 @@
+#!/usr/bin/perl
+
+# This script compiles an SVF file into the binary stream that the DebugDue's on-board SVF player
+# understands, and optionally plays it on a DebugDue connected over USB.
+#
+# The DebugDue executes the stream as it arrives and compares the TDO data itself, so this script
+# sends the whole stream in one go and only waits for the final report. See BusPirateSvfMode.h
+# for a description of the stream format.
+#
+# The usual SVF rules apply: the TDI, MASK and SMASK values are remembered until the scan length changes,
+# TDO is only compared when specified, and the HIR, TIR, HDR and TDR header and trailer bits are added
+# to every scan by this script, so the DebugDue never sees them separately.
+#
+# Limitations:
+# - FREQUENCY is ignored. The DebugDue always shifts at its maximum speed.
+# - RUNTEST SCK counts are treated as TCK counts, and the MAXIMUM time is ignored.
+# - PIO and PIOMAP are not supported.
+# - Standard XSVF files are not supported. They are normally generated from SVF files anyway.
+#
+# Usage:
+#   perl SvfPlayer.pl [options] <file.svf>
+#
+# Options:
+#   --device=<serial port>  Play the SVF file on the DebugDue connected to this serial port,
+#                           like /dev/ttyACM0 . The DebugDue must be in the Bus Pirate console mode.
+#   --output=<filename>     Write the compiled binary stream to this file.
+#
+# At least one of the options above must be specified. The exit code is non-zero
+# if any TDO comparison fails.
+#
+# You can try this script without any hardware against the host emulator's simulated JTAG chain,
+# see README.pod .
+#
+# Copyright (c) 2012 - R. Diez - Licensed under the GNU AGPLv3.
+
+use strict;
+use warnings;
+
+use FindBin qw( $Bin $Script );
+use Getopt::Long;
+use IO::Handle;
+use IO::Select;
+use Fcntl;
+use POSIX qw( ceil );
+use Time::HiRes qw( time );
+
+use constant EXIT_CODE_SUCCESS       => 0;
+use constant EXIT_CODE_FAILURE_ARGS  => 1;
+use constant EXIT_CODE_FAILURE_ERROR => 2;
+
+use constant TRUE  => 1;
+use constant FALSE => 0;
+
+# Command codes, see BusPirateSvfMode.h .
+use constant BIN_MODE_CHAR        => 0x00;
+use constant BIN_CMD_CONSOLE_MODE => 0x0F;
+use constant BIN_CMD_SVF_MODE     => 0x20;
+
+use constant SVF_CMD_EXIT    => 0x00;
+use constant SVF_CMD_REPORT  => 0x02;
+use constant SVF_CMD_TRST    => 0x03;
+use constant SVF_CMD_STATE   => 0x10;
+use constant SVF_CMD_RUNTEST => 0x11;
+use constant SVF_CMD_SIR     => 0x12;
+use constant SVF_CMD_SDR     => 0x13;
+
+use constant SCAN_FLAG_COMPARE_TDO => 0x01;
+
+use constant REPORT_LEN => 16;
+
+my %TAP_STATES = ( RESET     =>  0, IDLE      =>  1, DRSELECT  =>  2, DRCAPTURE =>  3,
+                   DRSHIFT   =>  4, DREXIT1   =>  5, DRPAUSE   =>  6, DREXIT2   =>  7,
+                   DRUPDATE  =>  8, IRSELECT  =>  9, IRCAPTURE => 10, IRSHIFT   => 11,
+                   IREXIT1   => 12, IRPAUSE   => 13, IREXIT2   => 14, IRUPDATE  => 15 );
+
+my @STABLE_STATES = qw( RESET IDLE DRPAUSE IRPAUSE );
+
+my %TRST_LEVELS = ( OFF => 0, ON => 1, Z => 2, ABSENT => 3 );
+
+
+# The compiled stream.
+my $g_stream = "";
+
+# For each JTAG command in the stream: the SVF line number, a description and,
+# for scans, the header and data bit counts, so that mismatches can be reported in SVF terms.
+my @g_jtagCmds;
+
+my $g_totalRunTestTimeUs = 0;
+my $g_totalBitCount = 0;
+
+
+sub write_stdout ( $ )
+{
+  ( print STDOUT $_[0] ) or die "Error writing to standard output: $!\n";
+}
+
+
+# Bit vectors are strings of '0' and '1' characters. The first character is the LSB,
+# which is the first bit shifted.
+
+sub hex_to_bits ( $ $ $ )
+{
+  my $hex        = shift;
+  my $bitCount   = shift;
+  my $lineNumber = shift;
+
+  $hex =~ s/\s+//g;
+
+  if ( $hex !~ m/\A[0-9a-fA-F]+\z/ )
+  {
+    die qq<Invalid hexadecimal value "$hex" in line $lineNumber.\n>;
+  }
+
+  my $bits = reverse( join( "", map { sprintf( "%04b", hex( $_ ) ) } split( //, $hex ) ) );
+
+  if ( length( $bits ) < $bitCount )
+  {
+    $bits .= "0" x ( $bitCount - length( $bits ) );
+  }
+  elsif ( substr( $bits, $bitCount ) =~ m/1/ )
+  {
+    die "The hexadecimal value in line $lineNumber has more bits than the scan length of $bitCount.\n";
+  }
+
+  return substr( $bits, 0, $bitCount );
+}
+
+
+sub parse_state_name ( $ $ )
+{
+  my $name       = uc( shift );
+  my $lineNumber = shift;
+
+  if ( not exists $TAP_STATES{ $name } )
+  {
+    die qq<Invalid TAP state "$name" in line $lineNumber.\n>;
+  }
+
+  return $name;
+}
+
+
+sub parse_stable_state_name ( $ $ )
+{
+  my $name = parse_state_name( $_[0], $_[1] );
+
+  if ( !grep { $_ eq $name } @STABLE_STATES )
+  {
+    die qq<State "$name" in line $_[1] is not a stable state.\n>;
+  }
+
+  return $name;
+}
+
+
+sub parse_number ( $ $ )
+{
+  my $str        = shift;
+  my $lineNumber = shift;
+
+  if ( !defined( $str ) || $str !~ m/\A[0-9]+(\.[0-9]*)?([eE][-+]?[0-9]+)?\z/ )
+  {
+    die qq<Invalid number "> . ( $str // "" ) . qq<" in line $lineNumber.\n>;
+  }
+
+  return $str + 0;
+}
+
+
+sub add_jtag_cmd ( $ $ $ )
+{
+  my $bytes       = shift;
+  my $lineNumber  = shift;
+  my $description = shift;
+
+  $g_stream .= $bytes;
+
+  my %cmd = ( lineNumber  => $lineNumber,
+              description => $description );
+  push @g_jtagCmds, \%cmd;
+
+  return \%cmd;
+}
+
+
+# The current values of the SIR, SDR, HIR, HDR, TIR and TDR parameters.
+
+my %g_scanParams;
+
+foreach my $name ( qw( SIR SDR HIR HDR TIR TDR ) )
+{
+  $g_scanParams{ $name } = { length => 0, tdi => "", tdo => undef, mask => "" };
+}
+
+my $g_endIrState = "IDLE";
+my $g_endDrState = "IDLE";
+
+my $g_runTestRunState = "IDLE";
+my $g_runTestEndState = "IDLE";
+
+
+sub parse_scan_params ( $ $ $ )
+{
+  my $name       = shift;
+  my $args       = shift;
+  my $lineNumber = shift;
+
+  my $params = $g_scanParams{ $name };
+
+  my $length = parse_number( shift @$args, $lineNumber );
+
+  if ( $length != int( $length ) )
+  {
+    die "Invalid scan length in line $lineNumber.\n";
+  }
+
+  my %values;
+
+  while ( @$args )
+  {
+    my $key = uc( shift @$args );
+    my $value = shift @$args;
+
+    if ( !( grep { $_ eq $key } qw( TDI TDO MASK SMASK ) ) ||
+         !defined( $value ) || $value !~ m/\A\((.*)\)\z/s )
+    {
+      die "Syntax error in the $name command in line $lineNumber.\n";
+    }
+
+    $values{ $key } = hex_to_bits( $1, $length, $lineNumber );
+  }
+
+  if ( $length != $params->{ length } )
+  {
+    if ( $length != 0 && !exists $values{ TDI } )
+    {
+      die "The $name command in line $lineNumber changes the scan length, so it must specify TDI.\n";
+    }
+
+    $params->{ length } = $length;
+    $params->{ tdi    } = "";
+    $params->{ mask   } = "1" x $length;
+  }
+
+  $params->{ tdi  } = $values{ TDI  } if exists $values{ TDI  };
+  $params->{ mask } = $values{ MASK } if exists $values{ MASK };
+
+  # SMASK only tells which TDI bits matter, so it is irrelevant here.
+
+  # For SIR and SDR, TDO is only compared when specified. The header and trailer parameters
+  # are remembered as a whole until the next HIR, HDR, TIR or TDR command.
+  $params->{ tdo } = $values{ TDO };
+}
+
+
+sub bits_to_byte ( $ $ )
+{
+  my $bits   = shift;
+  my $offset = shift;
+
+  my $chunk = substr( $bits, $offset, 8 );
+
+  return oct( "0b" . reverse( $chunk ) );
+}
+
+
+sub compile_scan ( $ $ )
+{
+  my $isSir      = shift;
+  my $lineNumber = shift;
+
+  my @parts = $isSir ? qw( HIR SIR TIR ) : qw( HDR SDR TDR );
+
+  my $tdi  = "";
+  my $tdo  = "";
+  my $mask = "";
+  my $compareTdo = FALSE;
+
+  # The header bits are shifted first, so they end up in the devices closest to TDO.
+
+  foreach my $name ( @parts )
+  {
+    my $params = $g_scanParams{ $name };
+
+    $tdi .= $params->{ tdi };
+
+    if ( defined( $params->{ tdo } ) )
+    {
+      $tdo  .= $params->{ tdo  };
+      $mask .= $params->{ mask };
+      $compareTdo = TRUE;
+    }
+    else
+    {
+      $tdo  .= "0" x $params->{ length };
+      $mask .= "0" x $params->{ length };
+    }
+  }
+
+  my $bitCount = length( $tdi );
+
+  if ( $bitCount == 0 )
+  {
+    die "Zero-length scans like the one in line $lineNumber are not supported.\n";
+  }
+
+  my $endState = $isSir ? $g_endIrState : $g_endDrState;
+
+  my $bytes = pack( "CCCN",
+                    $isSir ? SVF_CMD_SIR : SVF_CMD_SDR,
+                    $TAP_STATES{ $endState },
+                    $compareTdo ? SCAN_FLAG_COMPARE_TDO : 0,
+                    $bitCount );
+
+  for ( my $offset = 0; $offset < $bitCount; $offset += 8 )
+  {
+    $bytes .= pack( "C", bits_to_byte( $tdi, $offset ) );
+
+    if ( $compareTdo )
+    {
+      $bytes .= pack( "CC", bits_to_byte( $tdo, $offset ), bits_to_byte( $mask, $offset ) );
+    }
+  }
+
+  my $cmd = add_jtag_cmd( $bytes, $lineNumber, ( $isSir ? "SIR" : "SDR" ) . " with $bitCount bits" );
+
+  $cmd->{ headerBitCount } = $g_scanParams{ $parts[0] }{ length };
+  $cmd->{ dataBitCount   } = $g_scanParams{ $parts[1] }{ length };
+
+  $g_totalBitCount += $bitCount;
+}
+
+
+sub compile_runtest ( $ $ )
+{
+  my $args       = shift;
+  my $lineNumber = shift;
+
+  my $runState;
+  my $endState;
+  my $tckCount = 0;
+  my $minTimeSec = 0;
+
+  if ( @$args && exists $TAP_STATES{ uc( $args->[0] ) } )
+  {
+    $runState = parse_stable_state_name( shift @$args, $lineNumber );
+  }
+
+  if ( @$args >= 2 && uc( $args->[1] ) =~ m/\A(TCK|SCK)\z/ )
+  {
+    $tckCount = parse_number( shift @$args, $lineNumber );
+    shift @$args;
+  }
+
+  if ( @$args >= 2 && uc( $args->[1] ) eq "SEC" )
+  {
+    $minTimeSec = parse_number( shift @$args, $lineNumber );
+    shift @$args;
+  }
+
+  if ( @$args >= 3 && uc( $args->[0] ) eq "MAXIMUM" )
+  {
+    parse_number( $args->[1], $lineNumber );
+    splice( @$args, 0, 3 );
+  }
+
+  if ( @$args >= 2 && uc( $args->[0] ) eq "ENDSTATE" )
+  {
+    $endState = parse_stable_state_name( $args->[1], $lineNumber );
+    splice( @$args, 0, 2 );
+  }
+
+  if ( @$args )
+  {
+    die "Syntax error in the RUNTEST command in line $lineNumber.\n";
+  }
+
+  # The end state defaults to the run state, if specified, and otherwise to the last end state.
+
+  if ( defined( $runState ) )
+  {
+    $g_runTestRunState = $runState;
+    $g_runTestEndState = $runState;
+  }
+
+  $g_runTestEndState = $endState if defined( $endState );
+
+  my $minTimeUs = ceil( $minTimeSec * 1000000 );
+
+  if ( $tckCount > 0xFFFFFFFF || $minTimeUs > 0xFFFFFFFF )
+  {
+    die "The RUNTEST command in line $lineNumber is too long.\n";
+  }
+
+  add_jtag_cmd( pack( "CCCNN",
+                      SVF_CMD_RUNTEST,
+                      $TAP_STATES{ $g_runTestRunState },
+                      $TAP_STATES{ $g_runTestEndState },
+                      $tckCount,
+                      $minTimeUs ),
+                $lineNumber,
+                "RUNTEST" );
+
+  $g_totalRunTestTimeUs += $minTimeUs;
+}
+
+
+sub compile_statement ( $ $ )
+{
+  my $statement  = shift;
+  my $lineNumber = shift;
+
+  my @tokens;
+
+  while ( $statement =~ m/\G\s*(\([^)]*\)|[^\s()]+)/gc )
+  {
+    push @tokens, $1;
+  }
+
+  if ( $statement !~ m/\G\s*\z/gc )
+  {
+    die "Syntax error in line $lineNumber.\n";
+  }
+
+  return if @tokens == 0;
+
+  my $cmdName = uc( shift @tokens );
+
+  if ( $cmdName =~ m/\A(SIR|SDR|HIR|HDR|TIR|TDR)\z/ )
+  {
+    parse_scan_params( $cmdName, \@tokens, $lineNumber );
+
+    if ( $cmdName eq "SIR" || $cmdName eq "SDR" )
+    {
+      compile_scan( $cmdName eq "SIR", $lineNumber );
+    }
+  }
+  elsif ( $cmdName eq "ENDIR" || $cmdName eq "ENDDR" )
+  {
+    if ( @tokens != 1 )
+    {
+      die "Syntax error in the $cmdName command in line $lineNumber.\n";
+    }
+
+    my $state = parse_stable_state_name( $tokens[0], $lineNumber );
+
+    if ( $cmdName eq "ENDIR" )
+    {
+      $g_endIrState = $state;
+    }
+    else
+    {
+      $g_endDrState = $state;
+    }
+  }
+  elsif ( $cmdName eq "STATE" )
+  {
+    if ( @tokens == 0 )
+    {
+      die "Syntax error in the STATE command in line $lineNumber.\n";
+    }
+
+    for ( my $i = 0; $i < @tokens; ++$i )
+    {
+      my $state = $i == $#tokens ? parse_stable_state_name( $tokens[ $i ], $lineNumber )
+                                 : parse_state_name       ( $tokens[ $i ], $lineNumber );
+
+      add_jtag_cmd( pack( "CC", SVF_CMD_STATE, $TAP_STATES{ $state } ), $lineNumber, "STATE $state" );
+    }
+  }
+  elsif ( $cmdName eq "RUNTEST" )
+  {
+    compile_runtest( \@tokens, $lineNumber );
+  }
+  elsif ( $cmdName eq "TRST" )
+  {
+    if ( @tokens != 1 || !exists $TRST_LEVELS{ uc( $tokens[0] ) } )
+    {
+      die "Syntax error in the TRST command in line $lineNumber.\n";
+    }
+
+    add_jtag_cmd( pack( "CC", SVF_CMD_TRST, $TRST_LEVELS{ uc( $tokens[0] ) } ), $lineNumber, "TRST" );
+  }
+  elsif ( $cmdName eq "FREQUENCY" )
+  {
+    # Ignored, see the limitations at the top of this file.
+  }
+  else
+  {
+    die qq<Unsupported SVF command "$cmdName" in line $lineNumber.\n>;
+  }
+}
+
+
+sub compile_svf_file ( $ )
+{
+  my $filename = shift;
+
+  open( my $fh, "<", $filename ) or die qq<Cannot open file "$filename": $!\n>;
+
+  my $statement = "";
+  my $statementLineNumber;
+
+  while ( my $line = <$fh> )
+  {
+    # Remove the comments.
+    $line =~ s/(!|\/\/).*//s;
+
+    foreach my $piece ( split( /(;)/, $line ) )
+    {
+      if ( $piece eq ";" )
+      {
+        compile_statement( $statement, $statementLineNumber // $. );
+        $statement = "";
+        $statementLineNumber = undef;
+        next;
+      }
+
+      if ( !defined( $statementLineNumber ) && $piece =~ m/\S/ )
+      {
+        $statementLineNumber = $.;
+      }
+
+      $statement .= " " . $piece;
+    }
+  }
+
+  close( $fh ) or die qq<Cannot close file "$filename": $!\n>;
+
+  if ( $statement =~ m/\S/ )
+  {
+    die "The last statement in file \"$filename\" does not end with a semicolon.\n";
+  }
+}
+
+
+# ------------ Serial port ------------
+
+sub read_with_timeout ( $ $ $ )
+{
+  my $fh        = shift;
+  my $byteCount = shift;
+  my $timeout   = shift;
+
+  my $data = "";
+  my $select = IO::Select->new( $fh );
+  my $endTime = time() + $timeout;
+
+  while ( length( $data ) < $byteCount )
+  {
+    my $remaining = $endTime - time();
+
+    last if $remaining <= 0;
+
+    next if !$select->can_read( $remaining );
+
+    my $readCount = sysread( $fh, $data, $byteCount - length( $data ), length( $data ) );
+
+    if ( !defined( $readCount ) )
+    {
+      die "Error reading from the serial port: $!\n";
+    }
+
+    if ( $readCount == 0 )
+    {
+      die "The serial port has been closed.\n";
+    }
+  }
+
+  return $data;
+}
+
+
+sub write_all ( $ $ )
+{
+  my $fh   = shift;
+  my $data = shift;
+
+  my $offset = 0;
+
+  while ( $offset < length( $data ) )
+  {
+    my $writtenCount = syswrite( $fh, $data, length( $data ) - $offset, $offset );
+
+    if ( !defined( $writtenCount ) )
+    {
+      die "Error writing to the serial port: $!\n";
+    }
+
+    $offset += $writtenCount;
+  }
+}
+
+
+sub expect_reply ( $ $ $ )
+{
+  my $fh       = shift;
+  my $expected = shift;
+  my $context  = shift;
+
+  my $reply = read_with_timeout( $fh, length( $expected ), 3 );
+
+  if ( $reply ne $expected )
+  {
+    die qq<Unexpected reply "$reply" $context, expected "$expected".\n>;
+  }
+}
+
+
+sub enter_binary_mode ( $ )
+{
+  my $fh = shift;
+
+  # Discard anything the console may have printed so far.
+  read_with_timeout( $fh, 1000000, 0.2 );
+
+  # Like with the Bus Pirate, send zeros until the binary mode answers.
+
+  for ( my $i = 0; $i < 20; ++$i )
+  {
+    write_all( $fh, pack( "C", BIN_MODE_CHAR ) );
+
+    my $reply = read_with_timeout( $fh, 1000000, 0.05 );
+
+    if ( $reply =~ m/BBIO1/ )
+    {
+      # Each zero sent after the first one has generated another welcome string.
+      read_with_timeout( $fh, 1000000, 0.2 );
+      return;
+    }
+  }
+
+  die "The DebugDue did not enter the binary mode.\n";
+}
+
+
+sub describe_mismatch ( $ $ )
+{
+  my $cmd       = shift;
+  my $bitOffset = shift;
+
+  if ( !defined( $cmd->{ headerBitCount } ) )
+  {
+    return "bit $bitOffset";
+  }
+
+  my $headerBitCount = $cmd->{ headerBitCount };
+  my $dataBitCount   = $cmd->{ dataBitCount   };
+
+  if ( $bitOffset < $headerBitCount )
+  {
+    return "header bit $bitOffset";
+  }
+
+  if ( $bitOffset < $headerBitCount + $dataBitCount )
+  {
+    return "data bit " . ( $bitOffset - $headerBitCount );
+  }
+
+  return "trailer bit " . ( $bitOffset - $headerBitCount - $dataBitCount );
+}
+
+
+sub play_stream ( $ )
+{
+  my $device = shift;
+
+  system( "stty", "-F", $device, "raw", "-echo" ) == 0
+    or die qq<Cannot configure serial port "$device" with stty.\n>;
+
+  sysopen( my $fh, $device, O_RDWR | O_NOCTTY ) or die qq<Cannot open serial port "$device": $!\n>;
+
+  enter_binary_mode( $fh );
+
+  write_all( $fh, pack( "C", BIN_CMD_SVF_MODE ) );
+  expect_reply( $fh, "SVF1", "when entering the SVF player mode" );
+
+  my $startTime = time();
+
+  write_all( $fh, $g_stream . pack( "C", SVF_CMD_REPORT ) );
+
+  # The DebugDue shifts well above 100 Kbit/s, so this time-out is generous.
+  my $timeout = 10 + $g_totalRunTestTimeUs / 1000000 + $g_totalBitCount / 100000;
+
+  my $report = read_with_timeout( $fh, REPORT_LEN, $timeout );
+
+  if ( length( $report ) != REPORT_LEN )
+  {
+    die "Timeout waiting for the SVF player report.\n";
+  }
+
+  my $elapsedTime = time() - $startTime;
+
+  write_all( $fh, pack( "C", SVF_CMD_EXIT ) );
+  expect_reply( $fh, "BBIO1", "when leaving the SVF player mode" );
+
+  write_all( $fh, pack( "C", BIN_CMD_CONSOLE_MODE ) );
+
+  close( $fh ) or die "Cannot close the serial port: $!\n";
+
+  my ( $passed, $tdo8, $expectedTdo8, $mask8, $cmdCount, $failedCmdIndex, $failedBitOffset ) = unpack( "CCCCNNN", $report );
+
+  if ( $cmdCount != scalar( @g_jtagCmds ) )
+  {
+    die "The SVF player executed $cmdCount JTAG commands, but " . scalar( @g_jtagCmds ) . " were sent.\n";
+  }
+
+  write_stdout( sprintf( "Played %u JTAG commands in %.2f seconds.\n", $cmdCount, $elapsedTime ) );
+
+  if ( !$passed )
+  {
+    my $cmd = $g_jtagCmds[ $failedCmdIndex ];
+
+    die sprintf( "TDO mismatch in the %s in line %u, %s. TDO: 0x%02X, expected: 0x%02X, mask: 0x%02X.\n",
+                 $cmd->{ description },
+                 $cmd->{ lineNumber },
+                 describe_mismatch( $cmd, $failedBitOffset ),
+                 $tdo8, $expectedTdo8, $mask8 );
+  }
+
+  write_stdout( "All TDO comparisons passed.\n" );
+}
+
+
+sub main ()
+{
+  my $arg_device;
+  my $arg_output;
+  my $arg_help = FALSE;
+
+  Getopt::Long::Configure( "no_auto_abbrev", "prefix_pattern=(--|-)", "no_ignore_case" );
+
+  my $result = GetOptions(
+                 'help'     => \$arg_help,
+                 'device=s' => \$arg_device,
+                 'output=s' => \$arg_output
+               );
+
+  if ( not $result )
+  {
+    # GetOptions has already printed an error message.
+    return EXIT_CODE_FAILURE_ARGS;
+  }
+
+  if ( $arg_help )
+  {
+    write_stdout( "See the comments at the beginning of script $Bin/$Script for usage information.\n" );
+    return EXIT_CODE_SUCCESS;
+  }
+
+  if ( @ARGV != 1 )
+  {
+    die "Please specify exactly one SVF file.\n";
+  }
+
+  if ( !defined( $arg_device ) && !defined( $arg_output ) )
+  {
+    die "Please specify option --device or option --output.\n";
+  }
+
+  compile_svf_file( $ARGV[0] );
+
+  if ( defined( $arg_output ) )
+  {
+    open( my $fh, ">:raw", $arg_output ) or die qq<Cannot create file "$arg_output": $!\n>;
+    ( print $fh $g_stream ) or die qq<Cannot write to file "$arg_output": $!\n>;
+    close( $fh ) or die qq<Cannot close file "$arg_output": $!\n>;
+
+    write_stdout( sprintf( "Compiled %u JTAG commands into %u bytes.\n", scalar( @g_jtagCmds ), length( $g_stream ) ) );
+  }
+
+  if ( defined( $arg_device ) )
+  {
+    play_stream( $arg_device );
+  }
+
+  return EXIT_CODE_SUCCESS;
+}
+
+
+# ------------ Script entry point ------------
+
+eval
+{
+  my $exitCode = main();
+  exit $exitCode;
+};
+
+my $errorMessage = $@;
+
+# We want the error message to be the last thing on the screen,
+# so we need to flush the standard output first.
+STDOUT->flush();
+
+print STDERR "\nError running \"$Bin/$Script\": $errorMessage";
+
+exit EXIT_CODE_FAILURE_ERROR;
@@ -0,0 +1,654 @@
+#!/usr/bin/perl
+
+# This script drives the DebugDue's measuring USB speed tests over the native USB port
+# and summarises the results. See ProcessUsbSpeedTestCmd() in CommandProcessor.cpp
+# for a description of the tests and of the result lines the DebugDue prints.
+#
+# The tests are:
+#   PingPong     Round-trip latency for each of the --ping-sizes. The DebugDue measures the time
+#                between sending an echo and receiving the next ping, and this script measures
+#                the time between sending a ping and receiving its echo.
+#   FullDuplex   Throughput while sending and receiving at the same time.
+#   TxSizeSweep  Throughput with different udi_cdc_write_buf() write sizes on the DebugDue.
+#
+# Usage:
+#   perl UsbSpeedTest.pl [options] --device=<serial port>
+#
+# Options:
+#   --device=<serial port>  The DebugDue's native USB serial port, like /dev/ttyACM0 .
+#                           The DebugDue must be in the Bus Pirate console mode.
+#   --test=<name>           PingPong, FullDuplex, TxSizeSweep or All. The default is All.
+#   --ping-count=<count>    How many pings to send for each size. The default is 1000.
+#   --ping-sizes=<list>     Comma-separated ping sizes in bytes, up to 1024. The default is 1,63,64,65,512 .
+#   --duration=<seconds>    How long to run test FullDuplex. The default is 5 seconds.
+#   --step-time=<ms>        How long test TxSizeSweep spends on each write size. The default is 500 ms.
+#   --raw                   Print the DebugDue's result lines too, for further processing.
+#
+# Copyright (c) 2012 - R. Diez - Licensed under the GNU AGPLv3.
+
+use strict;
+use warnings;
+
+use FindBin qw( $Bin $Script );
+use Getopt::Long;
+use IO::Handle;
+use IO::Select;
+use Fcntl;
+use POSIX qw( EAGAIN );
+use Time::HiRes qw( time );
+
+use constant EXIT_CODE_SUCCESS       => 0;
+use constant EXIT_CODE_FAILURE_ARGS  => 1;
+use constant EXIT_CODE_FAILURE_ERROR => 2;
+
+use constant TRUE  => 1;
+use constant FALSE => 0;
+
+use constant EOL => "\r\n";
+
+# A line feed after the carriage return would stay in the DebugDue's Rx Buffer and count as test data.
+use constant CMD_TERMINATOR => "\r";
+
+use constant START_MSG  => "Starting USB speed test..." . EOL . ">";
+use constant FINISH_MSG => "USB speed test finished." . EOL . ">";
+
+# See FULL_DUPLEX_END_MARKER in BusPirateConsole.cpp .
+use constant FULL_DUPLEX_END_MARKER => "X";
+
+use constant MAX_PING_SIZE => 1024;
+
+# The DebugDue gives up after USB_SPEED_TEST_IDLE_TIMEOUT_MS, so wait a little longer than that.
+use constant IDLE_TIMEOUT => 7;
+
+# How much of the incoming data to keep when looking for the results at the end.
+use constant MAX_TAIL_LEN => 65536;
+
+my $g_printRawResults = FALSE;
+my $g_isConfigPrinted = FALSE;
+
+
+sub write_stdout ( $ )
+{
+  ( print STDOUT $_[0] ) or die "Error writing to standard output: $!\n";
+}
+
+
+# ------------ Serial port ------------
+
+# The serial port is in non-blocking mode, so that test FullDuplex can read and write at the same time.
+
+sub read_available ( $ $ $ )
+{
+  my $fh      = shift;
+  my $dataRef = shift;
+  my $timeout = shift;
+
+  my $select = IO::Select->new( $fh );
+
+  return 0 if !$select->can_read( $timeout );
+
+  my $readCount = sysread( $fh, $$dataRef, 65536, length( $$dataRef ) );
+
+  if ( !defined( $readCount ) )
+  {
+    return 0 if $! == EAGAIN;
+
+    die "Error reading from the serial port: $!\n";
+  }
+
+  if ( $readCount == 0 )
+  {
+    die "The serial port has been closed.\n";
+  }
+
+  return $readCount;
+}
+
+
+sub read_exactly ( $ $ $ )
+{
+  my $fh        = shift;
+  my $byteCount = shift;
+  my $context   = shift;
+
+  my $data = "";
+  my $endTime = time() + IDLE_TIMEOUT;
+
+  while ( length( $data ) < $byteCount )
+  {
+    my $remaining = $endTime - time();
+
+    if ( $remaining <= 0 )
+    {
+      die "Timeout waiting for $context.\n";
+    }
+
+    # Do not read past the requested data, because the results may follow.
+    my $chunk = "";
+    my $select = IO::Select->new( $fh );
+
+    next if !$select->can_read( $remaining );
+
+    my $readCount = sysread( $fh, $chunk, $byteCount - length( $data ) );
+
+    if ( !defined( $readCount ) )
+    {
+      next if $! == EAGAIN;
+
+      die "Error reading from the serial port: $!\n";
+    }
+
+    if ( $readCount == 0 )
+    {
+      die "The serial port has been closed.\n";
+    }
+
+    $data .= $chunk;
+  }
+
+  return $data;
+}
+
+
+sub write_all ( $ $ )
+{
+  my $fh   = shift;
+  my $data = shift;
+
+  my $offset = 0;
+  my $select = IO::Select->new( $fh );
+
+  while ( $offset < length( $data ) )
+  {
+    my $writtenCount = syswrite( $fh, $data, length( $data ) - $offset, $offset );
+
+    if ( !defined( $writtenCount ) )
+    {
+      if ( $! == EAGAIN )
+      {
+        $select->can_write( 1 );
+        next;
+      }
+
+      die "Error writing to the serial port: $!\n";
+    }
+
+    $offset += $writtenCount;
+  }
+}
+
+
+# Reads until the given text arrives and returns everything up to and including it.
+
+sub read_until ( $ $ $ )
+{
+  my $fh      = shift;
+  my $text    = shift;
+  my $timeout = shift;
+
+  my $data = "";
+  my $endTime = time() + $timeout;
+
+  for ( ; ; )
+  {
+    my $pos = index( $data, $text );
+
+    return substr( $data, 0, $pos + length( $text ) ) if $pos != -1;
+
+    my $remaining = $endTime - time();
+
+    if ( $remaining <= 0 )
+    {
+      die qq<Timeout waiting for "$text", received so far: "$data"\n>;
+    }
+
+    read_available( $fh, \$data, $remaining );
+  }
+}
+
+
+sub open_serial_port ( $ )
+{
+  my $device = shift;
+
+  system( "stty", "-F", $device, "raw", "-echo" ) == 0
+    or die qq<Cannot configure serial port "$device" with stty.\n>;
+
+  sysopen( my $fh, $device, O_RDWR | O_NOCTTY | O_NONBLOCK ) or die qq<Cannot open serial port "$device": $!\n>;
+
+  # Discard anything the console may have printed so far, and make sure that we get a prompt.
+  my $discarded = "";
+  while ( read_available( $fh, \$discarded, 0.2 ) != 0 )
+  {
+  }
+
+  write_all( $fh, CMD_TERMINATOR );
+  read_until( $fh, ">", 3 );
+
+  return $fh;
+}
+
+
+# ------------ Speed tests ------------
+
+sub start_test ( $ $ )
+{
+  my $fh      = shift;
+  my $command = shift;
+
+  write_all( $fh, "UsbSpeedTest $command" . CMD_TERMINATOR );
+
+  my $reply = read_until( $fh, ">", 3 );
+
+  if ( index( $reply, START_MSG ) == -1 )
+  {
+    die qq<The DebugDue did not start test "$command", the reply was: "$reply"\n>;
+  }
+}
+
+
+# Each result line is a keyword followed by "name=value" pairs. Returns a list of hashes,
+# with the keyword stored under name "type".
+
+sub parse_result_lines ( $ )
+{
+  my $text = shift;
+
+  my @results;
+
+  foreach my $line ( split( EOL, $text ) )
+  {
+    next if $line !~ m/\A(CONFIG|RESULT|HIST) (.*)\z/;
+
+    write_stdout( "  $line\n" ) if $g_printRawResults;
+
+    my %fields = ( type => $1 );
+
+    foreach my $pair ( split( / /, $2 ) )
+    {
+      if ( $pair !~ m/\A(\w+)=(\S*)\z/ )
+      {
+        die qq<Invalid result field "$pair".\n>;
+      }
+
+      $fields{ $1 } = $2;
+    }
+
+    push @results, \%fields;
+  }
+
+  return @results;
+}
+
+
+# Reads and discards the test data until the DebugDue has printed the results.
+# Returns the number of bytes received and the result lines.
+
+sub read_results ( $ $ )
+{
+  my $fh      = shift;
+  my $timeout = shift;
+
+  my $tail = "";
+  my $byteCount = 0;
+  my $lastActivityTime = time();
+  my $endTime = time() + $timeout;
+
+  for ( ; ; )
+  {
+    my $pos = index( $tail, FINISH_MSG );
+
+    if ( $pos != -1 )
+    {
+      my $resultsPos = rindex( $tail, EOL . "CONFIG ", $pos );
+
+      if ( $resultsPos == -1 )
+      {
+        die "The DebugDue finished the test without printing any results.\n";
+      }
+
+      return ( $byteCount - ( length( $tail ) - $resultsPos ), parse_result_lines( substr( $tail, $resultsPos, $pos - $resultsPos ) ) );
+    }
+
+    if ( time() > $endTime || time() - $lastActivityTime > IDLE_TIMEOUT )
+    {
+      die "Timeout waiting for the test results.\n";
+    }
+
+    my $readCount = read_available( $fh, \$tail, 0.5 );
+
+    if ( $readCount != 0 )
+    {
+      $byteCount += $readCount;
+      $lastActivityTime = time();
+
+      if ( length( $tail ) > MAX_TAIL_LEN * 2 )
+      {
+        # Keep enough to find the results, which may have arrived partially.
+        $tail = substr( $tail, -MAX_TAIL_LEN );
+      }
+    }
+  }
+}
+
+
+sub check_status ( $ )
+{
+  my $result = shift;
+
+  if ( $result->{ status } ne "ok" )
+  {
+    die "Test $result->{test} finished with status \"$result->{status}\".\n";
+  }
+}
+
+
+sub print_config ( $ )
+{
+  my $results = shift;
+
+  # The settings are the same for all tests.
+  return if $g_isConfigPrinted;
+
+  foreach my $r ( @$results )
+  {
+    next if $r->{ type } ne "CONFIG";
+
+    $g_isConfigPrinted = TRUE;
+
+    write_stdout( sprintf( "USB settings: packet size %u, Rx Buffer %u, Tx Buffer %u, Tx coalescing %s (flush timeout %u us), low-latency mode %s.\n",
+                           $r->{ packet_size },
+                           $r->{ rx_buffer_size },
+                           $r->{ tx_buffer_size },
+                           $r->{ tx_coalescing } ? "on" : "off",
+                           $r->{ tx_flush_timeout_us },
+                           $r->{ low_latency_mode } ? "on" : "off" ) );
+    return;
+  }
+}
+
+
+sub format_rate ( $ )
+{
+  return sprintf( "%.1f KiB/s", $_[0] / 1024 );
+}
+
+
+sub percentile ( $ $ )
+{
+  my $sortedValues = shift;
+  my $percent      = shift;
+
+  my $index = int( ( scalar( @$sortedValues ) - 1 ) * $percent / 100 + 0.5 );
+
+  return $sortedValues->[ $index ];
+}
+
+
+sub run_ping_pong ( $ $ $ )
+{
+  my $fh        = shift;
+  my $pingCount = shift;
+  my $pingSize  = shift;
+
+  write_stdout( "\nPingPong test with $pingCount pings of $pingSize bytes:\n" );
+
+  start_test( $fh, "PingPong $pingCount $pingSize" );
+
+  my $ping = "p" x $pingSize;
+  my @roundTripsUs;
+
+  for ( my $i = 0; $i < $pingCount; ++$i )
+  {
+    my $startTime = time();
+
+    write_all( $fh, $ping );
+
+    my $echo = read_exactly( $fh, $pingSize, "the echo of ping number " . ( $i + 1 ) );
+
+    push @roundTripsUs, ( time() - $startTime ) * 1000000;
+
+    if ( $echo ne $ping )
+    {
+      die "Ping number " . ( $i + 1 ) . " came back corrupted.\n";
+    }
+  }
+
+  my ( undef, @results ) = read_results( $fh, IDLE_TIMEOUT );
+
+  print_config( \@results );
+
+  my @sorted = sort { $a <=> $b } @roundTripsUs;
+  my $sum = 0;
+  $sum += $_ foreach @sorted;
+
+  write_stdout( sprintf( "Host-side round trip:      min %u us, avg %u us, median %u us, 99%% %u us, max %u us.\n",
+                         $sorted[ 0 ], $sum / scalar( @sorted ), percentile( \@sorted, 50 ), percentile( \@sorted, 99 ), $sorted[ -1 ] ) );
+
+  foreach my $r ( @results )
+  {
+    if ( $r->{ type } eq "RESULT" )
+    {
+      check_status( $r );
+
+      write_stdout( sprintf( "DebugDue-side round trip:  min %u us, avg %u us, max %u us, over %u samples.\n",
+                             $r->{ min_us }, $r->{ avg_us }, $r->{ max_us }, $r->{ sample_count } ) );
+    }
+    elsif ( $r->{ type } eq "HIST" )
+    {
+      write_stdout( sprintf( "  %7u - %-7s us: %u\n", $r->{ from_us }, $r->{ to_us }, $r->{ count } ) );
+    }
+  }
+}
+
+
+sub run_full_duplex ( $ $ )
+{
+  my $fh       = shift;
+  my $duration = shift;
+
+  write_stdout( "\nFullDuplex test for $duration seconds:\n" );
+
+  start_test( $fh, "FullDuplex" );
+
+  my $txData = "." x 4096;
+  my $txByteCount = 0;
+  my $rxByteCount = 0;
+  my $rxData = "";
+
+  my $select = IO::Select->new( $fh );
+  my $startTime = time();
+
+  while ( time() - $startTime < $duration )
+  {
+    my ( $canRead, $canWrite ) = IO::Select->select( $select, $select, undef, 0.1 );
+
+    if ( $canWrite && @$canWrite )
+    {
+      my $writtenCount = syswrite( $fh, $txData );
+
+      if ( defined( $writtenCount ) )
+      {
+        $txByteCount += $writtenCount;
+      }
+      elsif ( $! != EAGAIN )
+      {
+        die "Error writing to the serial port: $!\n";
+      }
+    }
+
+    if ( $canRead && @$canRead )
+    {
+      $rxData = "";
+      $rxByteCount += read_available( $fh, \$rxData, 0 );
+    }
+  }
+
+  my $elapsed = time() - $startTime;
+
+  write_all( $fh, FULL_DUPLEX_END_MARKER );
+
+  my ( undef, @results ) = read_results( $fh, IDLE_TIMEOUT );
+
+  print_config( \@results );
+
+  write_stdout( sprintf( "Host side:      sent %s, received %s.\n",
+                         format_rate( $txByteCount / $elapsed ), format_rate( $rxByteCount / $elapsed ) ) );
+
+  foreach my $r ( @results )
+  {
+    next if $r->{ type } ne "RESULT";
+
+    check_status( $r );
+
+    write_stdout( sprintf( "DebugDue side:  received %s, sent %s, over %u ms.\n",
+                           format_rate( $r->{ rx_bytes_per_s } ), format_rate( $r->{ tx_bytes_per_s } ), $r->{ duration_ms } ) );
+  }
+}
+
+
+sub run_tx_size_sweep ( $ $ )
+{
+  my $fh         = shift;
+  my $stepTimeMs = shift;
+
+  write_stdout( "\nTxSizeSweep test with $stepTimeMs ms per write size:\n" );
+
+  start_test( $fh, "TxSizeSweep $stepTimeMs" );
+
+  # We do not know how many write sizes there are, so just wait for the DebugDue to stop sending.
+  my ( undef, @results ) = read_results( $fh, 3600 );
+
+  print_config( \@results );
+
+  my $best;
+
+  foreach my $r ( @results )
+  {
+    next if $r->{ type } ne "RESULT";
+
+    check_status( $r );
+
+    $best = $r if !defined( $best ) || $r->{ bytes_per_s } > $best->{ bytes_per_s };
+  }
+
+  foreach my $r ( @results )
+  {
+    next if $r->{ type } ne "RESULT";
+
+    write_stdout( sprintf( "  Write size %4u: %14s in %7u write calls%s\n",
+                           $r->{ write_size },
+                           format_rate( $r->{ bytes_per_s } ),
+                           $r->{ write_calls },
+                           $r == $best ? "  <- best" : "" ) );
+  }
+}
+
+
+sub main ()
+{
+  my $arg_device;
+  my $arg_test = "All";
+  my $arg_pingCount = 1000;
+  my $arg_pingSizes = "1,63,64,65,512";
+  my $arg_duration = 5;
+  my $arg_stepTime = 500;
+  my $arg_help = FALSE;
+
+  Getopt::Long::Configure( "no_auto_abbrev", "prefix_pattern=(--|-)", "no_ignore_case" );
+
+  my $result = GetOptions(
+                 'help'         => \$arg_help,
+                 'device=s'     => \$arg_device,
+                 'test=s'       => \$arg_test,
+                 'ping-count=i' => \$arg_pingCount,
+                 'ping-sizes=s' => \$arg_pingSizes,
+                 'duration=f'   => \$arg_duration,
+                 'step-time=i'  => \$arg_stepTime,
+                 'raw'          => \$g_printRawResults
+               );
+
+  if ( not $result )
+  {
+    # GetOptions has already printed an error message.
+    return EXIT_CODE_FAILURE_ARGS;
+  }
+
+  if ( $arg_help )
+  {
+    write_stdout( "See the comments at the beginning of script $Bin/$Script for usage information.\n" );
+    return EXIT_CODE_SUCCESS;
+  }
+
+  if ( !defined( $arg_device ) )
+  {
+    die "Please specify option --device.\n";
+  }
+
+  if ( $arg_test !~ m/\A(PingPong|FullDuplex|TxSizeSweep|All)\z/ )
+  {
+    die qq<Unknown test "$arg_test".\n>;
+  }
+
+  if ( $arg_pingCount < 1 )
+  {
+    die "The ping count must be at least 1.\n";
+  }
+
+  my @pingSizes = split( /,/, $arg_pingSizes );
+
+  foreach my $size ( @pingSizes )
+  {
+    if ( $size !~ m/\A\d+\z/ || $size < 1 || $size > MAX_PING_SIZE )
+    {
+      die "Invalid ping size \"$size\", it must be between 1 and " . MAX_PING_SIZE . " bytes.\n";
+    }
+  }
+
+  if ( $arg_duration <= 0 )
+  {
+    die "The duration must be positive.\n";
+  }
+
+  my $fh = open_serial_port( $arg_device );
+
+  my $runAll = $arg_test eq "All";
+
+  if ( $runAll || $arg_test eq "PingPong" )
+  {
+    run_ping_pong( $fh, $arg_pingCount, $_ ) foreach @pingSizes;
+  }
+
+  if ( $runAll || $arg_test eq "FullDuplex" )
+  {
+    run_full_duplex( $fh, $arg_duration );
+  }
+
+  if ( $runAll || $arg_test eq "TxSizeSweep" )
+  {
+    run_tx_size_sweep( $fh, $arg_stepTime );
+  }
+
+  close( $fh ) or die "Cannot close the serial port: $!\n";
+
+  return EXIT_CODE_SUCCESS;
+}
+
+
+# ------------ Script entry point ------------
+
+eval
+{
+  my $exitCode = main();
+  exit $exitCode;
+};
+
+my $errorMessage = $@;
+
+# We want the error message to be the last thing on the screen,
+# so we need to flush the standard output first.
+STDOUT->flush();
+
+print STDERR "\nError running \"$Bin/$Script\": $errorMessage";
+
+exit EXIT_CODE_FAILURE_ERROR;